@@ -0,0 +1,302 @@
+#include "RenderServer.hpp"
+#include "ViewerApplication.hpp"
+#include "utils/headlessContext.hpp"
+#include "utils/localSocket.hpp"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string base64Encode(const std::vector<unsigned char> &bytes)
+{
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string encoded;
+  encoded.reserve((bytes.size() + 2) / 3 * 4);
+  for (size_t i = 0; i < bytes.size(); i += 3) {
+    const auto remaining = bytes.size() - i;
+    const uint32_t group = bytes[i] << 16 |
+                           (remaining > 1 ? bytes[i + 1] << 8 : 0) |
+                           (remaining > 2 ? bytes[i + 2] : 0);
+    encoded += alphabet[(group >> 18) & 63];
+    encoded += alphabet[(group >> 12) & 63];
+    encoded += remaining > 1 ? alphabet[(group >> 6) & 63] : '=';
+    encoded += remaining > 2 ? alphabet[group & 63] : '=';
+  }
+  return encoded;
+}
+
+bool isBlank(const std::string &line)
+{
+  return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+} // namespace
+
+RenderServer::RenderServer(const Options &options) : m_Options(options)
+{
+  // The models are rendered by threads with their own context, without
+  // window: check now that one can be created
+  HeadlessContext context;
+  std::cout << "Render server: " << context.description() << std::endl;
+}
+
+RenderServer::~RenderServer()
+{
+  while (!m_Models.empty()) {
+    release(std::prev(m_Models.end()));
+  }
+}
+
+std::string RenderServer::handle(const std::string &line)
+{
+  using nlohmann::json;
+  const auto start = std::chrono::steady_clock::now();
+
+  json response = json::object();
+  bool render = false;
+  try {
+    const auto request = json::parse(line);
+    if (!request.is_object()) {
+      throw std::runtime_error("Expected a JSON object");
+    }
+    if (request.count("id")) {
+      response["id"] = request["id"];
+    }
+    const auto command = request.value("command", std::string("render"));
+
+    if (command == "render") {
+      render = true;
+      ++m_RenderCount;
+      const auto modelIt = request.find("model");
+      if (modelIt == request.end() || !modelIt->is_string()) {
+        throw std::runtime_error("\"model\" must be the path of a model");
+      }
+      RenderJob job;
+      job.view = cameraViewFromJson(request, "Request", &job.hasCamera);
+      const auto sampleCount = request.value("spp", 1);
+      if (sampleCount < 1) {
+        throw std::runtime_error("\"spp\" must be at least 1");
+      }
+      job.sampleCount = uint32_t(sampleCount);
+      if (request.count("output")) {
+        job.outputPath = request["output"].get<std::string>();
+        job.format = imageFormatFromPath(job.outputPath);
+      } else {
+        job.format = imageFormatFromPath(
+            "image." + request.value("format", std::string("png")));
+      }
+
+      const fs::path modelPath = modelIt->get<std::string>();
+      if (!fs::exists(modelPath)) {
+        throw std::runtime_error("No such model " + modelPath.string());
+      }
+      bool cached = false;
+      auto &model = this->model(fs::canonical(modelPath), cached);
+      auto result = model.queue.render(job);
+      if (!result.ok) {
+        if (model.queue.isStopped()) {
+          release(m_Models.begin());
+        }
+        throw std::runtime_error(result.error);
+      }
+      if (!cached) {
+        evict();
+      }
+
+      response["ok"] = true;
+      response["width"] = result.width;
+      response["height"] = result.height;
+      response["cached"] = cached;
+      response["renderMs"] = result.renderTime;
+      response["encodeMs"] = result.encodeTime;
+      if (job.outputPath.empty()) {
+        response["format"] = imageFormatName(job.format);
+        response["data"] = base64Encode(result.bytes);
+      } else {
+        response["output"] = job.outputPath.string();
+      }
+    } else if (command == "stats") {
+      json buckets = json::array();
+      for (size_t i = 0; i < m_Latency.bucketCount(); ++i) {
+        if (!m_Latency.bucketSampleCount(i)) {
+          continue;
+        }
+        const auto bound = m_Latency.bucketBound(i);
+        buckets.push_back(
+            {{"le", i + 1 < m_Latency.bucketCount() ? json(bound) : "inf"},
+                {"count", m_Latency.bucketSampleCount(i)}});
+      }
+      json models = json::array();
+      size_t hostBytes = 0, gpuBytes = 0;
+      for (const auto &model : m_Models) {
+        models.push_back({{"model", model->path.string()},
+            {"hostBytes", model->queue.hostBytes()},
+            {"gpuBytes", model->queue.gpuBytes()}});
+        hostBytes += model->queue.hostBytes();
+        gpuBytes += model->queue.gpuBytes();
+      }
+      response["ok"] = true;
+      response["renders"] = m_RenderCount;
+      response["errors"] = m_ErrorCount;
+      response["latencyMs"] = {{"count", m_Latency.count()},
+          {"mean", m_Latency.mean()}, {"p50", m_Latency.percentile(0.5)},
+          {"p90", m_Latency.percentile(0.9)},
+          {"p99", m_Latency.percentile(0.99)}, {"max", m_Latency.max()},
+          {"buckets", buckets}};
+      response["cache"] = {{"hits", m_HitCount}, {"misses", m_MissCount},
+          {"evictions", m_EvictionCount}, {"hostBytes", hostBytes},
+          {"gpuBytes", gpuBytes}, {"models", models}};
+    } else if (command == "shutdown") {
+      m_Shutdown = true;
+      response["ok"] = true;
+    } else {
+      throw std::runtime_error("Unknown command " + command);
+    }
+  } catch (const std::exception &e) {
+    // Parse and type errors of the JSON library, or of the request
+    ++m_ErrorCount;
+    response["ok"] = false;
+    response["error"] = e.what();
+  }
+
+  if (render && response["ok"].get<bool>()) {
+    const auto latency = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start)
+                             .count();
+    m_Latency.add(latency);
+    response["totalMs"] = latency;
+  }
+  return response.dump();
+}
+
+void RenderServer::serveStdio()
+{
+  // The renderer logs with std::cout and printf: the standard output is
+  // redirected to the error output, the responses keep the original one
+  std::cout.flush();
+  std::fflush(stdout);
+  auto *responses = fdopen(dup(fileno(stdout)), "w");
+  if (!responses) {
+    throw std::runtime_error("Unable to keep the standard output.");
+  }
+  dup2(fileno(stderr), fileno(stdout));
+
+  std::string line;
+  while (!m_Shutdown && std::getline(std::cin, line)) {
+    if (isBlank(line)) {
+      continue;
+    }
+    const auto response = handle(line) + "\n";
+    std::fputs(response.c_str(), responses);
+    std::fflush(responses);
+  }
+  std::fclose(responses);
+}
+
+void RenderServer::serveSocket(const fs::path &path)
+{
+  auto listener = LocalSocket::listen(path);
+  std::cout << "Render server listening on " << path << std::endl;
+  while (!m_Shutdown) {
+    auto client = listener.accept();
+    std::string line;
+    try {
+      while (!m_Shutdown && client.readLine(line)) {
+        if (!isBlank(line)) {
+          client.writeLine(handle(line));
+        }
+      }
+    } catch (const std::length_error &e) {
+      // Refuse the request with an error and drop the client
+      ++m_ErrorCount;
+      std::cerr << e.what() << std::endl;
+      const nlohmann::json response = {{"ok", false}, {"error", e.what()}};
+      try {
+        client.writeLine(response.dump());
+      } catch (const std::runtime_error &) {
+      }
+    } catch (const std::runtime_error &e) {
+      // The client left, the server goes on
+      std::cerr << e.what() << std::endl;
+    }
+  }
+}
+
+RenderServer::Model &RenderServer::model(const fs::path &path, bool &cached)
+{
+  const auto it = std::find_if(m_Models.begin(), m_Models.end(),
+      [&](const std::unique_ptr<Model> &model) { return model->path == path; });
+  cached = it != m_Models.end();
+  if (cached) {
+    ++m_HitCount;
+    m_Models.splice(m_Models.begin(), m_Models, it);
+    return *m_Models.front();
+  }
+
+  ++m_MissCount;
+  std::cout << "Render server: loading " << path << std::endl;
+  auto model = std::make_unique<Model>();
+  model->path = path;
+  auto &queue = model->queue;
+  model->thread = std::thread([this, path, &queue]() {
+    try {
+      ViewerApplication::Options options;
+      options.appPath = m_Options.appPath;
+      options.width = m_Options.width;
+      options.height = m_Options.height;
+      options.gltfFile = path;
+      options.deferredRendering = m_Options.deferredRendering;
+      options.environment = m_Options.environment;
+      options.encoderThreadCount = 1;
+      options.renderQueue = &queue;
+      ViewerApplication app{options};
+      app.run();
+      queue.stopped();
+    } catch (const std::exception &e) {
+      queue.stopped(e.what());
+    }
+  });
+  m_Models.push_front(std::move(model));
+  return *m_Models.front();
+}
+
+void RenderServer::release(std::list<std::unique_ptr<Model>>::iterator it)
+{
+  auto &model = **it;
+  model.queue.close();
+  model.thread.join();
+  m_Models.erase(it);
+}
+
+void RenderServer::evict()
+{
+  const auto overBounds = [&]() {
+    size_t hostBytes = 0, gpuBytes = 0;
+    for (const auto &model : m_Models) {
+      hostBytes += model->queue.hostBytes();
+      gpuBytes += model->queue.gpuBytes();
+    }
+    return m_Models.size() > m_Options.maxModelCount ||
+           (m_Options.maxHostBytes && hostBytes > m_Options.maxHostBytes) ||
+           (m_Options.maxGpuBytes && gpuBytes > m_Options.maxGpuBytes);
+  };
+  while (m_Models.size() > 1 && overBounds()) {
+    std::cout << "Render server: releasing " << m_Models.back()->path
+              << std::endl;
+    release(std::prev(m_Models.end()));
+    ++m_EvictionCount;
+  }
+}
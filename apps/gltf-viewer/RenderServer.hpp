@@ -0,0 +1,94 @@
+#pragma once
+
+#include "utils/filesystem.hpp"
+#include "utils/latencyHistogram.hpp"
+#include "utils/renderQueue.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Render server of the serve command: renders images of glTF models on
+// request, without paying the process start, the OpenGL context, the shaders
+// and the model load for each image.
+//
+// The requests and their responses are JSON objects, one per line:
+// - {"command": "render", "model": "scene.gltf", ...}, the default command.
+// The view is given as in the files of --cameras ("eye", "center", "up",
+// "fov", "width", "height"), the default camera of the model without "eye".
+// "spp" is the samples per pixel. The image is written to "output", in the
+// format of its extension, else it is returned base64 encoded in the "data"
+// of the response, in "format" (png by default).
+// - {"command": "stats"}: the latency histogram of the renders, and the
+// models in the cache.
+// - {"command": "shutdown"}: stop the server after the response.
+// The "id" of a request is copied to its response. A response has "ok", and
+// an "error" if it failed.
+//
+// Each model is loaded by its own thread, with its own headless OpenGL
+// context, running a ViewerApplication on a RenderQueue. The models stay
+// loaded in a least recently used cache, bounded by a number of models and by
+// their host and GPU memory (see estimateModelMemory): when a new model goes
+// over a bound, the least recently used ones are released with their context.
+// The requests are handled one at a time.
+class RenderServer
+{
+public:
+  struct Options
+  {
+    fs::path appPath;
+    uint32_t width = 1280; // Of the images without width and height
+    uint32_t height = 720;
+    bool deferredRendering = false;
+    fs::path environment;
+    size_t maxModelCount = 4;
+    size_t maxHostBytes = 0; // 0 for no bound
+    size_t maxGpuBytes = 0;
+  };
+
+  // Throw std::runtime_error if no headless context can be created
+  explicit RenderServer(const Options &options);
+  ~RenderServer();
+
+  RenderServer(const RenderServer &) = delete;
+  RenderServer &operator=(const RenderServer &) = delete;
+
+  // The response to a request
+  std::string handle(const std::string &request);
+  bool shutdownRequested() const { return m_Shutdown; }
+
+  // Serve the requests of the standard input until its end or a shutdown.
+  // The responses go to the standard output, the logs to the error output.
+  void serveStdio();
+  // Serve the clients of a local socket, one after the other, until a
+  // shutdown
+  void serveSocket(const fs::path &path);
+
+private:
+  struct Model
+  {
+    fs::path path;
+    RenderQueue queue;
+    std::thread thread; // Running the ViewerApplication of the model
+  };
+
+  // The model of a path, loaded by a new thread if it is not in the cache
+  Model &model(const fs::path &path, bool &cached);
+  void release(std::list<std::unique_ptr<Model>>::iterator it);
+  // Release the least recently used models, except the most recent one,
+  // until the cache is within its bounds
+  void evict();
+
+  Options m_Options;
+  std::list<std::unique_ptr<Model>> m_Models; // Most recently used first
+  LatencyHistogram m_Latency;                 // Of the render requests
+  size_t m_RenderCount = 0;
+  size_t m_ErrorCount = 0;
+  size_t m_HitCount = 0;
+  size_t m_MissCount = 0;
+  size_t m_EvictionCount = 0;
+  bool m_Shutdown = false;
+};
@@ -1,12 +1,14 @@
 /** Branch Many Lights Test **/
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <iostream>
-#include <numeric>
+#include <sstream>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 
@@ -14,14 +16,20 @@
 #include "utils/TrackballCameraController.hpp"
 #include "utils/cameraControllerInterface.hpp"
 #include "utils/cameras.hpp"
-#include <stb_image_write.h>
 #include <tiny_gltf.h>
 
 // Include for DrawNode --> calcul ModelMatrix
 #include "utils/gltf.hpp"
 #include "utils/images.hpp"
-
-#define NB_POINTS_LIGHTS 3
+#include "utils/clusteredLights.hpp"
+#include "utils/dynamicResolution.hpp"
+#include "utils/meshArena.hpp"
+#include "utils/offscreenOutput.hpp"
+#include "utils/renderQueue.hpp"
+#include "utils/redrawScheduler.hpp"
+#include "utils/sceneRenderer.hpp"
+#include "utils/shaderWatcher.hpp"
+#include "utils/shadowMaps.hpp"
 
 ////////////////////////////////////////////////
 /// OpenGL project
@@ -36,102 +44,21 @@ void keyCallback(
   }
 }
 
-int ViewerApplication::run()
+// The shaders of the source tree, edited by the hot reload, or their build
+// copies when the sources are not there (e.g. an installed build)
+static fs::path shadersSourcePath(const fs::path &shadersPath)
 {
-  // Loader shaders
-  const auto glslProgram =
-      compileProgram({m_ShadersRootPath / m_AppName / m_vertexShader,
-          m_ShadersRootPath / m_AppName / m_fragmentShader});
-
-  // NORMAL MAPPING //
-  const auto modelMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelMatrix");
-
-  const auto modelViewProjMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewProjMatrix");
-  const auto modelViewMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewMatrix");
-  const auto normalMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMatrix");
-
-  /** Directional Light **/
-  const auto lightDirectionLocation =
-      glGetUniformLocation(glslProgram.glId(), "dirLight.uLightDirection");
-  const auto lightIntensityLocation =
-      glGetUniformLocation(glslProgram.glId(), "dirLight.uLightIntensity");
-
-  /** Point light **/
-  GLint pointLightPositionLocation[NB_POINTS_LIGHTS];
-  GLint pointLightColorLocation[NB_POINTS_LIGHTS];
-  GLint pointLightConstantLocation[NB_POINTS_LIGHTS];
-  GLint pointLightQuadraticLocation[NB_POINTS_LIGHTS];
-  GLint pointLightLinearLocation[NB_POINTS_LIGHTS];
-  std::string position;
-  std::string color;
-  std::string constant;
-  std::string quadratic;
-  std::string linear;
-
-  for (int i = 0; i < NB_POINTS_LIGHTS; ++i) {
-    position = "pointLight[" + std::to_string(i) + "].position";
-    color = "pointLight[" + std::to_string(i) + "].color";
-    constant = "pointLight[" + std::to_string(i) + "].constant";
-    quadratic = "pointLight[" + std::to_string(i) + "].quadratic";
-    linear = "pointLight[" + std::to_string(i) + "].linear";
-
-    pointLightPositionLocation[i] =
-        glGetUniformLocation(glslProgram.glId(), position.c_str());
-    pointLightColorLocation[i] =
-        glGetUniformLocation(glslProgram.glId(), color.c_str());
-    pointLightConstantLocation[i] =
-        glGetUniformLocation(glslProgram.glId(), constant.c_str());
-    pointLightQuadraticLocation[i] =
-        glGetUniformLocation(glslProgram.glId(), quadratic.c_str());
-    pointLightLinearLocation[i] =
-        glGetUniformLocation(glslProgram.glId(), linear.c_str());
+#ifdef GLMLV_SHADERS_SOURCE_DIR
+  const fs::path sourcePath = GLMLV_SHADERS_SOURCE_DIR;
+  if (fs::is_directory(sourcePath)) {
+    return sourcePath;
   }
+#endif
+  return shadersPath;
+}
 
-  /** Spot light **/
-  const auto spotLightPositionLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.position");
-  const auto spotLightDirectionLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.direction");
-  const auto spotLightColorLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.color");
-  const auto spotLightCutOffLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.cutOff");
-  const auto spotLightOuterCutOffLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.outerCutOff");
-  const auto spotLightConstantLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.constant");
-  const auto spotLightLinearLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.linear");
-  const auto spotLightQuadraticLocation =
-      glGetUniformLocation(glslProgram.glId(), "spotLight.quadratic");
-
-  const auto baseColorTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uBaseColorTexture");
-  const auto baseColorFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uBaseColorFactor");
-
-  const auto metallicFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uMetallicFactor");
-  const auto metallicRoughnessTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uMetallicRoughnessTexture");
-  const auto roughnessFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uRoughnessFactor");
-
-  const auto emissiveFactorLocation =
-      glGetUniformLocation(glslProgram.glId(), "uEmissiveFactor");
-  const auto emissiveTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uEmissiveTexture");
-
-  // NORMAL MAPPING //
-  const auto normalMappingLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMapping");
-  const auto normalTextureLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalTexture");
-
+int ViewerApplication::run()
+{
   tinygltf::Model model;
   // TODO Loading the glTF file
   if (!loadGltfFile(model)) {
@@ -139,21 +66,48 @@ int ViewerApplication::run()
     return false;
   }
 
-  //  compute the bounding box of the scene
-  glm::vec3 bboxMin, bboxMax;
-  computeSceneBounds(model, bboxMin, bboxMax);
-
-  // Diagonal vector
-  const auto diagVector = bboxMax - bboxMin;
-
   // NORMAL MAPPING
   bool normalMapping = false;
 
+  SceneResources resources;
+  resources.textureObjects = createTextureObjects(model);
+
+  // Creation of the per-instance matrices, shared by all the VAOs
+  resources.instanceBufferObject =
+      createInstanceBufferObject(model, resources.instanceBatches);
+
+  // The geometry is uploaded once, either repacked in the arena or as the
+  // buffers of the model
+  resources.useMeshArena = m_useMeshArena;
+  if (m_useMeshArena) {
+    resources.meshArena =
+        createMeshArena(model, resources.instanceBufferObject);
+  } else {
+    // Creation of Buffer Objects
+    std::vector<GLuint> tangentBufferObjects;
+    const auto bufferObjects =
+        createBufferObjects(model, normalMapping, tangentBufferObjects);
+
+    // Creation of Vertex Array Objects
+    resources.vertexArrayObjects = createVertexArrayObjects(model,
+        bufferObjects, tangentBufferObjects, resources.instanceBufferObject,
+        resources.meshToVertexArrays, normalMapping);
+  }
+
+  // Loader shaders: one program per feature mask, built on first use. Linked
+  // programs are stored on disk to skip compilation on next launches.
+  SceneRenderer renderer{model, std::move(resources),
+      m_ShadersRootPath / m_AppName, m_vertexShader, m_fragmentShader,
+      m_AppPath.parent_path() / (m_AppName + ".program-cache"),
+      m_nWindowWidth, m_nWindowHeight};
+  auto &settings = renderer.settings();
+  settings.normalMapping = normalMapping;
+  settings.useDeferredRendering = m_deferredRendering;
+
+  // Diagonal vector
+  const auto diagVector = renderer.bboxMax() - renderer.bboxMin();
   float maxDistance =
       glm::length(diagVector) > 0 ? glm::length(diagVector) : 100.f;
-  const auto projMatrix =
-      glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight,
-          0.001f * maxDistance, 1.5f * maxDistance);
 
   std::unique_ptr<CameraControllerInterface> cameraController =
       std::make_unique<TrackballCameraController>(m_GLFWHandle.window());
@@ -161,7 +115,7 @@ int ViewerApplication::run()
   if (m_hasUserCamera) {
     cameraController->setCamera(m_userCamera);
   } else {
-    const auto center = 0.5f * (bboxMax + bboxMin);
+    const auto center = 0.5f * (renderer.bboxMax() + renderer.bboxMin());
     const auto up = glm::vec3(0, 1, 0);
     // const auto eye = center + diag;
     // When handle flat scenes on the z axis
@@ -178,333 +132,186 @@ int ViewerApplication::run()
   float cosPhi = glm::cos(phi);
   float sinTheta = glm::sin(theta);
   float cosTheta = glm::cos(theta);
-  auto lightDirection =
+  settings.lightDirection =
       glm::vec3(sinTheta * cosPhi, cosTheta, sinTheta * sinPhi);
 
   static float lightIntensityFactor = 3.f;
-  auto lightIntensity = glm::vec3(3.f);
-
-  bool lightFromCamera = false;
-
-  /** Points Lights **/
-  glm::vec3 pointLightIntensity[NB_POINTS_LIGHTS] = {
-      glm::vec3(1.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f)};
-  bool enablePointLight = true;
-  bool enablePointLightAdditionnal = true;
-  glm::vec3 pointLightPosition[NB_POINTS_LIGHTS] = {glm::vec3(-10.f, 5.f, 0.f),
-      glm::vec3(10.f, 5.f, 0.f), glm::vec3(0.f, 5.f, 0.f)};
-
-  /** Spot Light **/
-  auto spotLightIntensity = glm::vec3(1.f);
-  auto spotLightPosition = glm::vec3(0.f);
-  auto spotLightDirection = glm::vec3(0.f, 0.f, -1.f);
-  bool enableSpotLight = true;
-  float spotLightCutOff = 12.5f;
-  float spotLightOuterCutOff = 12.5f;
-
-  const std::vector<GLuint> textureObjects = createTextureObjects(model);
-  float white[] = {1, 1, 1, 1};
-  GLuint whiteTexture = 0;
-  glGenTextures(1, &whiteTexture);
-  glBindTexture(GL_TEXTURE_2D, whiteTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, white);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-  glBindTexture(GL_TEXTURE_2D, 0);
-
-  // Creation of Buffer Objects
-  const auto bufferObjects = createBufferObjects(model, normalMapping);
-
-  // Creation of Vertex Array Objects
-  std::vector<VaoRange> meshToVertexArrays;
-  const auto vertexArrayObjects = createVertexArrayObjects(
-      model, bufferObjects, meshToVertexArrays, normalMapping);
-
-  // Setup OpenGL state for rendering
-  glEnable(GL_DEPTH_TEST);
-  glslProgram.use();
-
-  /** Binding gltf model materials **/
-  const auto bindMaterial = [&](const auto materialIndex) {
-    if (materialIndex >= 0) {
-      // only valid is materialIndex >= 0
-      const auto &material = model.materials[materialIndex];
-      const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
-
-      if (baseColorTextureLocation >= 0) {
-        auto textureObject = whiteTexture;
-        const auto baseColorTextureIndex =
-            pbrMetallicRoughness.baseColorTexture.index;
-        if (baseColorTextureIndex >= 0) {
-          // only valid if pbrMetallicRoughness.baseColorTexture.index >= 0:
-          const tinygltf::Texture &texture =
-              model.textures[baseColorTextureIndex];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
-          }
-        }
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(baseColorTextureLocation, 0);
-      }
 
-      if (baseColorFactorLocation >= 0) {
-        glUniform4f(baseColorFactorLocation,
-            (float)pbrMetallicRoughness.baseColorFactor[0],
-            (float)pbrMetallicRoughness.baseColorFactor[1],
-            (float)pbrMetallicRoughness.baseColorFactor[2],
-            (float)pbrMetallicRoughness.baseColorFactor[3]);
-      }
+  /** Image based lighting **/
+  if (!m_EnvironmentPath.empty()) {
+    renderer.loadEnvironment(
+        m_EnvironmentPath, environmentCacheDirectory(m_AppPath));
+  }
 
-      if (metallicFactorLocation >= 0) {
-        glUniform1f(
-            metallicFactorLocation, (float)pbrMetallicRoughness.metallicFactor);
-      }
-      if (roughnessFactorLocation >= 0) {
-        glUniform1f(roughnessFactorLocation,
-            (float)pbrMetallicRoughness.roughnessFactor);
-      }
-      if (metallicRoughnessTextureLocation > 0) {
-        auto textureObject = 0u;
-        if (pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
-          const auto &texture =
-              model.textures[pbrMetallicRoughness.metallicRoughnessTexture
-                                 .index];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
-          }
-        }
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(metallicRoughnessTextureLocation, 1);
-      }
+  // Progressive refinement: while the camera and the parameters stay still,
+  // jittered samples of the scene are averaged until refinementSampleCount,
+  // then the frames only copy the average and the loop goes idle.
+  bool progressiveRefinement = true;
+  int refinementSampleCount = 64;
+  Camera accumulationCamera; // Camera of the samples accumulated
+  bool resetAccumulation = true;
+
+  // Compile the variants of the materials for the default lights now rather
+  // than during the first frame
+  renderer.precompilePrograms();
+
+  std::string benchmarkReport;
+  if (m_benchmarkRenderers) {
+    // Offscreen, so that the window does not need to be shown
+    std::vector<unsigned char> pixels(3 * m_nWindowWidth * m_nWindowHeight);
+    renderToImage(m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), [&]() {
+      renderer.benchmarkRenderers(cameraController->getCamera());
+    });
+    return 0;
+  }
 
-      if (emissiveTextureLocation >= 0) {
-        GLuint textureObject = 0;
-        const auto emissiveIndex = material.emissiveTexture.index;
-        if (emissiveIndex >= 0) {
-          textureObject = textureObjects[emissiveIndex];
-        }
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(emissiveTextureLocation, 2);
-      }
+  OffscreenOutput::Settings outputSettings;
+  outputSettings.sampleCount = m_outputSampleCount;
+  outputSettings.tileSize = m_TileSize;
+  outputSettings.msaaSampleCount = m_MsaaSampleCount;
+  outputSettings.ssaaFactor = m_SsaaFactor;
+  outputSettings.ssaaFilter = m_SsaaFilter;
+  outputSettings.auxiliaryBuffers = m_AuxiliaryBuffers;
+  outputSettings.thumbnailSizes = m_ThumbnailSizes;
+  outputSettings.encoderThreadCount = m_EncoderThreadCount;
+  OffscreenOutput output{renderer, outputSettings};
+
+  if (m_benchmarkEncoders) {
+    output.benchmarkEncoders(cameraController->getCamera());
+    return 0;
+  }
 
-      if (emissiveFactorLocation >= 0) {
-        auto emissiveFactor = material.emissiveFactor;
-        glUniform3f(emissiveFactorLocation, (float)emissiveFactor[0],
-            (float)emissiveFactor[1], (float)emissiveFactor[2]);
-      }
+  if (m_benchmarkAntialiasing) {
+    output.benchmarkAntialiasing(cameraController->getCamera());
+    return 0;
+  }
 
-      // NORMAL MAPPING //
-      if (normalMappingLocation >= 0) {
-        glUniform1i(normalMappingLocation, (unsigned int)normalMapping);
-      }
-      if (normalTextureLocation >= 0) {
-        GLuint textureObject = 0;
-        const auto normalIndex = material.normalTexture.index;
-        if (normalIndex >= 0) {
-          textureObject = textureObjects[normalIndex];
-        }
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(normalTextureLocation, 2);
-      }
+  if (m_RenderQueue) {
+    // Render server: the model stays loaded, the jobs are rendered one at a
+    // time until the server closes the queue
+    size_t hostBytes = 0, gpuBytes = 0;
+    estimateModelMemory(model, hostBytes, gpuBytes);
+    m_RenderQueue->setModelMemory(hostBytes, gpuBytes);
+    output.serve(*m_RenderQueue, cameraController->getCamera());
+    return 0;
+  }
 
-    } else {
-      if (baseColorTextureLocation >= 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(baseColorTextureLocation, 0);
-      }
-      if (baseColorFactorLocation >= 0) {
-        glUniform4f(baseColorFactorLocation, 1, 1, 1, 1);
-      }
-      if (metallicFactorLocation >= 0) {
-        glUniform1f(metallicFactorLocation, 0.f);
-      }
-      if (roughnessFactorLocation >= 0) {
-        glUniform1f(roughnessFactorLocation, 0.f);
-      }
-      if (metallicRoughnessTextureLocation >= 0) {
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(metallicRoughnessTextureLocation, 0);
-      }
-      if (emissiveTextureLocation >= 0) {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(emissiveTextureLocation, 0);
-      }
-      if (metallicFactorLocation >= 0) {
-        glUniform3f(metallicFactorLocation, 0, 0, 0);
-      }
+  if (m_OrbitFrameCount) {
+    m_CameraViews =
+        orbitCameraViews(cameraController->getCamera(), m_OrbitFrameCount);
+  }
 
-      // NORMAL MAPPING //
-      if (normalMappingLocation >= 0) {
-        glUniform1i(normalMappingLocation, (unsigned int)normalMapping);
-      }
-      if (normalTextureLocation >= 0) {
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(normalTextureLocation, 2);
-      }
+  if (!m_StreamPath.empty()) {
+    // One frame of the camera without views
+    auto views = m_CameraViews;
+    if (views.empty()) {
+      views.push_back(CameraView{cameraController->getCamera()});
     }
-  };
-
-  /** Lambda function to draw the scene **/
-  const auto drawScene = [&](const Camera &camera) {
-    glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    output.stream(views, m_StreamPath, m_StreamFormat, m_FramesPerSecond);
+    return 0;
+  }
 
-    const auto viewMatrix = camera.getViewMatrix();
+  // render in a Image
+  if (!m_OutputPath.empty()) {
+    if (m_CameraViews.empty()) {
+      output.writeImage(cameraController->getCamera(), m_OutputPath);
+    } else {
+      output.writeImages(m_CameraViews, m_OutputPath);
+    }
+    return 0;
+  }
 
-    /** Binding Lights parameters **/
+  // Stats of the renderer, for the GUI
+  const auto &clusteredLights = renderer.clusteredLights();
+  const auto &dynamicResolution = renderer.dynamicResolution();
+  const auto &frameGraph = renderer.frameGraph();
+  const auto &shadowMaps = renderer.shadowMaps();
+  const auto &overdrawMeter = renderer.overdrawMeter();
+  const auto &programBinaryCache = renderer.programBinaryCache();
+  const auto &meshArena = renderer.meshArena();
+
+  // Hot reload: the shaders edited on disk are compiled again, without
+  // reloading the model
+  bool hotReload = false;
+  std::unique_ptr<ShaderFileWatcher> shaderWatcher;
+  GLsizei reloadCount = 0;
+  double reloadLatency = 0; // Milliseconds from the change to new programs
+
+  // Render on demand: when nothing changed since the last frame, it stays on
+  // screen and the loop sleeps until the next event instead of drawing it
+  // again. The timeout only bounds the time between two checks of the state.
+  bool renderOnDemand = true;
+  RedrawScheduler redrawScheduler{m_GLFWHandle.window()};
+  const double idleTimeout = 0.5;
+
+  // Process CPU time (all threads) over wall time, and frames drawn, measured
+  // every second
+  float cpuUsage = 0;
+  float drawnFramesPerSecond = 0;
+  auto statsStartClock = std::clock();
+  auto statsStartTime = glfwGetTime();
+  GLsizei statsFrameCount = 0;
 
-    /** Directionnal Light **/
-    if (lightDirectionLocation >= 0) {
-      if (lightFromCamera)
-        glUniform3f(lightDirectionLocation, 0, 0, 1);
-      else
-        glUniform3fv(lightDirectionLocation, 1,
-            glm::value_ptr(glm::normalize(
-                glm::vec3(viewMatrix * glm::vec4(lightDirection, 0.)))));
-    }
-    if (lightIntensityLocation >= 0) {
-      glUniform3fv(lightIntensityLocation, 1, glm::value_ptr(lightIntensity));
+  // Loop until the user closes the window
+  for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose();
+       ++iterationCount) {
+    if (renderOnDemand) {
+      redrawScheduler.waitEvents(idleTimeout);
     }
 
-    /** Point Light **/
-    for (int i = 0; i < NB_POINTS_LIGHTS; ++i) {
-      if (pointLightPositionLocation[i] >= 0) {
-        if ((i == 0 && enablePointLight) ||
-            (i > 0 && enablePointLightAdditionnal)) {
-          glUniform3fv(pointLightPositionLocation[i], 1,
-              glm::value_ptr(glm::normalize(glm::vec3(
-                  viewMatrix * glm::vec4(pointLightPosition[i], 1.)))));
-          glUniform3fv(pointLightColorLocation[i], 1,
-              glm::value_ptr(pointLightIntensity[i]));
-          glUniform1f(pointLightConstantLocation[i], 1.0f);
-          glUniform1f(pointLightLinearLocation[i], 0.09f);
-          glUniform1f(pointLightQuadraticLocation[i], 0.032f);
-        } else {
-          glUniform3fv(pointLightColorLocation[i], 1,
-              glm::value_ptr(glm::vec3(0, 0, 0)));
-        }
-      }
+    const auto statsTime = glfwGetTime();
+    if (statsTime - statsStartTime >= 1.) {
+      const auto clock = std::clock();
+      cpuUsage = float(100. * (clock - statsStartClock) / CLOCKS_PER_SEC /
+                       (statsTime - statsStartTime));
+      drawnFramesPerSecond =
+          float(statsFrameCount / (statsTime - statsStartTime));
+      statsStartClock = clock;
+      statsStartTime = statsTime;
+      statsFrameCount = 0;
     }
 
-    /** Spot Light **/
-    if (spotLightPositionLocation >= 0) {
-      if (enableSpotLight) {
-        glUniform3fv(
-            spotLightPositionLocation, 1, glm::value_ptr(spotLightPosition));
-        glUniform3fv(
-            spotLightDirectionLocation, 1, glm::value_ptr(spotLightDirection));
-        glUniform3fv(
-            spotLightColorLocation, 1, glm::value_ptr(spotLightIntensity));
-        glUniform1f(
-            spotLightCutOffLocation, glm::cos(glm::radians(spotLightCutOff)));
-        glUniform1f(spotLightOuterCutOffLocation,
-            glm::cos(glm::radians(spotLightOuterCutOff)));
-        glUniform1f(spotLightConstantLocation, 1.0f);
-        glUniform1f(spotLightLinearLocation, 0.09f);
-        glUniform1f(spotLightQuadraticLocation, 0.032f);
-      } else {
-        glUniform3fv(spotLightColorLocation, 1, glm::value_ptr(glm::vec3(0.f)));
-        glUniform1f(spotLightCutOffLocation, glm::cos(glm::radians(0.f)));
+    ShaderFileWatcher::Clock::time_point changeTime;
+    if (shaderWatcher && shaderWatcher->takeChange(changeTime)) {
+      if (m_ShadersSourcePath != m_ShadersRootPath / m_AppName) {
+        copyShaderFiles(m_ShadersSourcePath, m_ShadersRootPath / m_AppName);
       }
+      renderer.reloadShaders();
+      ++reloadCount;
+      reloadLatency = std::chrono::duration<double, std::milli>(
+          ShaderFileWatcher::Clock::now() - changeTime)
+                          .count();
+      redrawScheduler.requestRedraw();
+      resetAccumulation = true;
     }
 
-    // The recursive function that should draw a node
-    // We use a std::function because a simple lambda cannot be recursive
-    const std::function<void(int, const glm::mat4 &)> drawNode =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          const tinygltf::Node &node = model.nodes[nodeIdx];
-          const glm::mat4 modelMatrix =
-              getLocalToWorldMatrix(node, parentMatrix);
-          // si il a une mesh, nous recuperons l'indice
-          if (node.mesh >= 0) {
-            //  init  modelViewMatrix, modelViewProjectionMatrix, and
-            //  normalMatrix
-            const glm::mat4 MV = viewMatrix * modelMatrix;
-            const glm::mat4 MVP = projMatrix * MV;
-            const glm::mat4 N = glm::transpose(glm::inverse(MV));
-            // Send all to Shaders
-            glUniformMatrix4fv(
-                modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix4fv(
-                modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(MV));
-            glUniformMatrix4fv(
-                modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(MVP));
-            glUniformMatrix4fv(
-                normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(N));
-
-            /*********/
-            // node.mesh = l'indice dans model.meshes
-            const auto &mesh = model.meshes[node.mesh];
-            const auto &vaoRange = meshToVertexArrays[node.mesh];
-            // Nous recuperons ensuite les primitives a dessiner --> <
-            // vaoRange.count
-            for (size_t primitiveIndice = 0;
-                 primitiveIndice < mesh.primitives.size(); ++primitiveIndice) {
-              const auto vao =
-                  vertexArrayObjects[vaoRange.begin + primitiveIndice];
-              const auto &primitive = mesh.primitives[primitiveIndice];
-              bindMaterial(primitive.material);
-              glBindVertexArray(vao);
-              if (primitive.indices >= 0) {
-                const auto &accessor = model.accessors[primitive.indices];
-                const auto &bufferView = model.bufferViews[accessor.bufferView];
-                const auto byteOffset =
-                    accessor.byteOffset + bufferView.byteOffset;
-                glDrawElements(primitive.mode, GLsizei(accessor.count),
-                    accessor.componentType, (const GLvoid *)byteOffset);
-              } else {
-                const auto accessorIdx = (*begin(primitive.attributes)).second;
-                const auto &accessor = model.accessors[accessorIdx];
-                glDrawArrays(primitive.mode, 0, GLsizei(accessor.count));
-              }
-            }
-            /*********/
-          }
-          // For Children Nodes
-          for (const auto childNode : node.children) {
-            drawNode(childNode, modelMatrix);
-          }
-        };
-
-    // Draw the scene referenced by gltf file
-    if (model.defaultScene >= 0) {
-      // TODO Draw all nodes
-      for (const auto nodeIndice : model.scenes[model.defaultScene].nodes) {
-        drawNode(nodeIndice, glm::mat4(1));
-      }
+    if (renderOnDemand && !redrawScheduler.redrawPending()) {
+      continue;
     }
-  };
-
-  // render in a Image
-  if (!m_OutputPath.empty()) {
-    std::vector<unsigned char> pixels(3 * m_nWindowWidth * m_nWindowHeight);
-    renderToImage(m_nWindowWidth, m_nWindowHeight, 3, pixels.data(),
-        [&]() { drawScene(cameraController->getCamera()); });
-    flipImageYAxis(m_nWindowWidth, m_nWindowHeight, 3, pixels.data());
-    const auto strPath = m_OutputPath.string();
-    stbi_write_png(
-        strPath.c_str(), m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), 0);
-    return 0;
-  }
-
-  // Loop until the user closes the window
-  for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose();
-       ++iterationCount) {
     const auto seconds = glfwGetTime();
 
     const auto camera = cameraController->getCamera();
-    drawScene(camera);
+    const bool sceneChanged = resetAccumulation ||
+                              camera.eye() != accumulationCamera.eye() ||
+                              camera.center() != accumulationCamera.center() ||
+                              camera.up() != accumulationCamera.up();
+    if (progressiveRefinement && !sceneChanged) {
+      // No GPU work but the copy once all the samples are accumulated
+      if (renderer.sampleCount() < refinementSampleCount) {
+        renderer.accumulateSample(camera);
+        redrawScheduler.requestRedraw();
+      }
+      renderer.drawAccumulation();
+    } else {
+      renderer.drawFrame(camera);
+      renderer.resetSamples();
+      accumulationCamera = camera;
+      resetAccumulation = false;
+      if (progressiveRefinement) {
+        // The next frame starts the accumulation if nothing moves
+        redrawScheduler.requestRedraw();
+      }
+    }
 
     // GUI code:
     imguiNewFrame();
@@ -553,7 +360,7 @@ int ViewerApplication::run()
           cameraController->setCamera(currentCamera);
         }
         /** Parameter of NormalMapping**/
-        ImGui::Checkbox("NormalMapping", &normalMapping);
+        ImGui::Checkbox("NormalMapping", &settings.normalMapping);
 
         /** Parameter of Directionnal Light **/
         if (ImGui::CollapsingHeader(
@@ -565,12 +372,13 @@ int ViewerApplication::run()
             cosPhi = glm::cos(phi);
             sinTheta = glm::sin(theta);
             cosTheta = glm::cos(theta);
-            lightDirection =
+            settings.lightDirection =
                 glm::vec3(sinTheta * cosPhi, cosTheta, sinTheta * sinPhi);
           }
 
-          ImGui::Text("Directional light -> %.3f %.3f %.3f", lightDirection.x,
-              lightDirection.y, lightDirection.z);
+          ImGui::Text("Directional light -> %.3f %.3f %.3f",
+              settings.lightDirection.x, settings.lightDirection.y,
+              settings.lightDirection.z);
 
           static auto lightColor = glm::vec3(1.f);
 
@@ -578,34 +386,36 @@ int ViewerApplication::run()
                   "dirIntensity", &lightIntensityFactor, 0, 10.f) ||
               ImGui::ColorEdit3(
                   "dirColor", reinterpret_cast<float *>(&lightColor))) {
-            lightIntensity = lightColor * lightIntensityFactor;
+            settings.lightIntensity = lightColor * lightIntensityFactor;
           }
         }
-        ImGui::Checkbox("Light from camera", &lightFromCamera);
+        ImGui::Checkbox("Light from camera", &settings.lightFromCamera);
 
         /** Parameter of Point Light **/
         if (ImGui::CollapsingHeader(
                 "Point Light", ImGuiTreeNodeFlags_DefaultOpen)) {
           static auto pointLightColor = glm::vec3(1.f);
           static float lightIntensityFactor = 1.f;
-          if (ImGui::SliderFloat("posX", &pointLightPosition[0].x, -10, 10.f) ||
-              ImGui::SliderFloat("posY", &pointLightPosition[0].y, -10, 10.f) ||
-              ImGui::SliderFloat("posZ", &pointLightPosition[0].z, -10, 10.f)) {
+          auto &pointLightPosition = settings.pointLightPosition[0];
+          if (ImGui::SliderFloat("posX", &pointLightPosition.x, -10, 10.f) ||
+              ImGui::SliderFloat("posY", &pointLightPosition.y, -10, 10.f) ||
+              ImGui::SliderFloat("posZ", &pointLightPosition.z, -10, 10.f)) {
             ImGui::Text("Point light -> %.3f %.3f %.3f",
-                pointLightPosition[0].x, pointLightPosition[0].y,
-                pointLightPosition[0].z);
+                pointLightPosition.x, pointLightPosition.y,
+                pointLightPosition.z);
           }
           if (ImGui::SliderFloat(
                   "pointIntensity", &lightIntensityFactor, 0, 10.f) ||
               ImGui::ColorEdit3(
                   "pointColor", reinterpret_cast<float *>(&pointLightColor))) {
-            pointLightIntensity[0] = pointLightColor * lightIntensityFactor;
+            settings.pointLightIntensity[0] =
+                pointLightColor * lightIntensityFactor;
           }
         }
-        ImGui::Checkbox(
-            "enable/Disable Principal Point Light ", &enablePointLight);
+        ImGui::Checkbox("enable/Disable Principal Point Light ",
+            &settings.enablePointLight);
         ImGui::Checkbox("enable/Disable Additionnal Points Lights (2 lights) ",
-            &enablePointLightAdditionnal);
+            &settings.enablePointLightAdditionnal);
 
         /** Parameter of Spot Light **/
         if (ImGui::CollapsingHeader(
@@ -613,13 +423,14 @@ int ViewerApplication::run()
           static auto spotLightColor = glm::vec3(1.f);
           static float lightIntensityFactor = 1.f;
 
+          auto &spotLightPosition = settings.spotLightPosition;
           if (ImGui::SliderFloat("posSLX", &spotLightPosition.x, -10, 10.f) ||
               ImGui::SliderFloat("posSLY", &spotLightPosition.y, -10, 10.f) ||
               ImGui::SliderFloat("posSLZ", &spotLightPosition.z, -10, 10.f) ||
-              ImGui::SliderFloat(
-                  "CutOff", &spotLightCutOff, 0.f, spotLightOuterCutOff) ||
-              ImGui::SliderFloat("OuterCutOff", &spotLightOuterCutOff,
-                  spotLightCutOff, 20.f)) {
+              ImGui::SliderFloat("CutOff", &settings.spotLightCutOff, 0.f,
+                  settings.spotLightOuterCutOff) ||
+              ImGui::SliderFloat("OuterCutOff", &settings.spotLightOuterCutOff,
+                  settings.spotLightCutOff, 20.f)) {
             ImGui::Text("Spot light Position -> %.3f %.3f %.3f",
                 spotLightPosition.x, spotLightPosition.y, spotLightPosition.z);
           }
@@ -627,45 +438,257 @@ int ViewerApplication::run()
                   "spotIntensity", &lightIntensityFactor, 0, 10.f) ||
               ImGui::ColorEdit3(
                   "spotColor", reinterpret_cast<float *>(&spotLightColor))) {
-            spotLightIntensity = spotLightColor * lightIntensityFactor;
+            settings.spotLightIntensity = spotLightColor * lightIntensityFactor;
+          }
+        }
+        ImGui::Checkbox("enable/Disable Spot Light", &settings.enableSpotLight);
+
+        /** Parameter of Clustered Lighting **/
+        if (ImGui::CollapsingHeader(
+                "Clustered Lighting", ImGuiTreeNodeFlags_DefaultOpen)) {
+          ImGui::Checkbox("Clustered lighting", &settings.useClusteredLighting);
+          static int randomLightCount = 256;
+          ImGui::SliderInt("Random lights", &randomLightCount, 0, 2048);
+          if (ImGui::Button("Spawn random lights")) {
+            renderer.spawnRandomLights(randomLightCount);
+            settings.useClusteredLighting = true;
+          }
+          ImGui::Text("%d lights from the scene, %d random lights",
+              int(renderer.sceneLightCount()),
+              int(renderer.randomLightCount()));
+          if (settings.useClusteredLighting) {
+            float averageLightCount = 0;
+            uint32_t maxLightCount = 0;
+            clusteredLights.computeStats(averageLightCount, maxLightCount);
+            const auto &gridSize = clusteredLights.gridSize();
+            ImGui::Text("%d lights in %dx%dx%d clusters",
+                int(clusteredLights.lightCount()), gridSize.x, gridSize.y,
+                gridSize.z);
+            ImGui::Text("Lights per cluster: %.2f average, %u max (cap %u)",
+                averageLightCount, maxLightCount,
+                ClusteredLights::MAX_LIGHTS_PER_CLUSTER);
+          }
+        }
+      }
+      if (ImGui::CollapsingHeader("Renderer", ImGuiTreeNodeFlags_DefaultOpen)) {
+        int rendererType = settings.useDeferredRendering ? 1 : 0;
+        ImGui::RadioButton("Forward", &rendererType, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("Deferred", &rendererType, 1);
+        settings.useDeferredRendering = rendererType == 1;
+        if (ImGui::Button("Benchmark with 1, 10 and 100 lights")) {
+          benchmarkReport = renderer.benchmarkRenderers(camera);
+        }
+        if (!benchmarkReport.empty()) {
+          ImGui::TextUnformatted(benchmarkReport.c_str());
+        }
+      }
+      if (ImGui::CollapsingHeader(
+              "Dynamic resolution", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox("Dynamic resolution", &settings.useDynamicResolution);
+        ImGui::SliderFloat(
+            "Target frame time (ms)", &settings.targetFrameTime, 2.f, 33.f);
+        if (settings.useDynamicResolution) {
+          const auto renderSize = dynamicResolution.renderSize();
+          ImGui::Text("Scale %.0f%%: %dx%d, scene GPU time %.2f ms",
+              100.f * dynamicResolution.scale(), renderSize.x, renderSize.y,
+              dynamicResolution.gpuTime());
+        }
+      }
+      if (ImGui::CollapsingHeader("Frame graph")) {
+        ImGui::Text("Passes: %zu kept, %zu culled",
+            frameGraph.passCount() - frameGraph.culledPassCount(),
+            frameGraph.culledPassCount());
+        ImGui::TextWrapped("%s", frameGraph.passNames().c_str());
+        ImGui::Text("Transient textures: %zu in %zu allocations",
+            frameGraph.transientTextureCount(), frameGraph.allocationCount());
+        ImGui::Text("Render targets: %.1f MB, %.1f MB without aliasing",
+            frameGraph.peakBytes() / (1024.f * 1024.f),
+            frameGraph.unaliasedBytes() / (1024.f * 1024.f));
+      }
+      if (!renderer.environmentReport().empty() &&
+          ImGui::CollapsingHeader(
+              "Image based lighting", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox(
+            "Environment lighting", &settings.useImageBasedLighting);
+        ImGui::SliderFloat(
+            "Environment intensity", &settings.environmentIntensity, 0.f, 4.f);
+        ImGui::TextUnformatted(renderer.environmentReport().c_str());
+      }
+      if (ImGui::CollapsingHeader("Shadows", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox("Shadow maps", &settings.useShadows);
+        ImGui::Text("%d cascades of %dx%d texels, ending at %.2f %.2f %.2f",
+            ShadowMaps::CASCADE_COUNT, shadowMaps.size(), shadowMaps.size(),
+            renderer.cascadeEnds()[0], renderer.cascadeEnds()[1],
+            renderer.cascadeEnds()[2]);
+      }
+      if (ImGui::CollapsingHeader(
+              "Progressive refinement", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox(
+            "Accumulate samples when still", &progressiveRefinement);
+        ImGui::SliderInt("Samples", &refinementSampleCount, 1, 256);
+        if (progressiveRefinement) {
+          ImGui::Text("%d / %d samples accumulated",
+              renderer.sampleCount(), refinementSampleCount);
+        }
+      }
+      if (ImGui::CollapsingHeader(
+              "Depth pre-pass", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Combo("Mode", &settings.depthPrePassMode, "Off\0On\0Auto\0");
+        if (settings.depthPrePassMode == 2) {
+          ImGui::SliderFloat(
+              "Overdraw threshold", &settings.overdrawThreshold, 1.f, 5.f);
+          ImGui::Text("Pre-pass %s",
+              renderer.depthPrePassActive() ? "enabled" : "disabled");
+        }
+        ImGui::Text("Overdraw: %.2fx, %.0f fragments over %.0f pixels",
+            overdrawMeter.overdraw(), double(overdrawMeter.fragmentCount()),
+            double(overdrawMeter.coveredPixelCount()));
+      }
+      if (ImGui::CollapsingHeader(
+              "Draw order", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox("Cull back faces of single sided materials",
+            &settings.cullBackFaces);
+        ImGui::Checkbox("Sort opaque primitives front to back",
+            &settings.sortOpaqueItems);
+        ImGui::Text("%d opaque, %d blended draws",
+            GLsizei(renderer.opaqueDrawCount()),
+            GLsizei(renderer.blendedDrawCount()));
+      }
+      if (ImGui::CollapsingHeader("Shaders", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (ImGui::Checkbox("Hot reload", &hotReload)) {
+          // The watcher wakes up the loop waiting for events
+          shaderWatcher = hotReload ? std::make_unique<ShaderFileWatcher>(
+                                          m_ShadersSourcePath,
+                                          []() { glfwPostEmptyEvent(); })
+                                    : nullptr;
+        }
+        if (reloadCount > 0) {
+          ImGui::Text("Reload %d ready %.1f ms after the change", reloadCount,
+              reloadLatency);
+        }
+        if (!renderer.shaderErrorLog().empty()) {
+          ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f),
+              "Compilation failed, previous programs kept:");
+          ImGui::TextWrapped("%s", renderer.shaderErrorLog().c_str());
+        }
+      }
+      if (ImGui::CollapsingHeader("Stats", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox("Render on demand", &renderOnDemand);
+        ImGui::Text("CPU: %.1f%% of a core, %.1f frames drawn per second",
+            cpuUsage, drawnFramesPerSecond);
+        ImGui::Checkbox("Hardware instancing", &settings.useInstancing);
+        ImGui::Text(renderer.useMeshArena()
+                        ? "Mesh arena (base vertex draws)"
+                        : "One VAO per primitive");
+        ImGui::Text("Draw calls: %d, VAO binds: %d", renderer.drawCallCount(),
+            renderer.vaoBindCount());
+        ImGui::Text("Programs: %d permutations cached, %d switches",
+            GLsizei(renderer.programCount()),
+            renderer.programSwitchCount());
+        if (programBinaryCache.enabled()) {
+          ImGui::Text("Program binary cache: %u hits, %u misses, %.1f ms saved",
+              programBinaryCache.hitCount(), programBinaryCache.missCount(),
+              programBinaryCache.savedMilliseconds());
+        }
+        if (renderer.useMeshArena()) {
+          ImGui::Text("Arena: %d VAOs, %.2f MB",
+              GLsizei(meshArena.vertexArrays.size()),
+              (meshArena.vertexBytes + meshArena.indexBytes) /
+                  (1024.f * 1024.f));
+        }
+        ImGui::Text("Instances: %d in %d batches (ratio %.2f)",
+            renderer.instanceCount(),
+            GLsizei(renderer.instanceBatchCount()),
+            renderer.instanceBatchCount() == 0
+                ? 0.f
+                : float(renderer.instanceCount()) /
+                      renderer.instanceBatchCount());
+        if (settings.useShadows) {
+          ImGui::Text("Shadow pass: %.2f ms GPU, %u cache hits, %u misses",
+              shadowMaps.gpuTime(), shadowMaps.hitCount(),
+              shadowMaps.missCount());
+          for (GLsizei i = 0; i < ShadowMaps::LAYER_COUNT; ++i) {
+            const auto status =
+                shadowMaps.layerCached(i) ? "cached" : "rendered";
+            if (i == ShadowMaps::SPOT_LAYER) {
+              const bool spotShadow = settings.enableSpotLight &&
+                                      !settings.useClusteredLighting;
+              ImGui::Text("  Spot light: %s", spotShadow ? status : "off");
+            } else {
+              ImGui::Text("  Cascade %d: %s", i, status);
+            }
           }
         }
-        ImGui::Checkbox("enable/Disable Spot Light", &enableSpotLight);
       }
       ImGui::End();
     }
+    // A widget being edited may change any parameter of the scene: rather
+    // than comparing them all, the accumulation restarts. The checkboxes and
+    // the buttons apply their value when the mouse is released.
+    if (ImGui::IsAnyItemActive() ||
+        (ImGui::GetIO().WantCaptureMouse && ImGui::IsMouseReleased(0))) {
+      resetAccumulation = true;
+    }
 
     imguiRenderFrame();
 
-    glfwPollEvents(); // Poll for and process events
+    if (!renderOnDemand) {
+      glfwPollEvents(); // Poll for and process events
+    }
 
     auto ellapsedTime = glfwGetTime() - seconds;
     auto guiHasFocus =
         ImGui::GetIO().WantCaptureMouse || ImGui::GetIO().WantCaptureKeyboard;
-    if (!guiHasFocus) {
-      cameraController->update(float(ellapsedTime));
+    // Keys held down do not send events, the frames are drawn while the
+    // camera moves
+    if (!guiHasFocus && cameraController->update(float(ellapsedTime))) {
+      redrawScheduler.requestRedraw();
     }
 
     m_GLFWHandle.swapBuffers(); // Swap front and back buffers
+    redrawScheduler.frameDrawn();
+    ++statsFrameCount;
   }
   // TODO clean up allocated GL data
 
   return 0;
 }
 
-ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
-    uint32_t height, const fs::path &gltfFile,
-    const std::vector<float> &lookatArgs, const std::string &vertexShader,
-    const std::string &fragmentShader, const fs::path &output) :
-    m_nWindowWidth(width),
-    m_nWindowHeight(height),
-    m_AppPath{appPath},
+ViewerApplication::ViewerApplication(const Options &options) :
+    m_nWindowWidth(options.width),
+    m_nWindowHeight(options.height),
+    m_AppPath{options.appPath},
     m_AppName{m_AppPath.stem().string()},
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
     m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
-    m_gltfFilePath{gltfFile},
-    m_OutputPath{output}
+    m_ShadersSourcePath{shadersSourcePath(m_ShadersRootPath / m_AppName)},
+    m_gltfFilePath{options.gltfFile},
+    m_OutputPath{options.output},
+    m_deferredRendering{options.deferredRendering},
+    m_useMeshArena{options.useMeshArena},
+    m_benchmarkRenderers{options.benchmarkRenderers},
+    m_outputSampleCount{options.outputSampleCount},
+    m_EnvironmentPath{options.environment},
+    m_CameraViews{options.cameraViews},
+    m_EncoderThreadCount{options.encoderThreadCount},
+    m_benchmarkEncoders{options.benchmarkEncoders},
+    m_RenderQueue{options.renderQueue},
+    m_TileSize{options.tileSize},
+    m_MsaaSampleCount{options.msaaSampleCount},
+    m_SsaaFactor{options.ssaaFactor},
+    m_SsaaFilter{options.ssaaFilter},
+    m_benchmarkAntialiasing{options.benchmarkAntialiasing},
+    m_AuxiliaryBuffers{options.auxiliaryBuffers},
+    m_ThumbnailSizes{options.thumbnailSizes},
+    m_StreamPath{options.streamPath},
+    m_StreamFormat{options.streamFormat},
+    m_FramesPerSecond{options.framesPerSecond},
+    m_OrbitFrameCount{options.orbitFrameCount},
+    m_Headless{options.headless || !options.output.empty() ||
+               !options.streamPath.empty() || options.renderQueue}
 {
+  const auto &lookatArgs = options.lookatArgs;
   if (!lookatArgs.empty()) {
     m_hasUserCamera = true;
     m_userCamera =
@@ -674,19 +697,21 @@ ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
             glm::vec3(lookatArgs[6], lookatArgs[7], lookatArgs[8])};
   }
 
-  if (!vertexShader.empty()) {
-    m_vertexShader = vertexShader;
+  if (!options.vertexShader.empty()) {
+    m_vertexShader = options.vertexShader;
   }
 
-  if (!fragmentShader.empty()) {
-    m_fragmentShader = fragmentShader;
+  if (!options.fragmentShader.empty()) {
+    m_fragmentShader = options.fragmentShader;
   }
 
-  ImGui::GetIO().IniFilename =
-      m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
-                                  // positions in this file
+  if (!m_Headless) {
+    ImGui::GetIO().IniFilename =
+        m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
+                                    // positions in this file
 
-  glfwSetKeyCallback(m_GLFWHandle.window(), keyCallback);
+    glfwSetKeyCallback(m_GLFWHandle.window(), keyCallback);
+  }
 
   printGLVersion();
 }
@@ -716,12 +741,15 @@ bool ViewerApplication::loadGltfFile(tinygltf::Model &model)
 }
 
 std::vector<GLuint> ViewerApplication::createBufferObjects(
-    const tinygltf::Model &model, bool normalMapping)
+    const tinygltf::Model &model, bool normalMapping,
+    std::vector<GLuint> &tangentBufferObjects)
 {
   // create a vector of GLuint with the correct size (model.buffers.size())
   // and use glGenBuffers to create buffer objects.
-  std::vector<GLuint> bufferObjects(2 * model.buffers.size(), 0);
-  glGenBuffers(GLsizei(2 * model.buffers.size()), bufferObjects.data());
+  std::vector<GLuint> bufferObjects(model.buffers.size(), 0);
+  glGenBuffers(GLsizei(model.buffers.size()), bufferObjects.data());
+  tangentBufferObjects.assign(model.buffers.size(), 0);
+  glGenBuffers(GLsizei(model.buffers.size()), tangentBufferObjects.data());
   std::cout << "there is " << model.buffers.size()
             << " buffers in this gltf model" << std::endl;
   for (size_t i = 0; i < model.buffers.size(); ++i) {
@@ -782,14 +810,13 @@ std::vector<GLuint> ViewerApplication::createBufferObjects(
     //}
 
     // NORMAL MAPPING//
-    // je bind un 2e vbo indexé après tous les autres vbo potentiels
-    // Ainsi on aura d'abord les vbo contenant des pos, normal et texcoord,
-    // puis les vbo contenant tangents et bitangents
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[i] + model.buffers.size());
+    // les tangentes du buffer i vont dans son propre vbo,
+    // tangentBufferObjects[i]
+    glBindBuffer(GL_ARRAY_BUFFER, tangentBufferObjects[i]);
 
     // On donne le nouveau buffer au GPU
-    glBufferData(GL_ARRAY_BUFFER, tangentBuffer.size(), tangentBuffer.data(),
-        GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, tangentBuffer.size() * sizeof(float),
+        tangentBuffer.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
@@ -798,7 +825,9 @@ std::vector<GLuint> ViewerApplication::createBufferObjects(
 
 std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
     const tinygltf::Model &model, const std::vector<GLuint> &bufferObjects,
-    std::vector<VaoRange> &meshIndexToVaoRange, bool normalMapping)
+    const std::vector<GLuint> &tangentBufferObjects,
+    GLuint instanceBufferObject, std::vector<VaoRange> &meshIndexToVaoRange,
+    bool normalMapping)
 {
   std::vector<GLuint> vertexArrayObjects;
   const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
@@ -806,6 +835,9 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
   const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
   const GLuint VERTEX_ATTRIB_TANGENT_IDX = 3;
   // const GLuint VERTEX_ATTRIB_BITANGENT_IDX = 4;
+  // Consecutive locations because a matrix attribute takes one per column
+  const GLuint VERTEX_ATTRIB_INSTANCE_MODEL_MATRIX_IDX = 5;
+  const GLuint VERTEX_ATTRIB_INSTANCE_NORMAL_MATRIX_IDX = 9;
 
   // { Indice of Mesh , Number of primitives}  need this to Draw After
   meshIndexToVaoRange.resize(model.meshes.size());
@@ -842,7 +874,7 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
 
       glBindVertexArray(vao);
 
-      GLuint tangentBufferObject;
+      GLuint tangentBufferObject = 0;
 
       { // I'm opening a scope because I want to reuse the variable
         // iterator
@@ -876,7 +908,7 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
             const auto bufferIdx = bufferView.buffer;
             const auto bufferObject = bufferObjects[bufferIdx];
 
-            tangentBufferObject = bufferObject + model.buffers.size();
+            tangentBufferObject = tangentBufferObjects[bufferIdx];
 
             assert(GL_ARRAY_BUFFER == bufferView.target);
 
@@ -949,17 +981,76 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
           glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObject);
         }
 
+        // The same instance buffer for all the VAOs, the instanced draws
+        // start at the first instance of their batch
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+        for (GLuint column = 0; column < 4; ++column) {
+          const auto vertexAttrib =
+              VERTEX_ATTRIB_INSTANCE_MODEL_MATRIX_IDX + column;
+          glEnableVertexAttribArray(vertexAttrib);
+          glVertexAttribPointer(vertexAttrib, 4, GL_FLOAT, GL_FALSE,
+              sizeof(InstanceAttributes),
+              (const GLvoid *)(offsetof(InstanceAttributes, modelMatrix) +
+                               column * sizeof(glm::vec4)));
+          glVertexAttribDivisor(vertexAttrib, 1);
+        }
+        for (GLuint column = 0; column < 3; ++column) {
+          const auto vertexAttrib =
+              VERTEX_ATTRIB_INSTANCE_NORMAL_MATRIX_IDX + column;
+          glEnableVertexAttribArray(vertexAttrib);
+          glVertexAttribPointer(vertexAttrib, 3, GL_FLOAT, GL_FALSE,
+              sizeof(InstanceAttributes),
+              (const GLvoid *)(offsetof(InstanceAttributes, normalMatrix) +
+                               column * sizeof(glm::vec3)));
+          glVertexAttribDivisor(vertexAttrib, 1);
+        }
+
         // on débind le buffer (vbo)
         glBindBuffer(GL_ARRAY_BUFFER, 0);
       }
     }
+    compteur++;
   }
-  compteur++;
   // on debind le vao
   glBindVertexArray(0);
   return vertexArrayObjects;
 }
 
+GLuint ViewerApplication::createInstanceBufferObject(
+    const tinygltf::Model &model, std::vector<InstanceBatch> &instanceBatches)
+{
+  // Nodes sharing a mesh become one batch, their matrices being contiguous
+  std::vector<std::vector<glm::mat4>> meshInstances;
+  computeMeshInstances(model, meshInstances);
+
+  std::vector<InstanceAttributes> instanceAttributes;
+  instanceBatches.clear();
+  for (size_t meshIdx = 0; meshIdx < meshInstances.size(); ++meshIdx) {
+    const auto &instances = meshInstances[meshIdx];
+    if (instances.empty()) {
+      continue;
+    }
+    instanceBatches.push_back(InstanceBatch{int(meshIdx),
+        GLuint(instanceAttributes.size()), GLsizei(instances.size())});
+    for (const auto &instance : instances) {
+      instanceAttributes.push_back(computeInstanceAttributes(instance));
+    }
+  }
+
+  GLuint instanceBufferObject = 0;
+  glGenBuffers(1, &instanceBufferObject);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+  // Updated when the instances of a batch are sorted along the view axis
+  glBufferData(GL_ARRAY_BUFFER,
+      instanceAttributes.size() * sizeof(InstanceAttributes),
+      instanceAttributes.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  std::cout << instanceAttributes.size() << " mesh instances in "
+            << instanceBatches.size() << " instance batches" << std::endl;
+  return instanceBufferObject;
+}
+
 std::vector<GLuint> ViewerApplication::createTextureObjects(
     const tinygltf::Model &model) const
 {
@@ -1384,4 +1475,4 @@ void ViewerApplication::computeTexCoord(
       addTexCoord(nodeIdx, glm::mat4(1));
     }
   }
-}
\ No newline at end of file
+}
@@ -2,28 +2,82 @@
 
 #include "tiny_gltf.h"
 #include "utils/GLFWHandle.hpp"
+#include "utils/auxiliaryBuffers.hpp"
 #include "utils/cameraControllerInterface.hpp"
+#include "utils/cameraViews.hpp"
+#include "utils/downsample.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/frameStream.hpp"
+#include "utils/sceneRenderer.hpp"
 #include "utils/shaders.hpp"
 
+class RenderQueue;
+
 class ViewerApplication
 {
 public:
-  ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height,
-      const fs::path &gltfFile, const std::vector<float> &lookatArgs,
-      const std::string &vertexShader, const std::string &fragmentShader,
-      const fs::path &output);
+  struct Options
+  {
+    fs::path appPath; // Of the executable, the shaders are next to it
+    uint32_t width = 1280; // Of the window or of the output images
+    uint32_t height = 720;
+    fs::path gltfFile;
+    // Eye, center and up of the camera, the default camera if empty
+    std::vector<float> lookatArgs;
+    // Shaders of the forward renderer, the default ones if empty
+    std::string vertexShader;
+    std::string fragmentShader;
+    // Image rendered offscreen instead of the window, none if empty
+    fs::path output;
+    bool deferredRendering = false;
+    // Primitives repacked into the buffers of a MeshArena, else drawn from the
+    // buffers of the model with one VAO each
+    bool useMeshArena = true;
+    bool benchmarkRenderers = false;
+    // Samples per pixel of the output image
+    uint32_t outputSampleCount = 1;
+    // Equirectangular HDR image for image based lighting, none if empty
+    fs::path environment;
+    // Offscreen without window nor ImGui, also implied by output, streamPath
+    // and renderQueue
+    bool headless = false;
+    // Views rendered to numbered images from output, instead of the single
+    // camera of lookatArgs
+    std::vector<CameraView> cameraViews;
+    // Threads encoding the output images, 0 for one per hardware thread
+    size_t encoderThreadCount = 0;
+    bool benchmarkEncoders = false;
+    // Jobs of the render server, rendered by run() instead of the window or
+    // the output image
+    RenderQueue *renderQueue = nullptr;
+    // Side of the tiles of the output images, 0 to only tile the images
+    // larger than the GPU allows
+    uint32_t tileSize = 0;
+    // Anti-aliasing of the output images: samples per pixel of multisampling,
+    // and scale of supersampling, drawn larger then downsampled
+    uint32_t msaaSampleCount = 1;
+    uint32_t ssaaFactor = 1;
+    DownsampleFilter ssaaFilter = DownsampleFilter::Box;
+    bool benchmarkAntialiasing = false;
+    // Written next to each output image, empty for none
+    std::vector<AuxiliaryBuffers::Buffer> auxiliaryBuffers;
+    // Largest side of the output images written, from the largest to the
+    // smallest, instead of the one image of the window size if not empty
+    std::vector<uint32_t> thumbnailSizes;
+    // Frames of the views streamed there instead of written to files, "-" for
+    // the standard output, none if empty
+    fs::path streamPath;
+    FrameStreamFormat streamFormat = FrameStreamFormat::Y4M;
+    uint32_t framesPerSecond = 30;
+    // Views of a turntable around the camera center, instead of cameraViews
+    uint32_t orbitFrameCount = 0;
+  };
+
+  explicit ViewerApplication(const Options &options);
 
   int run();
 
 private:
-  // A range of indices in a vector containing Vertex Array Objects
-  struct VaoRange
-  {
-    GLsizei begin; // Index of first element in vertexArrayObjects
-    GLsizei count; // Number of elements in range
-  };
-
   struct Light
   {
     // vec3 position; // No longer necessery when using directional lights.
@@ -39,6 +93,8 @@ private:
   const fs::path m_AppPath;
   const std::string m_AppName;
   const fs::path m_ShadersRootPath;
+  // Watched by the hot reload, see shadersSourcePath()
+  const fs::path m_ShadersSourcePath;
 
   fs::path m_gltfFilePath;
   std::string m_vertexShader = "forward.vs.glsl";
@@ -47,14 +103,40 @@ private:
   bool m_hasUserCamera = false;
   Camera m_userCamera;
 
+  // From the Options, see there
   fs::path m_OutputPath;
 
+  bool m_deferredRendering = false;
+  bool m_useMeshArena = true;
+  bool m_benchmarkRenderers = false;
+  uint32_t m_outputSampleCount = 1;
+  fs::path m_EnvironmentPath;
+  std::vector<CameraView> m_CameraViews;
+  size_t m_EncoderThreadCount = 0;
+  bool m_benchmarkEncoders = false;
+  RenderQueue *m_RenderQueue = nullptr;
+  uint32_t m_TileSize = 0;
+  uint32_t m_MsaaSampleCount = 1;
+  uint32_t m_SsaaFactor = 1;
+  DownsampleFilter m_SsaaFilter = DownsampleFilter::Box;
+  bool m_benchmarkAntialiasing = false;
+  std::vector<AuxiliaryBuffers::Buffer> m_AuxiliaryBuffers;
+  std::vector<uint32_t> m_ThumbnailSizes;
+  fs::path m_StreamPath;
+  FrameStreamFormat m_StreamFormat = FrameStreamFormat::Y4M;
+  uint32_t m_FramesPerSecond = 30;
+  uint32_t m_OrbitFrameCount = 0;
+  // Offscreen only, without window nor ImGui: with an output image, or when
+  // requested for the benchmark
+  bool m_Headless = false;
+
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
   // Last to be initialized, first to be destroyed:
   GLFWHandle m_GLFWHandle{int(m_nWindowWidth), int(m_nWindowHeight),
       "glTF Viewer",
-      m_OutputPath.empty()}; // show the window only if m_OutputPath is empty
+      m_OutputPath.empty(), // show the window only if m_OutputPath is empty
+      m_Headless};
   /*
     ! THE ORDER OF DECLARATION OF MEMBER VARIABLES IS IMPORTANT !
     - m_ImGuiIniFilename.c_str() will be used by ImGUI in ImGui::Shutdown, which
@@ -67,11 +149,20 @@ private:
     before most of OpenGL function calls.
   */
   bool loadGltfFile(tinygltf::Model &model);
-  std::vector<GLuint> createBufferObjects(
-      const tinygltf::Model &model, bool normalMapping);
+  // One buffer object per buffer of the model, and one of tangents each
+  std::vector<GLuint> createBufferObjects(const tinygltf::Model &model,
+      bool normalMapping, std::vector<GLuint> &tangentBufferObjects);
+  // One VAO per primitive, with the per-instance attributes of
+  // instanceBufferObject attached (vertex attributes 5 to 11)
   std::vector<GLuint> createVertexArrayObjects(const tinygltf::Model &model,
       const std::vector<GLuint> &bufferObjects,
-      std::vector<VaoRange> &meshIndexToVaoRange, bool normalMapping);
+      const std::vector<GLuint> &tangentBufferObjects,
+      GLuint instanceBufferObject, std::vector<VaoRange> &meshIndexToVaoRange,
+      bool normalMapping);
+  // Build the buffer of per-instance model and normal matrices and fill
+  // instanceBatches
+  GLuint createInstanceBufferObject(const tinygltf::Model &model,
+      std::vector<InstanceBatch> &instanceBatches);
   std::vector<GLuint> createTextureObjects(const tinygltf::Model &model) const;
 
   void computeTangentAndBitangentCoordinates(std::vector<glm::vec3> &tangents,
@@ -1,8 +1,19 @@
+#include "RenderServer.hpp"
 #include "ViewerApplication.hpp"
 #include "utils/GLFWHandle.hpp"
+#include "utils/cameraViews.hpp"
+#include "utils/environmentLighting.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/imageEncoders.hpp"
+#include "utils/localSocket.hpp"
 
+#include <algorithm>
 #include <args.hxx>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
 
 std::vector<std::string> split(
     const std::string &str, const std::string &delim);
@@ -17,11 +28,48 @@ int main(int argc, char **argv)
   args::Group commands{parser, "commands"};
   args::Command info{commands, "info", "Display info about OpenGL",
       [&](args::Subparser &parser) {
+        args::Flag headless{parser, "headless",
+            "Create the context without display server (EGL)",
+            {"headless"}};
         parser.Parse();
-        GLFWHandle handle{1, 1, "", false};
+        GLFWHandle handle{1, 1, "", false, bool(headless)};
         printGLVersion();
       }};
 
+  args::Command ibl{commands, "ibl",
+      "Precompute the image based lighting of an equirectangular HDR "
+      "environment into the cache, without a window",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> environment{parser, "environment",
+            "Path to the HDR file", args::Options::Required};
+        parser.Parse();
+        const auto start = std::chrono::steady_clock::now();
+        bool fromCache = false;
+        const auto cacheDirectory = environmentCacheDirectory(argv[0]);
+        loadEnvironmentLighting(
+            args::get(environment), cacheDirectory, &fromCache);
+        std::cout << (fromCache ? "Already in " : "Precomputed into ")
+                  << cacheDirectory << " in "
+                  << std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count()
+                  << " ms" << std::endl;
+      }};
+
+  args::Command iblCheck{commands, "ibl-check",
+      "Check the image based lighting precomputation on a constant "
+      "environment, without a window",
+      [&](args::Subparser &parser) {
+        parser.Parse();
+        try {
+          checkEnvironmentLighting();
+          std::cout << "Environment lighting check passed" << std::endl;
+        } catch (const std::runtime_error &e) {
+          std::cerr << e.what() << std::endl;
+          returnCode = 1;
+        }
+      }};
+
   args::Command interactive{
       commands, "viewer", "Run glTF viewer", [&](args::Subparser &parser) {
         args::Positional<std::string> file{
@@ -41,11 +89,287 @@ int main(int argc, char **argv)
             "Height of window or output image if -b is specified",
             {"h", "height"}};
         args::ValueFlag<std::string> output{parser, "output",
-            "Output path to render the image. If specified no window is shown. "
-            "Only png is supported.",
-            {"o", "output"}};
+            "Output path to render the image. If specified no window is "
+            "shown, the context is headless. The format comes from the "
+            "extension: png, ppm, pam, rgba (raw), qoi, or pfm and exr for "
+            "linear float colors.",
+            {'o', "output"}};
+        args::Flag headless{parser, "headless",
+            "Render without window nor display server, with an EGL context. "
+            "Implied by --output, only valid with --output or a benchmark",
+            {"headless"}};
+        args::ValueFlag<std::string> renderer{parser, "renderer",
+            "Rendering path: forward (default) or deferred", {"renderer"}};
+        args::Flag noMeshArena{parser, "no-mesh-arena",
+            "Draw each primitive from the buffers of the model with its own "
+            "VAO, instead of repacking them into a few buffers drawn with "
+            "base vertex",
+            {"no-mesh-arena"}};
+        args::Flag benchmark{parser, "benchmark",
+            "Print the frame time of the forward and deferred renderers with "
+            "1, 10 and 100 lights, then exit",
+            {"benchmark"}};
+        args::ValueFlag<int32_t> spp{parser, "spp",
+            "Samples per pixel of the output image, rendered with sub-pixel "
+            "jitter and averaged (default 1)",
+            {"spp"}};
+        args::ValueFlag<std::string> environment{parser, "environment",
+            "Equirectangular HDR environment for image based lighting, "
+            "precomputed once and cached",
+            {"env"}};
+        args::ValueFlag<std::string> cameras{parser, "cameras",
+            "JSON or CSV file of views (eye, center, up, optional fov in "
+            "degrees and size), each rendered to a numbered image of "
+            "--output from one load of the model",
+            {"cameras"}};
+        args::ValueFlag<int32_t> pngLevel{parser, "level",
+            "Compression level of png output images, from 0 (none) to 9 "
+            "(smallest, slowest, default 8)",
+            {"png-level"}};
+        args::ValueFlag<int32_t> encoders{parser, "encoders",
+            "Threads encoding the output images (default one per hardware "
+            "thread)",
+            {"encoders"}};
+        args::Flag benchmarkEncoders{parser, "benchmark-encoders",
+            "Print the encoding time and throughput of each output format, "
+            "on the image of the camera, then exit",
+            {"benchmark-encoders"}};
+        args::ValueFlag<int32_t> tileSize{parser, "size",
+            "Render the output images in tiles of size x size pixels, "
+            "streamed to the file row by row: for images larger than the "
+            "GPU allows, or than the memory. Automatic, in tiles of 2048, for "
+            "the images larger than the largest texture. Tiles do not combine "
+            "with --ssaa, --aux, --thumbnails or --stream.",
+            {"tile-size"}};
+        args::ValueFlag<int32_t> msaa{parser, "samples",
+            "Multisampling of the output images, in samples per pixel, with "
+            "the forward renderer",
+            {"msaa"}};
+        args::ValueFlag<int32_t> ssaa{parser, "factor",
+            "Supersampling of the output images: drawn factor times larger, "
+            "then downsampled",
+            {"ssaa"}};
+        args::ValueFlag<std::string> ssaaFilter{parser, "filter",
+            "Filter of the supersampling and thumbnails downsample: box "
+            "(default) or lanczos",
+            {"ssaa-filter"}};
+        args::Flag benchmarkAntialiasing{parser, "benchmark-aa",
+            "Print the cost of the image of the camera without "
+            "anti-aliasing, with multisampling and with supersampling at "
+            "each sample count, then exit",
+            {"benchmark-aa"}};
+        args::ValueFlag<std::string> aux{parser, "buffers",
+            "Auxiliary buffers of the output images, comma separated: depth, "
+            "normal, node, material. Drawn by one extra geometry pass, each "
+            "written next to the image (out_depth.png...): as floats for a "
+            ".pfm or .exr output, else as a 16 bits PNG.",
+            {"aux"}};
+        args::ValueFlag<std::string> thumbnails{parser, "sizes",
+            "Write the output images at these sizes, comma separated, in "
+            "pixels of their largest side (out_1024.png...): drawn once at "
+            "the largest size, of the aspect ratio of --width and --height, "
+            "then downsampled from size to size",
+            {"thumbnails"}};
+        args::ValueFlag<std::string> stream{parser, "path",
+            "Stream the frames of the views (--cameras or --orbit) to a "
+            "video encoder instead of writing images: to the standard output "
+            "for -, else to a file or a named pipe. The logs then go to the "
+            "error output.",
+            {"stream"}};
+        args::ValueFlag<std::string> streamFormat{parser, "format",
+            "Format of --stream: y4m (default, YUV 4:2:0) or rgb (raw 8 bits "
+            "frames, without header)",
+            {"stream-format"}};
+        args::ValueFlag<int32_t> fps{parser, "fps",
+            "Frames per second written in the y4m header of --stream "
+            "(default 30)",
+            {"fps"}};
+        args::ValueFlag<int32_t> orbit{parser, "frames",
+            "Views of a turntable: frames views turning around the center of "
+            "the camera, along its up vector. Instead of --cameras, for "
+            "--output or --stream.",
+            {"orbit"}};
         parser.Parse();
 
+        const auto rendererName = renderer ? args::get(renderer) : "forward";
+        if (rendererName != "forward" && rendererName != "deferred") {
+          throw args::ValidationError(
+              "Unknown renderer " + rendererName +
+              " (expected forward or deferred)");
+        }
+
+        if (headless && !output && !stream && !benchmark &&
+            !benchmarkEncoders && !benchmarkAntialiasing) {
+          throw args::ValidationError(
+              "--headless needs --output, --stream or a benchmark");
+        }
+
+        // The frames go to the stream instead of --output, through the same
+        // offscreen rendering: the flags of --output apply to it
+        if (stream && output) {
+          throw args::ValidationError("--stream and --output do not combine");
+        }
+        if ((streamFormat || fps) && !stream) {
+          throw args::ValidationError(
+              "--stream-format and --fps need --stream");
+        }
+        auto frameStreamFormat = FrameStreamFormat::Y4M;
+        if (streamFormat) {
+          try {
+            frameStreamFormat =
+                frameStreamFormatFromName(args::get(streamFormat));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(e.what());
+          }
+        }
+        const auto framesPerSecond = fps ? args::get(fps) : 30;
+        if (framesPerSecond < 1) {
+          throw args::ValidationError("--fps must be at least 1");
+        }
+        const auto orbitFrameCount = orbit ? args::get(orbit) : 0;
+        if (orbit && orbitFrameCount < 1) {
+          throw args::ValidationError("--orbit must be at least 1");
+        }
+        if (orbit && !output && !stream) {
+          throw args::ValidationError("--orbit needs --output or --stream");
+        }
+        if (orbit && cameras) {
+          throw args::ValidationError("--orbit and --cameras do not combine");
+        }
+        if (stream && (tileSize || aux || thumbnails)) {
+          throw args::ValidationError(
+              "--stream does not combine with --tile-size, --aux or "
+              "--thumbnails");
+        }
+
+        if (output) {
+          try {
+            imageFormatFromPath(args::get(output));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(
+                "Unable to write --output: " + std::string(e.what()));
+          }
+        }
+
+        if (pngLevel) {
+          if (args::get(pngLevel) < 0 || args::get(pngLevel) > 9) {
+            throw args::ValidationError("--png-level must be from 0 to 9");
+          }
+          setPngCompressionLevel(args::get(pngLevel));
+        }
+
+        const auto encoderThreadCount = encoders ? args::get(encoders) : 0;
+        if (encoders && encoderThreadCount < 1) {
+          throw args::ValidationError("--encoders must be at least 1");
+        }
+
+        const auto outputTileSize = tileSize ? args::get(tileSize) : 0;
+        if (tileSize && outputTileSize < 1) {
+          throw args::ValidationError("--tile-size must be at least 1");
+        }
+        if (tileSize && !output) {
+          throw args::ValidationError("--tile-size needs --output");
+        }
+
+        const auto msaaSampleCount = msaa ? args::get(msaa) : 1;
+        if (msaaSampleCount < 1) {
+          throw args::ValidationError("--msaa must be at least 1");
+        }
+        const auto ssaaFactor = ssaa ? args::get(ssaa) : 1;
+        if (ssaaFactor < 1) {
+          throw args::ValidationError("--ssaa must be at least 1");
+        }
+        if ((msaa || ssaa) && !output && !stream) {
+          throw args::ValidationError(
+              "--msaa and --ssaa need --output or --stream");
+        }
+        // The G-buffer and the accumulated samples are not multisampled
+        if (msaaSampleCount > 1 && rendererName == "deferred") {
+          throw args::ValidationError(
+              "--msaa needs the forward renderer, use --ssaa or --spp");
+        }
+        if (msaaSampleCount > 1 && spp && args::get(spp) > 1) {
+          throw args::ValidationError("--msaa and --spp do not combine");
+        }
+        if (ssaaFactor > 1 && tileSize) {
+          throw args::ValidationError("--ssaa and --tile-size do not combine");
+        }
+        auto downsampleFilter = DownsampleFilter::Box;
+        if (ssaaFilter) {
+          try {
+            downsampleFilter = downsampleFilterFromName(args::get(ssaaFilter));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(e.what());
+          }
+        }
+
+        std::vector<AuxiliaryBuffers::Buffer> auxiliaryBuffers;
+        if (aux) {
+          if (!output) {
+            throw args::ValidationError("--aux needs --output");
+          }
+          // The pass draws the whole image at once
+          if (tileSize) {
+            throw args::ValidationError("--aux and --tile-size do not combine");
+          }
+          try {
+            auxiliaryBuffers =
+                AuxiliaryBuffers::buffersFromNames(args::get(aux));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(e.what());
+          }
+        }
+
+        std::vector<uint32_t> thumbnailSizes;
+        if (thumbnails) {
+          if (!output) {
+            throw args::ValidationError("--thumbnails needs --output");
+          }
+          if (tileSize) {
+            throw args::ValidationError(
+                "--thumbnails and --tile-size do not combine");
+          }
+          for (const auto &token : split(args::get(thumbnails), ",")) {
+            // The whole token, digits only: strtoul alone takes "12px",
+            // " 12" or "-12"
+            char *end = nullptr;
+            errno = 0;
+            const auto size = std::strtoul(token.c_str(), &end, 10);
+            if (token.empty() || !std::isdigit((unsigned char)token[0]) ||
+                *end != '\0' || errno == ERANGE || size < 1 ||
+                size > std::numeric_limits<uint32_t>::max()) {
+              throw args::ValidationError(
+                  "--thumbnails sizes must be integers of at least 1, got " +
+                  token);
+            }
+            thumbnailSizes.push_back(uint32_t(size));
+          }
+          // From the largest, drawn, to the smallest
+          std::sort(thumbnailSizes.rbegin(), thumbnailSizes.rend());
+          thumbnailSizes.erase(
+              std::unique(thumbnailSizes.begin(), thumbnailSizes.end()),
+              thumbnailSizes.end());
+        }
+
+        std::vector<CameraView> cameraViews;
+        if (cameras) {
+          if (!output && !stream) {
+            throw args::ValidationError(
+                "--cameras needs --output or --stream");
+          }
+          try {
+            cameraViews = loadCameraViews(args::get(cameras));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(
+                "Unable to read --cameras: " + std::string(e.what()));
+          }
+        }
+
+        const auto sampleCount = spp ? args::get(spp) : 1;
+        if (sampleCount < 1) {
+          throw args::ValidationError("--spp must be at least 1");
+        }
+
         std::vector<float> lookatParams;
         if (lookat) {
           const std::string &lookatArgs = args::get(lookat);
@@ -60,13 +384,169 @@ int main(int argc, char **argv)
           }
         }
 
-        uint32_t width = imageWidth ? args::get(imageWidth) : 1280;
-        uint32_t height = imageHeight ? args::get(imageHeight) : 720;
+        ViewerApplication::Options options;
+        options.appPath = argv[0];
+        options.width = imageWidth ? args::get(imageWidth) : 1280;
+        options.height = imageHeight ? args::get(imageHeight) : 720;
+        options.gltfFile = args::get(file);
+        options.lookatArgs = lookatParams;
+        options.vertexShader = args::get(vertexShader);
+        options.fragmentShader = args::get(fragmentShader);
+        options.output = args::get(output);
+        options.deferredRendering = rendererName == "deferred";
+        options.useMeshArena = !noMeshArena;
+        options.benchmarkRenderers = bool(benchmark);
+        options.outputSampleCount = uint32_t(sampleCount);
+        options.environment = args::get(environment);
+        options.headless =
+            headless || benchmarkEncoders || benchmarkAntialiasing;
+        options.cameraViews = cameraViews;
+        options.encoderThreadCount = size_t(encoderThreadCount);
+        options.benchmarkEncoders = bool(benchmarkEncoders);
+        options.tileSize = uint32_t(outputTileSize);
+        options.msaaSampleCount = uint32_t(msaaSampleCount);
+        options.ssaaFactor = uint32_t(ssaaFactor);
+        options.ssaaFilter = downsampleFilter;
+        options.benchmarkAntialiasing = bool(benchmarkAntialiasing);
+        options.auxiliaryBuffers = auxiliaryBuffers;
+        options.thumbnailSizes = thumbnailSizes;
+        options.streamPath = args::get(stream);
+        options.streamFormat = frameStreamFormat;
+        options.framesPerSecond = uint32_t(framesPerSecond);
+        options.orbitFrameCount = uint32_t(orbitFrameCount);
+
+        // Before the first log of the application
+        if (stream && args::get(stream) == "-") {
+          reserveStandardOutput();
+        }
 
-        ViewerApplication app{fs::path{argv[0]}, width, height, args::get(file),
-            lookatParams, args::get(vertexShader), args::get(fragmentShader),
-            args::get(output)};
-        returnCode = app.run();
+        ViewerApplication app{options};
+        try {
+          returnCode = app.run();
+        } catch (const std::runtime_error &e) {
+          // Tiles too large, or an output file that cannot be created
+          std::cerr << e.what() << std::endl;
+          returnCode = 1;
+        }
+      }};
+
+  args::Command serve{commands, "serve",
+      "Render images on request, the models and the OpenGL context kept "
+      "loaded between requests. The requests are JSON lines, read from the "
+      "standard input or from the clients of --socket: {\"model\": path, "
+      "\"eye\", \"center\", \"up\", \"width\", \"height\", \"output\": "
+      "path}, {\"command\": \"stats\"} or {\"command\": \"shutdown\"}",
+      [&](args::Subparser &parser) {
+        args::ValueFlag<std::string> socket{parser, "socket",
+            "Path of a local socket to serve, instead of the standard input",
+            {"socket"}};
+        args::ValueFlag<int32_t> imageWidth{parser, "width",
+            "Width of the images without width (default 1280)",
+            {"w", "width"}};
+        args::ValueFlag<int32_t> imageHeight{parser, "height",
+            "Height of the images without height (default 720)",
+            {"h", "height"}};
+        args::ValueFlag<std::string> renderer{parser, "renderer",
+            "Rendering path: forward (default) or deferred", {"renderer"}};
+        args::ValueFlag<std::string> environment{parser, "environment",
+            "Equirectangular HDR environment for image based lighting",
+            {"env"}};
+        args::ValueFlag<int32_t> cacheModels{parser, "count",
+            "Models kept loaded (default 4)", {"cache-models"}};
+        args::ValueFlag<int32_t> cacheHostMb{parser, "MB",
+            "Host memory of the models kept loaded (default no bound)",
+            {"cache-host-mb"}};
+        args::ValueFlag<int32_t> cacheGpuMb{parser, "MB",
+            "GPU memory of the models kept loaded (default no bound)",
+            {"cache-gpu-mb"}};
+        args::ValueFlag<int32_t> pngLevel{parser, "level",
+            "Compression level of png images, from 0 to 9 (default 8)",
+            {"png-level"}};
+        parser.Parse();
+
+        RenderServer::Options options;
+        options.appPath = argv[0];
+        options.width = imageWidth ? args::get(imageWidth) : 1280;
+        options.height = imageHeight ? args::get(imageHeight) : 720;
+        const auto rendererName = renderer ? args::get(renderer) : "forward";
+        if (rendererName != "forward" && rendererName != "deferred") {
+          throw args::ValidationError(
+              "Unknown renderer " + rendererName +
+              " (expected forward or deferred)");
+        }
+        options.deferredRendering = rendererName == "deferred";
+        options.environment = args::get(environment);
+        if (cacheModels) {
+          if (args::get(cacheModels) < 1) {
+            throw args::ValidationError("--cache-models must be at least 1");
+          }
+          options.maxModelCount = size_t(args::get(cacheModels));
+        }
+        if ((cacheHostMb && args::get(cacheHostMb) < 1) ||
+            (cacheGpuMb && args::get(cacheGpuMb) < 1)) {
+          throw args::ValidationError("The cache bounds must be at least 1");
+        }
+        options.maxHostBytes =
+            cacheHostMb ? size_t(args::get(cacheHostMb)) << 20 : 0;
+        options.maxGpuBytes =
+            cacheGpuMb ? size_t(args::get(cacheGpuMb)) << 20 : 0;
+        if (pngLevel) {
+          if (args::get(pngLevel) < 0 || args::get(pngLevel) > 9) {
+            throw args::ValidationError("--png-level must be from 0 to 9");
+          }
+          setPngCompressionLevel(args::get(pngLevel));
+        }
+
+        try {
+          RenderServer server{options};
+          if (socket) {
+            server.serveSocket(args::get(socket));
+          } else {
+            server.serveStdio();
+          }
+        } catch (const std::runtime_error &e) {
+          std::cerr << e.what() << std::endl;
+          returnCode = 1;
+        }
+      }};
+
+  args::Command request{commands, "request",
+      "Send requests to the render server of a local socket and print its "
+      "responses, to try it out",
+      [&](args::Subparser &parser) {
+        args::ValueFlag<std::string> socket{parser, "socket",
+            "Path of the socket of the server", {"socket"},
+            args::Options::Required};
+        args::PositionalList<std::string> requests{parser, "requests",
+            "JSON requests, else one per line of the standard input"};
+        parser.Parse();
+
+        try {
+          auto connection = LocalSocket::connect(args::get(socket));
+          const auto send = [&](const std::string &line) {
+            connection.writeLine(line);
+            std::string response;
+            if (!connection.readLine(response)) {
+              throw std::runtime_error("The server closed the connection");
+            }
+            std::cout << response << std::endl;
+          };
+          if (requests) {
+            for (const auto &line : args::get(requests)) {
+              send(line);
+            }
+          } else {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+              if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                send(line);
+              }
+            }
+          }
+        } catch (const std::runtime_error &e) {
+          std::cerr << e.what() << std::endl;
+          returnCode = 1;
+        }
       }};
 
   try {
@@ -0,0 +1,27 @@
+#version 330
+
+// Auxiliary buffers of the output images, see utils/auxiliaryBuffers.hpp: the
+// outputs match the indices of AuxiliaryBuffers::Buffer, the framebuffer
+// discards the ones not requested.
+
+in vec3 vViewSpacePosition;
+in vec3 vViewSpaceNormal;
+
+layout(location = 0) out float fDepth;
+layout(location = 1) out vec3 fNormal;
+layout(location = 2) out float fNodeId;
+layout(location = 3) out float fMaterialId;
+
+// Plus one, 0 is left where no geometry is seen
+uniform int uNodeId;
+uniform int uMaterialId;
+
+void main()
+{
+  fDepth = -vViewSpacePosition.z;
+  // Towards the camera, for the back faces of double sided materials
+  vec3 normal = normalize(vViewSpaceNormal);
+  fNormal = gl_FrontFacing ? normal : -normal;
+  fNodeId = float(uNodeId);
+  fMaterialId = float(uMaterialId);
+}
@@ -0,0 +1,93 @@
+#version 430
+
+// Assign the punctual lights to the clusters of the view frustum, one
+// invocation per cluster. MAX_LIGHTS_PER_CLUSTER and the *_BINDING points are
+// defined by the viewer, see utils/clusteredLights.hpp.
+
+layout(local_size_x = 64) in;
+
+struct PunctualLight
+{
+  vec4 positionRange;           // View space position, range
+  vec4 colorSpot;               // Color, 1 for a spot light
+  vec4 directionOuterConeCos;   // View space spot direction
+  vec4 attenuationInnerConeCos; // Constant, linear, quadratic terms
+};
+
+layout(std430, binding = LIGHTS_BINDING) readonly buffer PunctualLights
+{
+  PunctualLight punctualLights[];
+};
+layout(std430, binding = CLUSTER_LIGHT_COUNTS_BINDING) writeonly buffer
+    ClusterLightCounts
+{
+  uint clusterLightCounts[];
+};
+layout(std430, binding = CLUSTER_LIGHT_INDICES_BINDING) writeonly buffer
+    ClusterLightIndices
+{
+  uint clusterLightIndices[];
+};
+
+uniform uvec3 uClusterGridSize;
+uniform mat4 uInverseProjMatrix;
+uniform vec2 uClusterDepthRange; // Near and far depths of the slices
+uniform uint uLightCount;
+
+// Point of the view ray through ndc.xy at view space depth -depth
+vec3 viewRayAtDepth(vec2 ndc, float depth)
+{
+  vec4 onNearPlane = uInverseProjMatrix * vec4(ndc, -1, 1);
+  vec3 ray = onNearPlane.xyz / onNearPlane.w;
+  return ray * (depth / -ray.z);
+}
+
+void main()
+{
+  uint clusterIndex = gl_GlobalInvocationID.x;
+  uint clusterCount =
+      uClusterGridSize.x * uClusterGridSize.y * uClusterGridSize.z;
+  if (clusterIndex >= clusterCount) {
+    return;
+  }
+  uvec3 cluster = uvec3(clusterIndex % uClusterGridSize.x,
+      (clusterIndex / uClusterGridSize.x) % uClusterGridSize.y,
+      clusterIndex / (uClusterGridSize.x * uClusterGridSize.y));
+
+  // Bounding box of the cluster in view space
+  vec2 ndcMin = vec2(cluster.xy) / vec2(uClusterGridSize.xy) * 2 - 1;
+  vec2 ndcMax = vec2(cluster.xy + 1) / vec2(uClusterGridSize.xy) * 2 - 1;
+  float depthRatio = uClusterDepthRange.y / uClusterDepthRange.x;
+  float sliceNear = cluster.z == 0
+      ? 0
+      : uClusterDepthRange.x *
+            pow(depthRatio, float(cluster.z) / uClusterGridSize.z);
+  float sliceFar = uClusterDepthRange.x *
+                   pow(depthRatio, float(cluster.z + 1) / uClusterGridSize.z);
+
+  vec3 aabbMin = vec3(1e30);
+  vec3 aabbMax = vec3(-1e30);
+  for (int corner = 0; corner < 4; ++corner) {
+    vec2 ndc = vec2(corner % 2 == 0 ? ndcMin.x : ndcMax.x,
+        corner / 2 == 0 ? ndcMin.y : ndcMax.y);
+    vec3 nearPoint = viewRayAtDepth(ndc, sliceNear);
+    vec3 farPoint = viewRayAtDepth(ndc, sliceFar);
+    aabbMin = min(aabbMin, min(nearPoint, farPoint));
+    aabbMax = max(aabbMax, max(nearPoint, farPoint));
+  }
+
+  // Keep the lights whose sphere of influence overlaps the box
+  uint count = 0;
+  uint firstIndex = clusterIndex * MAX_LIGHTS_PER_CLUSTER;
+  for (uint i = 0; i < uLightCount && count < MAX_LIGHTS_PER_CLUSTER; ++i) {
+    vec3 center = punctualLights[i].positionRange.xyz;
+    float range = punctualLights[i].positionRange.w;
+    vec3 closestPoint = clamp(center, aabbMin, aabbMax);
+    vec3 d = closestPoint - center;
+    if (dot(d, d) <= range * range) {
+      clusterLightIndices[firstIndex + count] = i;
+      ++count;
+    }
+  }
+  clusterLightCounts[clusterIndex] = count;
+}
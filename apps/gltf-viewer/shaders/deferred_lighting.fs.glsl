@@ -0,0 +1,43 @@
+#version 430
+
+// Lighting pass of the deferred renderer: the lights are evaluated once per
+// pixel from the G-buffer written by gbuffer.fs.glsl. The pixels without
+// geometry are rejected by the depth test, see fullscreen_triangle.vs.glsl. The
+// features of a permutation are the #defines of pbr_lights.glsl.
+
+#include "pbr_brdf.glsl"
+#include "pbr_lights.glsl"
+
+uniform sampler2D uGBufferBaseColor;
+uniform sampler2D uGBufferNormal;
+uniform sampler2D uGBufferMetallicRoughness;
+uniform sampler2D uGBufferEmissive;
+uniform sampler2D uGBufferDepth;
+
+uniform mat4 uInverseProjMatrix;
+uniform vec2 uViewportSize; // Smaller than the G-buffer with dynamic resolution
+
+out vec3 fColor;
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  float depth = texelFetch(uGBufferDepth, pixel, 0).r;
+
+  // View space position from the depth buffer
+  vec2 uv = gl_FragCoord.xy / uViewportSize;
+  vec4 ndcPosition = vec4(2 * vec3(uv, depth) - 1, 1);
+  vec4 viewSpacePosition = uInverseProjMatrix * ndcPosition;
+  viewSpacePosition /= viewSpacePosition.w;
+
+  vec3 baseColor = texelFetch(uGBufferBaseColor, pixel, 0).rgb;
+  vec3 normal = texelFetch(uGBufferNormal, pixel, 0).xyz;
+  vec2 metallicRoughness = texelFetch(uGBufferMetallicRoughness, pixel, 0).rg;
+  vec3 emissive = texelFetch(uGBufferEmissive, pixel, 0).rgb;
+
+  SurfacePoint surface = surfacePoint(baseColor, metallicRoughness.r,
+      metallicRoughness.g, normal, viewSpacePosition.xyz);
+
+  fColor = lightsValue(surface, viewSpacePosition.xyz);
+  fColor += LINEARtoSRGB(emissive);
+}
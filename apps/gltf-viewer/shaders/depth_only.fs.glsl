@@ -0,0 +1,6 @@
+#version 330
+
+// No color output, with the color writes disabled: used by the depth pre-pass
+// and by the coverage pass of the overdraw measure.
+
+void main() {}
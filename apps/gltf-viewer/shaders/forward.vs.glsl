@@ -5,6 +5,8 @@ layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
 layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitangent;
+layout(location = 5) in mat4 aInstanceModelMatrix; // locations 5 to 8
+layout(location = 9) in mat3 aInstanceNormalMatrix; // locations 9 to 11
 
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
@@ -13,26 +15,48 @@ out mat3 TBN;
 
 out vec3 vTangent;
 
+// The depth pre-pass and the shading pass must compute the same depth
+invariant gl_Position;
+
 uniform mat4 uModelMatrix;
 uniform mat4 uModelViewProjMatrix;
 uniform mat4 uModelViewMatrix;
 uniform mat4 uNormalMatrix;
 
+// With instancing the model and normal matrices are vertex attributes, so the
+// other matrices are computed here from the view and projection matrices
+uniform bool uUseInstancing;
+uniform mat4 uViewMatrix;
+uniform mat4 uProjMatrix;
+
 void main()
 {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1.0));
-	  vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0.0)));
+    mat4 modelMatrix = uModelMatrix;
+    mat4 modelViewMatrix = uModelViewMatrix;
+    mat4 modelViewProjMatrix = uModelViewProjMatrix;
+    mat4 normalMatrix = uNormalMatrix;
+    if (uUseInstancing) {
+      modelMatrix = aInstanceModelMatrix;
+      modelViewMatrix = uViewMatrix * modelMatrix;
+      modelViewProjMatrix = uProjMatrix * modelViewMatrix;
+      // The view matrix is a rotation and a translation, its normal matrix is
+      // its upper 3x3
+      normalMatrix = mat4(mat3(uViewMatrix) * aInstanceNormalMatrix);
+    }
+
+    vViewSpacePosition = vec3(modelViewMatrix * vec4(aPosition, 1.0));
+	  vViewSpaceNormal = normalize(vec3(normalMatrix * vec4(aNormal, 0.0)));
 	  vTexCoords = aTexCoords;
 
     // On multiplie par la modelMatrix car on veut uniquement leur orientation dans le "tangent space",
     //si on voulait aussi leur directino il faudrait multiplier en plus par la normal matrix
-    vec3 N = normalize(vec3(uModelMatrix * vec4(aNormal, 0.0)));
-    vec3 T = normalize(vec3(uModelMatrix * vec4(aTangent, 0.0)));
+    vec3 N = normalize(vec3(modelMatrix * vec4(aNormal, 0.0)));
+    vec3 T = normalize(vec3(modelMatrix * vec4(aTangent, 0.0)));
     //vec3 B = normalize(vec3(uModelMatrix * vec4(aBitangent, 0.0)));
     vec3 B = cross(N, T);
     TBN = mat3(T, B, N);
 
     vTangent = normalize(aTangent);
 
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1.0);
+    gl_Position =  modelViewProjMatrix * vec4(aPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330
+
+// A triangle covering the screen on the far plane, drawn without vertex
+// buffer: glDrawArrays(GL_TRIANGLES, 0, 3) with an empty vertex array object
+// bound. With a GL_GREATER depth test against the depth buffer of the scene,
+// only the pixels covered by the geometry pass: the deferred lighting pass
+// shades them and the overdraw measure counts them.
+
+void main()
+{
+  vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(2 * position - 1, 1, 1);
+}
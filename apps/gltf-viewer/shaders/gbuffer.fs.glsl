@@ -0,0 +1,23 @@
+#version 430
+
+// Geometry pass of the deferred renderer: the material of the fragment is
+// written to the G-buffer, see utils/gBuffer.hpp for its layout. The features
+// of a permutation are the #defines of pbr_material.glsl.
+
+#include "pbr_brdf.glsl"
+#include "pbr_material.glsl"
+
+layout(location = 0) out vec4 fBaseColor; // sRGB texture, encoded by GL
+layout(location = 1) out vec4 fNormal;
+layout(location = 2) out vec2 fMetallicRoughness;
+layout(location = 3) out vec3 fEmissive;
+
+void main()
+{
+  Material material = sampleMaterial();
+
+  fBaseColor = vec4(material.baseColor.rgb, 1);
+  fNormal = vec4(material.normal, 0);
+  fMetallicRoughness = vec2(material.metallic, material.roughness);
+  fEmissive = material.emissive;
+}
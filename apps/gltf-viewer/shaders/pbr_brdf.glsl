@@ -0,0 +1,101 @@
+// Metallic-roughness BRDF of glTF, shared by the forward and the deferred
+// renderers. Included by the fragment shaders, see loadShaderSource.
+
+// Constants
+const float GAMMA = 2.2;
+const float INV_GAMMA = 1. / GAMMA;
+const float M_PI = 3.141592653589793;
+const float M_1_PI = 1.0 / M_PI;
+
+const vec3 dielectricSpecular = vec3(0.04, 0.04, 0.04);
+const vec3 black = vec3(0, 0, 0);
+
+// We need some simple tone mapping functions
+// Basic gamma = 2.2 implementation
+// Stolen here:
+// https://github.com/KhronosGroup/glTF-Sample-Viewer/blob/master/src/shaders/tonemapping.glsl
+
+// linear to sRGB approximation
+// see http://chilliant.blogspot.com/2012/08/srgb-approximations-for-hlsl.html
+vec3 LINEARtoSRGB(vec3 color) { return pow(color, vec3(INV_GAMMA)); }
+
+// sRGB to linear approximation
+// see http://chilliant.blogspot.com/2012/08/srgb-approximations-for-hlsl.html
+vec4 SRGBtoLINEAR(vec4 srgbIn)
+{
+  return vec4(pow(srgbIn.xyz, vec3(GAMMA)), srgbIn.w);
+}
+
+// Everything the BRDF needs that does not depend on the light, evaluated once
+// per fragment
+struct SurfacePoint
+{
+  vec3 N;
+  vec3 V;
+  vec3 cDiff;
+  vec3 F0;
+  float roughness;
+  float alphaPow2;
+};
+
+// N is the view space normal, baseColor is linear
+SurfacePoint surfacePoint(vec3 baseColor, float metallicFactor,
+    float roughness, vec3 N, vec3 viewSpacePosition)
+{
+  SurfacePoint surface;
+
+  surface.N = N;
+  surface.V = normalize(-viewSpacePosition);
+
+  vec3 metallic = vec3(metallicFactor);
+  surface.cDiff = mix(baseColor * (1 - dielectricSpecular.r), black, metallic);
+  surface.F0 = mix(vec3(dielectricSpecular), baseColor, metallic);
+  surface.roughness = roughness;
+  float _alpha = roughness * roughness;
+  surface.alphaPow2 = _alpha * _alpha;
+
+  return surface;
+}
+
+// (f_diffuse + f_specular) * NdotL for a light coming from direction L
+vec3 brdf(SurfacePoint surface, vec3 L)
+{
+  vec3 N = surface.N;
+  vec3 V = surface.V;
+  vec3 H = normalize(L + V);
+  float _alphaPow2 = surface.alphaPow2;
+
+  float NdotL = clamp(dot(N, L), 0.0, 1.0);
+  float NdotV = clamp(dot(N, V), 0.0, 1.0);
+  float NdotH = clamp(dot(N, H), 0.0, 1.0);
+  float VdotH = clamp(dot(V, H), 0.0, 1.0);
+
+  vec3 diffuse = surface.cDiff * M_1_PI;
+
+  /** F **/
+  float baseShlickFactor = 1 - VdotH;
+  float shlickFactor = baseShlickFactor * baseShlickFactor; // power 2
+  shlickFactor *= shlickFactor;                             // power 4
+  shlickFactor *= baseShlickFactor;                         // power 5
+  vec3 F = surface.F0 + (1 - surface.F0) * shlickFactor;
+
+  /** Vis **/
+  float Vis = 0;
+  float denumVis =
+      (NdotL)*sqrt((NdotV * NdotV) * (1 - _alphaPow2) + _alphaPow2) +
+      (NdotV)*sqrt((NdotL * NdotL) * (1 - _alphaPow2) + _alphaPow2);
+  if (denumVis > 0) {
+    Vis = 0.5 / denumVis;
+  }
+
+  /** D **/
+  float DenumD = M_PI * ((NdotH * NdotH * (_alphaPow2 - 1) + 1) *
+                            (NdotH * NdotH * (_alphaPow2 - 1) + 1));
+  float D = _alphaPow2 / DenumD;
+
+  /** f_specular = F . Vis . D **/
+  vec3 f_specular = F * Vis * D;
+  vec3 f_diffuse = (1 - F) * diffuse;
+
+  return (f_diffuse + f_specular) * NdotL;
+}
@@ -0,0 +1,293 @@
+// Lights of the scene, shared by the forward and the deferred renderers.
+// Requires pbr_brdf.glsl. The lights a permutation evaluates are selected by
+// the viewer at compile time:
+// - NUM_POINT_LIGHTS (number of enabled point lights, 0 to 3)
+// - HAS_SPOT_LIGHT
+// - CLUSTERED_LIGHTS: the point and spot lights are read from the buffers of
+// utils/clusteredLights.hpp instead of the uniforms, and only the lights of
+// the cluster of the fragment are evaluated
+// - IMAGE_BASED_LIGHTING: the environment precomputed by
+// utils/environmentLighting.hpp
+// - HAS_SHADOWS: the directional and the spot lights are shadowed by the
+// layers of utils/shadowMaps.hpp
+// The directional light is always evaluated.
+
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 0
+#endif
+
+/** Directional Light **/
+struct directionalLight
+{
+  vec3 uLightDirection;
+  vec3 uLightIntensity;
+};
+uniform directionalLight dirLight;
+
+/** Point Light **/
+struct PointLight
+{
+  vec3 position;
+  vec3 color;
+  float constant;
+  float linear;
+  float quadratic;
+};
+#if NUM_POINT_LIGHTS > 0
+uniform PointLight pointLight[NUM_POINT_LIGHTS];
+#endif
+
+/** Spot light **/
+struct SpotLight
+{
+  vec3 position;
+  vec3 direction;
+  vec3 color;
+  float cutOff;
+  float outerCutOff;
+  float constant;
+  float linear;
+  float quadratic;
+};
+#ifdef HAS_SPOT_LIGHT
+uniform SpotLight spotLight;
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+struct PunctualLight
+{
+  vec4 positionRange;           // View space position, range
+  vec4 colorSpot;               // Color, 1 for a spot light
+  vec4 directionOuterConeCos;   // View space spot direction
+  vec4 attenuationInnerConeCos; // Constant, linear, quadratic terms
+};
+
+layout(std430, binding = LIGHTS_BINDING) readonly buffer PunctualLights
+{
+  PunctualLight punctualLights[];
+};
+layout(std430, binding = CLUSTER_LIGHT_COUNTS_BINDING) readonly buffer
+    ClusterLightCounts
+{
+  uint clusterLightCounts[];
+};
+layout(std430, binding = CLUSTER_LIGHT_INDICES_BINDING) readonly buffer
+    ClusterLightIndices
+{
+  uint clusterLightIndices[];
+};
+
+uniform uvec3 uClusterGridSize;
+uniform vec2 uClusterTileSize;       // In pixels
+uniform vec2 uClusterDepthScaleBias; // slice = log(depth) * scale + bias
+#endif
+
+#ifdef IMAGE_BASED_LIGHTING
+uniform vec3 uIrradianceSH[9]; // Diffuse radiance of a white surface
+uniform samplerCube uSpecularEnvironment; // Mip level per roughness step
+uniform sampler2D uBrdfLut; // Scale and bias of F0, of NdotV and roughness
+uniform mat3 uViewToWorld; // The environment is in world space
+uniform float uEnvironmentIntensity;
+#endif
+
+#ifdef HAS_SHADOWS
+uniform sampler2DArrayShadow uShadowMaps;
+// From view space to the clip space of the light of each layer
+uniform mat4 uShadowMatrices[SHADOW_LAYER_COUNT];
+uniform float uCascadeEnds[SHADOW_CASCADE_COUNT]; // View depths
+
+// Fraction of the light of a layer reaching a view space position, filtered
+// over 3x3 texels
+float shadowFactor(int layer, SurfacePoint surface, vec3 viewSpacePosition)
+{
+  // The position is pushed along the normal by a texel, against the acne
+  // of the surfaces at grazing angles to the light
+  vec4 clipPosition = uShadowMatrices[layer] * vec4(viewSpacePosition, 1);
+  vec3 rowX = vec3(uShadowMatrices[layer][0][0], uShadowMatrices[layer][1][0],
+      uShadowMatrices[layer][2][0]);
+  float mapSize = float(textureSize(uShadowMaps, 0).x);
+  float texelSize = 2.0 * clipPosition.w / (length(rowX) * mapSize);
+  clipPosition = uShadowMatrices[layer] *
+                 vec4(viewSpacePosition + surface.N * texelSize, 1);
+
+  vec3 position = clipPosition.xyz / clipPosition.w * 0.5 + 0.5;
+  if (clipPosition.w <= 0 || any(lessThan(position, vec3(0))) ||
+      any(greaterThan(position, vec3(1)))) {
+    return 1.0; // Out of the map, nothing casts shadows there
+  }
+  float lit = 0;
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      vec2 offset = vec2(x, y) / mapSize;
+      lit += texture(
+          uShadowMaps, vec4(position.xy + offset, layer, position.z));
+    }
+  }
+  return lit / 9.0;
+}
+
+// The first cascade ending beyond the position covers it
+float directionalShadowFactor(SurfacePoint surface, vec3 viewSpacePosition)
+{
+  float depth = -viewSpacePosition.z;
+  for (int i = 0; i < SHADOW_CASCADE_COUNT; ++i) {
+    if (depth <= uCascadeEnds[i]) {
+      return shadowFactor(i, surface, viewSpacePosition);
+    }
+  }
+  return 1.0;
+}
+#endif
+
+vec3 directionalLightValue(SurfacePoint surface, vec3 viewSpacePosition)
+{
+  vec3 color =
+      brdf(surface, dirLight.uLightDirection) * dirLight.uLightIntensity;
+#ifdef HAS_SHADOWS
+  color *= directionalShadowFactor(surface, viewSpacePosition);
+#endif
+  return LINEARtoSRGB(color);
+}
+
+#if NUM_POINT_LIGHTS > 0
+vec3 pointLightValue(
+    SurfacePoint surface, vec3 viewSpacePosition, PointLight pointLight)
+{
+  /** lightDir **/
+  vec3 L = normalize(pointLight.position - viewSpacePosition);
+
+  // attenuation
+  float distance = length(pointLight.position - viewSpacePosition);
+  float attenuation =
+      1.0 / (pointLight.constant + pointLight.linear * distance +
+                pointLight.quadratic * (distance * distance));
+
+  return LINEARtoSRGB(brdf(surface, L) * attenuation * pointLight.color);
+}
+#endif
+
+#ifdef HAS_SPOT_LIGHT
+vec3 spotLightValue(SurfacePoint surface, vec3 viewSpacePosition)
+{
+  vec3 L = normalize(spotLight.position - viewSpacePosition);
+
+  float theta = dot(L, normalize(-spotLight.direction));
+  float epsilon = spotLight.cutOff - spotLight.outerCutOff;
+  float intensity = clamp((theta - spotLight.outerCutOff) / epsilon, 0.0, 1.0);
+
+  // attenuation
+  float distance = length(spotLight.position - viewSpacePosition);
+  float attenuation = 1.0 / (spotLight.constant + spotLight.linear * distance +
+                                spotLight.quadratic * (distance * distance));
+
+  vec3 color = brdf(surface, L) * intensity * attenuation * spotLight.color;
+#ifdef HAS_SHADOWS
+  color *= shadowFactor(SPOT_SHADOW_LAYER, surface, viewSpacePosition);
+#endif
+  return LINEARtoSRGB(color);
+}
+#endif
+
+#ifdef CLUSTERED_LIGHTS
+vec3 punctualLightValue(
+    SurfacePoint surface, vec3 viewSpacePosition, PunctualLight light)
+{
+  vec3 toLight = light.positionRange.xyz - viewSpacePosition;
+  float distance = length(toLight);
+  vec3 L = toLight / distance;
+
+  // attenuation, smoothly faded out to zero at the range of the light
+  vec3 terms = light.attenuationInnerConeCos.xyz;
+  float attenuation =
+      1.0 / max(terms.x + terms.y * distance + terms.z * distance * distance,
+                1e-4);
+  float window =
+      clamp(1.0 - pow(distance / light.positionRange.w, 4.0), 0.0, 1.0);
+  attenuation *= window * window;
+
+  if (light.colorSpot.w > 0) {
+    float theta = dot(L, normalize(-light.directionOuterConeCos.xyz));
+    float epsilon = max(light.attenuationInnerConeCos.w -
+                            light.directionOuterConeCos.w,
+        1e-4);
+    attenuation *= clamp(
+        (theta - light.directionOuterConeCos.w) / epsilon, 0.0, 1.0);
+  }
+
+  return LINEARtoSRGB(brdf(surface, L) * attenuation * light.colorSpot.rgb);
+}
+
+vec3 clusteredLightsValue(SurfacePoint surface, vec3 viewSpacePosition)
+{
+  uvec2 tile = uvec2(gl_FragCoord.xy / uClusterTileSize);
+  float slice = log(-viewSpacePosition.z) * uClusterDepthScaleBias.x +
+                uClusterDepthScaleBias.y;
+  uvec3 cluster = min(uvec3(tile, uint(max(slice, 0.0))), uClusterGridSize - 1);
+  uint clusterIndex =
+      cluster.x +
+      uClusterGridSize.x * (cluster.y + uClusterGridSize.y * cluster.z);
+
+  vec3 color = vec3(0);
+  uint firstIndex = clusterIndex * MAX_LIGHTS_PER_CLUSTER;
+  uint count = clusterLightCounts[clusterIndex];
+  for (uint i = 0; i < count; ++i) {
+    uint lightIndex = clusterLightIndices[firstIndex + i];
+    color += punctualLightValue(
+        surface, viewSpacePosition, punctualLights[lightIndex]);
+  }
+  return color;
+}
+#endif
+
+#ifdef IMAGE_BASED_LIGHTING
+// Same basis as utils/environmentLighting.cpp
+vec3 irradianceSH(vec3 N)
+{
+  return uIrradianceSH[0] * 0.282095 + uIrradianceSH[1] * 0.488603 * N.y +
+         uIrradianceSH[2] * 0.488603 * N.z +
+         uIrradianceSH[3] * 0.488603 * N.x +
+         uIrradianceSH[4] * 1.092548 * N.x * N.y +
+         uIrradianceSH[5] * 1.092548 * N.y * N.z +
+         uIrradianceSH[6] * 0.315392 * (3 * N.z * N.z - 1) +
+         uIrradianceSH[7] * 1.092548 * N.x * N.z +
+         uIrradianceSH[8] * 0.546274 * (N.x * N.x - N.y * N.y);
+}
+
+// Split sum approximation of the environment reflected by a surface point
+vec3 imageBasedLightValue(SurfacePoint surface)
+{
+  vec3 N = uViewToWorld * surface.N;
+  vec3 R = uViewToWorld * reflect(-surface.V, surface.N);
+  float NdotV = clamp(dot(surface.N, surface.V), 0.0, 1.0);
+
+  vec3 diffuse = surface.cDiff * max(irradianceSH(N), 0.0);
+
+  float lod = surface.roughness *
+              float(textureQueryLevels(uSpecularEnvironment) - 1);
+  vec3 prefiltered = textureLod(uSpecularEnvironment, R, lod).rgb;
+  vec2 scaleBias = texture(uBrdfLut, vec2(NdotV, surface.roughness)).rg;
+  vec3 specular = prefiltered * (surface.F0 * scaleBias.x + scaleBias.y);
+
+  return LINEARtoSRGB((diffuse + specular) * uEnvironmentIntensity);
+}
+#endif
+
+// Sum of the enabled lights reflected by a surface point
+vec3 lightsValue(SurfacePoint surface, vec3 viewSpacePosition)
+{
+  vec3 color = directionalLightValue(surface, viewSpacePosition);
+#if NUM_POINT_LIGHTS > 0
+  for (int i = 0; i < NUM_POINT_LIGHTS; ++i)
+    color += pointLightValue(surface, viewSpacePosition, pointLight[i]);
+#endif
+#ifdef HAS_SPOT_LIGHT
+  color += spotLightValue(surface, viewSpacePosition);
+#endif
+#ifdef CLUSTERED_LIGHTS
+  color += clusteredLightsValue(surface, viewSpacePosition);
+#endif
+#ifdef IMAGE_BASED_LIGHTING
+  color += imageBasedLightValue(surface);
+#endif
+  return color;
+}
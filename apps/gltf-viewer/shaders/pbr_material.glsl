@@ -0,0 +1,84 @@
+// glTF metallic-roughness material sampled at the fragment, shared by the
+// forward and the G-buffer passes. Requires pbr_brdf.glsl. The textures a
+// permutation reads are selected by the viewer at compile time:
+// - HAS_BASE_COLOR_TEXTURE, HAS_METALLIC_ROUGHNESS_TEXTURE
+// - HAS_NORMAL_MAP (normal mapping enabled and material has a normal texture)
+// - HAS_EMISSIVE (non black emissive factor), HAS_EMISSIVE_TEXTURE
+// - DOUBLE_SIDED (back faces are not culled and face the other way)
+// Without any define, only the factors are used.
+
+in vec3 vViewSpacePosition;
+in vec3 vViewSpaceNormal;
+in vec2 vTexCoords;
+in mat3 TBN;
+
+in vec3 vTangent;
+
+uniform vec4 uBaseColorFactor;
+uniform float uMetallicFactor;
+uniform float uRoughnessFactor;
+uniform vec3 uEmissiveFactor;
+
+#ifdef HAS_BASE_COLOR_TEXTURE
+uniform sampler2D uBaseColorTexture;
+#endif
+#ifdef HAS_METALLIC_ROUGHNESS_TEXTURE
+uniform sampler2D uMetallicRoughnessTexture;
+#endif
+#ifdef HAS_EMISSIVE_TEXTURE
+uniform sampler2D uEmissiveTexture;
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform sampler2D uNormalTexture;
+#endif
+
+struct Material
+{
+  vec4 baseColor; // Linear
+  float metallic;
+  float roughness;
+  vec3 normal; // View space
+  vec3 emissive; // Linear
+};
+
+Material sampleMaterial()
+{
+  Material material;
+
+  material.normal = normalize(vViewSpaceNormal);
+#ifdef HAS_NORMAL_MAP
+  // NORMAL MAPPING//
+  vec3 N = texture(uNormalTexture, vTexCoords).rgb;
+  N = N * 2.0 - 1.0;
+  material.normal = normalize(TBN * N);
+#endif
+#ifdef DOUBLE_SIDED
+  if (!gl_FrontFacing) {
+    material.normal = -material.normal;
+  }
+#endif
+
+  material.baseColor = uBaseColorFactor;
+#ifdef HAS_BASE_COLOR_TEXTURE
+  material.baseColor *= SRGBtoLINEAR(texture(uBaseColorTexture, vTexCoords));
+#endif
+
+  material.metallic = uMetallicFactor;
+  material.roughness = uRoughnessFactor;
+#ifdef HAS_METALLIC_ROUGHNESS_TEXTURE
+  vec4 metallicRougnessFromTexture =
+      texture(uMetallicRoughnessTexture, vTexCoords);
+  material.metallic *= metallicRougnessFromTexture.b;
+  material.roughness *= metallicRougnessFromTexture.g;
+#endif
+
+  material.emissive = black;
+#ifdef HAS_EMISSIVE
+  material.emissive = uEmissiveFactor;
+#ifdef HAS_EMISSIVE_TEXTURE
+  material.emissive *= SRGBtoLINEAR(texture(uEmissiveTexture, vTexCoords)).rgb;
+#endif
+#endif
+
+  return material;
+}
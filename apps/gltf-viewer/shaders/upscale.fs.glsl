@@ -0,0 +1,23 @@
+#version 330
+
+// Copy of the lower left corner of a texture, of uSourceSize pixels, over the
+// whole viewport with bilinear filtering: the upscale of dynamic resolution,
+// and the final copy of the deferred renderer where both sizes are equal and
+// the texels are copied as is. Drawn with fullscreen_triangle.vs.glsl and the
+// depth test disabled.
+
+uniform sampler2D uSourceTexture;
+uniform vec2 uSourceSize;
+uniform vec2 uViewportSize;
+
+out vec4 fColor;
+
+void main()
+{
+  // Clamped to the texel centers of the corner, the texels around it are not
+  // part of the frame
+  vec2 sourcePixel = gl_FragCoord.xy / uViewportSize * uSourceSize;
+  sourcePixel = clamp(sourcePixel, vec2(0.5), uSourceSize - 0.5);
+  fColor = texture(uSourceTexture,
+      sourcePixel / vec2(textureSize(uSourceTexture, 0)));
+}
@@ -1,4 +1,26 @@
+#ifdef GLMLV_USE_ZLIB
+#include <cstdlib>
+#include <zlib.h>
+
+// Deflate of the PNG written by stb_image_write: zlib is faster than its own
+// and has all the levels, from 0
+static unsigned char *zlibCompress(
+    unsigned char *data, int size, int *outSize, int level)
+{
+  auto compressedSize = compressBound(uLong(size));
+  auto *compressed = static_cast<unsigned char *>(std::malloc(compressedSize));
+  if (!compressed || compress2(compressed, &compressedSize, data,
+                         uLong(size), level) != Z_OK) {
+    std::free(compressed);
+    return nullptr;
+  }
+  *outSize = int(compressedSize);
+  return compressed;
+}
+#define STBIW_ZLIB_COMPRESS zlibCompress
+#endif
+
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <tiny_gltf.h>
\ No newline at end of file
+#include <tiny_gltf.h>
@@ -2,6 +2,7 @@
 
 #include "gl_debug_output.hpp"
 #include "glfw.hpp"
+#include "headlessContext.hpp"
 #include <glm/glm.hpp>
 
 #include <imgui.h>
@@ -9,15 +10,41 @@
 #include <imgui_impl_opengl3.h>
 
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 // Class responsible for initializing GLFW, creating a window, initializing
-// OpenGL function pointers with GLAD library and initializing ImGUI
+// OpenGL function pointers with GLAD library and initializing ImGUI.
+//
+// A headless handle only creates an OpenGL context, for offscreen rendering:
+// a HeadlessContext, which needs no display server, else a hidden window if
+// EGL is not available. It has no ImGui context, and window() is null without
+// window.
 class GLFWHandle
 {
 public:
-  GLFWHandle(int width, int height, const char *title, bool visible = true)
+  GLFWHandle(int width, int height, const char *title, bool visible = true,
+      bool headless = false) :
+      m_Headless(headless), m_Size(width, height)
   {
+    if (headless) {
+      try {
+        m_pHeadlessContext = std::make_unique<HeadlessContext>();
+        if (!gladLoadGLLoader(&HeadlessContext::getProcAddress)) {
+          throw std::runtime_error("Unable to load OpenGL with EGL.");
+        }
+        std::clog << "Headless context: "
+                  << m_pHeadlessContext->description() << std::endl;
+        initGLDebugOutput();
+        return;
+      } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << " Falling back to a hidden window."
+                  << std::endl;
+        m_pHeadlessContext.reset();
+        visible = false;
+      }
+    }
+
     if (!glfwInit()) {
       std::cerr << "Unable to init GLFW.\n";
       throw std::runtime_error("Unable to init GLFW.\n");
@@ -54,6 +81,10 @@ public:
 
     initGLDebugOutput();
 
+    if (headless) {
+      return;
+    }
+
     // Setup ImGui
     ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(m_pWindow, true);
@@ -63,33 +94,53 @@ public:
 
   ~GLFWHandle()
   {
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (!m_Headless) {
+      ImGui_ImplOpenGL3_Shutdown();
+      ImGui_ImplGlfw_Shutdown();
+      ImGui::DestroyContext();
+    }
 
-    glfwDestroyWindow(m_pWindow);
-    glfwTerminate();
+    if (m_pWindow) {
+      glfwDestroyWindow(m_pWindow);
+      glfwTerminate();
+    }
   }
 
   // Non-copyable class:
   GLFWHandle(const GLFWHandle &) = delete;
   GLFWHandle &operator=(const GLFWHandle &) = delete;
 
-  bool shouldClose() const { return glfwWindowShouldClose(m_pWindow); }
+  bool headless() const { return m_Headless; }
+
+  bool shouldClose() const
+  {
+    return !m_pWindow || glfwWindowShouldClose(m_pWindow);
+  }
 
   glm::ivec2 framebufferSize() const
   {
+    if (!m_pWindow) {
+      return m_Size;
+    }
     int displayWidth, displayHeight;
     glfwGetFramebufferSize(m_pWindow, &displayWidth, &displayHeight);
     return glm::ivec2(displayWidth, displayHeight);
   }
 
-  void swapBuffers() const { glfwSwapBuffers(m_pWindow); }
+  void swapBuffers() const
+  {
+    if (m_pWindow) {
+      glfwSwapBuffers(m_pWindow);
+    }
+  }
 
   GLFWwindow *window() { return m_pWindow; }
 
 private:
+  bool m_Headless;
+  glm::ivec2 m_Size;
   GLFWwindow *m_pWindow = nullptr;
+  std::unique_ptr<HeadlessContext> m_pHeadlessContext;
 };
 
 inline void imguiNewFrame()
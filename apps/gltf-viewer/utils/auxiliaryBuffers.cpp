@@ -0,0 +1,143 @@
+#include "auxiliaryBuffers.hpp"
+#include "imageEncoders.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char *bufferNames[AuxiliaryBuffers::BUFFER_COUNT] = {
+    "depth", "normal", "node", "material"};
+
+} // namespace
+
+const char *AuxiliaryBuffers::bufferName(Buffer buffer)
+{
+  return bufferNames[buffer];
+}
+
+std::vector<AuxiliaryBuffers::Buffer> AuxiliaryBuffers::buffersFromNames(
+    const std::string &names)
+{
+  std::vector<Buffer> buffers;
+  std::istringstream stream(names);
+  std::string name;
+  while (std::getline(stream, name, ',')) {
+    const auto nameIt =
+        std::find(std::begin(bufferNames), std::end(bufferNames), name);
+    if (nameIt == std::end(bufferNames)) {
+      throw std::runtime_error("Unknown auxiliary buffer \"" + name +
+                               "\" (expected depth, normal, node or "
+                               "material)");
+    }
+    const auto buffer = Buffer(nameIt - std::begin(bufferNames));
+    if (std::find(buffers.begin(), buffers.end(), buffer) == buffers.end()) {
+      buffers.push_back(buffer);
+    }
+  }
+  return buffers;
+}
+
+size_t AuxiliaryBuffers::componentCount(Buffer buffer)
+{
+  return buffer == NORMAL ? 3 : 1;
+}
+
+AuxiliaryBuffers::~AuxiliaryBuffers()
+{
+  glDeleteFramebuffers(1, &m_Framebuffer);
+  glDeleteTextures(BUFFER_COUNT, m_Textures);
+  glDeleteTextures(1, &m_DepthTexture);
+}
+
+void AuxiliaryBuffers::resize(
+    GLsizei width, GLsizei height, const std::vector<Buffer> &buffers)
+{
+  if (width == m_Width && height == m_Height && buffers == m_Buffers) {
+    return;
+  }
+  m_Width = width;
+  m_Height = height;
+  m_Buffers = buffers;
+
+  GLint previousTextureObject = 0;
+  GLint previousFramebufferObject = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
+
+  // Storage of glTexStorage2D is immutable, the textures are created again
+  glDeleteTextures(BUFFER_COUNT, m_Textures);
+  glDeleteTextures(1, &m_DepthTexture);
+  std::fill(std::begin(m_Textures), std::end(m_Textures), 0);
+  for (const auto buffer : buffers) {
+    glGenTextures(1, &m_Textures[buffer]);
+    glBindTexture(GL_TEXTURE_2D, m_Textures[buffer]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+  }
+  glGenTextures(1, &m_DepthTexture);
+  glBindTexture(GL_TEXTURE_2D, m_DepthTexture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
+
+  if (!m_Framebuffer) {
+    glGenFramebuffers(1, &m_Framebuffer);
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+  // The outputs of the buffers not requested are discarded
+  GLenum drawBuffers[BUFFER_COUNT];
+  for (int i = 0; i < BUFFER_COUNT; ++i) {
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, m_Textures[i], 0);
+    drawBuffers[i] = m_Textures[i] ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+  }
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0);
+  glDrawBuffers(BUFFER_COUNT, drawBuffers);
+
+  const auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  (void)framebufferStatus;
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
+}
+
+void writeAuxiliaryBuffer(const fs::path &path,
+    AuxiliaryBuffers::Buffer buffer, const ReadbackImage &image,
+    float maxDepth)
+{
+  const auto pixelCount = size_t(image.width) * image.height;
+  const auto componentCount = image.componentCount;
+  const auto format = imageFormatFromPath(path);
+  if (imageFormatIsFloat(format)) {
+    // To the RGB or RGBA of the format, with an opaque alpha
+    const auto formatComponentCount = imageFormatComponentCount(format);
+    ReadbackImage color(image.width, image.height, formatComponentCount);
+    color.floatPixels.resize(pixelCount * formatComponentCount, 1.f);
+    for (size_t i = 0; i < pixelCount; ++i) {
+      for (size_t c = 0; c < 3; ++c) {
+        color.floatPixels[i * formatComponentCount + c] =
+            image.floatPixels[i * componentCount +
+                              std::min(c, componentCount - 1)];
+      }
+    }
+    writeImage(path, color, format);
+    return;
+  }
+
+  float scale = 1.f, bias = 0.f;
+  if (buffer == AuxiliaryBuffers::DEPTH) {
+    scale = maxDepth > 0.f ? 65535.f / maxDepth : 0.f;
+  } else if (buffer == AuxiliaryBuffers::NORMAL) {
+    scale = bias = 0.5f * 65535.f;
+  }
+  std::vector<uint16_t> values(image.floatPixels.size());
+  std::transform(image.floatPixels.begin(), image.floatPixels.end(),
+      values.begin(), [&](float value) {
+        return uint16_t(
+            std::min(std::max(value * scale + bias + 0.5f, 0.f), 65535.f));
+      });
+  writePng16(path, image.width, image.height, componentCount, values);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "readbackPipeline.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Auxiliary buffers of the output images, pixel aligned with them, for
+// datasets: one geometry pass (auxiliary_buffers.fs.glsl) writes each
+// requested buffer to the fragment output matching its index, in a GL_RGBA32F
+// texture for a plain copy at the readback:
+// - DEPTH: distance along the view axis, 0 where no geometry is seen
+// - NORMAL: view space normal, facing the camera, 0 where no geometry is seen
+// - NODE_ID: index of the glTF node plus one, 0 where no geometry is seen
+// - MATERIAL_ID: index of the material plus one, 0 for the default material
+// The textures are only allocated, and written, for the requested buffers.
+class AuxiliaryBuffers
+{
+public:
+  enum Buffer
+  {
+    DEPTH,
+    NORMAL,
+    NODE_ID,
+    MATERIAL_ID,
+    BUFFER_COUNT
+  };
+
+  // "depth", "normal", "node" and "material"
+  static const char *bufferName(Buffer buffer);
+  // Parse comma separated names, throw std::runtime_error for other names
+  static std::vector<Buffer> buffersFromNames(const std::string &names);
+  // Components read back: 3 for the normal, 1 for the others
+  static size_t componentCount(Buffer buffer);
+
+  AuxiliaryBuffers() = default;
+  ~AuxiliaryBuffers();
+
+  AuxiliaryBuffers(const AuxiliaryBuffers &) = delete;
+  AuxiliaryBuffers &operator=(const AuxiliaryBuffers &) = delete;
+
+  // Allocate the textures of the buffers for width x height pixels, does
+  // nothing if they already have that size and buffers
+  void resize(
+      GLsizei width, GLsizei height, const std::vector<Buffer> &buffers);
+
+  // To draw the pass into, with a depth texture
+  GLuint framebuffer() const { return m_Framebuffer; }
+  // 0 if the buffer is not allocated
+  GLuint texture(Buffer buffer) const { return m_Textures[buffer]; }
+
+private:
+  GLuint m_Framebuffer = 0;
+  GLuint m_Textures[BUFFER_COUNT] = {};
+  GLuint m_DepthTexture = 0;
+  GLsizei m_Width = 0;
+  GLsizei m_Height = 0;
+  std::vector<Buffer> m_Buffers;
+};
+
+// Write a buffer read back as floats. With a float format (.pfm or .exr) the
+// values are written as they are, the depth and the identifiers repeated in
+// the color components. Else path gets a 16 bits PNG: the depth scaled from
+// [0, maxDepth] to [0, 65535], the normal from [-1, 1] to [0, 65535] and the
+// identifiers as they are, clamped to 65535. Throw std::runtime_error if the
+// write fails.
+void writeAuxiliaryBuffer(const fs::path &path,
+    AuxiliaryBuffers::Buffer buffer, const ReadbackImage &image,
+    float maxDepth);
@@ -0,0 +1,175 @@
+#include "cameraViews.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <json.hpp>
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void checkView(const CameraView &view, const std::string &where)
+{
+  if (view.fovy < 0.f || view.fovy >= 180.f) {
+    throw std::runtime_error(where + ": fov out of [0, 180) degrees");
+  }
+  if ((view.width == 0) != (view.height == 0)) {
+    throw std::runtime_error(where + ": width without height or the reverse");
+  }
+}
+
+std::vector<CameraView> loadJsonViews(std::istream &input)
+{
+  using nlohmann::json;
+  json document;
+  try {
+    input >> document;
+  } catch (const json::exception &e) {
+    throw std::runtime_error(e.what());
+  }
+  const auto &cameras =
+      document.is_object() ? document.value("cameras", json()) : document;
+  if (!cameras.is_array()) {
+    throw std::runtime_error("Expected an array of cameras");
+  }
+
+  std::vector<CameraView> views;
+  for (size_t i = 0; i < cameras.size(); ++i) {
+    views.push_back(
+        cameraViewFromJson(cameras[i], "Camera " + std::to_string(i)));
+  }
+  return views;
+}
+
+std::vector<CameraView> loadCsvViews(std::istream &input)
+{
+  std::vector<CameraView> views;
+  std::string line;
+  for (int lineNumber = 1; std::getline(input, line); ++lineNumber) {
+    const auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    const auto where = "Line " + std::to_string(lineNumber);
+    std::vector<float> values;
+    std::stringstream fields(line);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+      size_t end = 0;
+      try {
+        values.push_back(std::stof(field, &end));
+      } catch (const std::exception &) {
+        end = 0;
+      }
+      if (end == 0 ||
+          field.find_first_not_of(" \t\r", end) != std::string::npos) {
+        // A header names the columns
+        if (views.empty() && values.empty()) {
+          break;
+        }
+        throw std::runtime_error(where + ": invalid number \"" + field + "\"");
+      }
+    }
+    if (values.empty()) {
+      continue;
+    }
+    if (values.size() != 9 && values.size() != 10 && values.size() != 12) {
+      throw std::runtime_error(where + ": expected 9, 10 or 12 numbers, got " +
+                               std::to_string(values.size()));
+    }
+    CameraView view;
+    view.camera = Camera{glm::vec3(values[0], values[1], values[2]),
+        glm::vec3(values[3], values[4], values[5]),
+        glm::vec3(values[6], values[7], values[8])};
+    if (values.size() >= 10) {
+      view.fovy = values[9];
+    }
+    if (values.size() == 12) {
+      if (values[10] < 0.f || values[11] < 0.f) {
+        throw std::runtime_error(where + ": negative size");
+      }
+      view.width = uint32_t(values[10]);
+      view.height = uint32_t(values[11]);
+    }
+    checkView(view, where);
+    views.push_back(view);
+  }
+  return views;
+}
+
+} // namespace
+
+CameraView cameraViewFromJson(
+    const nlohmann::json &camera, const std::string &where, bool *hasCamera)
+{
+  using nlohmann::json;
+  const auto vector = [&](const char *key) {
+    const auto it = camera.find(key);
+    if (it == camera.end() || !it->is_array() || it->size() != 3 ||
+        !(*it)[0].is_number() || !(*it)[1].is_number() ||
+        !(*it)[2].is_number()) {
+      throw std::runtime_error(
+          where + ": \"" + key + "\" must be an array of 3 numbers");
+    }
+    return glm::vec3((*it)[0].get<float>(), (*it)[1].get<float>(),
+        (*it)[2].get<float>());
+  };
+  if (!camera.is_object()) {
+    throw std::runtime_error(where + ": expected an object");
+  }
+  CameraView view;
+  const bool withCamera = !hasCamera || camera.count("eye") ||
+                          camera.count("center") || camera.count("up");
+  if (withCamera) {
+    view.camera = Camera{vector("eye"), vector("center"), vector("up")};
+  }
+  if (hasCamera) {
+    *hasCamera = withCamera;
+  }
+  try {
+    view.fovy = camera.value("fov", 0.f);
+    view.width = camera.value("width", 0u);
+    view.height = camera.value("height", 0u);
+  } catch (const json::exception &e) {
+    throw std::runtime_error(where + ": " + e.what());
+  }
+  checkView(view, where);
+  return view;
+}
+
+std::vector<CameraView> loadCameraViews(const fs::path &path)
+{
+  std::ifstream input(path.string());
+  if (!input) {
+    throw std::runtime_error("Unable to open " + path.string());
+  }
+  auto extension = path.extension().string();
+  for (auto &c : extension) {
+    c = char(std::tolower(c));
+  }
+  auto views =
+      extension == ".json" ? loadJsonViews(input) : loadCsvViews(input);
+  if (views.empty()) {
+    throw std::runtime_error("No camera in " + path.string());
+  }
+  return views;
+}
+
+std::vector<CameraView> orbitCameraViews(
+    const Camera &camera, uint32_t frameCount)
+{
+  const auto center = camera.center();
+  const auto up = glm::normalize(camera.up());
+  const auto eyeOffset = glm::vec4(camera.eye() - center, 0.f);
+  std::vector<CameraView> views(frameCount);
+  for (uint32_t i = 0; i < frameCount; ++i) {
+    const auto angle = 2.f * glm::pi<float>() * i / frameCount;
+    const auto rotation = glm::rotate(glm::mat4(1), angle, up);
+    views[i].camera =
+        Camera{center + glm::vec3(rotation * eyeOffset), center, up};
+  }
+  return views;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cameras.hpp"
+#include "filesystem.hpp"
+
+#include <json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A view rendered by the batch of --cameras, or by the render server
+struct CameraView
+{
+  Camera camera;
+  float fovy = 0.f;    // Vertical field of view in degrees, 0 for the default
+  uint32_t width = 0;  // Size of the image, 0 for the size of the command line
+  uint32_t height = 0;
+};
+
+// Read the views of a file, JSON if its extension is .json, else CSV:
+// - JSON: an array of objects, or an object with such an array in "cameras".
+// Each object has "eye", "center" and "up" arrays of 3 numbers, and optionally
+// "fov", "width" and "height".
+// - CSV: one view per line, eye_x,eye_y,eye_z,center_x,center_y,center_z,
+// up_x,up_y,up_z then optionally fov, then optionally width,height. The empty
+// lines, the lines starting with # and a header line are skipped.
+// Throw std::runtime_error, with the view or the line, on invalid input.
+std::vector<CameraView> loadCameraViews(const fs::path &path);
+
+// The view of a JSON object with "eye", "center" and "up" arrays of 3
+// numbers, and optionally "fov", "width" and "height". The camera is optional
+// if hasCamera is not null, it receives whether the object has one. Throw
+// std::runtime_error, starting with where, on invalid input.
+CameraView cameraViewFromJson(const nlohmann::json &object,
+    const std::string &where, bool *hasCamera = nullptr);
+
+// frameCount views turning around the axis through the center of camera along
+// its up vector, a full turn from camera itself: the turntable of --orbit.
+std::vector<CameraView> orbitCameraViews(
+    const Camera &camera, uint32_t frameCount);
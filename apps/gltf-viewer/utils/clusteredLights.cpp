@@ -0,0 +1,143 @@
+#include "clusteredLights.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+
+namespace {
+
+// Layout of struct PunctualLight in the shaders (std430)
+struct GPUPunctualLight
+{
+  glm::vec4 positionRange;           // View space position, range
+  glm::vec4 colorSpot;               // Color, 1 for a spot light
+  glm::vec4 directionOuterConeCos;   // View space spot direction
+  glm::vec4 attenuationInnerConeCos; // Constant, linear, quadratic terms
+};
+
+const GLuint WORK_GROUP_SIZE = 64; // local_size_x of the compute shader
+
+// Depth of the first slice boundary, relative to the far plane: a near plane
+// very close to the eye would waste most slices on an empty volume
+const float CLUSTER_NEAR_RATIO = 0.01f;
+
+} // namespace
+
+ClusteredLights::ClusteredLights(
+    const fs::path &computeShaderPath, const glm::uvec3 &gridSize) :
+    m_ComputeShaderPath(computeShaderPath),
+    m_Program(compileProgram({computeShaderPath}, shaderDefines())),
+    m_GridSize(gridSize)
+{
+  getUniformLocations();
+
+  const auto clusterCount = m_GridSize.x * m_GridSize.y * m_GridSize.z;
+  glGenBuffers(3, m_Buffers);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffers[1]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, clusterCount * sizeof(uint32_t),
+      nullptr, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffers[2]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+      clusterCount * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), nullptr,
+      GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+ClusteredLights::~ClusteredLights() { glDeleteBuffers(3, m_Buffers); }
+
+void ClusteredLights::reloadProgram()
+{
+  m_Program = compileProgram({m_ComputeShaderPath}, shaderDefines());
+  getUniformLocations();
+}
+
+void ClusteredLights::getUniformLocations()
+{
+  m_GridSizeLocation = m_Program.getUniformLocation("uClusterGridSize");
+  m_InverseProjMatrixLocation =
+      m_Program.getUniformLocation("uInverseProjMatrix");
+  m_DepthRangeLocation = m_Program.getUniformLocation("uClusterDepthRange");
+  m_LightCountLocation = m_Program.getUniformLocation("uLightCount");
+}
+
+std::vector<std::string> ClusteredLights::shaderDefines()
+{
+  return {"MAX_LIGHTS_PER_CLUSTER " + std::to_string(MAX_LIGHTS_PER_CLUSTER),
+      "LIGHTS_BINDING " + std::to_string(LIGHTS_BINDING),
+      "CLUSTER_LIGHT_COUNTS_BINDING " +
+          std::to_string(CLUSTER_LIGHT_COUNTS_BINDING),
+      "CLUSTER_LIGHT_INDICES_BINDING " +
+          std::to_string(CLUSTER_LIGHT_INDICES_BINDING)};
+}
+
+void ClusteredLights::update(const std::vector<PunctualLight> &viewSpaceLights,
+    const glm::mat4 &projMatrix, float zNear, float zFar,
+    const glm::uvec2 &viewportSize)
+{
+  std::vector<GPUPunctualLight> lights;
+  lights.reserve(viewSpaceLights.size());
+  for (const auto &light : viewSpaceLights) {
+    lights.push_back(GPUPunctualLight{glm::vec4(light.position, light.range),
+        glm::vec4(light.color, light.isSpot ? 1.f : 0.f),
+        glm::vec4(light.direction, light.outerConeCos),
+        glm::vec4(light.attenuation, light.innerConeCos)});
+  }
+  m_LightCount = lights.size();
+
+  // The buffer only grows, an empty one is not allowed to be bound
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffers[0]);
+  if (lights.size() > m_LightBufferCapacity || m_LightBufferCapacity == 0) {
+    m_LightBufferCapacity = std::max(lights.size(), size_t(1));
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        m_LightBufferCapacity * sizeof(GPUPunctualLight), nullptr,
+        GL_DYNAMIC_DRAW);
+  }
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+      lights.size() * sizeof(GPUPunctualLight), lights.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, m_Buffers[0]);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_COUNTS_BINDING, m_Buffers[1]);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_INDICES_BINDING, m_Buffers[2]);
+
+  // Exponential slices from clusterNear to zFar, the first one extending to
+  // the eye
+  const auto clusterNear = std::max(zNear, CLUSTER_NEAR_RATIO * zFar);
+  const auto logDepthRange = glm::log(zFar / clusterNear);
+  m_DepthScaleBias = glm::vec2(m_GridSize.z / logDepthRange,
+      -(m_GridSize.z * glm::log(clusterNear)) / logDepthRange);
+  m_TileSize = glm::vec2(viewportSize) / glm::vec2(m_GridSize);
+
+  m_Program.use();
+  glUniform3ui(m_GridSizeLocation, m_GridSize.x, m_GridSize.y, m_GridSize.z);
+  glUniformMatrix4fv(m_InverseProjMatrixLocation, 1, GL_FALSE,
+      glm::value_ptr(glm::inverse(projMatrix)));
+  glUniform2f(m_DepthRangeLocation, clusterNear, zFar);
+  glUniform1ui(m_LightCountLocation, GLuint(m_LightCount));
+  const auto clusterCount = m_GridSize.x * m_GridSize.y * m_GridSize.z;
+  glDispatchCompute(
+      (clusterCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ClusteredLights::computeStats(
+    float &averageLightCount, uint32_t &maxLightCount) const
+{
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  const auto clusterCount = m_GridSize.x * m_GridSize.y * m_GridSize.z;
+  std::vector<uint32_t> counts(clusterCount);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffers[1]);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+      counts.size() * sizeof(uint32_t), counts.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  uint64_t sum = 0;
+  maxLightCount = 0;
+  for (const auto count : counts) {
+    sum += count;
+    maxLightCount = std::max(maxLightCount, count);
+  }
+  averageLightCount = float(sum) / clusterCount;
+}
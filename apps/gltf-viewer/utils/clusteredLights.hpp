@@ -0,0 +1,80 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf.hpp"
+#include "shaders.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Clustered forward lighting: the view frustum is split in a grid of clusters,
+// tiles in screen space and exponential slices in depth. A compute shader
+// assigns each punctual light to the clusters its range overlaps, so that
+// a fragment only evaluates the lights of its cluster.
+//
+// The buffers are bound to these shader storage binding points, which the
+// shaders declare with layout(std430, binding = N):
+// - 0: the lights, in view space (struct PunctualLight of the shaders)
+// - 1: the number of lights of each cluster
+// - 2: the indices of the lights of each cluster, MAX_LIGHTS_PER_CLUSTER per
+// cluster
+class ClusteredLights
+{
+public:
+  static const GLuint LIGHTS_BINDING = 0;
+  static const GLuint CLUSTER_LIGHT_COUNTS_BINDING = 1;
+  static const GLuint CLUSTER_LIGHT_INDICES_BINDING = 2;
+  static const uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+
+  // computeShaderPath is the light assignment compute shader
+  explicit ClusteredLights(const fs::path &computeShaderPath,
+      const glm::uvec3 &gridSize = glm::uvec3(16, 9, 24));
+  ~ClusteredLights();
+
+  ClusteredLights(const ClusteredLights &) = delete;
+  ClusteredLights &operator=(const ClusteredLights &) = delete;
+
+  // The #defines the shaders reading the clusters must be compiled with
+  static std::vector<std::string> shaderDefines();
+
+  // Upload the lights, given in view space, and assign them to the clusters
+  // of the frustum of projMatrix, for a viewport of viewportSize pixels.
+  // Leaves the buffers bound to their binding points.
+  void update(const std::vector<PunctualLight> &viewSpaceLights,
+      const glm::mat4 &projMatrix, float zNear, float zFar,
+      const glm::uvec2 &viewportSize);
+
+  // Uniforms a fragment shader needs to find its cluster
+  const glm::uvec3 &gridSize() const { return m_GridSize; }
+  const glm::vec2 &tileSize() const { return m_TileSize; }
+  // slice = log(-viewSpaceZ) * depthScaleBias.x + depthScaleBias.y
+  const glm::vec2 &depthScaleBias() const { return m_DepthScaleBias; }
+
+  size_t lightCount() const { return m_LightCount; }
+
+  // Read back the number of lights per cluster, which stalls the pipeline
+  void computeStats(float &averageLightCount, uint32_t &maxLightCount) const;
+
+  // Compile the compute shader again, after its source was edited. On failure
+  // the previous program is kept and std::runtime_error is thrown.
+  void reloadProgram();
+
+private:
+  void getUniformLocations();
+
+  fs::path m_ComputeShaderPath;
+  GLProgram m_Program;
+  GLint m_GridSizeLocation;
+  GLint m_InverseProjMatrixLocation;
+  GLint m_DepthRangeLocation;
+  GLint m_LightCountLocation;
+
+  glm::uvec3 m_GridSize;
+  glm::vec2 m_TileSize = glm::vec2(1);
+  glm::vec2 m_DepthScaleBias = glm::vec2(0);
+  size_t m_LightCount = 0;
+
+  GLuint m_Buffers[3] = {0, 0, 0}; // Lights, counts and indices
+  size_t m_LightBufferCapacity = 0;
+};
@@ -0,0 +1,272 @@
+#include "downsample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define GLMLV_DOWNSAMPLE_SSE
+#endif
+
+namespace {
+
+// The weights of the source pixels of each target pixel, along one axis
+struct FilterTaps
+{
+  size_t maxCount = 0;
+  std::vector<size_t> count;   // Taps of each target
+  std::vector<float> weights;  // maxCount per target, summing to 1
+  std::vector<GLsizei> source; // maxCount per target, clamped to the edges
+};
+
+float lanczos(float x)
+{
+  const float PI = 3.14159265358979f;
+  const auto a = 2.f;
+  x = std::abs(x);
+  if (x < 1e-6f) {
+    return 1.f;
+  }
+  if (x >= a) {
+    return 0.f;
+  }
+  return a * std::sin(PI * x) * std::sin(PI * x / a) / (PI * PI * x * x);
+}
+
+FilterTaps filterTaps(
+    GLsizei sourceSize, GLsizei targetSize, DownsampleFilter filter)
+{
+  const auto scale = float(sourceSize) / targetSize;
+  FilterTaps taps;
+  std::vector<std::vector<std::pair<GLsizei, float>>> all(targetSize);
+  for (GLsizei i = 0; i < targetSize; ++i) {
+    auto &weights = all[i];
+    if (filter == DownsampleFilter::Box) {
+      // Area of each source pixel in the target pixel
+      const auto begin = i * scale, end = (i + 1) * scale;
+      for (auto s = GLsizei(std::floor(begin)); s < end; ++s) {
+        const auto overlap =
+            std::min(end, s + 1.f) - std::max(begin, float(s));
+        if (overlap > 0.f) {
+          weights.emplace_back(s, overlap);
+        }
+      }
+    } else {
+      // The kernel stretched to the target pixels
+      const auto center = (i + 0.5f) * scale;
+      const auto radius = 2.f * std::max(scale, 1.f);
+      for (auto s = GLsizei(std::floor(center - radius));
+           s <= GLsizei(std::ceil(center + radius)); ++s) {
+        const auto weight =
+            lanczos((s + 0.5f - center) / std::max(scale, 1.f));
+        if (weight != 0.f) {
+          weights.emplace_back(s, weight);
+        }
+      }
+    }
+    taps.maxCount = std::max(taps.maxCount, weights.size());
+  }
+
+  taps.count.resize(targetSize);
+  taps.weights.assign(targetSize * taps.maxCount, 0.f);
+  taps.source.assign(targetSize * taps.maxCount, 0);
+  for (GLsizei i = 0; i < targetSize; ++i) {
+    const auto &weights = all[i];
+    float sum = 0.f;
+    for (const auto &weight : weights) {
+      sum += weight.second;
+    }
+    taps.count[i] = weights.size();
+    for (size_t k = 0; k < weights.size(); ++k) {
+      taps.weights[i * taps.maxCount + k] = weights[k].second / sum;
+      taps.source[i * taps.maxCount + k] =
+          std::min(std::max(weights[k].first, 0), sourceSize - 1);
+    }
+  }
+  return taps;
+}
+
+// sum += weight * values, for count floats, a multiple of 4
+void addWeighted(float *sum, const float *values, float weight, size_t count)
+{
+#ifdef GLMLV_DOWNSAMPLE_SSE
+  const auto w = _mm_set1_ps(weight);
+  for (size_t i = 0; i < count; i += 4) {
+    _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i),
+                               _mm_mul_ps(_mm_loadu_ps(values + i), w)));
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    sum[i] += weight * values[i];
+  }
+#endif
+}
+
+// Decoding and encoding of the values of an image, RGBA floats in between
+class LinearConverter
+{
+public:
+  explicit LinearConverter(float gamma) : m_Gamma(gamma)
+  {
+    for (int i = 0; i < 256; ++i) {
+      m_ByteToLinear[i] = std::pow(i / 255.f, gamma);
+    }
+    // The linear values rounded to each byte start at the middle between
+    // the byte and the previous one
+    for (int i = 1; i < 256; ++i) {
+      m_LinearThresholds[i - 1] = std::pow((i - 0.5f) / 255.f, gamma);
+    }
+  }
+
+  // Row of a source image to RGBA linear floats
+  void decode(
+      const ReadbackImage &image, GLsizei y, std::vector<float> &row) const
+  {
+    const auto componentCount = image.componentCount;
+    const auto width = size_t(image.width);
+    const auto offset = size_t(y) * width * componentCount;
+    row.resize(4 * width);
+    auto *pixel = row.data();
+    if (image.floatPixels.empty()) {
+      const auto *source = image.pixels.data() + offset;
+      for (size_t x = 0; x < width; ++x, pixel += 4) {
+        pixel[0] = m_ByteToLinear[source[0]];
+        pixel[1] = m_ByteToLinear[source[1]];
+        pixel[2] = m_ByteToLinear[source[2]];
+        pixel[3] = componentCount == 4 ? source[3] / 255.f : 1.f;
+        source += componentCount;
+      }
+      return;
+    }
+    const auto *source = image.floatPixels.data() + offset;
+    for (size_t x = 0; x < width; ++x, pixel += 4) {
+      for (size_t c = 0; c < 3; ++c) {
+        pixel[c] = std::pow(std::max(source[c], 0.f), m_Gamma);
+      }
+      pixel[3] = componentCount == 4 ? source[3] : 1.f;
+      source += componentCount;
+    }
+  }
+
+  // RGBA linear floats to a row of a target image
+  void encode(const float *row, ReadbackImage &image, GLsizei y) const
+  {
+    const auto componentCount = image.componentCount;
+    const auto width = size_t(image.width);
+    const auto offset = size_t(y) * width * componentCount;
+    for (size_t x = 0; x < width; ++x) {
+      const auto *pixel = row + 4 * x;
+      for (size_t c = 0; c < componentCount; ++c) {
+        const auto index = offset + x * componentCount + c;
+        const auto value = std::max(pixel[c], 0.f); // Negative lobes
+        if (image.floatPixels.empty()) {
+          image.pixels[index] =
+              c == 3 ? (unsigned char)(std::min(value, 1.f) * 255.f + 0.5f)
+                     : (unsigned char)(std::upper_bound(
+                                           std::begin(m_LinearThresholds),
+                                           std::end(m_LinearThresholds),
+                                           value) -
+                                       std::begin(m_LinearThresholds));
+        } else {
+          image.floatPixels[index] =
+              c == 3 ? value : std::pow(value, 1.f / m_Gamma);
+        }
+      }
+    }
+  }
+
+private:
+  float m_Gamma;
+  float m_ByteToLinear[256];
+  float m_LinearThresholds[255];
+};
+
+} // namespace
+
+DownsampleFilter downsampleFilterFromName(const std::string &name)
+{
+  for (const auto filter :
+      {DownsampleFilter::Box, DownsampleFilter::Lanczos}) {
+    if (name == downsampleFilterName(filter)) {
+      return filter;
+    }
+  }
+  throw std::runtime_error(
+      "Unknown filter " + name + " (expected box or lanczos)");
+}
+
+const char *downsampleFilterName(DownsampleFilter filter)
+{
+  return filter == DownsampleFilter::Box ? "box" : "lanczos";
+}
+
+ReadbackImage downsampleImage(const ReadbackImage &image, GLsizei width,
+    GLsizei height, DownsampleFilter filter, float gamma, size_t threadCount)
+{
+  ReadbackImage target(width, height, image.componentCount);
+  const auto valueCount = size_t(width) * height * image.componentCount;
+  if (image.floatPixels.empty()) {
+    target.pixels.resize(valueCount);
+  } else {
+    target.floatPixels.resize(valueCount);
+  }
+  const auto columns = filterTaps(image.width, width, filter);
+  const auto rows = filterTaps(image.height, height, filter);
+  const LinearConverter converter{gamma};
+
+  const auto downsampleRows = [&](GLsizei begin, GLsizei end) {
+    const auto sourceSize = 4 * size_t(image.width);
+    std::vector<float> source, sum(sourceSize), targetRow(4 * size_t(width));
+    for (GLsizei y = begin; y < end; ++y) {
+      // The source rows of the target row, weighted
+      std::fill(sum.begin(), sum.end(), 0.f);
+      for (size_t k = 0; k < rows.count[y]; ++k) {
+        converter.decode(image, rows.source[y * rows.maxCount + k], source);
+        addWeighted(sum.data(), source.data(),
+            rows.weights[y * rows.maxCount + k], sourceSize);
+      }
+      // Then their columns
+      for (GLsizei x = 0; x < width; ++x) {
+        const auto *weights = columns.weights.data() + x * columns.maxCount;
+        const auto *sources = columns.source.data() + x * columns.maxCount;
+#ifdef GLMLV_DOWNSAMPLE_SSE
+        auto pixel = _mm_setzero_ps();
+        for (size_t k = 0; k < columns.count[x]; ++k) {
+          pixel = _mm_add_ps(pixel,
+              _mm_mul_ps(_mm_loadu_ps(sum.data() + 4 * sources[k]),
+                  _mm_set1_ps(weights[k])));
+        }
+        _mm_storeu_ps(targetRow.data() + 4 * x, pixel);
+#else
+        float pixel[4] = {};
+        for (size_t k = 0; k < columns.count[x]; ++k) {
+          for (size_t c = 0; c < 4; ++c) {
+            pixel[c] += weights[k] * sum[4 * sources[k] + c];
+          }
+        }
+        std::copy(pixel, pixel + 4, targetRow.begin() + 4 * x);
+#endif
+      }
+      converter.encode(targetRow.data(), target, y);
+    }
+  };
+
+  if (!threadCount) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threadCount = std::min(threadCount, size_t(height));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; ++i) {
+    threads.emplace_back(downsampleRows, GLsizei(height * i / threadCount),
+        GLsizei(height * (i + 1) / threadCount));
+  }
+  downsampleRows(0, GLsizei(height / threadCount));
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return target;
+}
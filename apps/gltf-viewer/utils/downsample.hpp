@@ -0,0 +1,29 @@
+#pragma once
+
+#include "readbackPipeline.hpp"
+
+#include <cstddef>
+#include <string>
+
+enum class DownsampleFilter
+{
+  Box,     // Average of the source pixels covered by each target pixel
+  Lanczos, // Lanczos 2 lobes: sharper, slower
+};
+
+// Parse "box" or "lanczos", throw std::runtime_error for other names
+DownsampleFilter downsampleFilterFromName(const std::string &name);
+const char *downsampleFilterName(DownsampleFilter filter);
+
+// Resize an image, of bytes or floats, to a smaller one, as the supersampled
+// output images and the thumbnails are. The filter is applied to linear
+// values: the colors encoded with gamma are decoded, filtered, then encoded
+// again, so that the edges are not darkened. Alpha is filtered as is.
+//
+// The filter is separable: the source rows of a target row are weighted and
+// summed, then the columns of that sum. The sums run on 4 floats at once with
+// SSE (one RGBA pixel), and the target rows are split between threadCount
+// threads, 0 for one per hardware thread.
+ReadbackImage downsampleImage(const ReadbackImage &image, GLsizei width,
+    GLsizei height, DownsampleFilter filter, float gamma,
+    size_t threadCount = 0);
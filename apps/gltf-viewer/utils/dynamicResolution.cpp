@@ -0,0 +1,85 @@
+#include "dynamicResolution.hpp"
+
+#include <cmath>
+
+DynamicResolution::DynamicResolution()
+{
+  for (auto &timerQuery : m_Queries) {
+    glGenQueries(1, &timerQuery.query);
+  }
+}
+
+DynamicResolution::~DynamicResolution()
+{
+  for (auto &timerQuery : m_Queries) {
+    glDeleteQueries(1, &timerQuery.query);
+  }
+}
+
+void DynamicResolution::resize(GLsizei width, GLsizei height)
+{
+  m_Width = width;
+  m_Height = height;
+}
+
+void DynamicResolution::beginFrame()
+{
+  // The query of this frame is still in flight, waiting for it would stall
+  auto &timerQuery = m_Queries[m_NextQuery];
+  m_Measuring = !timerQuery.pending;
+  if (m_Measuring) {
+    glBeginQuery(GL_TIME_ELAPSED, timerQuery.query);
+  }
+}
+
+void DynamicResolution::endFrame(float targetFrameTime)
+{
+  if (m_Measuring) {
+    glEndQuery(GL_TIME_ELAPSED);
+    m_Queries[m_NextQuery].pending = true;
+    m_Queries[m_NextQuery].scale = m_Scale;
+    m_NextQuery = (m_NextQuery + 1) % QUERY_COUNT;
+    m_Measuring = false;
+  }
+
+  // From the oldest query, the queries complete in order
+  for (int i = 0; i < QUERY_COUNT; ++i) {
+    auto &timerQuery = m_Queries[(m_NextQuery + i) % QUERY_COUNT];
+    if (!timerQuery.pending) {
+      continue;
+    }
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(
+        timerQuery.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      break;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(timerQuery.query, GL_QUERY_RESULT, &nanoseconds);
+    timerQuery.pending = false;
+    updateScale(timerQuery.scale, float(nanoseconds * 1e-6), targetFrameTime);
+  }
+}
+
+glm::ivec2 DynamicResolution::renderSize() const
+{
+  const auto size = glm::round(m_Scale * glm::vec2(m_Width, m_Height));
+  return glm::max(glm::ivec2(size), glm::ivec2(1));
+}
+
+void DynamicResolution::updateScale(
+    float frameScale, float frameTime, float targetFrameTime)
+{
+  m_GpuTime = frameTime;
+  if (frameTime <= 0.f) {
+    return;
+  }
+  // The frame time is about proportional to the number of pixels, the square
+  // of the scale. The scale aims a bit under the target to absorb the
+  // variations of the frame time, and moves half way to it since the
+  // measures arrive a few frames late.
+  const auto targetScale =
+      frameScale * std::sqrt(0.9f * targetFrameTime / frameTime);
+  m_Scale = glm::clamp(
+      m_Scale + 0.5f * (targetScale - m_Scale), MIN_SCALE, MAX_SCALE);
+}
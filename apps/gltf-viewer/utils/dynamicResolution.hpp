@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Dynamic resolution: the scene is rendered into an offscreen target at a
+// scale of the window resolution, chosen to hold a GPU frame time target, and
+// then upscaled to the window by the caller. The caller allocates the target
+// at the full resolution and only uses its lower left corner of renderSize()
+// pixels, so that changing the scale does not reallocate it.
+//
+// The GPU time of each frame is measured by a ring of GL_TIME_ELAPSED queries,
+// read a few frames later when available so that the CPU never waits for the
+// GPU. A frame is not measured when all the queries are still in flight.
+class DynamicResolution
+{
+public:
+  DynamicResolution();
+  ~DynamicResolution();
+
+  DynamicResolution(const DynamicResolution &) = delete;
+  DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+  // Set the size of the window, the full resolution
+  void resize(GLsizei width, GLsizei height);
+
+  // Start measuring the frame
+  void beginFrame();
+
+  // Stop measuring the frame, then update the scale from the measures
+  // available, to hold targetFrameTime milliseconds
+  void endFrame(float targetFrameTime);
+
+  glm::ivec2 renderSize() const;
+  float scale() const { return m_Scale; }
+  // Last GPU time measured, in milliseconds
+  float gpuTime() const { return m_GpuTime; }
+
+  static constexpr float MIN_SCALE = 0.5f;
+  static constexpr float MAX_SCALE = 1.f;
+
+private:
+  // Update the scale from the time of a frame rendered at frameScale
+  void updateScale(float frameScale, float frameTime, float targetFrameTime);
+
+  static const int QUERY_COUNT = 4;
+  struct TimerQuery
+  {
+    GLuint query = 0;
+    bool pending = false;
+    float scale = 1.f; // Scale of the frame measured
+  };
+  TimerQuery m_Queries[QUERY_COUNT];
+  int m_NextQuery = 0; // Oldest query, used by the next frame
+  bool m_Measuring = false;
+
+  GLsizei m_Width = 0;
+  GLsizei m_Height = 0;
+
+  float m_Scale = MAX_SCALE;
+  float m_GpuTime = 0;
+};
@@ -0,0 +1,595 @@
+#include "environmentLighting.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <stb_image.h>
+
+namespace {
+
+const float pi = glm::pi<float>();
+
+const GLsizei specularSize = 128;
+const int specularMipCount = 6; // 128 to 4 texels, roughness steps of 0.2
+const int specularSampleCount = 128;
+const GLsizei brdfLutSize = 128;
+const int brdfLutSampleCount = 512;
+
+// Header of a cache file, followed by the 9 SH coefficients, the texels of the
+// mip levels and the BRDF table, as floats
+struct CacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  int32_t specularSize;
+  int32_t specularMipCount;
+  int32_t brdfLutSize;
+};
+
+const char cacheMagic[4] = {'I', 'B', 'L', 'C'};
+const uint32_t cacheVersion = 1;
+
+// Call function(i) for i in [0, count) on all the hardware threads. A thread
+// takes the next index once done with the previous one, since the indices do
+// not all cost the same.
+template <typename Function>
+void parallelFor(int count, const Function &function)
+{
+  std::atomic<int> nextIndex{0};
+  const auto worker = [&]() {
+    for (int i = nextIndex++; i < count; i = nextIndex++) {
+      function(i);
+    }
+  };
+  const auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> threads;
+  for (auto i = 1u; i < threadCount; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// Texture coordinates of a direction in an equirectangular image, v = 0 at +Y
+glm::vec2 equirectangularCoords(const glm::vec3 &direction)
+{
+  return glm::vec2(0.5f + std::atan2(direction.z, direction.x) / (2 * pi),
+      std::acos(glm::clamp(direction.y, -1.f, 1.f)) / pi);
+}
+
+glm::vec3 equirectangularDirection(float u, float v)
+{
+  const auto phi = (u - 0.5f) * 2 * pi;
+  const auto theta = v * pi;
+  return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+      std::sin(theta) * std::sin(phi));
+}
+
+// Equirectangular image and its levels downsampled by 2, sampled with
+// bilinear filtering and a linear interpolation between two levels
+class EquirectangularMap
+{
+public:
+  EquirectangularMap(const float *texels, int width, int height)
+  {
+    Level level{width, height, {}};
+    level.texels.resize(size_t(width) * height);
+    for (size_t i = 0; i < level.texels.size(); ++i) {
+      level.texels[i] = glm::make_vec3(texels + 3 * i);
+    }
+    m_Levels.push_back(std::move(level));
+    while (m_Levels.back().width > 1 || m_Levels.back().height > 1) {
+      const auto &previous = m_Levels.back();
+      Level next{std::max(1, previous.width / 2),
+          std::max(1, previous.height / 2), {}};
+      next.texels.resize(size_t(next.width) * next.height);
+      for (int y = 0; y < next.height; ++y) {
+        const int y0 = std::min(2 * y, previous.height - 1);
+        const int y1 = std::min(2 * y + 1, previous.height - 1);
+        for (int x = 0; x < next.width; ++x) {
+          const int x0 = std::min(2 * x, previous.width - 1);
+          const int x1 = std::min(2 * x + 1, previous.width - 1);
+          next.texels[x + next.width * y] =
+              0.25f * (previous.texel(x0, y0) + previous.texel(x1, y0) +
+                          previous.texel(x0, y1) + previous.texel(x1, y1));
+        }
+      }
+      m_Levels.push_back(std::move(next));
+    }
+  }
+
+  glm::vec3 sample(const glm::vec3 &direction, float lod) const
+  {
+    const auto uv = equirectangularCoords(direction);
+    lod = glm::clamp(lod, 0.f, float(m_Levels.size() - 1));
+    const auto level = std::min(int(lod), int(m_Levels.size()) - 2);
+    if (level < 0) {
+      return sampleLevel(m_Levels[0], uv);
+    }
+    return glm::mix(sampleLevel(m_Levels[level], uv),
+        sampleLevel(m_Levels[level + 1], uv), lod - level);
+  }
+
+  // Solid angle of a texel of the first level, on average over the sphere
+  float texelSolidAngle() const
+  {
+    return 4 * pi / (float(m_Levels[0].width) * m_Levels[0].height);
+  }
+
+private:
+  struct Level
+  {
+    int width;
+    int height;
+    std::vector<glm::vec3> texels;
+
+    const glm::vec3 &texel(int x, int y) const
+    {
+      return texels[x + size_t(width) * y];
+    }
+  };
+
+  static glm::vec3 sampleLevel(const Level &level, const glm::vec2 &uv)
+  {
+    // Wrapped around the vertical axis, clamped at the poles
+    const auto x = uv.x * level.width - 0.5f;
+    const auto y = uv.y * level.height - 0.5f;
+    const auto x0 = int(std::floor(x));
+    const auto y0 = int(std::floor(y));
+    const auto fx = x - x0;
+    const auto fy = y - y0;
+    const auto wrap = [&](int x) {
+      return ((x % level.width) + level.width) % level.width;
+    };
+    const auto clampY = [&](int y) {
+      return glm::clamp(y, 0, level.height - 1);
+    };
+    const auto top = glm::mix(level.texel(wrap(x0), clampY(y0)),
+        level.texel(wrap(x0 + 1), clampY(y0)), fx);
+    const auto bottom = glm::mix(level.texel(wrap(x0), clampY(y0 + 1)),
+        level.texel(wrap(x0 + 1), clampY(y0 + 1)), fx);
+    return glm::mix(top, bottom, fy);
+  }
+
+  std::vector<Level> m_Levels;
+};
+
+// Real spherical harmonics of bands 0 to 2, the same as pbr_lights.glsl
+std::array<float, 9> shBasis(const glm::vec3 &d)
+{
+  return {0.282095f, 0.488603f * d.y, 0.488603f * d.z, 0.488603f * d.x,
+      1.092548f * d.x * d.y, 1.092548f * d.y * d.z,
+      0.315392f * (3 * d.z * d.z - 1), 1.092548f * d.x * d.z,
+      0.546274f * (d.x * d.x - d.y * d.y)};
+}
+
+std::array<glm::vec3, 9> computeIrradianceSH(
+    const float *texels, int width, int height)
+{
+  std::vector<std::array<glm::vec3, 9>> rowSums(height);
+  parallelFor(height, [&](int y) {
+    const auto v = (y + 0.5f) / height;
+    const auto solidAngle =
+        std::sin(v * pi) * (pi / height) * (2 * pi / width);
+    auto &sum = rowSums[y];
+    sum.fill(glm::vec3(0));
+    for (int x = 0; x < width; ++x) {
+      const auto direction = equirectangularDirection((x + 0.5f) / width, v);
+      const auto radiance =
+          glm::make_vec3(texels + 3 * (x + size_t(width) * y));
+      const auto basis = shBasis(direction);
+      for (int i = 0; i < 9; ++i) {
+        sum[i] += radiance * (basis[i] * solidAngle);
+      }
+    }
+  });
+
+  // Summed in the order of the rows, so that the result does not depend on
+  // the threads
+  std::array<glm::vec3, 9> coefficients;
+  coefficients.fill(glm::vec3(0));
+  for (const auto &sum : rowSums) {
+    for (int i = 0; i < 9; ++i) {
+      coefficients[i] += sum[i];
+    }
+  }
+  // Convolution with the clamped cosine, whose bands are pi, 2 pi / 3 and
+  // pi / 4, divided by pi
+  const float bandFactors[9] = {
+      1.f, 2.f / 3, 2.f / 3, 2.f / 3, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+  for (int i = 0; i < 9; ++i) {
+    coefficients[i] *= bandFactors[i];
+  }
+  return coefficients;
+}
+
+// Point i of the Hammersley set of count points in [0, 1)^2
+glm::vec2 hammersley(uint32_t i, uint32_t count)
+{
+  auto bits = i;
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return glm::vec2(float(i) / count, float(bits) * 2.3283064365386963e-10f);
+}
+
+// Half vector around +Z distributed like the GGX normal distribution
+glm::vec3 importanceSampleGGX(const glm::vec2 &xi, float alphaPow2)
+{
+  const auto phi = 2 * pi * xi.x;
+  const auto cosTheta =
+      std::sqrt((1 - xi.y) / (1 + (alphaPow2 - 1) * xi.y));
+  const auto sinTheta = std::sqrt(1 - cosTheta * cosTheta);
+  return glm::vec3(
+      sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+float ggxDistribution(float NdotH, float alphaPow2)
+{
+  const auto denominator = NdotH * NdotH * (alphaPow2 - 1) + 1;
+  return alphaPow2 / (pi * denominator * denominator);
+}
+
+// Height correlated Smith visibility, the same as pbr_brdf.glsl
+float smithVisibility(float NdotL, float NdotV, float alphaPow2)
+{
+  const auto denominator =
+      NdotL * std::sqrt(NdotV * NdotV * (1 - alphaPow2) + alphaPow2) +
+      NdotV * std::sqrt(NdotL * NdotL * (1 - alphaPow2) + alphaPow2);
+  return denominator > 0 ? 0.5f / denominator : 0.f;
+}
+
+// Direction of the center of a texel of a cubemap face, see the table of
+// the cube map face selection in the OpenGL specification
+glm::vec3 cubemapDirection(int face, int x, int y, int size)
+{
+  const auto s = 2 * (x + 0.5f) / size - 1;
+  const auto t = 2 * (y + 0.5f) / size - 1;
+  switch (face) {
+  case 0:
+    return glm::normalize(glm::vec3(1, -t, -s));
+  case 1:
+    return glm::normalize(glm::vec3(-1, -t, s));
+  case 2:
+    return glm::normalize(glm::vec3(s, 1, t));
+  case 3:
+    return glm::normalize(glm::vec3(s, -1, -t));
+  case 4:
+    return glm::normalize(glm::vec3(s, -t, 1));
+  default:
+    return glm::normalize(glm::vec3(-s, -t, -1));
+  }
+}
+
+// Radiance convolved with the GGX lobe of a roughness, assuming that the
+// view direction is the normal (N = V = R). The samples read the level of the
+// environment whose texels cover their solid angle, which removes the noise
+// of the few samples (filtered importance sampling).
+std::vector<glm::vec3> prefilterSpecular(
+    const EquirectangularMap &environment, int size, float roughness)
+{
+  struct Sample
+  {
+    glm::vec3 direction; // Around +Z
+    float weight;        // NdotL
+    float lod;
+  };
+  std::vector<Sample> samples;
+  if (roughness == 0.f) {
+    const auto cubemapTexelSolidAngle = 4 * pi / (6.f * size * size);
+    samples.push_back({glm::vec3(0, 0, 1), 1.f,
+        0.5f * std::log2(
+                   cubemapTexelSolidAngle / environment.texelSolidAngle())});
+  } else {
+    const auto alpha = roughness * roughness;
+    const auto alphaPow2 = alpha * alpha;
+    for (int i = 0; i < specularSampleCount; ++i) {
+      const auto H = importanceSampleGGX(
+          hammersley(i, specularSampleCount), alphaPow2);
+      // Reflection of V = N = +Z
+      const auto L = glm::vec3(2 * H.z * H.x, 2 * H.z * H.y, 2 * H.z * H.z - 1);
+      if (L.z <= 0) {
+        continue;
+      }
+      // pdf(L) = D * NdotH / (4 * VdotH) = D / 4 when V = N
+      const auto pdf = ggxDistribution(H.z, alphaPow2) / 4;
+      const auto sampleSolidAngle = 1 / (specularSampleCount * pdf);
+      samples.push_back({L, L.z,
+          0.5f * std::log2(sampleSolidAngle / environment.texelSolidAngle()) +
+              1});
+    }
+  }
+
+  std::vector<glm::vec3> texels(6 * size_t(size) * size);
+  parallelFor(6 * size, [&](int row) {
+    const auto face = row / size;
+    const auto y = row % size;
+    for (int x = 0; x < size; ++x) {
+      const auto N = cubemapDirection(face, x, y, size);
+      const auto up =
+          std::abs(N.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+      const auto T = glm::normalize(glm::cross(up, N));
+      const auto B = glm::cross(N, T);
+      auto color = glm::vec3(0);
+      float totalWeight = 0;
+      for (const auto &sample : samples) {
+        const auto L = sample.direction.x * T + sample.direction.y * B +
+                       sample.direction.z * N;
+        color += environment.sample(L, sample.lod) * sample.weight;
+        totalWeight += sample.weight;
+      }
+      texels[x + size * size_t(row)] = color / totalWeight;
+    }
+  });
+  return texels;
+}
+
+// Scale and bias of F0 in the integral of the specular BRDF times NdotL over
+// the hemisphere (split sum approximation), for NdotV in x and the roughness
+// in y
+std::vector<glm::vec2> computeBrdfLut(int size)
+{
+  std::vector<glm::vec2> table(size_t(size) * size);
+  parallelFor(size, [&](int y) {
+    const auto roughness = (y + 0.5f) / size;
+    const auto alpha = roughness * roughness;
+    const auto alphaPow2 = alpha * alpha;
+    for (int x = 0; x < size; ++x) {
+      const auto NdotV = (x + 0.5f) / size;
+      const auto V = glm::vec3(std::sqrt(1 - NdotV * NdotV), 0, NdotV);
+      auto scaleBias = glm::vec2(0);
+      for (int i = 0; i < brdfLutSampleCount; ++i) {
+        const auto H = importanceSampleGGX(
+            hammersley(i, brdfLutSampleCount), alphaPow2);
+        const auto VdotH = glm::dot(V, H);
+        const auto L = 2 * VdotH * H - V;
+        const auto NdotL = L.z;
+        if (NdotL <= 0 || VdotH <= 0) {
+          continue;
+        }
+        // BRDF * NdotL / pdf, where pdf = D * NdotH / (4 * VdotH), without F
+        const auto weight = smithVisibility(NdotL, NdotV, alphaPow2) * 4 *
+                            VdotH * NdotL / H.z;
+        const auto fresnel = std::pow(1 - VdotH, 5.f);
+        scaleBias += weight * glm::vec2(1 - fresnel, fresnel);
+      }
+      table[x + size * size_t(y)] = scaleBias / float(brdfLutSampleCount);
+    }
+  });
+  return table;
+}
+
+bool readCache(const fs::path &path, EnvironmentLighting &lighting)
+{
+  std::ifstream in(path.string(), std::ios::binary);
+  CacheHeader header;
+  if (!in || !in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      !std::equal(
+          std::begin(header.magic), std::end(header.magic), cacheMagic) ||
+      header.version != cacheVersion ||
+      header.specularSize != specularSize ||
+      header.specularMipCount != specularMipCount ||
+      header.brdfLutSize != brdfLutSize) {
+    return false;
+  }
+  lighting.specularSize = specularSize;
+  lighting.specularMips.resize(specularMipCount);
+  for (int level = 0; level < specularMipCount; ++level) {
+    const auto size = size_t(specularSize >> level);
+    lighting.specularMips[level].resize(6 * size * size);
+  }
+  lighting.brdfLutSize = brdfLutSize;
+  lighting.brdfLut.resize(size_t(brdfLutSize) * brdfLutSize);
+
+  const auto read = [&](auto &values) {
+    in.read(reinterpret_cast<char *>(values.data()),
+        values.size() * sizeof(values[0]));
+  };
+  read(lighting.irradianceSH);
+  for (auto &mip : lighting.specularMips) {
+    read(mip);
+  }
+  read(lighting.brdfLut);
+  return bool(in);
+}
+
+void writeCache(const fs::path &path, const EnvironmentLighting &lighting)
+{
+  CacheHeader header;
+  std::copy(std::begin(cacheMagic), std::end(cacheMagic), header.magic);
+  header.version = cacheVersion;
+  header.specularSize = lighting.specularSize;
+  header.specularMipCount = int32_t(lighting.specularMips.size());
+  header.brdfLutSize = lighting.brdfLutSize;
+
+  std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  const auto write = [&](const auto &values) {
+    out.write(reinterpret_cast<const char *>(values.data()),
+        values.size() * sizeof(values[0]));
+  };
+  write(lighting.irradianceSH);
+  for (const auto &mip : lighting.specularMips) {
+    write(mip);
+  }
+  write(lighting.brdfLut);
+  if (!out) {
+    throw std::runtime_error(
+        "Unable to write environment cache " + path.string());
+  }
+}
+
+} // namespace
+
+fs::path environmentCacheDirectory(const fs::path &appPath)
+{
+  return appPath.parent_path() / (appPath.stem().string() + ".ibl-cache");
+}
+
+EnvironmentLighting loadEnvironmentLighting(
+    const fs::path &hdrPath, const fs::path &cacheDirectory, bool *fromCache)
+{
+  std::ifstream in(hdrPath.string(), std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Unable to open " + hdrPath.string());
+  }
+  const std::vector<char> bytes(
+      (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  std::stringstream filename;
+  filename << std::hex << std::setw(16) << std::setfill('0')
+           << fnv1a64(bytes.data(), bytes.size()) << ".ibl";
+  const auto cachePath = cacheDirectory / filename.str();
+
+  EnvironmentLighting lighting;
+  if (readCache(cachePath, lighting)) {
+    if (fromCache) {
+      *fromCache = true;
+    }
+    return lighting;
+  }
+
+  int width = 0, height = 0, componentCount = 0;
+  const auto texels =
+      stbi_loadf_from_memory(reinterpret_cast<const stbi_uc *>(bytes.data()),
+          int(bytes.size()), &width, &height, &componentCount, 3);
+  if (!texels) {
+    throw std::runtime_error("Unable to decode " + hdrPath.string() + ": " +
+                             stbi_failure_reason());
+  }
+  lighting = computeEnvironmentLighting(texels, width, height);
+  stbi_image_free(texels);
+
+  std::error_code error;
+  fs::create_directories(cacheDirectory, error);
+  if (error) {
+    throw std::runtime_error("Unable to create " + cacheDirectory.string() +
+                             " (" + error.message() + ")");
+  }
+  writeCache(cachePath, lighting);
+  if (fromCache) {
+    *fromCache = false;
+  }
+  return lighting;
+}
+
+EnvironmentLighting computeEnvironmentLighting(
+    const float *texels, int width, int height)
+{
+  EnvironmentLighting lighting;
+  lighting.irradianceSH = computeIrradianceSH(texels, width, height);
+
+  const EquirectangularMap environment{texels, width, height};
+  lighting.specularSize = specularSize;
+  for (int level = 0; level < specularMipCount; ++level) {
+    const auto roughness = float(level) / (specularMipCount - 1);
+    lighting.specularMips.push_back(
+        prefilterSpecular(environment, specularSize >> level, roughness));
+  }
+
+  lighting.brdfLutSize = brdfLutSize;
+  lighting.brdfLut = computeBrdfLut(brdfLutSize);
+  return lighting;
+}
+
+void checkEnvironmentLighting()
+{
+  const auto check = [](bool condition, const std::string &what) {
+    if (!condition) {
+      throw std::runtime_error("Environment lighting check failed: " + what);
+    }
+  };
+  const auto near = [](const glm::vec3 &value, const glm::vec3 &expected,
+                        float tolerance) {
+    return glm::all(glm::lessThanEqual(glm::abs(value - expected),
+        glm::vec3(tolerance) * glm::max(glm::abs(expected), glm::vec3(1))));
+  };
+
+  const auto radiance = glm::vec3(0.5f, 1.f, 2.f);
+  const int width = 64, height = 32;
+  std::vector<float> texels;
+  for (int i = 0; i < width * height; ++i) {
+    texels.insert(end(texels), {radiance.x, radiance.y, radiance.z});
+  }
+  const auto lighting =
+      computeEnvironmentLighting(texels.data(), width, height);
+
+  // The shaders evaluate the diffuse radiance as the dot product of the
+  // coefficients with shBasis(N), the band 0 of which is constant
+  const auto band0 = shBasis(glm::vec3(0, 0, 1))[0];
+  check(near(lighting.irradianceSH[0] * band0, radiance, 1e-3f),
+      "band 0 of the constant environment");
+  // Relative to band 0, up to the error of the sum over the texels
+  for (int i = 1; i < 9; ++i) {
+    check(glm::all(glm::lessThanEqual(glm::abs(lighting.irradianceSH[i]),
+              1e-3f * lighting.irradianceSH[0])),
+        "coefficient " + std::to_string(i) + " of the constant environment");
+  }
+
+  for (size_t level = 0; level < lighting.specularMips.size(); ++level) {
+    for (const auto &texel : lighting.specularMips[level]) {
+      check(near(texel, radiance, 1e-3f),
+          "prefiltered radiance of mip level " + std::to_string(level));
+    }
+  }
+
+  // The texel of the largest NdotV and of the smallest roughness, whose
+  // centers are half a texel from 1 and 0
+  const auto &scaleBias = lighting.brdfLut[size_t(lighting.brdfLutSize) - 1];
+  check(std::abs(scaleBias.x - 1) < 1e-2f && std::abs(scaleBias.y) < 1e-2f,
+      "BRDF table at NdotV = 1 and roughness 0");
+}
+
+EnvironmentTextures createEnvironmentTextures(
+    const EnvironmentLighting &lighting)
+{
+  EnvironmentTextures textures;
+
+  const auto mipCount = GLsizei(lighting.specularMips.size());
+  glGenTextures(1, &textures.specularCubemap);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, textures.specularCubemap);
+  glTexStorage2D(GL_TEXTURE_CUBE_MAP, mipCount, GL_RGB16F,
+      lighting.specularSize, lighting.specularSize);
+  for (GLsizei level = 0; level < mipCount; ++level) {
+    const auto size = lighting.specularSize >> level;
+    for (int face = 0; face < 6; ++face) {
+      glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0,
+          size, size, GL_RGB, GL_FLOAT,
+          lighting.specularMips[level].data() + face * size_t(size) * size);
+    }
+  }
+  glTexParameteri(
+      GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+  glGenTextures(1, &textures.brdfLut);
+  glBindTexture(GL_TEXTURE_2D, textures.brdfLut);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, lighting.brdfLutSize,
+      lighting.brdfLutSize);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lighting.brdfLutSize,
+      lighting.brdfLutSize, GL_RG, GL_FLOAT, lighting.brdfLut.data());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  // Filter across the edges of the faces
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+  return textures;
+}
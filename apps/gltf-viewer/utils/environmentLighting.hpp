@@ -0,0 +1,71 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+
+// Image based lighting from an equirectangular HDR environment, with the
+// split sum approximation:
+// - the diffuse irradiance as 9 spherical harmonics coefficients (bands 0 to
+// 2), already convolved with the cosine lobe and divided by pi so that the
+// shader gets the diffuse radiance of a white surface with one evaluation
+// - the radiance prefiltered with the GGX lobe in a cubemap, one mip level per
+// roughness from 0 (mirror) to 1
+// - the scale and bias of F0 in the specular integral of the BRDF, a 2D table
+// of NdotV and roughness
+//
+// Everything is precomputed on the CPU by all the hardware threads, so that
+// it does not need a GL context, and stored in a cache directory under a hash
+// of the HDR file: the next launches only read the results back.
+struct EnvironmentLighting
+{
+  std::array<glm::vec3, 9> irradianceSH;
+
+  // Faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, rows from the
+  // first texel of glTexImage2D. Mip level i has specularSize >> i texels
+  // per side and a roughness of i / (mip count - 1).
+  GLsizei specularSize = 0;
+  std::vector<std::vector<glm::vec3>> specularMips;
+
+  // brdfLut[NdotV index + brdfLutSize * roughness index]
+  GLsizei brdfLutSize = 0;
+  std::vector<glm::vec2> brdfLut;
+};
+
+// Cache of the environments next to the executable
+fs::path environmentCacheDirectory(const fs::path &appPath);
+
+// Load the environment lighting of an HDR file from the cache, or precompute
+// it and store it in the cache. Throws std::runtime_error when the file cannot
+// be read. fromCache tells whether the cache was used.
+EnvironmentLighting loadEnvironmentLighting(const fs::path &hdrPath,
+    const fs::path &cacheDirectory, bool *fromCache = nullptr);
+
+// Precompute the lighting of an equirectangular image of width x height RGB
+// texels, the first row being the top (+Y) of the environment
+EnvironmentLighting computeEnvironmentLighting(
+    const float *texels, int width, int height);
+
+// Check the precomputation against closed forms, throw std::runtime_error on
+// the first mismatch:
+// - a constant environment only projects to the band 0 of the spherical
+// harmonics, and the diffuse radiance of a white surface is the constant
+// - its prefiltered radiance is the constant at every roughness
+// - the BRDF table is (1, 0) at NdotV = 1 and roughness 0
+void checkEnvironmentLighting();
+
+// GL textures of an environment, to bind with the IMAGE_BASED_LIGHTING
+// programs of the viewer
+struct EnvironmentTextures
+{
+  GLuint specularCubemap = 0;
+  GLuint brdfLut = 0;
+};
+
+EnvironmentTextures createEnvironmentTextures(
+    const EnvironmentLighting &lighting);
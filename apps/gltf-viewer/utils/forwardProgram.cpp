@@ -0,0 +1,145 @@
+#include "forwardProgram.hpp"
+#include "clusteredLights.hpp"
+#include "shadowMaps.hpp"
+
+#include <utility>
+
+ForwardProgram::ForwardProgram(GLProgram &&glslProgram) :
+    program(std::move(glslProgram))
+{
+  // NORMAL MAPPING //
+  modelMatrixLocation = program.getUniformLocation("uModelMatrix");
+
+  modelViewProjMatrixLocation =
+      program.getUniformLocation("uModelViewProjMatrix");
+  modelViewMatrixLocation = program.getUniformLocation("uModelViewMatrix");
+  normalMatrixLocation = program.getUniformLocation("uNormalMatrix");
+
+  // INSTANCING //
+  viewMatrixLocation = program.getUniformLocation("uViewMatrix");
+  projMatrixLocation = program.getUniformLocation("uProjMatrix");
+  useInstancingLocation = program.getUniformLocation("uUseInstancing");
+
+  /** Directional Light **/
+  lightDirectionLocation =
+      program.getUniformLocation("dirLight.uLightDirection");
+  lightIntensityLocation =
+      program.getUniformLocation("dirLight.uLightIntensity");
+
+  /** Point light **/
+  for (int i = 0; i < NB_POINTS_LIGHTS; ++i) {
+    const auto prefix = "pointLight[" + std::to_string(i) + "].";
+    pointLightPositionLocation[i] =
+        program.getUniformLocation((prefix + "position").c_str());
+    pointLightColorLocation[i] =
+        program.getUniformLocation((prefix + "color").c_str());
+    pointLightConstantLocation[i] =
+        program.getUniformLocation((prefix + "constant").c_str());
+    pointLightLinearLocation[i] =
+        program.getUniformLocation((prefix + "linear").c_str());
+    pointLightQuadraticLocation[i] =
+        program.getUniformLocation((prefix + "quadratic").c_str());
+  }
+
+  /** Spot light **/
+  spotLightPositionLocation = program.getUniformLocation("spotLight.position");
+  spotLightDirectionLocation =
+      program.getUniformLocation("spotLight.direction");
+  spotLightColorLocation = program.getUniformLocation("spotLight.color");
+  spotLightCutOffLocation = program.getUniformLocation("spotLight.cutOff");
+  spotLightOuterCutOffLocation =
+      program.getUniformLocation("spotLight.outerCutOff");
+  spotLightConstantLocation = program.getUniformLocation("spotLight.constant");
+  spotLightLinearLocation = program.getUniformLocation("spotLight.linear");
+  spotLightQuadraticLocation =
+      program.getUniformLocation("spotLight.quadratic");
+
+  /** Clustered lights **/
+  clusterGridSizeLocation = program.getUniformLocation("uClusterGridSize");
+  clusterTileSizeLocation = program.getUniformLocation("uClusterTileSize");
+  clusterDepthScaleBiasLocation =
+      program.getUniformLocation("uClusterDepthScaleBias");
+
+  /** Image based lighting **/
+  irradianceSHLocation = program.getUniformLocation("uIrradianceSH");
+  specularEnvironmentLocation =
+      program.getUniformLocation("uSpecularEnvironment");
+  brdfLutLocation = program.getUniformLocation("uBrdfLut");
+  viewToWorldLocation = program.getUniformLocation("uViewToWorld");
+  environmentIntensityLocation =
+      program.getUniformLocation("uEnvironmentIntensity");
+
+  /** Shadows **/
+  shadowMapsLocation = program.getUniformLocation("uShadowMaps");
+  shadowMatricesLocation = program.getUniformLocation("uShadowMatrices");
+  cascadeEndsLocation = program.getUniformLocation("uCascadeEnds");
+
+  baseColorTextureLocation = program.getUniformLocation("uBaseColorTexture");
+  baseColorFactorLocation = program.getUniformLocation("uBaseColorFactor");
+
+  metallicFactorLocation = program.getUniformLocation("uMetallicFactor");
+  metallicRoughnessTextureLocation =
+      program.getUniformLocation("uMetallicRoughnessTexture");
+  roughnessFactorLocation = program.getUniformLocation("uRoughnessFactor");
+
+  emissiveFactorLocation = program.getUniformLocation("uEmissiveFactor");
+  emissiveTextureLocation = program.getUniformLocation("uEmissiveTexture");
+
+  // NORMAL MAPPING //
+  normalTextureLocation = program.getUniformLocation("uNormalTexture");
+
+  /** Deferred lighting pass **/
+  inverseProjMatrixLocation = program.getUniformLocation("uInverseProjMatrix");
+  static const char *gBufferTextureNames[GBuffer::TEXTURE_COUNT] = {
+      "uGBufferBaseColor", "uGBufferNormal", "uGBufferMetallicRoughness",
+      "uGBufferEmissive", "uGBufferDepth"};
+  for (int i = 0; i < GBuffer::TEXTURE_COUNT; ++i) {
+    gBufferTextureLocations[i] =
+        program.getUniformLocation(gBufferTextureNames[i]);
+  }
+  viewportSizeLocation = program.getUniformLocation("uViewportSize");
+
+  /** Upscale pass **/
+  sourceTextureLocation = program.getUniformLocation("uSourceTexture");
+  sourceSizeLocation = program.getUniformLocation("uSourceSize");
+
+  /** Auxiliary buffers pass **/
+  nodeIdLocation = program.getUniformLocation("uNodeId");
+  materialIdLocation = program.getUniformLocation("uMaterialId");
+}
+
+std::vector<std::string> forwardProgramDefines(uint32_t featureMask)
+{
+  static const std::pair<uint32_t, const char *> featureDefines[] = {
+      {HAS_BASE_COLOR_TEXTURE, "HAS_BASE_COLOR_TEXTURE"},
+      {HAS_METALLIC_ROUGHNESS_TEXTURE, "HAS_METALLIC_ROUGHNESS_TEXTURE"},
+      {HAS_NORMAL_MAP, "HAS_NORMAL_MAP"},
+      {HAS_EMISSIVE, "HAS_EMISSIVE"},
+      {HAS_EMISSIVE_TEXTURE, "HAS_EMISSIVE_TEXTURE"},
+      {DOUBLE_SIDED, "DOUBLE_SIDED"},
+      {HAS_SPOT_LIGHT, "HAS_SPOT_LIGHT"},
+      {IMAGE_BASED_LIGHTING, "IMAGE_BASED_LIGHTING"}};
+
+  std::vector<std::string> defines;
+  for (const auto &featureDefine : featureDefines) {
+    if (featureMask & featureDefine.first) {
+      defines.emplace_back(featureDefine.second);
+    }
+  }
+  const auto pointLightCount =
+      (featureMask & NUM_POINT_LIGHTS_MASK) >> NUM_POINT_LIGHTS_SHIFT;
+  defines.push_back("NUM_POINT_LIGHTS " + std::to_string(pointLightCount));
+  if (featureMask & CLUSTERED_LIGHTS) {
+    defines.emplace_back("CLUSTERED_LIGHTS");
+    for (auto &define : ClusteredLights::shaderDefines()) {
+      defines.push_back(std::move(define));
+    }
+  }
+  if (featureMask & HAS_SHADOWS) {
+    defines.emplace_back("HAS_SHADOWS");
+    for (auto &define : ShadowMaps::shaderDefines()) {
+      defines.push_back(std::move(define));
+    }
+  }
+  return defines;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "gBuffer.hpp"
+#include "shaders.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define NB_POINTS_LIGHTS 3
+
+// Features of a permutation of the forward program. The low bits come from
+// the material, the high bits from the lights of the scene. The pass bits
+// select the programs of the other passes instead: the G-buffer pass only
+// uses the material bits, the lighting pass only the lights bits, the depth
+// only, upscale and auxiliary buffers passes none of them.
+enum ForwardProgramFeatures : uint32_t
+{
+  HAS_BASE_COLOR_TEXTURE = 1 << 0,
+  HAS_METALLIC_ROUGHNESS_TEXTURE = 1 << 1,
+  HAS_NORMAL_MAP = 1 << 2,
+  HAS_EMISSIVE = 1 << 3,
+  HAS_EMISSIVE_TEXTURE = 1 << 4,
+  DOUBLE_SIDED = 1 << 5, // Normals flipped on back faces
+  HAS_SPOT_LIGHT = 1 << 8,
+  NUM_POINT_LIGHTS_SHIFT = 9, // Number of point lights in bits 9 to 10
+  NUM_POINT_LIGHTS_MASK = 3 << NUM_POINT_LIGHTS_SHIFT,
+  CLUSTERED_LIGHTS = 1 << 11, // Point and spot lights from ClusteredLights
+  IMAGE_BASED_LIGHTING = 1 << 12, // Environment of EnvironmentLighting
+  HAS_SHADOWS = 1 << 13, // Directional and spot lights shadowed by ShadowMaps
+  GBUFFER_PASS = 1 << 14,
+  LIGHTING_PASS = 1 << 15,
+  DEPTH_PREPASS = 1 << 16,
+  COVERAGE_PASS = 1 << 17, // Pixels covered by the geometry, for overdraw
+  UPSCALE_PASS = 1 << 18,  // Texture copied over the viewport
+  AUXILIARY_PASS = 1 << 19 // Depth, normals and ids, see AuxiliaryBuffers
+};
+
+// A permutation of the forward program, or of a pass of the deferred
+// renderer, with the locations of its uniforms: -1 for the ones removed by
+// its #defines or absent from its shaders
+struct ForwardProgram
+{
+  explicit ForwardProgram(GLProgram &&program);
+
+  GLProgram program;
+
+  GLint modelMatrixLocation;
+  GLint modelViewProjMatrixLocation;
+  GLint modelViewMatrixLocation;
+  GLint normalMatrixLocation;
+  GLint viewMatrixLocation;
+  GLint projMatrixLocation;
+  GLint useInstancingLocation;
+
+  GLint lightDirectionLocation;
+  GLint lightIntensityLocation;
+  GLint pointLightPositionLocation[NB_POINTS_LIGHTS];
+  GLint pointLightColorLocation[NB_POINTS_LIGHTS];
+  GLint pointLightConstantLocation[NB_POINTS_LIGHTS];
+  GLint pointLightLinearLocation[NB_POINTS_LIGHTS];
+  GLint pointLightQuadraticLocation[NB_POINTS_LIGHTS];
+  GLint spotLightPositionLocation;
+  GLint spotLightDirectionLocation;
+  GLint spotLightColorLocation;
+  GLint spotLightCutOffLocation;
+  GLint spotLightOuterCutOffLocation;
+  GLint spotLightConstantLocation;
+  GLint spotLightLinearLocation;
+  GLint spotLightQuadraticLocation;
+  GLint clusterGridSizeLocation;
+  GLint clusterTileSizeLocation;
+  GLint clusterDepthScaleBiasLocation;
+  GLint irradianceSHLocation;
+  GLint specularEnvironmentLocation;
+  GLint brdfLutLocation;
+  GLint viewToWorldLocation;
+  GLint environmentIntensityLocation;
+  GLint shadowMapsLocation;
+  GLint shadowMatricesLocation;
+  GLint cascadeEndsLocation;
+
+  GLint baseColorTextureLocation;
+  GLint baseColorFactorLocation;
+  GLint metallicFactorLocation;
+  GLint metallicRoughnessTextureLocation;
+  GLint roughnessFactorLocation;
+  GLint emissiveFactorLocation;
+  GLint emissiveTextureLocation;
+  GLint normalTextureLocation;
+
+  // Deferred lighting pass
+  GLint inverseProjMatrixLocation;
+  GLint gBufferTextureLocations[GBuffer::TEXTURE_COUNT];
+  GLint viewportSizeLocation;
+
+  // Upscale pass
+  GLint sourceTextureLocation;
+  GLint sourceSizeLocation;
+
+  // Auxiliary buffers pass
+  GLint nodeIdLocation;
+  GLint materialIdLocation;
+
+  // Last frame for which the lights and camera uniforms were set
+  uint64_t frameIndex = 0;
+};
+
+// #defines injected in the shaders for a feature mask
+std::vector<std::string> forwardProgramDefines(uint32_t featureMask);
@@ -0,0 +1,391 @@
+#include "frameGraph.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+
+struct FormatInfo
+{
+  GLenum internalFormat;
+  GLenum viewClass; // GL_NONE when the textures of the format have no views
+  size_t bytesPerTexel;
+};
+
+// The formats of the render targets of the viewer
+const FormatInfo formatInfos[] = {{GL_RGBA32F, GL_VIEW_CLASS_128_BITS, 16},
+    {GL_RGBA16F, GL_VIEW_CLASS_64_BITS, 8},
+    {GL_RG32F, GL_VIEW_CLASS_64_BITS, 8},
+    {GL_RGBA8, GL_VIEW_CLASS_32_BITS, 4},
+    {GL_SRGB8_ALPHA8, GL_VIEW_CLASS_32_BITS, 4},
+    {GL_R11F_G11F_B10F, GL_VIEW_CLASS_32_BITS, 4},
+    {GL_RGB10_A2, GL_VIEW_CLASS_32_BITS, 4},
+    {GL_RG16F, GL_VIEW_CLASS_32_BITS, 4}, {GL_R32F, GL_VIEW_CLASS_32_BITS, 4},
+    {GL_RG8, GL_VIEW_CLASS_16_BITS, 2}, {GL_R16F, GL_VIEW_CLASS_16_BITS, 2},
+    {GL_R8, GL_VIEW_CLASS_8_BITS, 1}, {GL_DEPTH_COMPONENT32F, GL_NONE, 4},
+    {GL_DEPTH_COMPONENT24, GL_NONE, 4}, {GL_DEPTH24_STENCIL8, GL_NONE, 4}};
+
+FormatInfo formatInfo(GLenum internalFormat)
+{
+  for (const auto &info : formatInfos) {
+    if (info.internalFormat == internalFormat) {
+      return info;
+    }
+  }
+  assert(false && "Unknown render target format");
+  return {internalFormat, GL_NONE, 4};
+}
+
+GLenum depthAttachment(GLenum internalFormat)
+{
+  switch (internalFormat) {
+  case GL_DEPTH_COMPONENT32F:
+  case GL_DEPTH_COMPONENT24:
+    return GL_DEPTH_ATTACHMENT;
+  case GL_DEPTH24_STENCIL8:
+    return GL_DEPTH_STENCIL_ATTACHMENT;
+  default:
+    return GL_NONE;
+  }
+}
+
+// Allocations unused for that many frames are released
+const uint64_t unusedFrameLimit = 8;
+
+} // namespace
+
+FrameGraph::Resource FrameGraph::PassBuilder::read(Resource resource)
+{
+  assert(resource >= 0 && resource < Resource(m_Graph.m_Resources.size()));
+  auto &reads = m_Graph.m_Passes[m_PassIndex].reads;
+  if (std::find(begin(reads), end(reads), resource) == end(reads)) {
+    reads.push_back(resource);
+  }
+  return resource;
+}
+
+FrameGraph::Resource FrameGraph::PassBuilder::write(Resource resource)
+{
+  assert(resource >= 0 && resource < Resource(m_Graph.m_Resources.size()));
+  auto &writes = m_Graph.m_Passes[m_PassIndex].writes;
+  if (std::find(begin(writes), end(writes), resource) == end(writes)) {
+    writes.push_back(resource);
+  }
+  return resource;
+}
+
+FrameGraph::~FrameGraph()
+{
+  for (const auto &framebuffer : m_Framebuffers) {
+    glDeleteFramebuffers(1, &framebuffer.second);
+  }
+  for (const auto &allocation : m_Allocations) {
+    for (const auto &view : allocation.views) {
+      glDeleteTextures(1, &view.second);
+    }
+    glDeleteTextures(1, &allocation.texture);
+  }
+}
+
+void FrameGraph::reset()
+{
+  m_Resources.clear();
+  m_Passes.clear();
+  m_ResourceAllocations.clear();
+}
+
+FrameGraph::Resource FrameGraph::createTexture(
+    const std::string &name, const TextureDesc &desc)
+{
+  ResourceNode resource;
+  resource.name = name;
+  resource.desc = desc;
+  m_Resources.push_back(resource);
+  return Resource(m_Resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::importFramebuffer(
+    const std::string &name, GLuint framebuffer)
+{
+  ResourceNode resource;
+  resource.name = name;
+  resource.imported = true;
+  resource.isFramebuffer = true;
+  resource.framebuffer = framebuffer;
+  m_Resources.push_back(resource);
+  return Resource(m_Resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::importTexture(
+    const std::string &name, GLuint texture)
+{
+  ResourceNode resource;
+  resource.name = name;
+  resource.imported = true;
+  resource.texture = texture;
+  m_Resources.push_back(resource);
+  return Resource(m_Resources.size() - 1);
+}
+
+void FrameGraph::addPass(const std::string &name,
+    const std::function<void(PassBuilder &)> &setup,
+    std::function<void()> execute)
+{
+  m_Passes.emplace_back();
+  m_Passes.back().name = name;
+  m_Passes.back().execute = std::move(execute);
+  PassBuilder builder{*this, m_Passes.size() - 1};
+  setup(builder);
+}
+
+void FrameGraph::compile()
+{
+  ++m_FrameIndex;
+
+  // A pass is kept if a pass kept after it needs one of its writes
+  m_CulledPassCount = 0;
+  for (auto passIndex = int(m_Passes.size()) - 1; passIndex >= 0;
+       --passIndex) {
+    auto &pass = m_Passes[passIndex];
+    pass.kept = std::any_of(
+        begin(pass.writes), end(pass.writes), [&](Resource resource) {
+          return m_Resources[resource].isFramebuffer ||
+                 m_Resources[resource].needed;
+        });
+    if (!pass.kept) {
+      ++m_CulledPassCount;
+      continue;
+    }
+    for (const auto *resources : {&pass.reads, &pass.writes}) {
+      for (const auto resource : *resources) {
+        m_Resources[resource].needed = true;
+      }
+    }
+  }
+
+  // Lifetimes of the resources, in passes kept
+  for (int passIndex = 0; passIndex < int(m_Passes.size()); ++passIndex) {
+    const auto &pass = m_Passes[passIndex];
+    if (!pass.kept) {
+      continue;
+    }
+    for (const auto *resources : {&pass.reads, &pass.writes}) {
+      for (const auto resource : *resources) {
+        auto &node = m_Resources[resource];
+        if (node.firstPass < 0) {
+          node.firstPass = passIndex;
+        }
+        node.lastPass = passIndex;
+      }
+    }
+  }
+
+  // Allocation of the transient textures along the passes: a texture takes
+  // an allocation free at its first pass, and frees it after its last one
+  for (auto &allocation : m_Allocations) {
+    allocation.inUse = false;
+  }
+  m_ResourceAllocations.assign(m_Resources.size(), -1);
+  m_TransientTextureCount = 0;
+  m_UnaliasedBytes = 0;
+  for (int passIndex = 0; passIndex < int(m_Passes.size()); ++passIndex) {
+    for (Resource resource = 0; resource < Resource(m_Resources.size());
+         ++resource) {
+      auto &node = m_Resources[resource];
+      if (node.imported || node.firstPass != passIndex) {
+        continue;
+      }
+      node.texture =
+          acquireTexture(node.desc, m_ResourceAllocations[resource]);
+      ++m_TransientTextureCount;
+      m_UnaliasedBytes += formatInfo(node.desc.internalFormat).bytesPerTexel *
+                          node.desc.width * node.desc.height;
+    }
+    releaseTextures(passIndex);
+  }
+
+  // Allocations of the frame, and release of the ones unused for a while
+  m_FrameAllocationCount = 0;
+  m_PeakBytes = 0;
+  for (size_t i = 0; i < m_Allocations.size();) {
+    auto &allocation = m_Allocations[i];
+    if (allocation.lastFrame == m_FrameIndex) {
+      ++m_FrameAllocationCount;
+      m_PeakBytes += allocation.byteSize;
+    } else if (allocation.lastFrame + unusedFrameLimit < m_FrameIndex) {
+      std::vector<GLuint> textures = {allocation.texture};
+      for (const auto &view : allocation.views) {
+        textures.push_back(view.second);
+      }
+      for (auto it = begin(m_Framebuffers); it != end(m_Framebuffers);) {
+        const bool usesTexture = std::any_of(
+            begin(it->first), end(it->first), [&](GLuint texture) {
+              return std::find(begin(textures), end(textures), texture) !=
+                     end(textures);
+            });
+        if (usesTexture) {
+          glDeleteFramebuffers(1, &it->second);
+          it = m_Framebuffers.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      glDeleteTextures(GLsizei(textures.size()), textures.data());
+      m_Allocations.erase(begin(m_Allocations) + i);
+      continue;
+    }
+    ++i;
+  }
+}
+
+void FrameGraph::execute()
+{
+  for (int passIndex = 0; passIndex < int(m_Passes.size()); ++passIndex) {
+    if (m_Passes[passIndex].kept) {
+      m_CurrentPass = passIndex;
+      m_Passes[passIndex].execute();
+    }
+  }
+  m_CurrentPass = -1;
+}
+
+GLuint FrameGraph::texture(Resource resource) const
+{
+  assert(m_Resources[resource].firstPass >= 0);
+  return m_Resources[resource].texture;
+}
+
+void FrameGraph::bindFramebuffer()
+{
+  assert(m_CurrentPass >= 0);
+  const auto &pass = m_Passes[m_CurrentPass];
+
+  // Color attachments in the order of the writes, then the depth one
+  std::vector<GLuint> attachments;
+  GLuint depthTexture = 0;
+  GLenum depthAttachmentPoint = GL_NONE;
+  for (const auto resource : pass.writes) {
+    const auto &node = m_Resources[resource];
+    if (node.isFramebuffer) {
+      // The pass renders to the framebuffer of the caller
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, node.framebuffer);
+      return;
+    }
+    const auto attachmentPoint = depthAttachment(node.desc.internalFormat);
+    if (attachmentPoint != GL_NONE) {
+      depthTexture = node.texture;
+      depthAttachmentPoint = attachmentPoint;
+    } else {
+      attachments.push_back(node.texture);
+    }
+  }
+  const auto colorCount = GLsizei(attachments.size());
+  attachments.push_back(depthTexture);
+
+  auto &framebuffer = m_Framebuffers[attachments];
+  if (framebuffer) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    return;
+  }
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+  std::vector<GLenum> drawBuffers;
+  for (GLsizei i = 0; i < colorCount; ++i) {
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, attachments[i], 0);
+    drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+  }
+  if (depthTexture) {
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, depthAttachmentPoint, depthTexture, 0);
+  }
+  if (drawBuffers.empty()) {
+    glDrawBuffer(GL_NONE);
+  } else {
+    glDrawBuffers(GLsizei(drawBuffers.size()), drawBuffers.data());
+  }
+  const auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  (void)framebufferStatus;
+}
+
+std::string FrameGraph::passNames() const
+{
+  std::string names;
+  for (const auto &pass : m_Passes) {
+    if (pass.kept) {
+      names += (names.empty() ? "" : " > ") + pass.name;
+    }
+  }
+  return names;
+}
+
+GLuint FrameGraph::acquireTexture(
+    const TextureDesc &desc, int &allocationIndex)
+{
+  const auto info = formatInfo(desc.internalFormat);
+  // A free allocation of the same format, else one of its view class
+  Allocation *allocation = nullptr;
+  for (auto &candidate : m_Allocations) {
+    if (candidate.inUse || candidate.width != desc.width ||
+        candidate.height != desc.height) {
+      continue;
+    }
+    if (candidate.internalFormat == desc.internalFormat) {
+      allocation = &candidate;
+      break;
+    }
+    if (!allocation && info.viewClass != GL_NONE &&
+        candidate.viewClass == info.viewClass) {
+      allocation = &candidate;
+    }
+  }
+  if (!allocation) {
+    m_Allocations.emplace_back();
+    allocation = &m_Allocations.back();
+    allocation->viewClass = info.viewClass;
+    allocation->internalFormat = desc.internalFormat;
+    allocation->width = desc.width;
+    allocation->height = desc.height;
+    allocation->byteSize = info.bytesPerTexel * desc.width * desc.height;
+    glGenTextures(1, &allocation->texture);
+    glBindTexture(GL_TEXTURE_2D, allocation->texture);
+    glTexStorage2D(
+        GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+  }
+  allocation->inUse = true;
+  allocation->lastFrame = m_FrameIndex;
+  allocationIndex = int(allocation - m_Allocations.data());
+
+  auto texture = allocation->texture;
+  if (allocation->internalFormat != desc.internalFormat) {
+    auto &view = allocation->views[desc.internalFormat];
+    if (!view) {
+      // A name never bound, as glTextureView requires
+      glGenTextures(1, &view);
+      glTextureView(view, GL_TEXTURE_2D, allocation->texture,
+          desc.internalFormat, 0, 1, 0, 1);
+    }
+    texture = view;
+  }
+  // The parameters are those of this texture, not of the allocation
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
+
+void FrameGraph::releaseTextures(int passIndex)
+{
+  for (Resource resource = 0; resource < Resource(m_Resources.size());
+       ++resource) {
+    const auto allocationIndex = m_ResourceAllocations[resource];
+    if (m_Resources[resource].lastPass == passIndex && allocationIndex >= 0) {
+      m_Allocations[allocationIndex].inUse = false;
+    }
+  }
+}
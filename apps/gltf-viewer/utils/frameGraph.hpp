@@ -0,0 +1,163 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Frame graph: the render passes of a frame are recorded with the resources
+// they read and write, then compiled and executed.
+//
+// - Transient textures are created from a description and only live during
+// the frame. The external targets (framebuffer of the caller, textures owned
+// by other objects) are imported.
+// - Compiling culls the passes whose results nobody uses: a pass is kept when
+// it writes an imported framebuffer, or a resource read or written by a pass
+// kept after it. A write keeps the previous content of its target (it can
+// blend or depth test against it), so it also depends on the earlier writers.
+// - The passes kept are executed in the order they were added, which must be
+// the order of their dependencies. The lifetime of a transient texture spans
+// its first to its last pass, the textures which are never alive at the same
+// time share allocations: allocations of the same size and view class (e.g.
+// GL_RGBA8, GL_SRGB8_ALPHA8 and GL_R11F_G11F_B10F are all 32 bits per texel)
+// are aliased through glTextureView. The allocations are kept from frame to
+// frame, and released after a few frames without use.
+//
+// The passes write a texture as a color attachment, in the order of their
+// writes, or as the depth attachment for a depth format. The framebuffer
+// objects of these attachments are cached.
+class FrameGraph
+{
+public:
+  using Resource = int;
+  static const Resource NO_RESOURCE = -1;
+
+  struct TextureDesc
+  {
+    GLenum internalFormat;
+    GLsizei width;
+    GLsizei height;
+    GLenum filter = GL_NEAREST; // Min and mag filters, edges clamped
+  };
+
+  // Declares the resources of a pass, while it is added
+  class PassBuilder
+  {
+  public:
+    // Sampled by the pass
+    Resource read(Resource resource);
+    // An attachment of the pass, or an imported target it renders to
+    Resource write(Resource resource);
+
+  private:
+    friend class FrameGraph;
+    PassBuilder(FrameGraph &graph, size_t passIndex) :
+        m_Graph(graph), m_PassIndex(passIndex)
+    {
+    }
+    FrameGraph &m_Graph;
+    size_t m_PassIndex;
+  };
+
+  FrameGraph() = default;
+  ~FrameGraph();
+
+  FrameGraph(const FrameGraph &) = delete;
+  FrameGraph &operator=(const FrameGraph &) = delete;
+
+  // Forget the passes and resources of the previous frame, the allocations
+  // are kept for this one
+  void reset();
+
+  Resource createTexture(const std::string &name, const TextureDesc &desc);
+  Resource importFramebuffer(const std::string &name, GLuint framebuffer);
+  Resource importTexture(const std::string &name, GLuint texture);
+
+  // setup declares the resources of the pass now, execute draws it
+  void addPass(const std::string &name,
+      const std::function<void(PassBuilder &)> &setup,
+      std::function<void()> execute);
+
+  // Cull the passes, then allocate the transient textures
+  void compile();
+  // Execute the passes kept, in order
+  void execute();
+
+  // While executing a pass: the texture of a resource, and the framebuffer of
+  // its writes bound to GL_DRAW_FRAMEBUFFER
+  GLuint texture(Resource resource) const;
+  void bindFramebuffer();
+
+  /** Stats of the last compiled frame **/
+  size_t passCount() const { return m_Passes.size(); }
+  size_t culledPassCount() const { return m_CulledPassCount; }
+  size_t transientTextureCount() const { return m_TransientTextureCount; }
+  size_t allocationCount() const { return m_FrameAllocationCount; }
+  // Bytes of the allocations used by the frame, the peak memory of its
+  // render targets since they all exist at the same time
+  size_t peakBytes() const { return m_PeakBytes; }
+  // Bytes the transient textures would use without aliasing
+  size_t unaliasedBytes() const { return m_UnaliasedBytes; }
+  // Names of the passes kept, in the order of execution
+  std::string passNames() const;
+
+private:
+  struct ResourceNode
+  {
+    std::string name;
+    TextureDesc desc;
+    bool imported = false;
+    GLuint texture = 0; // Imported, or view of the allocation of the frame
+    GLuint framebuffer = 0; // Imported framebuffer
+    bool isFramebuffer = false;
+    bool needed = false; // By a pass kept
+    int firstPass = -1;
+    int lastPass = -1;
+  };
+
+  struct PassNode
+  {
+    std::string name;
+    std::vector<Resource> reads;
+    std::vector<Resource> writes;
+    std::function<void()> execute;
+    bool kept = false;
+  };
+
+  // Storage shared by the transient textures of a view class and a size
+  struct Allocation
+  {
+    GLenum viewClass;
+    GLenum internalFormat; // Of the storage
+    GLsizei width;
+    GLsizei height;
+    GLuint texture = 0;
+    size_t byteSize = 0;
+    std::map<GLenum, GLuint> views; // By internal format
+    uint64_t lastFrame = 0;         // Last frame using it
+    bool inUse = false;             // By a texture alive in the current pass
+  };
+
+  // Texture of a transient resource, in an allocation free in the current
+  // pass
+  GLuint acquireTexture(const TextureDesc &desc, int &allocationIndex);
+  void releaseTextures(int passIndex);
+
+  std::vector<ResourceNode> m_Resources;
+  std::vector<PassNode> m_Passes;
+  std::vector<Allocation> m_Allocations;
+  std::vector<int> m_ResourceAllocations; // Index in m_Allocations
+  std::map<std::vector<GLuint>, GLuint> m_Framebuffers; // By attachments
+  int m_CurrentPass = -1;
+  uint64_t m_FrameIndex = 0;
+
+  size_t m_CulledPassCount = 0;
+  size_t m_TransientTextureCount = 0;
+  size_t m_FrameAllocationCount = 0;
+  size_t m_PeakBytes = 0;
+  size_t m_UnaliasedBytes = 0;
+};
@@ -0,0 +1,174 @@
+#include "frameStream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Of reserveStandardOutput(), until a stream takes it
+std::FILE *reservedOutput = nullptr;
+
+unsigned char clampByte(float value)
+{
+  return (unsigned char)std::min(std::max(value + 0.5f, 0.f), 255.f);
+}
+
+} // namespace
+
+FrameStreamFormat frameStreamFormatFromName(const std::string &name)
+{
+  if (name == "y4m") {
+    return FrameStreamFormat::Y4M;
+  }
+  if (name == "rgb") {
+    return FrameStreamFormat::RGB;
+  }
+  throw std::runtime_error(
+      "Unknown stream format " + name + " (expected y4m or rgb)");
+}
+
+void reserveStandardOutput()
+{
+  if (reservedOutput) {
+    return;
+  }
+  // The renderer logs with std::cout and printf: the standard output is
+  // redirected to the error output, the frames keep the original one
+  std::cout.flush();
+  std::fflush(stdout);
+  reservedOutput = fdopen(dup(fileno(stdout)), "wb");
+  if (!reservedOutput) {
+    throw std::runtime_error("Unable to keep the standard output.");
+  }
+  dup2(fileno(stderr), fileno(stdout));
+}
+
+FrameStream::FrameStream(const fs::path &path, FrameStreamFormat format,
+    GLsizei width, GLsizei height, uint32_t framesPerSecond) :
+    m_Format(format),
+    m_Width(width),
+    m_Height(height)
+{
+#ifndef _WIN32
+  // A reader closing the pipe is an error of the write, not a signal killing
+  // the process
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
+  if (path == "-") {
+    reserveStandardOutput();
+    m_File = reservedOutput;
+    reservedOutput = nullptr;
+  } else {
+    m_File = std::fopen(path.string().c_str(), "wb");
+    if (!m_File) {
+      throw std::runtime_error("Unable to open " + path.string());
+    }
+  }
+#ifdef _WIN32
+  _setmode(_fileno(m_File), _O_BINARY);
+#endif
+
+  if (format == FrameStreamFormat::Y4M) {
+    // "C420jpeg": the chroma sited at the center of its 2 x 2 pixels
+    const auto header = "YUV4MPEG2 W" + std::to_string(width) + " H" +
+                        std::to_string(height) + " F" +
+                        std::to_string(framesPerSecond) +
+                        ":1 Ip A1:1 C420jpeg\n";
+    m_Bytes.assign(header.begin(), header.end());
+  }
+}
+
+FrameStream::~FrameStream() { std::fclose(m_File); }
+
+void FrameStream::write(const ReadbackImage &frame)
+{
+  if (m_Failed) {
+    return;
+  }
+  if (frame.width != m_Width || frame.height != m_Height ||
+      frame.componentCount != 3) {
+    m_Failed = true;
+    throw std::runtime_error("Streamed frame of the wrong size");
+  }
+  if (m_Format == FrameStreamFormat::Y4M) {
+    static const char frameHeader[] = "FRAME\n";
+    m_Bytes.insert(
+        m_Bytes.end(), frameHeader, frameHeader + sizeof(frameHeader) - 1);
+    appendYuv420(frame);
+  } else {
+    m_Bytes.insert(m_Bytes.end(), frame.pixels.begin(), frame.pixels.end());
+  }
+
+  // Flushed at each frame, for the reader to get it now
+  const auto start = std::chrono::steady_clock::now();
+  const auto written = std::fwrite(m_Bytes.data(), 1, m_Bytes.size(), m_File);
+  const auto flushed = std::fflush(m_File) == 0;
+  m_BlockedTime += std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start)
+                       .count();
+  if (written != m_Bytes.size() || !flushed) {
+    m_Failed = true;
+    throw std::runtime_error(errno == EPIPE
+                                 ? "The reader closed the stream."
+                                 : "Unable to write the stream.");
+  }
+  m_Bytes.clear();
+  ++m_FrameCount;
+}
+
+void FrameStream::appendYuv420(const ReadbackImage &frame)
+{
+  const auto width = size_t(m_Width), height = size_t(m_Height);
+  const auto chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+  const auto lumaOffset = m_Bytes.size();
+  const auto cbOffset = lumaOffset + width * height;
+  const auto crOffset = cbOffset + chromaWidth * chromaHeight;
+  m_Bytes.resize(crOffset + chromaWidth * chromaHeight);
+  auto *luma = m_Bytes.data() + lumaOffset;
+  auto *cb = m_Bytes.data() + cbOffset;
+  auto *cr = m_Bytes.data() + crOffset;
+
+  // BT.601, from RGB bytes to Y in [16, 235] and chroma in [16, 240]
+  const auto *pixels = frame.pixels.data();
+  for (size_t i = 0; i < width * height; ++i) {
+    const auto *rgb = pixels + 3 * i;
+    luma[i] = clampByte(
+        16.f + (65.481f * rgb[0] + 128.553f * rgb[1] + 24.966f * rgb[2]) /
+                   255.f);
+  }
+  for (size_t y = 0; y < chromaHeight; ++y) {
+    for (size_t x = 0; x < chromaWidth; ++x) {
+      // The pixels of the block inside the frame, for odd sizes
+      float r = 0.f, g = 0.f, b = 0.f;
+      size_t count = 0;
+      for (size_t py = 2 * y; py < std::min(2 * y + 2, height); ++py) {
+        for (size_t px = 2 * x; px < std::min(2 * x + 2, width); ++px) {
+          const auto *rgb = pixels + 3 * (py * width + px);
+          r += rgb[0];
+          g += rgb[1];
+          b += rgb[2];
+          ++count;
+        }
+      }
+      const auto scale = 1.f / (255.f * count);
+      r *= scale;
+      g *= scale;
+      b *= scale;
+      cb[y * chromaWidth + x] =
+          clampByte(128.f - 37.797f * r - 74.203f * g + 112.f * b);
+      cr[y * chromaWidth + x] =
+          clampByte(128.f + 112.f * r - 93.786f * g - 18.214f * b);
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "readbackPipeline.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Containers of the streamed frames, read by video encoders without a file
+enum class FrameStreamFormat
+{
+  Y4M, // YUV4MPEG2: 4:2:0, BT.601 limited range, size and rate in the header
+  RGB, // Raw 8 bits RGB frames one after the other, without header
+};
+
+// Parse "y4m" or "rgb", throw std::runtime_error for other names
+FrameStreamFormat frameStreamFormatFromName(const std::string &name);
+
+// Keep the standard output for the FrameStream of "-", the logs written to it
+// going to the error output from now on: call it before the first log. The
+// stream does it otherwise. Throw std::runtime_error if it fails.
+void reserveStandardOutput();
+
+// Frames of an animation, a turntable for example, written to the standard
+// output or to a named pipe as they are rendered, for a video encoder reading
+// them, e.g. "ffmpeg -i - out.mp4": nothing is written to the disk.
+//
+// write() blocks while the reader is behind, when the pipe is full. Called by
+// the encoder thread of a ReadbackPipeline, it fills the queue of the pipeline
+// then the ring of its buffers, and the render thread waits: the frames in
+// flight are bounded by the pipeline whatever the speed of the reader.
+class FrameStream
+{
+public:
+  // "-" for the standard output, see reserveStandardOutput(). Opening a named
+  // pipe waits for its reader. Throw std::runtime_error if the path cannot be
+  // opened.
+  FrameStream(const fs::path &path, FrameStreamFormat format, GLsizei width,
+      GLsizei height, uint32_t framesPerSecond);
+  ~FrameStream();
+
+  FrameStream(const FrameStream &) = delete;
+  FrameStream &operator=(const FrameStream &) = delete;
+
+  // Write a frame of RGB bytes of the size of the stream, rows from the top.
+  // Throw std::runtime_error if the reader closed the stream or if the write
+  // fails, failed() is then true and the next frames are dropped.
+  void write(const ReadbackImage &frame);
+
+  // Thread safe, for the render thread to stop
+  bool failed() const { return m_Failed; }
+  size_t frameCount() const { return m_FrameCount; }
+  // Time write() waited for the reader, in milliseconds
+  double blockedTime() const { return m_BlockedTime; }
+
+private:
+  // The RGB pixels of a frame to Y, Cb and Cr planes, the chroma averaged
+  // over 2 x 2 pixels
+  void appendYuv420(const ReadbackImage &frame);
+
+  std::FILE *m_File = nullptr;
+  FrameStreamFormat m_Format;
+  GLsizei m_Width;
+  GLsizei m_Height;
+  std::vector<unsigned char> m_Bytes; // Of the frame being written
+  std::atomic<bool> m_Failed{false};
+  size_t m_FrameCount = 0;
+  double m_BlockedTime = 0;
+};
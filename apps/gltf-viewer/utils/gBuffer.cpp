@@ -0,0 +1,22 @@
+#include "gBuffer.hpp"
+
+namespace {
+
+const GLenum textureFormats[GBuffer::TEXTURE_COUNT] = {GL_SRGB8_ALPHA8,
+    GL_RGBA16F, GL_RG8, GL_R11F_G11F_B10F, GL_DEPTH_COMPONENT32F};
+
+const char *textureNames[GBuffer::TEXTURE_COUNT] = {"G-buffer base color",
+    "G-buffer normal", "G-buffer metallic roughness", "G-buffer emissive",
+    "G-buffer depth"};
+
+} // namespace
+
+GLenum GBuffer::textureFormat(Texture texture)
+{
+  return textureFormats[texture];
+}
+
+const char *GBuffer::textureName(Texture texture)
+{
+  return textureNames[texture];
+}
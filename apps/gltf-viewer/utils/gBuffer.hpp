@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Render targets of the deferred renderer, transient textures of the frame
+// graph. The geometry pass writes the attributes of the surface seen by each
+// pixel in one texture each:
+// - BASE_COLOR: GL_SRGB8_ALPHA8, linear color written with GL_FRAMEBUFFER_SRGB
+// - NORMAL: GL_RGBA16F, view space normal
+// - METALLIC_ROUGHNESS: GL_RG8
+// - EMISSIVE: GL_R11F_G11F_B10F, linear
+// - DEPTH: GL_DEPTH_COMPONENT32F, from which the lighting pass reconstructs the
+// view space position
+// The color textures are written to the fragment outputs matching their index.
+//
+// The lighting pass then writes the lit color (LIT_COLOR_FORMAT), testing the
+// depth buffer without writing it, so that only the pixels covered by the
+// geometry are shaded. The lit color is finally copied to the framebuffer of
+// the caller by a draw, since glBlitFramebuffer cannot write to a multisampled
+// framebuffer.
+//
+// The viewport can be smaller than the textures, e.g. with dynamic
+// resolution, the passes then use their lower left corner.
+struct GBuffer
+{
+  enum Texture
+  {
+    BASE_COLOR,
+    NORMAL,
+    METALLIC_ROUGHNESS,
+    EMISSIVE,
+    DEPTH,
+    TEXTURE_COUNT
+  };
+
+  static GLenum textureFormat(Texture texture);
+  static const char *textureName(Texture texture);
+
+  static const GLenum LIT_COLOR_FORMAT = GL_RGBA16F;
+};
@@ -3,7 +3,35 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Throw std::runtime_error if the elements of the accessor, elementSize bytes
+// each, do not all fit in its buffer
+void checkAccessorBounds(int accessorIdx, const tinygltf::Accessor &accessor,
+    const tinygltf::Buffer &buffer, size_t byteOffset, size_t byteStride,
+    size_t elementSize)
+{
+  if (!accessor.count) {
+    return;
+  }
+  const auto bufferSize = buffer.data.size();
+  // The last element is not padded to the stride
+  if (bufferSize < elementSize || byteOffset > bufferSize - elementSize ||
+      (accessor.count - 1) >
+          (bufferSize - elementSize - byteOffset) / byteStride) {
+    throw std::runtime_error("Accessor " + std::to_string(accessorIdx) +
+                             " reads past the end of its buffer");
+  }
+}
+
+} // namespace
 
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix)
@@ -153,4 +181,309 @@ void computeSceneBounds(
       updateBounds(nodeIdx, glm::mat4(1));
     }
   }
-}
\ No newline at end of file
+}
+
+bool computePrimitiveBounds(const tinygltf::Model &model,
+    const tinygltf::Primitive &primitive, glm::vec3 &bboxMin,
+    glm::vec3 &bboxMax)
+{
+  bboxMin = bboxMax = glm::vec3(0);
+  const auto positionAttrIdxIt = primitive.attributes.find("POSITION");
+  if (positionAttrIdxIt == end(primitive.attributes)) {
+    return false;
+  }
+  // min and max are required by the specification for POSITION
+  const auto &accessor = model.accessors[(*positionAttrIdxIt).second];
+  if (accessor.minValues.size() != 3 || accessor.maxValues.size() != 3) {
+    return false;
+  }
+  bboxMin = glm::vec3(
+      accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
+  bboxMax = glm::vec3(
+      accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]);
+  return true;
+}
+
+bool readFloatAccessor(const tinygltf::Model &model, int accessorIdx,
+    int numComponents, std::vector<float> &out)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  if (accessor.type != numComponents || accessor.bufferView < 0) {
+    return false;
+  }
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  if (componentSize <= 0 ||
+      (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT &&
+          !accessor.normalized)) {
+    return false;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto &buffer = model.buffers[bufferView.buffer];
+  const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+  const auto byteStride = bufferView.byteStride
+                              ? bufferView.byteStride
+                              : numComponents * size_t(componentSize);
+  checkAccessorBounds(accessorIdx, accessor, buffer, byteOffset, byteStride,
+      numComponents * size_t(componentSize));
+
+  out.resize(accessor.count * numComponents);
+  for (size_t i = 0; i < accessor.count; ++i) {
+    const auto *element = &buffer.data[byteOffset + byteStride * i];
+    for (int c = 0; c < numComponents; ++c) {
+      const auto *component = element + c * componentSize;
+      auto &value = out[i * numComponents + c];
+      // Normalized integers conversion rules from the glTF specification
+      switch (accessor.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        std::memcpy(&value, component, sizeof(float));
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        value = *component / 255.f;
+        break;
+      case TINYGLTF_COMPONENT_TYPE_BYTE:
+        value = std::max(*(const int8_t *)component / 127.f, -1.f);
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        value = *(const uint16_t *)component / 65535.f;
+        break;
+      case TINYGLTF_COMPONENT_TYPE_SHORT:
+        value = std::max(*(const int16_t *)component / 32767.f, -1.f);
+        break;
+      default:
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool readIndexAccessor(
+    const tinygltf::Model &model, int accessorIdx, std::vector<uint32_t> &out)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  if (accessor.type != TINYGLTF_TYPE_SCALAR || accessor.bufferView < 0) {
+    return false;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto &buffer = model.buffers[bufferView.buffer];
+  const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  if (componentSize <= 0) {
+    return false;
+  }
+  const auto byteStride =
+      bufferView.byteStride ? bufferView.byteStride : size_t(componentSize);
+  checkAccessorBounds(accessorIdx, accessor, buffer, byteOffset, byteStride,
+      size_t(componentSize));
+
+  out.resize(accessor.count);
+  for (size_t i = 0; i < accessor.count; ++i) {
+    const auto *index = &buffer.data[byteOffset + byteStride * i];
+    switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      out[i] = *index;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      out[i] = *(const uint16_t *)index;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      out[i] = *(const uint32_t *)index;
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+void computeMeshInstances(const tinygltf::Model &model,
+    std::vector<std::vector<glm::mat4>> &meshInstances)
+{
+  meshInstances.clear();
+  meshInstances.resize(model.meshes.size());
+  if (model.defaultScene < 0) {
+    return;
+  }
+
+  // Expand the per-instance TRS of EXT_mesh_gpu_instancing
+  // https://github.com/KhronosGroup/glTF/tree/master/extensions/2.0/Vendor/EXT_mesh_gpu_instancing
+  const auto addGpuInstances = [&](const tinygltf::Value &extension,
+                                   const glm::mat4 &modelMatrix,
+                                   std::vector<glm::mat4> &instances) {
+    if (!extension.Has("attributes")) {
+      return false;
+    }
+    const auto &attributes = extension.Get("attributes");
+    std::vector<float> translations, rotations, scales;
+    const auto readAttribute = [&](const char *name, int numComponents,
+                                   std::vector<float> &out) {
+      if (!attributes.Has(name)) {
+        return true;
+      }
+      const auto accessorIdx = attributes.Get(name).GetNumberAsInt();
+      if (!readFloatAccessor(model, int(accessorIdx), numComponents, out)) {
+        std::cerr << "EXT_mesh_gpu_instancing " << name
+                  << " accessor cannot be read as floats, skipping it."
+                  << std::endl;
+        return false;
+      }
+      return true;
+    };
+    if (!readAttribute("TRANSLATION", 3, translations) ||
+        !readAttribute("ROTATION", 4, rotations) ||
+        !readAttribute("SCALE", 3, scales)) {
+      return false;
+    }
+    // All the attributes present have the same count, one per instance
+    size_t count = 0;
+    for (const auto attributeCount : {translations.size() / 3,
+             rotations.size() / 4, scales.size() / 3}) {
+      if (attributeCount && count && attributeCount != count) {
+        std::cerr << "EXT_mesh_gpu_instancing attributes with different "
+                     "counts, skipping them."
+                  << std::endl;
+        return false;
+      }
+      count = std::max(count, attributeCount);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      auto instanceMatrix = modelMatrix;
+      if (!translations.empty()) {
+        instanceMatrix = glm::translate(instanceMatrix,
+            glm::vec3(translations[3 * i], translations[3 * i + 1],
+                translations[3 * i + 2]));
+      }
+      if (!rotations.empty()) {
+        instanceMatrix *= glm::mat4_cast(
+            glm::quat(rotations[4 * i + 3], rotations[4 * i],
+                rotations[4 * i + 1],
+                rotations[4 * i + 2])); // prototype is w, x, y, z
+      }
+      if (!scales.empty()) {
+        instanceMatrix = glm::scale(instanceMatrix,
+            glm::vec3(scales[3 * i], scales[3 * i + 1], scales[3 * i + 2]));
+      }
+      instances.push_back(instanceMatrix);
+    }
+    return true;
+  };
+
+  const std::function<void(int, const glm::mat4 &)> addInstances =
+      [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+        const auto &node = model.nodes[nodeIdx];
+        const glm::mat4 modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
+        if (node.mesh >= 0) {
+          auto &instances = meshInstances[node.mesh];
+          const auto extensionIt =
+              node.extensions.find("EXT_mesh_gpu_instancing");
+          if (extensionIt == end(node.extensions) ||
+              !addGpuInstances((*extensionIt).second, modelMatrix, instances)) {
+            instances.push_back(modelMatrix);
+          }
+        }
+        for (const auto childNodeIdx : node.children) {
+          addInstances(childNodeIdx, modelMatrix);
+        }
+      };
+  for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
+    addInstances(nodeIdx, glm::mat4(1));
+  }
+}
+
+InstanceAttributes computeInstanceAttributes(const glm::mat4 &modelMatrix)
+{
+  return {modelMatrix, glm::transpose(glm::inverse(glm::mat3(modelMatrix)))};
+}
+
+float computeLightRange(const glm::vec3 &color, const glm::vec3 &attenuation)
+{
+  // Solve quadratic * d^2 + linear * d + constant = 256 * max(color)
+  const auto maxColor = glm::max(color.r, glm::max(color.g, color.b));
+  const auto c = attenuation.x - 256.f * maxColor;
+  const auto b = attenuation.y;
+  const auto a = attenuation.z;
+  if (c >= 0.f) {
+    return 0.f; // Too dim to light anything
+  }
+  if (a <= 0.f) {
+    return b > 0.f ? -c / b : std::numeric_limits<float>::max();
+  }
+  return (-b + glm::sqrt(b * b - 4.f * a * c)) / (2.f * a);
+}
+
+void computePunctualLights(
+    const tinygltf::Model &model, std::vector<PunctualLight> &lights)
+{
+  lights.clear();
+  if (model.defaultScene < 0 || model.lights.empty()) {
+    return;
+  }
+
+  // https://github.com/KhronosGroup/glTF/tree/master/extensions/2.0/Khronos/KHR_lights_punctual
+  const auto addLight = [&](const tinygltf::Light &gltfLight,
+                            const glm::mat4 &modelMatrix) {
+    if (gltfLight.type != "point" && gltfLight.type != "spot") {
+      return;
+    }
+    PunctualLight light;
+    light.position = glm::vec3(modelMatrix * glm::vec4(0, 0, 0, 1));
+    light.color = glm::vec3(1);
+    if (gltfLight.color.size() == 3) {
+      light.color = glm::vec3(float(gltfLight.color[0]),
+          float(gltfLight.color[1]), float(gltfLight.color[2]));
+    }
+    light.color *= float(gltfLight.intensity);
+    // Inverse square law
+    light.attenuation = glm::vec3(0, 0, 1);
+    light.range = gltfLight.range > 0.
+                      ? float(gltfLight.range)
+                      : computeLightRange(light.color, light.attenuation);
+    if (gltfLight.type == "spot") {
+      light.isSpot = true;
+      light.direction = glm::normalize(
+          glm::vec3(modelMatrix * glm::vec4(0, 0, -1, 0)));
+      light.innerConeCos = float(glm::cos(gltfLight.spot.innerConeAngle));
+      light.outerConeCos = float(glm::cos(gltfLight.spot.outerConeAngle));
+    }
+    lights.push_back(light);
+  };
+
+  const std::function<void(int, const glm::mat4 &)> addLights =
+      [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+        const auto &node = model.nodes[nodeIdx];
+        const glm::mat4 modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
+        const auto extensionIt = node.extensions.find("KHR_lights_punctual");
+        if (extensionIt != end(node.extensions) &&
+            (*extensionIt).second.Has("light")) {
+          const auto lightIdx =
+              (*extensionIt).second.Get("light").GetNumberAsInt();
+          if (lightIdx >= 0 && size_t(lightIdx) < model.lights.size()) {
+            addLight(model.lights[lightIdx], modelMatrix);
+          }
+        }
+        for (const auto childNodeIdx : node.children) {
+          addLights(childNodeIdx, modelMatrix);
+        }
+      };
+  for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
+    addLights(nodeIdx, glm::mat4(1));
+  }
+}
+
+void estimateModelMemory(
+    const tinygltf::Model &model, size_t &hostBytes, size_t &gpuBytes)
+{
+  hostBytes = 0;
+  gpuBytes = 0;
+  for (const auto &buffer : model.buffers) {
+    hostBytes += buffer.data.size();
+    gpuBytes += buffer.data.size();
+  }
+  for (const auto &image : model.images) {
+    hostBytes += image.image.size();
+    // RGBA texture with its mipmaps, a third more
+    gpuBytes += size_t(image.width) * image.height * 4 * 4 / 3;
+  }
+}
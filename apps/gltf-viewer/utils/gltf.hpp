@@ -3,8 +3,74 @@
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
 
+#include <vector>
+
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix);
 
 void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
+    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
+
+// Bounding box of a primitive in model space, from the min and max of its
+// POSITION accessor. Return false, with an empty box at the origin, if they are
+// absent.
+bool computePrimitiveBounds(const tinygltf::Model &model,
+    const tinygltf::Primitive &primitive, glm::vec3 &bboxMin,
+    glm::vec3 &bboxMax);
+
+// Read an accessor of numComponents components per element into out, as
+// floats. Normalized integer components are converted to [0, 1] or [-1, 1].
+// Return false if the accessor does not have that many components or cannot be
+// converted, throw std::runtime_error if it reads past the end of its buffer.
+bool readFloatAccessor(const tinygltf::Model &model, int accessorIdx,
+    int numComponents, std::vector<float> &out);
+
+// Read an index accessor of any unsigned component type into out. Throw
+// std::runtime_error if it reads past the end of its buffer.
+bool readIndexAccessor(
+    const tinygltf::Model &model, int accessorIdx, std::vector<uint32_t> &out);
+
+// For each mesh of the model, compute the world matrices of all its instances
+// in the default scene: one per node referencing the mesh, or one per entry of
+// the EXT_mesh_gpu_instancing attributes of that node when present.
+void computeMeshInstances(const tinygltf::Model &model,
+    std::vector<std::vector<glm::mat4>> &meshInstances);
+
+// Per-instance vertex attributes of an instanced draw: the world matrix and
+// its normal matrix, computed once per instance instead of once per vertex
+struct InstanceAttributes
+{
+  glm::mat4 modelMatrix;
+  glm::mat3 normalMatrix; // Inverse transpose of the upper 3x3 of modelMatrix
+};
+
+InstanceAttributes computeInstanceAttributes(const glm::mat4 &modelMatrix);
+
+// A point or spot light, in world space unless stated otherwise
+struct PunctualLight
+{
+  glm::vec3 position;
+  glm::vec3 color;       // Color times intensity
+  glm::vec3 attenuation; // Constant, linear and quadratic terms
+  float range;           // Distance where the light is faded out to zero
+  bool isSpot = false;
+  glm::vec3 direction = glm::vec3(0, 0, -1);
+  float innerConeCos = 1.f;
+  float outerConeCos = 0.f;
+};
+
+// Range beyond which a light attenuated by 1 / (constant + linear * d +
+// quadratic * d^2) contributes less than 1/256 of its color
+float computeLightRange(const glm::vec3 &color, const glm::vec3 &attenuation);
+
+// Collect the point and spot lights of KHR_lights_punctual instantiated by the
+// nodes of the default scene. Directional lights are ignored, the viewer has
+// its own.
+void computePunctualLights(
+    const tinygltf::Model &model, std::vector<PunctualLight> &lights);
+
+// Memory of a loaded model: on the host, its buffers and decoded images kept
+// with it; on the GPU, estimated as its buffers uploaded once as vertex and
+// index data and its images as mipmapped RGBA textures
+void estimateModelMemory(
+    const tinygltf::Model &model, size_t &hostBytes, size_t &gpuBytes);
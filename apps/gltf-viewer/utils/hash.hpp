@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+// 64 bits FNV-1a of size bytes. Several values are hashed together by passing
+// the hash of the previous ones as seed.
+inline uint64_t fnv1a64(
+    const void *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+{
+  const auto bytes = static_cast<const uint8_t *>(data);
+  auto hash = seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
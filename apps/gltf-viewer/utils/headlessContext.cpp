@@ -0,0 +1,173 @@
+#include "headlessContext.hpp"
+
+#include <stdexcept>
+
+#ifdef GLMLV_USE_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace {
+
+// Contexts of each display: the display of EGL is shared by the process, and
+// eglTerminate would destroy the contexts of the other threads
+std::mutex displayMutex;
+std::map<EGLDisplay, int> displayContextCounts;
+
+// Whether a space separated list of extensions contains name
+bool hasExtension(const char *extensions, const char *name)
+{
+  if (!extensions) {
+    return false;
+  }
+  const auto length = std::strlen(name);
+  for (auto start = extensions; (start = std::strstr(start, name));
+       start += length) {
+    const bool wordStart = start == extensions || start[-1] == ' ';
+    const bool wordEnd = start[length] == ' ' || start[length] == '\0';
+    if (wordStart && wordEnd) {
+      return true;
+    }
+  }
+  return false;
+}
+
+EGLDisplay initializeDisplay(EGLDisplay display)
+{
+  EGLint major = 0, minor = 0;
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor)) {
+    return display;
+  }
+  return EGL_NO_DISPLAY;
+}
+
+} // namespace
+
+HeadlessContext::HeadlessContext()
+{
+  // The platforms are client extensions, queried without display
+  const auto clientExtensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  EGLDisplay display = EGL_NO_DISPLAY;
+  if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    const auto getPlatformDisplay =
+        PFNEGLGETPLATFORMDISPLAYEXTPROC(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+      display = initializeDisplay(getPlatformDisplay(
+          EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr));
+      m_Description = "EGL surfaceless platform";
+    }
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = initializeDisplay(eglGetDisplay(EGL_DEFAULT_DISPLAY));
+    m_Description = "EGL default display";
+  }
+  if (display == EGL_NO_DISPLAY) {
+    throw std::runtime_error("Unable to initialize an EGL display.");
+  }
+  m_Display = display;
+  {
+    std::lock_guard<std::mutex> lock(displayMutex);
+    ++displayContextCounts[display];
+  }
+  // The destructor is not called when the constructor throws
+  const auto fail = [&](const char *message) {
+    destroy();
+    throw std::runtime_error(message);
+  };
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    fail("EGL display without desktop OpenGL.");
+  }
+
+  // A config is only needed for the pbuffer
+  const auto displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+  const bool surfaceless =
+      hasExtension(displayExtensions, "EGL_KHR_surfaceless_context") &&
+      hasExtension(displayExtensions, "EGL_KHR_no_config_context");
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  if (!surfaceless) {
+    const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE,
+        8, EGL_BLUE_SIZE, 8, EGL_NONE};
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1,
+            &configCount) ||
+        configCount == 0) {
+      fail("No EGL config with pbuffers for OpenGL.");
+    }
+    const EGLint pbufferAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    m_Surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+    if (m_Surface == EGL_NO_SURFACE) {
+      fail("Unable to create an EGL pbuffer.");
+    }
+    m_Description += ", pbuffer";
+  } else {
+    m_Description += ", surfaceless context";
+  }
+
+  // Same context as the window of GLFWHandle
+  const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+      EGL_CONTEXT_MINOR_VERSION_KHR, 3, EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR, EGL_CONTEXT_FLAGS_KHR,
+      EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR, EGL_NONE};
+  m_Context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (m_Context == EGL_NO_CONTEXT) {
+    fail("Unable to create an OpenGL 4.3 EGL context.");
+  }
+  const auto surface = m_Surface ? EGLSurface(m_Surface) : EGL_NO_SURFACE;
+  if (!eglMakeCurrent(display, surface, surface, m_Context)) {
+    fail("Unable to make the EGL context current.");
+  }
+}
+
+HeadlessContext::~HeadlessContext() { destroy(); }
+
+void HeadlessContext::destroy()
+{
+  if (!m_Display) {
+    return;
+  }
+  eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (m_Context) {
+    eglDestroyContext(m_Display, m_Context);
+  }
+  if (m_Surface) {
+    eglDestroySurface(m_Display, m_Surface);
+  }
+  eglReleaseThread();
+  {
+    std::lock_guard<std::mutex> lock(displayMutex);
+    if (!--displayContextCounts[m_Display]) {
+      displayContextCounts.erase(m_Display);
+      eglTerminate(m_Display);
+    }
+  }
+  m_Display = nullptr;
+}
+
+void *HeadlessContext::getProcAddress(const char *name)
+{
+  return reinterpret_cast<void *>(eglGetProcAddress(name));
+}
+
+#else
+
+HeadlessContext::HeadlessContext()
+{
+  throw std::runtime_error("Built without EGL, no headless context.");
+}
+
+HeadlessContext::~HeadlessContext() = default;
+
+void HeadlessContext::destroy() {}
+
+void *HeadlessContext::getProcAddress(const char *) { return nullptr; }
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+// OpenGL 4.3 core context without window nor display server, created with
+// EGL, to render offscreen on machines without X11 or Wayland (render
+// servers, CPU-only CI with Mesa llvmpipe). The context has no default
+// framebuffer: the application renders to its own framebuffer objects.
+//
+// The display comes from EGL_MESA_platform_surfaceless when the EGL client
+// supports it, else from the default display of the EGL implementation. The
+// context is made current without surface when the display supports
+// EGL_KHR_surfaceless_context, else with a 1x1 pbuffer. Several threads can
+// each have their context, the display is terminated with the last one.
+//
+// Only available when built with EGL (GLMLV_USE_EGL, defined by CMake when it
+// finds the library), the constructor throws otherwise.
+class HeadlessContext
+{
+public:
+  // Create the context and make it current, throw std::runtime_error on
+  // failure
+  HeadlessContext();
+  ~HeadlessContext();
+
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+  // Loader of the OpenGL functions, for gladLoadGLLoader. The EGL of Mesa
+  // also returns the core functions (EGL_KHR_get_all_proc_addresses).
+  static void *getProcAddress(const char *name);
+
+  // How the context was created, for the logs
+  const std::string &description() const { return m_Description; }
+
+private:
+  void destroy();
+
+  // EGLDisplay, EGLSurface and EGLContext, not to include EGL in the users
+  void *m_Display = nullptr;
+  void *m_Surface = nullptr; // Pbuffer, null with a surfaceless context
+  void *m_Context = nullptr;
+  std::string m_Description;
+};
@@ -0,0 +1,951 @@
+#include "imageEncoders.hpp"
+
+#include <stb_image_write.h>
+
+#ifdef GLMLV_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const ImageFormat FORMATS[] = {ImageFormat::PNG, ImageFormat::PPM,
+    ImageFormat::PAM, ImageFormat::RGBA, ImageFormat::QOI, ImageFormat::PFM,
+    ImageFormat::EXR};
+
+bool isLittleEndian()
+{
+  const uint32_t one = 1;
+  unsigned char firstByte;
+  std::memcpy(&firstByte, &one, 1);
+  return firstByte == 1;
+}
+
+void appendString(std::vector<unsigned char> &bytes, const std::string &str)
+{
+  bytes.insert(bytes.end(), str.begin(), str.end());
+}
+
+void appendLittleEndian(
+    std::vector<unsigned char> &bytes, uint64_t value, size_t byteCount)
+{
+  for (size_t i = 0; i < byteCount; ++i) {
+    bytes.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+void appendBigEndian(std::vector<unsigned char> &bytes, uint32_t value)
+{
+  for (int i = 3; i >= 0; --i) {
+    bytes.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+// As 32 bits little endian floats
+void appendFloats(
+    std::vector<unsigned char> &bytes, const float *values, size_t count)
+{
+  if (isLittleEndian()) {
+    const auto *first = reinterpret_cast<const unsigned char *>(values);
+    bytes.insert(bytes.end(), first, first + count * sizeof(float));
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, values + i, sizeof(bits));
+    appendLittleEndian(bytes, bits, 4);
+  }
+}
+
+// A row of float pixels, the colors raised to the power gamma
+void decodeRow(const float *source, size_t width, size_t componentCount,
+    float gamma, std::vector<float> &row)
+{
+  row.assign(source, source + width * componentCount);
+  if (gamma == 1.f) {
+    return;
+  }
+  for (size_t x = 0; x < width; ++x) {
+    for (size_t c = 0; c < 3; ++c) {
+      auto &value = row[x * componentCount + c];
+      value = value > 0.f ? std::pow(value, gamma) : 0.f;
+    }
+  }
+}
+
+std::vector<unsigned char> encodePng(const ReadbackImage &image)
+{
+  std::vector<unsigned char> bytes;
+  const auto append = [](void *context, void *data, int size) {
+    auto &bytes = *static_cast<std::vector<unsigned char> *>(context);
+    const auto *first = static_cast<unsigned char *>(data);
+    bytes.insert(bytes.end(), first, first + size);
+  };
+  if (!stbi_write_png_to_func(append, &bytes, image.width, image.height,
+          int(image.componentCount), image.pixels.data(),
+          int(image.width * image.componentCount))) {
+    throw std::runtime_error("PNG encoding failed.");
+  }
+  return bytes;
+}
+
+// P6 for RGB, P7 for RGBA
+void appendNetpbmHeader(std::vector<unsigned char> &bytes, GLsizei width,
+    GLsizei height, size_t componentCount)
+{
+  const auto w = std::to_string(width);
+  const auto h = std::to_string(height);
+  if (componentCount == 3) {
+    appendString(bytes, "P6\n" + w + " " + h + "\n255\n");
+  } else {
+    appendString(bytes, "P7\nWIDTH " + w + "\nHEIGHT " + h +
+                            "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE "
+                            "RGB_ALPHA\nENDHDR\n");
+  }
+}
+
+std::vector<unsigned char> encodeNetpbm(const ReadbackImage &image)
+{
+  std::vector<unsigned char> bytes;
+  bytes.reserve(64 + image.pixels.size());
+  appendNetpbmHeader(bytes, image.width, image.height, image.componentCount);
+  bytes.insert(bytes.end(), image.pixels.begin(), image.pixels.end());
+  return bytes;
+}
+
+void appendRawRgbaHeader(
+    std::vector<unsigned char> &bytes, GLsizei width, GLsizei height)
+{
+  appendString(bytes, "RGBA");
+  appendLittleEndian(bytes, uint32_t(width), 4);
+  appendLittleEndian(bytes, uint32_t(height), 4);
+}
+
+std::vector<unsigned char> encodeRawRgba(const ReadbackImage &image)
+{
+  std::vector<unsigned char> bytes;
+  bytes.reserve(12 + image.pixels.size());
+  appendRawRgbaHeader(bytes, image.width, image.height);
+  bytes.insert(bytes.end(), image.pixels.begin(), image.pixels.end());
+  return bytes;
+}
+
+// https://qoiformat.org/qoi-specification.pdf. The state is kept from call to
+// call, for the rows of ImageStreamWriter.
+class QoiEncoder
+{
+public:
+  // Append the header
+  void begin(std::vector<unsigned char> &bytes, GLsizei width, GLsizei height,
+      size_t componentCount)
+  {
+    appendString(bytes, "qoif");
+    appendBigEndian(bytes, uint32_t(width));
+    appendBigEndian(bytes, uint32_t(height));
+    bytes.push_back((unsigned char)componentCount);
+    bytes.push_back(0); // sRGB colors, linear alpha
+    m_ComponentCount = componentCount;
+    m_RemainingCount = size_t(width) * height;
+    for (auto &pixel : m_Index) {
+      pixel.a = 0;
+    }
+  }
+
+  // Append the next pixels
+  void encode(std::vector<unsigned char> &bytes, const unsigned char *source,
+      size_t pixelCount)
+  {
+    for (size_t i = 0; i < pixelCount; ++i, source += m_ComponentCount) {
+      --m_RemainingCount;
+      Pixel pixel;
+      pixel.r = source[0];
+      pixel.g = source[1];
+      pixel.b = source[2];
+      if (m_ComponentCount == 4) {
+        pixel.a = source[3];
+      }
+
+      if (pixel == m_Previous) {
+        ++m_Run;
+        if (m_Run == 62 || m_RemainingCount == 0) {
+          bytes.push_back(OP_RUN | (m_Run - 1));
+          m_Run = 0;
+        }
+        continue;
+      }
+      if (m_Run) {
+        bytes.push_back(OP_RUN | (m_Run - 1));
+        m_Run = 0;
+      }
+
+      const auto hash =
+          (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+      if (m_Index[hash] == pixel) {
+        bytes.push_back(OP_INDEX | hash);
+      } else if (pixel.a != m_Previous.a) {
+        m_Index[hash] = pixel;
+        bytes.insert(
+            bytes.end(), {OP_RGBA, pixel.r, pixel.g, pixel.b, pixel.a});
+      } else {
+        m_Index[hash] = pixel;
+        // Differences wrap around, as 8 bits signed integers
+        const auto dr = int8_t(pixel.r - m_Previous.r);
+        const auto dg = int8_t(pixel.g - m_Previous.g);
+        const auto db = int8_t(pixel.b - m_Previous.b);
+        const auto drg = dr - dg;
+        const auto dbg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          bytes.push_back(
+              OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+                   dbg >= -8 && dbg <= 7) {
+          bytes.push_back(OP_LUMA | (dg + 32));
+          bytes.push_back((drg + 8) << 4 | (dbg + 8));
+        } else {
+          bytes.insert(bytes.end(), {OP_RGB, pixel.r, pixel.g, pixel.b});
+        }
+      }
+      m_Previous = pixel;
+    }
+  }
+
+  // Append the end marker
+  void end(std::vector<unsigned char> &bytes)
+  {
+    bytes.insert(bytes.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  }
+
+private:
+  static const unsigned char OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80,
+                             OP_RUN = 0xc0, OP_RGB = 0xfe, OP_RGBA = 0xff;
+  struct Pixel
+  {
+    unsigned char r = 0, g = 0, b = 0, a = 255;
+    bool operator==(const Pixel &other) const
+    {
+      return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+  };
+
+  size_t m_ComponentCount = 4;
+  size_t m_RemainingCount = 0;
+  Pixel m_Index[64];
+  Pixel m_Previous;
+  unsigned char m_Run = 0;
+};
+
+std::vector<unsigned char> encodeQoi(const ReadbackImage &image)
+{
+  std::vector<unsigned char> bytes;
+  // Worst case: one OP_RGBA per pixel
+  bytes.reserve(14 + size_t(image.width) * image.height * 5 + 8);
+  QoiEncoder encoder;
+  encoder.begin(bytes, image.width, image.height, image.componentCount);
+  encoder.encode(
+      bytes, image.pixels.data(), size_t(image.width) * image.height);
+  encoder.end(bytes);
+  return bytes;
+}
+
+// Portable float map: RGB, rows from the bottom, negative scale for little
+// endian floats
+void appendPfmHeader(
+    std::vector<unsigned char> &bytes, GLsizei width, GLsizei height)
+{
+  appendString(bytes, "PF\n" + std::to_string(width) + " " +
+                          std::to_string(height) + "\n-1.0\n");
+}
+
+std::vector<unsigned char> encodePfm(const ReadbackImage &image, float gamma)
+{
+  std::vector<unsigned char> bytes;
+  bytes.reserve(64 + image.floatPixels.size() * sizeof(float));
+  appendPfmHeader(bytes, image.width, image.height);
+  const auto width = size_t(image.width);
+  std::vector<float> row;
+  for (GLsizei y = image.height - 1; y >= 0; --y) {
+    decodeRow(image.floatPixels.data() + y * width * 3, width, 3, gamma, row);
+    appendFloats(bytes, row.data(), row.size());
+  }
+  return bytes;
+}
+
+// Uncompressed scanline OpenEXR of 32 bits float channels, see
+// https://openexr.com/en/latest/OpenEXRFileLayout.html
+
+// Channels of the file, sorted by name: A, B, G, R. Index of each in a pixel.
+std::vector<std::pair<std::string, size_t>> exrChannels(size_t componentCount)
+{
+  std::vector<std::pair<std::string, size_t>> channels = {
+      {"B", 2}, {"G", 1}, {"R", 0}};
+  if (componentCount == 4) {
+    channels.insert(channels.begin(), {"A", 3});
+  }
+  return channels;
+}
+
+size_t exrLineSize(GLsizei width, size_t componentCount)
+{
+  return size_t(width) * componentCount * sizeof(float);
+}
+
+// The header, then the offsets of the scanlines in the file
+void appendExrHeader(std::vector<unsigned char> &bytes, GLsizei width,
+    GLsizei height, size_t componentCount)
+{
+  const auto channels = exrChannels(componentCount);
+  appendLittleEndian(bytes, 20000630, 4); // Magic number
+  appendLittleEndian(bytes, 2, 4);        // Version 2, single part scanlines
+
+  const auto attribute = [&](const std::string &name,
+                             const std::string &type, size_t size) {
+    appendString(bytes, name);
+    bytes.push_back(0);
+    appendString(bytes, type);
+    bytes.push_back(0);
+    appendLittleEndian(bytes, size, 4);
+  };
+  attribute("channels", "chlist", channels.size() * 18 + 1);
+  for (const auto &channel : channels) {
+    appendString(bytes, channel.first);
+    bytes.push_back(0);
+    appendLittleEndian(bytes, 2, 4); // FLOAT
+    appendLittleEndian(bytes, 0, 4); // pLinear and reserved
+    appendLittleEndian(bytes, 1, 4); // x and y sampling
+    appendLittleEndian(bytes, 1, 4);
+  }
+  bytes.push_back(0);
+  attribute("compression", "compression", 1);
+  bytes.push_back(0); // NO_COMPRESSION
+  for (const auto name : {"dataWindow", "displayWindow"}) {
+    attribute(name, "box2i", 16);
+    appendLittleEndian(bytes, 0, 4);
+    appendLittleEndian(bytes, 0, 4);
+    appendLittleEndian(bytes, width - 1, 4);
+    appendLittleEndian(bytes, height - 1, 4);
+  }
+  attribute("lineOrder", "lineOrder", 1);
+  bytes.push_back(0); // INCREASING_Y
+  const float one = 1.f, zeros[2] = {0.f, 0.f};
+  attribute("pixelAspectRatio", "float", 4);
+  appendFloats(bytes, &one, 1);
+  attribute("screenWindowCenter", "v2f", 8);
+  appendFloats(bytes, zeros, 2);
+  attribute("screenWindowWidth", "float", 4);
+  appendFloats(bytes, &one, 1);
+  bytes.push_back(0); // End of the header
+
+  // The scanlines have the same size, uncompressed
+  const auto lineSize = exrLineSize(width, componentCount);
+  auto offset = bytes.size() + size_t(height) * 8;
+  for (GLsizei y = 0; y < height; ++y) {
+    appendLittleEndian(bytes, offset, 8);
+    offset += 8 + lineSize;
+  }
+}
+
+// A scanline: y, byte size, then the values of each channel
+void appendExrScanline(std::vector<unsigned char> &bytes, GLsizei y,
+    const float *source, GLsizei width, size_t componentCount, float gamma,
+    std::vector<float> &row, std::vector<float> &channel)
+{
+  appendLittleEndian(bytes, uint32_t(y), 4);
+  appendLittleEndian(bytes, exrLineSize(width, componentCount), 4);
+  decodeRow(source, size_t(width), componentCount, gamma, row);
+  channel.resize(size_t(width));
+  for (const auto &c : exrChannels(componentCount)) {
+    for (size_t x = 0; x < size_t(width); ++x) {
+      channel[x] = row[x * componentCount + c.second];
+    }
+    appendFloats(bytes, channel.data(), channel.size());
+  }
+}
+
+std::vector<unsigned char> encodeExr(const ReadbackImage &image, float gamma)
+{
+  const auto width = size_t(image.width);
+  const auto componentCount = image.componentCount;
+  std::vector<unsigned char> bytes;
+  bytes.reserve(1024 + image.height * (16 + width * componentCount * 4));
+  appendExrHeader(bytes, image.width, image.height, componentCount);
+  std::vector<float> row, channel;
+  for (GLsizei y = 0; y < image.height; ++y) {
+    appendExrScanline(bytes, y,
+        image.floatPixels.data() + y * width * componentCount, image.width,
+        componentCount, gamma, row, channel);
+  }
+  return bytes;
+}
+
+// CRC of the PNG chunks
+uint32_t crc32(uint32_t crc, const unsigned char *data, size_t size)
+{
+  static const auto table = []() {
+    std::vector<uint32_t> table(256);
+    for (uint32_t i = 0; i < 256; ++i) {
+      auto value = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+      }
+      table[i] = value;
+    }
+    return table;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+// Filter a PNG row with each filter, keep the one with the smallest sum of
+// absolute values, as libpng and stb_image_write do. filtered gets the filter
+// type then the filtered bytes.
+void filterPngRow(const unsigned char *row, const unsigned char *previousRow,
+    size_t size, size_t pixelSize, std::vector<unsigned char> &filtered)
+{
+  const auto paeth = [](int a, int b, int c) {
+    const auto p = a + b - c;
+    const auto pa = std::abs(p - a), pb = std::abs(p - b),
+               pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+  };
+  std::vector<unsigned char> candidate(1 + size);
+  size_t bestSum = std::numeric_limits<size_t>::max();
+  for (unsigned char type = 0; type < 5; ++type) {
+    candidate[0] = type;
+    size_t sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+      const int left = i >= pixelSize ? row[i - pixelSize] : 0;
+      const int up = previousRow[i];
+      const int upLeft = i >= pixelSize ? previousRow[i - pixelSize] : 0;
+      int prediction = 0;
+      switch (type) {
+      case 1:
+        prediction = left;
+        break;
+      case 2:
+        prediction = up;
+        break;
+      case 3:
+        prediction = (left + up) / 2;
+        break;
+      case 4:
+        prediction = paeth(left, up, upLeft);
+        break;
+      }
+      const auto value = (unsigned char)(row[i] - prediction);
+      candidate[1 + i] = value;
+      sum += std::abs(int(int8_t(value)));
+    }
+    if (sum < bestSum) {
+      bestSum = sum;
+      filtered.swap(candidate);
+      candidate.resize(1 + size);
+    }
+  }
+}
+
+// The zlib stream of the PNG rows
+struct Deflater
+{
+#ifdef GLMLV_USE_ZLIB
+  z_stream stream = {};
+
+  explicit Deflater(int level)
+  {
+    if (deflateInit(&stream, std::min(std::max(level, 0), 9)) != Z_OK) {
+      throw std::runtime_error("Unable to initialize zlib.");
+    }
+  }
+  ~Deflater() { deflateEnd(&stream); }
+
+  void append(const unsigned char *data, size_t size,
+      std::vector<unsigned char> &bytes, int flush = Z_NO_FLUSH)
+  {
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = uInt(size);
+    unsigned char buffer[16384];
+    do {
+      stream.next_out = buffer;
+      stream.avail_out = sizeof(buffer);
+      deflate(&stream, flush);
+      bytes.insert(
+          bytes.end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+    } while (stream.avail_out == 0);
+  }
+
+  void finish(std::vector<unsigned char> &bytes)
+  {
+    append(nullptr, 0, bytes, Z_FINISH);
+  }
+#else
+  // Without zlib, stored blocks of at most 65535 bytes, not compressed
+  std::vector<unsigned char> block;
+  uint32_t adlerA = 1, adlerB = 0;
+  bool started = false;
+
+  explicit Deflater(int) {}
+
+  void append(const unsigned char *data, size_t size,
+      std::vector<unsigned char> &bytes)
+  {
+    if (!started) {
+      bytes.insert(bytes.end(), {0x78, 0x01}); // Header of the zlib stream
+      started = true;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      adlerA = (adlerA + data[i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+      block.push_back(data[i]);
+      if (block.size() == 65535) {
+        storeBlock(false, bytes);
+      }
+    }
+  }
+
+  void finish(std::vector<unsigned char> &bytes)
+  {
+    append(nullptr, 0, bytes); // For the header of an empty stream
+    storeBlock(true, bytes);
+    appendBigEndian(bytes, adlerB << 16 | adlerA);
+  }
+
+  void storeBlock(bool last, std::vector<unsigned char> &bytes)
+  {
+    const auto size = uint16_t(block.size());
+    bytes.push_back(last ? 1 : 0);
+    appendLittleEndian(bytes, size, 2);
+    appendLittleEndian(bytes, uint16_t(~size), 2);
+    bytes.insert(bytes.end(), block.begin(), block.end());
+    block.clear();
+  }
+#endif
+};
+
+void appendPngChunk(std::vector<unsigned char> &bytes, const char *type,
+    const std::vector<unsigned char> &data)
+{
+  const auto start = bytes.size();
+  appendBigEndian(bytes, uint32_t(data.size()));
+  appendString(bytes, type);
+  bytes.insert(bytes.end(), data.begin(), data.end());
+  // Of the type and the data
+  appendBigEndian(
+      bytes, crc32(0, bytes.data() + start + 4, bytes.size() - start - 4));
+}
+
+void writeFile(const fs::path &path, const std::vector<unsigned char> &bytes)
+{
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  if (!file) {
+    throw std::runtime_error("Unable to write " + path.string());
+  }
+}
+
+// 8 bits pixels of componentCount components from float RGBA pixels,
+// converted as OpenGL does
+ReadbackImage toBytes(const ReadbackImage &image, size_t componentCount)
+{
+  ReadbackImage bytes(image.width, image.height, componentCount);
+  const auto pixelCount = size_t(image.width) * image.height;
+  bytes.pixels.resize(pixelCount * componentCount);
+  for (size_t i = 0; i < pixelCount; ++i) {
+    for (size_t c = 0; c < componentCount; ++c) {
+      const auto value =
+          std::min(std::max(image.floatPixels[4 * i + c], 0.f), 1.f);
+      bytes.pixels[i * componentCount + c] =
+          (unsigned char)(value * 255.f + 0.5f);
+    }
+  }
+  return bytes;
+}
+
+} // namespace
+
+ImageFormat imageFormatFromPath(const fs::path &path)
+{
+  auto extension = path.extension().string();
+  std::transform(
+      extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return char(std::tolower(static_cast<unsigned char>(c)));
+      });
+  std::string names;
+  for (const auto format : FORMATS) {
+    const auto name = std::string(".") + imageFormatName(format);
+    if (extension == name) {
+      return format;
+    }
+    names += (names.empty() ? "" : ", ") + name;
+  }
+  throw std::runtime_error("Unknown image format \"" + extension +
+                           "\" (expected " + names + ")");
+}
+
+const char *imageFormatName(ImageFormat format)
+{
+  switch (format) {
+  case ImageFormat::PNG:
+    return "png";
+  case ImageFormat::PPM:
+    return "ppm";
+  case ImageFormat::PAM:
+    return "pam";
+  case ImageFormat::RGBA:
+    return "rgba";
+  case ImageFormat::QOI:
+    return "qoi";
+  case ImageFormat::PFM:
+    return "pfm";
+  case ImageFormat::EXR:
+    return "exr";
+  }
+  return "";
+}
+
+size_t imageFormatComponentCount(ImageFormat format)
+{
+  switch (format) {
+  case ImageFormat::PNG:
+  case ImageFormat::PPM:
+  case ImageFormat::PFM:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+bool imageFormatIsFloat(ImageFormat format)
+{
+  return format == ImageFormat::PFM || format == ImageFormat::EXR;
+}
+
+void setPngCompressionLevel(int level)
+{
+  stbi_write_png_compression_level = level;
+}
+
+int pngCompressionLevel() { return stbi_write_png_compression_level; }
+
+std::vector<unsigned char> encodeImage(
+    const ReadbackImage &image, ImageFormat format, float gamma)
+{
+  switch (format) {
+  case ImageFormat::PNG:
+    return encodePng(image);
+  case ImageFormat::PPM:
+  case ImageFormat::PAM:
+    return encodeNetpbm(image);
+  case ImageFormat::RGBA:
+    return encodeRawRgba(image);
+  case ImageFormat::QOI:
+    return encodeQoi(image);
+  case ImageFormat::PFM:
+    return encodePfm(image, gamma);
+  case ImageFormat::EXR:
+    return encodeExr(image, gamma);
+  }
+  return {};
+}
+
+void writeImage(const fs::path &path, const ReadbackImage &image,
+    ImageFormat format, float gamma)
+{
+  writeFile(path, encodeImage(image, format, gamma));
+}
+
+std::vector<unsigned char> encodePng16(GLsizei width, GLsizei height,
+    size_t componentCount, const std::vector<uint16_t> &values)
+{
+  std::vector<unsigned char> bytes;
+  appendString(bytes, "\x89PNG\r\n\x1a\n");
+  std::vector<unsigned char> header;
+  appendBigEndian(header, uint32_t(width));
+  appendBigEndian(header, uint32_t(height));
+  // 16 bits gray, gray and alpha, RGB or RGBA, deflate, adaptive filters, not
+  // interlaced
+  static const unsigned char colorTypes[] = {0, 4, 2, 6};
+  header.insert(header.end(), {16, colorTypes[componentCount - 1], 0, 0, 0});
+  appendPngChunk(bytes, "IHDR", header);
+
+  // The samples are big endian, the filters work on their bytes
+  const auto rowSize = size_t(width) * componentCount * 2;
+  std::vector<unsigned char> row(rowSize), previousRow(rowSize, 0), filtered,
+      data;
+  Deflater deflater{pngCompressionLevel()};
+  for (GLsizei y = 0; y < height; ++y) {
+    const auto *source = values.data() + y * size_t(width) * componentCount;
+    for (size_t i = 0; i < rowSize / 2; ++i) {
+      row[2 * i] = (unsigned char)(source[i] >> 8);
+      row[2 * i + 1] = (unsigned char)(source[i] & 0xff);
+    }
+    filterPngRow(row.data(), previousRow.data(), rowSize, componentCount * 2,
+        filtered);
+    deflater.append(filtered.data(), filtered.size(), data);
+    row.swap(previousRow);
+  }
+  deflater.finish(data);
+  appendPngChunk(bytes, "IDAT", data);
+  appendPngChunk(bytes, "IEND", {});
+  return bytes;
+}
+
+void writePng16(const fs::path &path, GLsizei width, GLsizei height,
+    size_t componentCount, const std::vector<uint16_t> &values)
+{
+  writeFile(path, encodePng16(width, height, componentCount, values));
+}
+
+struct ImageStreamWriter::DeflateState : Deflater
+{
+  using Deflater::Deflater;
+};
+
+struct ImageStreamWriter::QoiState : QoiEncoder
+{
+};
+
+ImageStreamWriter::ImageStreamWriter(const fs::path &path, ImageFormat format,
+    GLsizei width, GLsizei height, float gamma) :
+    m_Path(path),
+    m_Format(format),
+    m_Width(width),
+    m_Height(height),
+    m_Gamma(gamma),
+    m_File(path, std::ios::binary)
+{
+  if (!m_File) {
+    throw std::runtime_error("Unable to create " + path.string());
+  }
+  const auto componentCount = imageFormatComponentCount(format);
+  switch (format) {
+  case ImageFormat::PNG: {
+    appendString(m_Bytes, "\x89PNG\r\n\x1a\n");
+    std::vector<unsigned char> header;
+    appendBigEndian(header, uint32_t(width));
+    appendBigEndian(header, uint32_t(height));
+    // 8 bits RGB or RGBA, deflate, adaptive filters, not interlaced
+    const unsigned char colorType = componentCount == 4 ? 6 : 2;
+    header.insert(header.end(), {8, colorType, 0, 0, 0});
+    flushBytes();
+    writePngChunk("IHDR", header);
+    m_PreviousRow.assign(size_t(width) * componentCount, 0);
+    m_Deflate = std::make_unique<DeflateState>(pngCompressionLevel());
+    break;
+  }
+  case ImageFormat::PPM:
+  case ImageFormat::PAM:
+    appendNetpbmHeader(m_Bytes, width, height, componentCount);
+    break;
+  case ImageFormat::RGBA:
+    appendRawRgbaHeader(m_Bytes, width, height);
+    break;
+  case ImageFormat::QOI:
+    m_Qoi = std::make_unique<QoiState>();
+    m_Qoi->begin(m_Bytes, width, height, componentCount);
+    break;
+  case ImageFormat::PFM:
+    appendPfmHeader(m_Bytes, width, height);
+    break;
+  case ImageFormat::EXR:
+    appendExrHeader(m_Bytes, width, height, componentCount);
+    break;
+  }
+  m_HeaderSize = m_Bytes.size();
+  flushBytes();
+}
+
+ImageStreamWriter::~ImageStreamWriter() = default;
+
+void ImageStreamWriter::write(const ReadbackImage &strip)
+{
+  const auto componentCount = imageFormatComponentCount(m_Format);
+  if (strip.width != m_Width || strip.componentCount != componentCount ||
+      m_RowCount + strip.height > m_Height) {
+    throw std::runtime_error(
+        "Rows of the wrong size for " + m_Path.string());
+  }
+  const auto width = size_t(m_Width);
+  switch (m_Format) {
+  case ImageFormat::PNG:
+    writePngRows(strip);
+    break;
+  case ImageFormat::PPM:
+  case ImageFormat::PAM:
+  case ImageFormat::RGBA:
+    m_File.write(reinterpret_cast<const char *>(strip.pixels.data()),
+        strip.pixels.size());
+    break;
+  case ImageFormat::QOI:
+    m_Qoi->encode(
+        m_Bytes, strip.pixels.data(), width * size_t(strip.height));
+    flushBytes();
+    break;
+  case ImageFormat::PFM: {
+    // Each row at its place from the end of the file
+    std::vector<float> row;
+    const auto rowSize = width * 3 * sizeof(float);
+    for (GLsizei y = 0; y < strip.height; ++y) {
+      decodeRow(strip.floatPixels.data() + y * width * 3, width, 3, m_Gamma,
+          row);
+      appendFloats(m_Bytes, row.data(), row.size());
+      m_File.seekp(std::streamoff(m_HeaderSize +
+                                  (m_Height - 1 - m_RowCount - y) * rowSize));
+      flushBytes();
+    }
+    break;
+  }
+  case ImageFormat::EXR: {
+    std::vector<float> row, channel;
+    for (GLsizei y = 0; y < strip.height; ++y) {
+      appendExrScanline(m_Bytes, m_RowCount + y,
+          strip.floatPixels.data() + y * width * componentCount, m_Width,
+          componentCount, m_Gamma, row, channel);
+    }
+    flushBytes();
+    break;
+  }
+  }
+  m_RowCount += strip.height;
+  if (!m_File) {
+    throw std::runtime_error("Unable to write " + m_Path.string());
+  }
+}
+
+void ImageStreamWriter::close()
+{
+  if (m_RowCount != m_Height) {
+    throw std::runtime_error("Missing rows in " + m_Path.string());
+  }
+  if (m_Format == ImageFormat::PNG) {
+    m_Deflate->finish(m_Bytes);
+    const auto data = std::move(m_Bytes);
+    m_Bytes.clear();
+    writePngChunk("IDAT", data);
+    writePngChunk("IEND", {});
+  } else if (m_Format == ImageFormat::QOI) {
+    m_Qoi->end(m_Bytes);
+    flushBytes();
+  }
+  m_File.close();
+  if (!m_File) {
+    throw std::runtime_error("Unable to write " + m_Path.string());
+  }
+}
+
+void ImageStreamWriter::flushBytes()
+{
+  m_File.write(reinterpret_cast<const char *>(m_Bytes.data()), m_Bytes.size());
+  m_Bytes.clear();
+}
+
+void ImageStreamWriter::writePngChunk(
+    const char *type, const std::vector<unsigned char> &data)
+{
+  std::vector<unsigned char> chunk;
+  appendPngChunk(chunk, type, data);
+  m_File.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+}
+
+void ImageStreamWriter::writePngRows(const ReadbackImage &strip)
+{
+  const auto rowSize = m_PreviousRow.size();
+  std::vector<unsigned char> filtered;
+  for (GLsizei y = 0; y < strip.height; ++y) {
+    const auto *row = strip.pixels.data() + y * rowSize;
+    filterPngRow(
+        row, m_PreviousRow.data(), rowSize, strip.componentCount, filtered);
+    m_Deflate->append(filtered.data(), filtered.size(), m_Bytes);
+    std::copy(row, row + rowSize, m_PreviousRow.begin());
+  }
+  // One IDAT chunk per strip, once the deflater has output something
+  if (!m_Bytes.empty()) {
+    const auto data = std::move(m_Bytes);
+    m_Bytes.clear();
+    writePngChunk("IDAT", data);
+  }
+}
+
+std::string benchmarkImageEncoders(
+    const ReadbackImage &image, size_t threadCount, float gamma)
+{
+  using clock = std::chrono::steady_clock;
+  const auto secondsSince = [](clock::time_point start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+  const auto megapixels = image.width * image.height * 1e-6;
+
+  std::ostringstream report;
+  report << "Encoding a " << image.width << "x" << image.height
+         << " image, PNG at level " << pngCompressionLevel() << "\n"
+         << "Format  Size (KB)  Time (ms)  MPixels/s  Images/s ("
+         << threadCount << (threadCount == 1 ? " thread)\n" : " threads)\n")
+         << std::fixed << std::setprecision(1);
+  for (const auto format : FORMATS) {
+    const auto componentCount = imageFormatComponentCount(format);
+    ReadbackImage input;
+    if (imageFormatIsFloat(format)) {
+      input = ReadbackImage(image.width, image.height, componentCount);
+      if (componentCount == 4) {
+        input.floatPixels = image.floatPixels;
+      } else {
+        for (size_t i = 0; i < image.floatPixels.size(); i += 4) {
+          input.floatPixels.insert(input.floatPixels.end(),
+              image.floatPixels.begin() + i,
+              image.floatPixels.begin() + i + 3);
+        }
+      }
+    } else {
+      input = toBytes(image, componentCount);
+    }
+
+    // At least 3 encodes and half a second on one thread, after a first one
+    // warming up the caches
+    auto size = encodeImage(input, format, gamma).size();
+    size_t encodeCount = 0;
+    auto start = clock::now();
+    while (encodeCount < 3 || secondsSince(start) < 0.5) {
+      size = encodeImage(input, format, gamma).size();
+      ++encodeCount;
+    }
+    const auto encodeTime = secondsSince(start) / encodeCount;
+
+    // As many images on each thread
+    start = clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+      threads.emplace_back([&]() {
+        for (size_t j = 0; j < encodeCount; ++j) {
+          encodeImage(input, format, gamma);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    const auto imagesPerSecond =
+        threadCount * encodeCount / secondsSince(start);
+
+    report << std::left << std::setw(6) << imageFormatName(format)
+           << std::right << std::setw(11) << size / 1024.
+           << std::setw(11) << encodeTime * 1000 << std::setw(11)
+           << megapixels / encodeTime << std::setw(12) << imagesPerSecond
+           << '\n';
+  }
+  return report.str();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "readbackPipeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// File formats of the output images, chosen from the extension of the path
+enum class ImageFormat
+{
+  PNG,  // .png: RGB, deflate at the level of setPngCompressionLevel
+  PPM,  // .ppm: binary RGB (P6), uncompressed
+  PAM,  // .pam: RGBA (P7), uncompressed
+  RGBA, // .rgba: raw RGBA after a 12 bytes header, see encodeImage
+  QOI,  // .qoi: RGBA, "Quite OK Image" lossless compression
+  PFM,  // .pfm: linear float RGB, uncompressed
+  EXR,  // .exr: linear float RGBA, uncompressed OpenEXR scanlines
+};
+
+// Throw std::runtime_error if the extension is none of the formats
+ImageFormat imageFormatFromPath(const fs::path &path);
+
+// Extension of a format, without the dot
+const char *imageFormatName(ImageFormat format);
+// Components of the images encoded to a format: 3 (RGB) or 4 (RGBA)
+size_t imageFormatComponentCount(ImageFormat format);
+// Whether a format encodes ReadbackImage::floatPixels instead of pixels
+bool imageFormatIsFloat(ImageFormat format);
+
+// Deflate level of the PNG encoder, from 0 (stored) to 9, for all the
+// threads: set it before they start encoding. With zlib (GLMLV_USE_ZLIB) the
+// levels are those of zlib, the fallback deflate of stb_image_write uses 5 for
+// the levels below.
+void setPngCompressionLevel(int level);
+int pngCompressionLevel();
+
+// Encode an image, of imageFormatComponentCount(format) components, to the
+// bytes of a file. Thread safe.
+//
+// The float formats store linear values: the float pixels are raised to the
+// power gamma, to decode colors the renderer encoded with that gamma.
+//
+// The raw RGBA format is the magic "RGBA", then the width and the height as
+// 32 bits little endian integers, then the pixels row by row from the top.
+std::vector<unsigned char> encodeImage(
+    const ReadbackImage &image, ImageFormat format, float gamma = 1.f);
+
+// Encode then write an image, throw std::runtime_error if it fails
+void writeImage(const fs::path &path, const ReadbackImage &image,
+    ImageFormat format, float gamma = 1.f);
+
+// Encode 16 bits samples to a PNG, of 1 (gray), 2 (gray and alpha), 3 (RGB)
+// or 4 (RGBA) components, for the values that 8 bits cannot hold: the depth,
+// normals and identifiers of the auxiliary buffers. The samples are row by row
+// from the top. Deflated as the streamed PNG are, see ImageStreamWriter.
+std::vector<unsigned char> encodePng16(GLsizei width, GLsizei height,
+    size_t componentCount, const std::vector<uint16_t> &values);
+// Throw std::runtime_error if the write fails
+void writePng16(const fs::path &path, GLsizei width, GLsizei height,
+    size_t componentCount, const std::vector<uint16_t> &values);
+
+// Write an image to a file strip by strip, the rows from the top, without
+// holding the whole image: for the tiled rendering of images too large for
+// the memory. Only the current strip and a row are kept.
+//
+// The files are the ones of writeImage, except for PNG: the rows are filtered
+// and deflated as a stream, by zlib with GLMLV_USE_ZLIB, else stored without
+// compression. PFM rows go from the bottom, the file is written backwards.
+class ImageStreamWriter
+{
+public:
+  // Throw std::runtime_error if the file cannot be created
+  ImageStreamWriter(const fs::path &path, ImageFormat format, GLsizei width,
+      GLsizei height, float gamma = 1.f);
+  ~ImageStreamWriter();
+
+  ImageStreamWriter(const ImageStreamWriter &) = delete;
+  ImageStreamWriter &operator=(const ImageStreamWriter &) = delete;
+
+  // The next rows of the image, of its width and of
+  // imageFormatComponentCount(format) components. Throw std::runtime_error if
+  // the write fails.
+  void write(const ReadbackImage &strip);
+  // Finish the file once all the rows are written, throw std::runtime_error
+  // if they are not or if the write fails
+  void close();
+
+private:
+  struct QoiState;
+  struct DeflateState;
+
+  // Write m_Bytes to the file and clear it
+  void flushBytes();
+  void writePngChunk(const char *type, const std::vector<unsigned char> &data);
+  void writePngRows(const ReadbackImage &strip);
+
+  fs::path m_Path;
+  ImageFormat m_Format;
+  GLsizei m_Width;
+  GLsizei m_Height;
+  float m_Gamma;
+  std::ofstream m_File;
+  size_t m_HeaderSize = 0;
+  GLsizei m_RowCount = 0; // Written so far
+  std::vector<unsigned char> m_Bytes;
+  std::vector<unsigned char> m_PreviousRow; // Of the PNG filters
+  std::unique_ptr<QoiState> m_Qoi;
+  std::unique_ptr<DeflateState> m_Deflate;
+};
+
+// Time the encoders of all the formats on an image of float RGBA pixels,
+// converted to 8 bits for the other formats: on one thread, then on
+// threadCount threads encoding different images at once. Return the report.
+std::string benchmarkImageEncoders(
+    const ReadbackImage &image, size_t threadCount, float gamma = 1.f);
@@ -1,65 +1,138 @@
 #include "images.hpp"
 
+#include <algorithm>
 #include <cassert>
-#include <glad/glad.h>
 #include <iostream>
 
-void renderToImage(size_t width, size_t height, size_t numComponents,
-    unsigned char *outPixels, std::function<void()> drawScene)
+ImageFramebuffer::~ImageFramebuffer()
 {
+  glDeleteFramebuffers(1, &m_Framebuffer);
+  glDeleteTextures(1, &m_ColorTexture);
+  glDeleteTextures(1, &m_DepthTexture);
+  glDeleteFramebuffers(1, &m_MultisampleFramebuffer);
+  glDeleteTextures(1, &m_MultisampleColorTexture);
+}
+
+void ImageFramebuffer::resize(
+    GLsizei width, GLsizei height, GLenum colorFormat, GLsizei sampleCount)
+{
+  sampleCount = std::max(sampleCount, 1);
+  if (width == m_Width && height == m_Height &&
+      colorFormat == m_ColorFormat && sampleCount == m_SampleCount) {
+    return;
+  }
+  m_Width = width;
+  m_Height = height;
+  m_ColorFormat = colorFormat;
+  m_SampleCount = sampleCount;
+
   GLint previousTextureObject = 0;
   GLint previousFramebufferObject = 0;
-
-  // Save previous GL state that we will change in order to put it back after
   glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
 
-  GLuint textureObject = 0;
-
-  glGenTextures(1, &textureObject);
-
-  glBindTexture(GL_TEXTURE_2D, textureObject);
-
-  // Lets avoid warnings
-  const auto w = GLsizei(width);
-  const auto h = GLsizei(height);
-
-  // if we want better quality, we can use multisampling, but for testing
-  // purpose it is useless todo replace with glTexStorage2DMultisample (in that
-  // case need to todo glBlitFramebuffer in another one in order to be able to
-  // glGetTexImage)
-  // https://stackoverflow.com/questions/14019910/how-does-glteximage2dmultisample-work
-  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, w, h);
-
-  GLuint depthTexture;
+  // Storage of glTexStorage2D is immutable, the textures are created again
+  glDeleteTextures(1, &m_ColorTexture);
+  glDeleteTextures(1, &m_DepthTexture);
+  glDeleteTextures(1, &m_MultisampleColorTexture);
+  m_DepthTexture = 0;
+  m_MultisampleColorTexture = 0;
+
+  glGenTextures(1, &m_ColorTexture);
+  glBindTexture(GL_TEXTURE_2D, m_ColorTexture);
+  // The format of the pixels of the images: read back without conversion
+  glTexStorage2D(GL_TEXTURE_2D, 1, colorFormat, width, height);
+
+  // The depth is only needed where the scene is drawn: in the multisampled
+  // textures with multisampling, resolved to the color texture with
+  // glBlitFramebuffer for the readback
+  GLuint depthTexture = 0;
   glGenTextures(1, &depthTexture);
-
-  glBindTexture(GL_TEXTURE_2D, depthTexture);
-
-  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, w, h);
+  if (sampleCount > 1) {
+    glGenTextures(1, &m_MultisampleColorTexture);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, m_MultisampleColorTexture);
+    glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, sampleCount,
+        colorFormat, width, height, GL_TRUE);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, depthTexture);
+    glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, sampleCount,
+        GL_DEPTH_COMPONENT32F, width, height, GL_TRUE);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+  } else {
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+  }
+  m_DepthTexture = depthTexture;
 
   glBindTexture(GL_TEXTURE_2D, previousTextureObject);
 
-  GLuint framebufferObject = 0;
-  glGenFramebuffers(1, &framebufferObject);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferObject);
+  const auto attach = [](GLuint &framebuffer, GLuint colorTexture,
+                          GLuint depthTexture) {
+    if (!framebuffer) {
+      glGenFramebuffers(1, &framebuffer);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+
+    GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, drawBuffers);
+
+    const auto framebufferStatus =
+        glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+    assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+    (void)framebufferStatus;
+  };
+  if (sampleCount > 1) {
+    attach(m_MultisampleFramebuffer, m_MultisampleColorTexture, depthTexture);
+    attach(m_Framebuffer, m_ColorTexture, 0);
+  } else {
+    attach(m_Framebuffer, m_ColorTexture, depthTexture);
+  }
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
+}
 
-  glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureObject, 0);
-  glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+void ImageFramebuffer::resolve()
+{
+  if (m_SampleCount <= 1) {
+    return;
+  }
+  GLint previousReadFramebuffer = 0;
+  GLint previousDrawFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_MultisampleFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+  // Same size: the samples of each pixel are averaged
+  glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, m_Width, m_Height,
+      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFramebuffer);
+}
+
+void renderToImage(ImageFramebuffer &framebuffer, size_t width, size_t height,
+    size_t numComponents, unsigned char *outPixels,
+    std::function<void()> drawScene)
+{
+  GLint previousTextureObject = 0;
+  GLint previousFramebufferObject = 0;
 
-  GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-  glDrawBuffers(1, drawBuffers);
+  // Save previous GL state that we will change in order to put it back after
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
 
-  const auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  framebuffer.resize(GLsizei(width), GLsizei(height));
+  const auto framebufferObject = framebuffer.framebuffer();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferObject);
 
   drawScene();
+  framebuffer.resolve();
 
   GLint currentlyBoundFBO = 0;
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentlyBoundFBO);
-  if (currentlyBoundFBO != framebufferObject) {
+  if (GLuint(currentlyBoundFBO) != framebufferObject) {
     // Display a warning on clog
     // It may not be an error because the drawScene() function might have render
     // to the framebuffer but unbound it after.
@@ -69,10 +142,23 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
         << std::endl;
   }
 
-  glBindTexture(GL_TEXTURE_2D, textureObject);
+  // Rows of outPixels are tightly packed, whatever the width
+  GLint previousPackAlignment = 4;
+  glGetIntegerv(GL_PACK_ALIGNMENT, &previousPackAlignment);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindTexture(GL_TEXTURE_2D, framebuffer.colorTexture());
   glGetTexImage(GL_TEXTURE_2D, 0, numComponents == 3 ? GL_RGB : GL_RGBA,
       GL_UNSIGNED_BYTE, outPixels);
+  glPixelStorei(GL_PACK_ALIGNMENT, previousPackAlignment);
 
   glBindTexture(GL_TEXTURE_2D, previousTextureObject);
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
-}
\ No newline at end of file
+}
+
+void renderToImage(size_t width, size_t height, size_t numComponents,
+    unsigned char *outPixels, std::function<void()> drawScene)
+{
+  ImageFramebuffer framebuffer;
+  renderToImage(framebuffer, width, height, numComponents, outPixels,
+      std::move(drawScene));
+}
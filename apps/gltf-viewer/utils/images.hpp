@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glad/glad.h>
+
 #include <functional>
 
 template <typename ComponentType>
@@ -17,6 +19,56 @@ void flipImageYAxis(
   }
 }
 
+// Offscreen framebuffer of renderToImage: a color texture, GL_RGBA8 for the
+// 8 bits images or GL_RGBA32F for the float ones, and a depth texture. Keep
+// one to render several images without allocating it again for each, it is
+// only reallocated when the size, the format or the samples of the images
+// change.
+//
+// With several samples per pixel, the scene is drawn in multisampled color
+// and depth textures, then resolve() averages the samples in the color
+// texture, to be read back.
+class ImageFramebuffer
+{
+public:
+  ImageFramebuffer() = default;
+  ~ImageFramebuffer();
+
+  ImageFramebuffer(const ImageFramebuffer &) = delete;
+  ImageFramebuffer &operator=(const ImageFramebuffer &) = delete;
+
+  // Allocate the textures for width x height pixels, does nothing if they
+  // already have that size, format and sample count
+  void resize(GLsizei width, GLsizei height, GLenum colorFormat = GL_RGBA8,
+      GLsizei sampleCount = 1);
+  // Resolve the multisampled textures to colorTexture(), after drawing.
+  // Nothing to do with one sample.
+  void resolve();
+
+  // To draw the scene into
+  GLuint framebuffer() const
+  {
+    return m_SampleCount > 1 ? m_MultisampleFramebuffer : m_Framebuffer;
+  }
+  GLuint colorTexture() const { return m_ColorTexture; }
+  GLsizei sampleCount() const { return m_SampleCount; }
+
+private:
+  GLuint m_Framebuffer = 0;
+  GLuint m_ColorTexture = 0;
+  GLuint m_DepthTexture = 0;
+  GLuint m_MultisampleFramebuffer = 0;
+  GLuint m_MultisampleColorTexture = 0;
+  GLsizei m_Width = 0;
+  GLsizei m_Height = 0;
+  GLenum m_ColorFormat = GL_NONE;
+  GLsizei m_SampleCount = 1;
+};
+
+void renderToImage(ImageFramebuffer &framebuffer, size_t width, size_t height,
+    size_t numComponents, unsigned char *outPixels,
+    std::function<void()> drawScene);
+// With a framebuffer for this image only
 void renderToImage(size_t width, size_t height, size_t numComponents,
     unsigned char *outPixels, std::function<void()> drawScene);
 // Setup GL state in order to render in texture, call drawScene() then get the
@@ -0,0 +1,51 @@
+#include "latencyHistogram.hpp"
+
+#include <algorithm>
+#include <limits>
+
+LatencyHistogram::LatencyHistogram()
+{
+  // 1 ms to 100 s
+  for (double decade = 1.; decade <= 1e5; decade *= 10.) {
+    for (const auto step : {1., 2., 5.}) {
+      if (decade * step <= 1e5) {
+        m_Bounds.push_back(decade * step);
+      }
+    }
+  }
+  m_Bounds.push_back(std::numeric_limits<double>::infinity());
+  m_Counts.resize(m_Bounds.size(), 0);
+}
+
+void LatencyHistogram::add(double milliseconds)
+{
+  const auto bucket =
+      std::lower_bound(m_Bounds.begin(), m_Bounds.end(), milliseconds) -
+      m_Bounds.begin();
+  ++m_Counts[bucket];
+  ++m_Count;
+  m_Sum += milliseconds;
+  m_Max = std::max(m_Max, milliseconds);
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+  if (!m_Count) {
+    return 0.;
+  }
+  // Rank of the sample, from 1
+  const auto rank = std::max(size_t(1), size_t(p * m_Count + 0.5));
+  size_t count = 0;
+  for (size_t i = 0; i < m_Counts.size(); ++i) {
+    count += m_Counts[i];
+    if (count >= rank) {
+      return std::min(m_Bounds[i], m_Max);
+    }
+  }
+  return m_Max;
+}
+
+double LatencyHistogram::bucketBound(size_t bucket) const
+{
+  return m_Bounds[bucket];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Histogram of latencies in milliseconds, in buckets of bounds 1, 2, 5, 10,
+// 20, 50, ... ms: constant memory however many samples are added. The
+// percentiles are the upper bounds of their buckets, capped to the maximum.
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void add(double milliseconds);
+
+  size_t count() const { return m_Count; }
+  double mean() const { return m_Count ? m_Sum / m_Count : 0.; }
+  double max() const { return m_Max; }
+  // p in [0, 1]
+  double percentile(double p) const;
+
+  // The last bucket has an infinite bound
+  size_t bucketCount() const { return m_Counts.size(); }
+  double bucketBound(size_t bucket) const;
+  size_t bucketSampleCount(size_t bucket) const { return m_Counts[bucket]; }
+
+private:
+  std::vector<double> m_Bounds;
+  std::vector<size_t> m_Counts;
+  size_t m_Count = 0;
+  double m_Sum = 0;
+  double m_Max = 0;
+};
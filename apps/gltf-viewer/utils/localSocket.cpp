@@ -0,0 +1,197 @@
+#include "localSocket.hpp"
+
+#include <stdexcept>
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL; // A closed peer is an error, not SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+[[noreturn]] void fail(const std::string &what)
+{
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+sockaddr_un socketAddress(const fs::path &path)
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  const auto str = path.string();
+  if (str.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + str);
+  }
+  std::strncpy(address.sun_path, str.c_str(), sizeof(address.sun_path) - 1);
+  return address;
+}
+
+} // namespace
+
+LocalSocket LocalSocket::listen(const fs::path &path)
+{
+  const auto address = socketAddress(path);
+  struct stat status;
+  if (stat(address.sun_path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(address.sun_path);
+  }
+  LocalSocket socket{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (socket.m_Descriptor < 0) {
+    fail("Unable to create a socket");
+  }
+  if (bind(socket.m_Descriptor, (const sockaddr *)&address,
+          sizeof(address)) < 0) {
+    fail("Unable to bind " + path.string());
+  }
+  socket.m_Path = path;
+  if (::listen(socket.m_Descriptor, 8) < 0) {
+    fail("Unable to listen on " + path.string());
+  }
+  return socket;
+}
+
+LocalSocket LocalSocket::connect(const fs::path &path)
+{
+  const auto address = socketAddress(path);
+  LocalSocket socket{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (socket.m_Descriptor < 0) {
+    fail("Unable to create a socket");
+  }
+  if (::connect(socket.m_Descriptor, (const sockaddr *)&address,
+          sizeof(address)) < 0) {
+    fail("Unable to connect to " + path.string());
+  }
+  return socket;
+}
+
+LocalSocket LocalSocket::accept()
+{
+  int descriptor;
+  do {
+    descriptor = ::accept(m_Descriptor, nullptr, nullptr);
+  } while (descriptor < 0 && errno == EINTR);
+  if (descriptor < 0) {
+    fail("Unable to accept a client");
+  }
+  return LocalSocket{descriptor};
+}
+
+bool LocalSocket::readLine(std::string &line)
+{
+  auto end = m_Buffer.find('\n');
+  while (end == std::string::npos) {
+    char data[4096];
+    const auto size = ::recv(m_Descriptor, data, sizeof(data), 0);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size < 0) {
+      fail("Unable to read the socket");
+    }
+    if (size == 0) {
+      // A last line without '\n'
+      if (m_Buffer.empty()) {
+        return false;
+      }
+      line = std::move(m_Buffer);
+      m_Buffer.clear();
+      return true;
+    }
+    const auto searched = m_Buffer.size();
+    m_Buffer.append(data, size_t(size));
+    end = m_Buffer.find('\n', searched);
+    if (end == std::string::npos && m_Buffer.size() > MAX_LINE_SIZE) {
+      m_Buffer.clear();
+      throw std::length_error("Line longer than " +
+                              std::to_string(MAX_LINE_SIZE) + " bytes");
+    }
+  }
+  line = m_Buffer.substr(0, end);
+  m_Buffer.erase(0, end + 1);
+  return true;
+}
+
+void LocalSocket::writeLine(const std::string &line)
+{
+  const auto data = line + '\n';
+  size_t written = 0;
+  while (written < data.size()) {
+    const auto size = ::send(m_Descriptor, data.data() + written,
+        data.size() - written, SEND_FLAGS);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    }
+    if (size < 0) {
+      fail("Unable to write the socket");
+    }
+    written += size_t(size);
+  }
+}
+
+void LocalSocket::close()
+{
+  if (m_Descriptor >= 0) {
+    ::close(m_Descriptor);
+    m_Descriptor = -1;
+  }
+  if (!m_Path.empty()) {
+    unlink(m_Path.string().c_str());
+    m_Path.clear();
+  }
+}
+
+#else
+
+LocalSocket LocalSocket::listen(const fs::path &)
+{
+  throw std::runtime_error("Local sockets are not available on Windows");
+}
+
+LocalSocket LocalSocket::connect(const fs::path &)
+{
+  throw std::runtime_error("Local sockets are not available on Windows");
+}
+
+LocalSocket LocalSocket::accept() { return {}; }
+
+bool LocalSocket::readLine(std::string &) { return false; }
+
+void LocalSocket::writeLine(const std::string &) {}
+
+void LocalSocket::close() {}
+
+#endif
+
+LocalSocket::~LocalSocket() { close(); }
+
+LocalSocket::LocalSocket(LocalSocket &&other) :
+    m_Descriptor(other.m_Descriptor),
+    m_Path(std::move(other.m_Path)),
+    m_Buffer(std::move(other.m_Buffer))
+{
+  other.m_Descriptor = -1;
+  other.m_Path.clear();
+}
+
+LocalSocket &LocalSocket::operator=(LocalSocket &&other)
+{
+  if (this != &other) {
+    close();
+    m_Descriptor = other.m_Descriptor;
+    m_Path = std::move(other.m_Path);
+    m_Buffer = std::move(other.m_Buffer);
+    other.m_Descriptor = -1;
+    other.m_Path.clear();
+  }
+  return *this;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <string>
+
+// Stream socket between processes of the machine (Unix domain socket), read
+// and written line by line, for the render server and its client. Not
+// available on Windows: listen and connect throw.
+//
+// The functions throw std::runtime_error on errors.
+class LocalSocket
+{
+public:
+  // Listening socket at path. A socket file left there by a server which did
+  // not stop cleanly is replaced, the file is removed with the socket.
+  static LocalSocket listen(const fs::path &path);
+  static LocalSocket connect(const fs::path &path);
+
+  LocalSocket() = default;
+  ~LocalSocket();
+
+  LocalSocket(LocalSocket &&other);
+  LocalSocket &operator=(LocalSocket &&other);
+  LocalSocket(const LocalSocket &) = delete;
+  LocalSocket &operator=(const LocalSocket &) = delete;
+
+  // Wait for a client of a listening socket
+  LocalSocket accept();
+
+  // Longest line readLine accepts, a client sending more without '\n' is
+  // broken or hostile and would grow the buffer without limit
+  static const size_t MAX_LINE_SIZE = 1 << 20;
+
+  // Read a line without its '\n', return false at the end of the stream.
+  // Throw std::length_error for a line longer than MAX_LINE_SIZE.
+  bool readLine(std::string &line);
+  // Write a line, adding its '\n'
+  void writeLine(const std::string &line);
+
+private:
+  explicit LocalSocket(int descriptor) : m_Descriptor(descriptor) {}
+  void close();
+
+  int m_Descriptor = -1;
+  fs::path m_Path;      // Of a listening socket, removed with it
+  std::string m_Buffer; // Read but not returned yet
+};
@@ -0,0 +1,275 @@
+#include "meshArena.hpp"
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+
+namespace {
+
+const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
+const GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
+const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
+const GLuint VERTEX_ATTRIB_TANGENT_IDX = 3;
+const GLuint VERTEX_ATTRIB_INSTANCE_MODEL_MATRIX_IDX = 5;
+const GLuint VERTEX_ATTRIB_INSTANCE_NORMAL_MATRIX_IDX = 9;
+
+// Attributes present in a vertex format, in their interleaved order
+enum VertexFormatBits
+{
+  HAS_NORMAL = 1 << 0,
+  HAS_TEXCOORD0 = 1 << 1,
+  HAS_TANGENT = 1 << 2
+};
+
+GLsizei vertexFormatComponentCount(int format)
+{
+  return 3 + ((format & HAS_NORMAL) ? 3 : 0) +
+         ((format & HAS_TEXCOORD0) ? 2 : 0) + ((format & HAS_TANGENT) ? 3 : 0);
+}
+
+// CPU side of the buffers of a vertex format, filled primitive after primitive
+// before a single upload
+struct FormatArena
+{
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+  GLsizei vertexCount = 0;
+};
+
+// Per vertex tangents, accumulated over the triangles sharing the vertex and
+// orthogonalized against the normal
+std::vector<glm::vec3> computeTangents(const std::vector<float> &positions,
+    const std::vector<float> &normals, const std::vector<float> &texCoords,
+    const std::vector<uint32_t> &indices)
+{
+  const auto vertexCount = positions.size() / 3;
+  std::vector<glm::vec3> tangents(vertexCount, glm::vec3(0));
+  const auto position = [&](uint32_t i) {
+    return glm::vec3(
+        positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+  };
+  const auto texCoord = [&](uint32_t i) {
+    return glm::vec2(texCoords[2 * i], texCoords[2 * i + 1]);
+  };
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const auto i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+    if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount) {
+      continue;
+    }
+    const auto deltaPos1 = position(i1) - position(i0);
+    const auto deltaPos2 = position(i2) - position(i0);
+    const auto deltaUV1 = texCoord(i1) - texCoord(i0);
+    const auto deltaUV2 = texCoord(i2) - texCoord(i0);
+    const auto det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+    if (det == 0.f) {
+      continue;
+    }
+    const auto tangent =
+        (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) / det;
+    tangents[i0] += tangent;
+    tangents[i1] += tangent;
+    tangents[i2] += tangent;
+  }
+  for (size_t v = 0; v < vertexCount; ++v) {
+    const auto N =
+        glm::vec3(normals[3 * v], normals[3 * v + 1], normals[3 * v + 2]);
+    auto T = tangents[v] - N * glm::dot(N, tangents[v]);
+    if (glm::dot(T, T) < 1e-12f) {
+      // Degenerated UVs, any vector orthogonal to the normal will do
+      T = glm::cross(N, glm::abs(N.x) < 0.9f ? glm::vec3(1, 0, 0)
+                                             : glm::vec3(0, 1, 0));
+    }
+    tangents[v] = glm::normalize(T);
+  }
+  return tangents;
+}
+
+} // namespace
+
+MeshArena createMeshArena(
+    const tinygltf::Model &model, GLuint instanceBufferObject)
+{
+  MeshArena arena;
+  std::map<int, size_t> formatToArena; // Vertex format -> index in arenas
+  std::vector<int> arenaFormats;
+  std::vector<FormatArena> arenas;
+  std::vector<size_t> primitiveArenas;
+
+  for (const auto &mesh : model.meshes) {
+    arena.meshToFirstPrimitive.push_back(arena.primitives.size());
+    for (const auto &primitive : mesh.primitives) {
+      arena.primitives.push_back(
+          MeshArena::Primitive{0, GLenum(primitive.mode), 0, 0, 0});
+      primitiveArenas.push_back(0);
+
+      std::vector<float> positions, normals, texCoords;
+      const auto readAttribute = [&](const char *name, int numComponents,
+                                     std::vector<float> &out) {
+        const auto it = primitive.attributes.find(name);
+        if (it == end(primitive.attributes)) {
+          return false;
+        }
+        if (!readFloatAccessor(model, (*it).second, numComponents, out)) {
+          std::cerr << "Unable to read " << name << " accessor, skipping it."
+                    << std::endl;
+          return false;
+        }
+        return true;
+      };
+      if (!readAttribute("POSITION", 3, positions)) {
+        continue; // Nothing to draw, the primitive keeps indexCount = 0
+      }
+      const auto vertexCount = GLsizei(positions.size() / 3);
+
+      int format = 0;
+      if (readAttribute("NORMAL", 3, normals) &&
+          normals.size() == positions.size()) {
+        format |= HAS_NORMAL;
+      }
+      if (readAttribute("TEXCOORD_0", 2, texCoords) &&
+          texCoords.size() / 2 == positions.size() / 3) {
+        format |= HAS_TEXCOORD0;
+      }
+
+      std::vector<uint32_t> indices;
+      if (primitive.indices < 0 ||
+          !readIndexAccessor(model, primitive.indices, indices)) {
+        // Non indexed primitives are drawn with an identity index list
+        indices.resize(vertexCount);
+        for (GLsizei i = 0; i < vertexCount; ++i) {
+          indices[i] = uint32_t(i);
+        }
+      }
+
+      std::vector<glm::vec3> tangents;
+      if ((format & HAS_NORMAL) && (format & HAS_TEXCOORD0) &&
+          primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+        tangents = computeTangents(positions, normals, texCoords, indices);
+        format |= HAS_TANGENT;
+      }
+
+      auto formatIt = formatToArena.find(format);
+      if (formatIt == end(formatToArena)) {
+        formatIt = formatToArena.emplace(format, arenas.size()).first;
+        arenas.emplace_back();
+        arenaFormats.push_back(format);
+      }
+      auto &formatArena = arenas[(*formatIt).second];
+
+      auto &arenaPrimitive = arena.primitives.back();
+      primitiveArenas.back() = (*formatIt).second;
+      arenaPrimitive.indexCount = GLsizei(indices.size());
+      arenaPrimitive.indexByteOffset =
+          GLsizeiptr(formatArena.indices.size() * sizeof(uint32_t));
+      arenaPrimitive.baseVertex = formatArena.vertexCount;
+
+      formatArena.indices.insert(
+          end(formatArena.indices), begin(indices), end(indices));
+      formatArena.vertices.reserve(
+          formatArena.vertices.size() +
+          vertexCount * vertexFormatComponentCount(format));
+      for (GLsizei v = 0; v < vertexCount; ++v) {
+        auto &vertices = formatArena.vertices;
+        vertices.insert(
+            end(vertices), &positions[3 * v], &positions[3 * v + 3]);
+        if (format & HAS_NORMAL) {
+          vertices.insert(end(vertices), &normals[3 * v], &normals[3 * v + 3]);
+        }
+        if (format & HAS_TEXCOORD0) {
+          vertices.insert(
+              end(vertices), &texCoords[2 * v], &texCoords[2 * v + 2]);
+        }
+        if (format & HAS_TANGENT) {
+          vertices.insert(
+              end(vertices), {tangents[v].x, tangents[v].y, tangents[v].z});
+        }
+      }
+      formatArena.vertexCount += vertexCount;
+    }
+  }
+
+  // Upload each vertex format arena and describe its layout in a single VAO
+  arena.vertexArrays.resize(arenas.size(), 0);
+  arena.bufferObjects.resize(2 * arenas.size(), 0);
+  glGenVertexArrays(
+      GLsizei(arena.vertexArrays.size()), arena.vertexArrays.data());
+  glGenBuffers(GLsizei(arena.bufferObjects.size()), arena.bufferObjects.data());
+  for (size_t i = 0; i < arenas.size(); ++i) {
+    const auto format = arenaFormats[i];
+    const auto &formatArena = arenas[i];
+    const auto vertexBufferObject = arena.bufferObjects[2 * i];
+    const auto indexBufferObject = arena.bufferObjects[2 * i + 1];
+
+    glBindVertexArray(arena.vertexArrays[i]);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferObject);
+    glBufferData(GL_ARRAY_BUFFER, formatArena.vertices.size() * sizeof(float),
+        formatArena.vertices.data(), GL_STATIC_DRAW);
+    const auto stride =
+        GLsizei(vertexFormatComponentCount(format) * sizeof(float));
+    size_t offset = 0;
+    const auto addAttribute = [&](GLuint vertexAttrib, GLint size) {
+      glEnableVertexAttribArray(vertexAttrib);
+      glVertexAttribPointer(vertexAttrib, size, GL_FLOAT, GL_FALSE, stride,
+          (const GLvoid *)offset);
+      offset += size * sizeof(float);
+    };
+    addAttribute(VERTEX_ATTRIB_POSITION_IDX, 3);
+    if (format & HAS_NORMAL) {
+      addAttribute(VERTEX_ATTRIB_NORMAL_IDX, 3);
+    }
+    if (format & HAS_TEXCOORD0) {
+      addAttribute(VERTEX_ATTRIB_TEXCOORD0_IDX, 2);
+    }
+    if (format & HAS_TANGENT) {
+      addAttribute(VERTEX_ATTRIB_TANGENT_IDX, 3);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBufferObject);
+    for (GLuint column = 0; column < 4; ++column) {
+      const auto vertexAttrib =
+          VERTEX_ATTRIB_INSTANCE_MODEL_MATRIX_IDX + column;
+      glEnableVertexAttribArray(vertexAttrib);
+      glVertexAttribPointer(vertexAttrib, 4, GL_FLOAT, GL_FALSE,
+          sizeof(InstanceAttributes),
+          (const GLvoid *)(offsetof(InstanceAttributes, modelMatrix) +
+                           column * sizeof(glm::vec4)));
+      glVertexAttribDivisor(vertexAttrib, 1);
+    }
+    for (GLuint column = 0; column < 3; ++column) {
+      const auto vertexAttrib =
+          VERTEX_ATTRIB_INSTANCE_NORMAL_MATRIX_IDX + column;
+      glEnableVertexAttribArray(vertexAttrib);
+      glVertexAttribPointer(vertexAttrib, 3, GL_FLOAT, GL_FALSE,
+          sizeof(InstanceAttributes),
+          (const GLvoid *)(offsetof(InstanceAttributes, normalMatrix) +
+                           column * sizeof(glm::vec3)));
+      glVertexAttribDivisor(vertexAttrib, 1);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObject);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+        formatArena.indices.size() * sizeof(uint32_t),
+        formatArena.indices.data(), GL_STATIC_DRAW);
+
+    arena.vertexBytes += formatArena.vertices.size() * sizeof(float);
+    arena.indexBytes += formatArena.indices.size() * sizeof(uint32_t);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  for (size_t i = 0; i < arena.primitives.size(); ++i) {
+    if (arena.primitives[i].indexCount > 0) {
+      arena.primitives[i].vertexArray = arena.vertexArrays[primitiveArenas[i]];
+    }
+  }
+
+  std::cout << "Mesh arena: " << arena.primitives.size() << " primitives in "
+            << arena.vertexArrays.size() << " vertex formats ("
+            << arena.vertexBytes << " vertex bytes, " << arena.indexBytes
+            << " index bytes)" << std::endl;
+  return arena;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <tiny_gltf.h>
+
+#include <vector>
+
+// Every primitive of a model repacked into a few large buffers: one
+// interleaved vertex buffer and one 32 bits index buffer per vertex format (the
+// set of attributes a primitive has). Primitives are then drawn with
+// glDrawElements*BaseVertex from a single VAO per vertex format.
+struct MeshArena
+{
+  struct Primitive
+  {
+    GLuint vertexArray; // VAO of the vertex format of the primitive
+    GLenum mode;
+    GLsizei indexCount;
+    GLsizeiptr indexByteOffset; // In the index buffer of the vertex format
+    GLint baseVertex;
+  };
+
+  std::vector<GLuint> vertexArrays; // One per vertex format
+  std::vector<GLuint> bufferObjects; // Vertex and index buffers
+  std::vector<Primitive> primitives;
+  // Index in primitives of the first primitive of each mesh, the primitives of
+  // a mesh being contiguous
+  std::vector<size_t> meshToFirstPrimitive;
+  size_t vertexBytes = 0;
+  size_t indexBytes = 0;
+};
+
+// Build the arena of the model. The per-instance model and normal matrices of
+// instanceBufferObject are attached to each VAO (vertex attributes 5 to 11), as
+// for the per-primitive VAOs.
+MeshArena createMeshArena(
+    const tinygltf::Model &model, GLuint instanceBufferObject);
@@ -0,0 +1,631 @@
+#include "offscreenOutput.hpp"
+#include "renderQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// The renderers encode their colors with the GAMMA of pbr_brdf.glsl, the
+// float images are decoded to linear values
+const float SHADER_GAMMA = 2.2f;
+
+// Of the images larger than a framebuffer can be, without --tile-size
+const GLsizei DEFAULT_TILE_SIZE = 2048;
+
+GLenum colorFormatOf(ImageFormat format)
+{
+  return imageFormatIsFloat(format) ? GL_RGBA32F : GL_RGBA8;
+}
+
+// Largest side of a thumbnail
+glm::ivec2 thumbnailSize(GLsizei width, GLsizei height, uint32_t side)
+{
+  const auto scale = float(side) / std::max(width, height);
+  return glm::ivec2(std::max(1, int(std::lround(width * scale))),
+      std::max(1, int(std::lround(height * scale))));
+}
+
+} // namespace
+
+OffscreenOutput::OffscreenOutput(
+    SceneRenderer &renderer, const Settings &settings) :
+    m_Renderer(renderer),
+    m_Settings(settings),
+    m_DefaultWidth(renderer.width()),
+    m_DefaultHeight(renderer.height())
+{
+  // Multisampling: the forward renderer draws in the multisampled textures of
+  // the framebuffer, resolved before the readback
+  GLint maxColorSamples = 1, maxDepthSamples = 1;
+  glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxColorSamples);
+  glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maxDepthSamples);
+  m_MaxMsaaSampleCount = std::min(maxColorSamples, maxDepthSamples);
+  if (m_Settings.msaaSampleCount > GLuint(m_MaxMsaaSampleCount)) {
+    throw std::runtime_error("At most " +
+                             std::to_string(m_MaxMsaaSampleCount) +
+                             " samples per pixel for multisampling");
+  }
+
+  GLint maxTextureSize = 0, maxViewportDims[2] = {};
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+  m_MaxFramebufferSize =
+      std::min({maxTextureSize, maxViewportDims[0], maxViewportDims[1]});
+  if (m_Settings.tileSize > GLuint(m_MaxFramebufferSize)) {
+    throw std::runtime_error("Tiles larger than the largest framebuffer, " +
+                             std::to_string(m_MaxFramebufferSize));
+  }
+}
+
+void OffscreenOutput::setView(const CameraView &view)
+{
+  m_Renderer.setSize(view.width ? GLsizei(view.width) : m_DefaultWidth,
+      view.height ? GLsizei(view.height) : m_DefaultHeight);
+  m_Renderer.setPerspective(view.fovy > 0.f ? glm::radians(view.fovy)
+                                            : SceneRenderer::DEFAULT_FOVY);
+}
+
+void OffscreenOutput::drawOutput(
+    const Camera &camera, GLenum colorFormat, uint32_t sampleCount)
+{
+  m_ImageFramebuffer.resize(m_Renderer.width(), m_Renderer.height(),
+      colorFormat, GLsizei(m_Settings.msaaSampleCount));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_ImageFramebuffer.framebuffer());
+  if (sampleCount <= 1) {
+    m_Renderer.drawScene(camera);
+  } else {
+    m_Renderer.resetSamples();
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+      m_Renderer.accumulateSample(camera);
+    }
+    m_Renderer.drawAccumulation();
+  }
+  m_ImageFramebuffer.resolve();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+GLsizei OffscreenOutput::outputTileSize() const
+{
+  if (m_Settings.tileSize) {
+    return GLsizei(m_Settings.tileSize);
+  }
+  return std::max(m_Renderer.width(), m_Renderer.height()) >
+                 m_MaxFramebufferSize
+             ? std::min(DEFAULT_TILE_SIZE, m_MaxFramebufferSize)
+             : 0;
+}
+
+// Each tile is drawn at tileSize x tileSize with the projection of its part
+// of the image, a sub-frustum, the tiles of the last row and column extending
+// out of the image. The tiles of a row are read back into a strip of the
+// image, written to the file before the next row: the GPU memory is the one
+// of a tile and the host memory the one of a strip, whatever the size of the
+// image.
+void OffscreenOutput::drawTiledOutput(const Camera &camera, GLsizei tileSize,
+    const fs::path &path, ImageFormat format,
+    ReadbackPipeline &readbackPipeline)
+{
+  const auto imageSize = glm::ivec2(m_Renderer.width(), m_Renderer.height());
+  const auto componentCount = imageFormatComponentCount(format);
+  const auto floatOutput = imageFormatIsFloat(format);
+  ImageStreamWriter writer{
+      path, format, imageSize.x, imageSize.y, SHADER_GAMMA};
+  ReadbackImage strip(imageSize.x, 0, componentCount);
+  // From the normalized device coordinates of the image to the ones of a
+  // tile
+  const auto scale = glm::vec2(imageSize) / float(tileSize);
+  m_Renderer.setSize(tileSize, tileSize);
+  for (GLsizei top = 0; top < imageSize.y; top += tileSize) {
+    strip.height = std::min(tileSize, imageSize.y - top);
+    const auto stripSize = size_t(imageSize.x) * strip.height * componentCount;
+    if (floatOutput) {
+      strip.floatPixels.resize(stripSize);
+    } else {
+      strip.pixels.resize(stripSize);
+    }
+    for (GLsizei left = 0; left < imageSize.x; left += tileSize) {
+      const auto tileCenter =
+          2.f * glm::vec2((left + 0.5f * tileSize) / imageSize.x,
+                    1.f - (top + 0.5f * tileSize) / imageSize.y) -
+          1.f;
+      m_Renderer.setTileProjection(
+          glm::scale(glm::translate(glm::mat4(1),
+                         glm::vec3(-tileCenter * scale, 0.f)),
+              glm::vec3(scale, 1.f)) *
+          m_Renderer.imageProjMatrix());
+      drawOutput(camera, colorFormatOf(format), m_Settings.sampleCount);
+      // Rows from the top, the tile is cropped to the image
+      readbackPipeline.readback(m_ImageFramebuffer.colorTexture(), tileSize,
+          tileSize, componentCount, floatOutput ? GL_FLOAT : GL_UNSIGNED_BYTE,
+          [&, left](const ReadbackImage &tile) {
+            const auto rowSize =
+                size_t(std::min(tileSize, imageSize.x - left)) *
+                componentCount;
+            for (GLsizei y = 0; y < strip.height; ++y) {
+              const auto source = size_t(y) * tileSize * componentCount;
+              const auto target =
+                  (size_t(y) * imageSize.x + left) * componentCount;
+              if (floatOutput) {
+                std::copy_n(tile.floatPixels.data() + source, rowSize,
+                    strip.floatPixels.data() + target);
+              } else {
+                std::copy_n(tile.pixels.data() + source, rowSize,
+                    strip.pixels.data() + target);
+              }
+            }
+          });
+    }
+    readbackPipeline.finish();
+    writer.write(strip);
+  }
+  writer.close();
+
+  m_Renderer.setSize(imageSize.x, imageSize.y);
+  m_Renderer.setTileProjection(m_Renderer.imageProjMatrix());
+}
+
+// One geometry pass over the nodes of the scene, with the camera and
+// projection of the image
+void OffscreenOutput::drawAuxiliaryOutput(const Camera &camera)
+{
+  const auto width = m_Renderer.width(), height = m_Renderer.height();
+  if (std::max(width, height) > m_MaxFramebufferSize) {
+    throw std::runtime_error(
+        "Auxiliary buffers larger than the largest framebuffer, " +
+        std::to_string(m_MaxFramebufferSize));
+  }
+  m_AuxiliaryBuffers.resize(width, height, m_Settings.auxiliaryBuffers);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_AuxiliaryBuffers.framebuffer());
+  glViewport(0, 0, width, height);
+  const GLfloat zeros[4] = {}, farDepth = 1.f;
+  for (const auto buffer : m_Settings.auxiliaryBuffers) {
+    glClearBufferfv(GL_COLOR, buffer, zeros);
+  }
+  glClearBufferfv(GL_DEPTH, 0, &farDepth);
+  m_Renderer.drawAuxiliaryBuffers(camera);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+// Checked once the size of the image drawn is known, before drawing anything:
+// main cannot see it without --tile-size
+void OffscreenOutput::checkOutputTiling() const
+{
+  if (m_Settings.tileSize || !outputTileSize()) {
+    return;
+  }
+  if (!m_Settings.thumbnailSizes.empty() ||
+      !m_Settings.auxiliaryBuffers.empty() || m_Settings.ssaaFactor > 1) {
+    throw std::runtime_error(
+        "Images larger than the largest framebuffer, " +
+        std::to_string(m_MaxFramebufferSize) +
+        ", are drawn in tiles, without --thumbnails, --aux or --ssaa");
+  }
+}
+
+// The image is drawn at the largest size, then each smaller one is
+// downsampled from the previous by the encoder thread
+void OffscreenOutput::thumbnailOutputView()
+{
+  if (m_Settings.thumbnailSizes.empty()) {
+    return;
+  }
+  const auto size = thumbnailSize(m_Renderer.width(), m_Renderer.height(),
+      m_Settings.thumbnailSizes.front());
+  m_Renderer.setSize(size.x, size.y);
+  m_Renderer.setPerspective(glm::atan(1.f / m_Renderer.projMatrix()[1][1]) *
+                            2.f);
+}
+
+// The auxiliary buffers of an image are written next to it, out.png gives
+// out_depth.png..., at the size of the image before its supersampling
+void OffscreenOutput::writeAuxiliaryOutput(const Camera &camera,
+    const fs::path &imagePath, ImageFormat format,
+    ReadbackPipeline &readbackPipeline)
+{
+  if (m_Settings.auxiliaryBuffers.empty()) {
+    return;
+  }
+  drawAuxiliaryOutput(camera);
+  const auto extension = imageFormatIsFloat(format)
+                             ? imagePath.extension().string()
+                             : std::string(".png");
+  const auto maxDepth = m_Renderer.zFar();
+  for (const auto buffer : m_Settings.auxiliaryBuffers) {
+    auto path = imagePath;
+    path.replace_filename(imagePath.stem().string() + "_" +
+                          AuxiliaryBuffers::bufferName(buffer) + extension);
+    readbackPipeline.readback(m_AuxiliaryBuffers.texture(buffer),
+        m_Renderer.width(), m_Renderer.height(),
+        AuxiliaryBuffers::componentCount(buffer), GL_FLOAT,
+        [=](const ReadbackImage &image) {
+          writeAuxiliaryBuffer(path, buffer, image, maxDepth);
+        });
+  }
+}
+
+// The images are drawn ssaaFactor times larger, then downsampled by the
+// encoder threads
+void OffscreenOutput::supersampleOutputView()
+{
+  const auto factor = GLsizei(m_Settings.ssaaFactor);
+  if (factor <= 1) {
+    return;
+  }
+  if (std::max(m_Renderer.width(), m_Renderer.height()) * factor >
+      m_MaxFramebufferSize) {
+    throw std::runtime_error(
+        "Supersampled images larger than the largest framebuffer, " +
+        std::to_string(m_MaxFramebufferSize));
+  }
+  m_Renderer.setSize(m_Renderer.width() * factor, m_Renderer.height() * factor);
+}
+
+void OffscreenOutput::readbackOutput(ImageFormat format,
+    ReadbackPipeline &readbackPipeline, ReadbackPipeline::Handler handler)
+{
+  if (m_Settings.ssaaFactor > 1) {
+    handler = [this, handler](const ReadbackImage &image) {
+      handler(downsampleImage(image, image.width / m_Settings.ssaaFactor,
+          image.height / m_Settings.ssaaFactor, m_Settings.ssaaFilter,
+          SHADER_GAMMA));
+    };
+  }
+  readbackPipeline.readback(m_ImageFramebuffer.colorTexture(),
+      m_Renderer.width(), m_Renderer.height(),
+      imageFormatComponentCount(format),
+      imageFormatIsFloat(format) ? GL_FLOAT : GL_UNSIGNED_BYTE,
+      std::move(handler));
+}
+
+// out.png gives out_1024.png, out_512.png... with thumbnails
+fs::path OffscreenOutput::writeOutput(const fs::path &path,
+    const ReadbackImage &image, ImageFormat format) const
+{
+  if (m_Settings.thumbnailSizes.empty()) {
+    ::writeImage(path, image, format, SHADER_GAMMA);
+    return path;
+  }
+  fs::path largestPath;
+  ReadbackImage thumbnail;
+  const ReadbackImage *previous = &image;
+  for (const auto side : m_Settings.thumbnailSizes) {
+    const auto size = thumbnailSize(image.width, image.height, side);
+    if (size != glm::ivec2(previous->width, previous->height)) {
+      thumbnail = downsampleImage(
+          *previous, size.x, size.y, m_Settings.ssaaFilter, SHADER_GAMMA);
+      previous = &thumbnail;
+    }
+    auto thumbnailPath = path;
+    thumbnailPath.replace_filename(path.stem().string() + "_" +
+                                   std::to_string(side) +
+                                   path.extension().string());
+    ::writeImage(thumbnailPath, *previous, format, SHADER_GAMMA);
+    if (largestPath.empty()) {
+      largestPath = thumbnailPath;
+    }
+  }
+  return largestPath;
+}
+
+void OffscreenOutput::writeImage(const Camera &camera, const fs::path &path)
+{
+  const auto format = imageFormatFromPath(path);
+  ReadbackPipeline readbackPipeline{3, m_Settings.encoderThreadCount};
+  if (!m_Settings.auxiliaryBuffers.empty() && !imageFormatIsFloat(format)) {
+    std::cout << "Depth of the 16 bits auxiliary buffers from 0 to "
+              << m_Renderer.zFar() << ", scene units times "
+              << 65535.f / m_Renderer.zFar() << std::endl;
+  }
+  thumbnailOutputView();
+  checkOutputTiling();
+  writeAuxiliaryOutput(camera, path, format, readbackPipeline);
+  supersampleOutputView();
+  if (const auto tileSize = outputTileSize()) {
+    drawTiledOutput(camera, tileSize, path, format, readbackPipeline);
+    return;
+  }
+  drawOutput(camera, colorFormatOf(format), m_Settings.sampleCount);
+  readbackOutput(format, readbackPipeline,
+      [&](const ReadbackImage &image) { writeOutput(path, image, format); });
+  readbackPipeline.finish();
+}
+
+void OffscreenOutput::writeImages(
+    const std::vector<CameraView> &views, const fs::path &path)
+{
+  const auto format = imageFormatFromPath(path);
+  ReadbackPipeline readbackPipeline{3, m_Settings.encoderThreadCount};
+  if (!m_Settings.auxiliaryBuffers.empty() && !imageFormatIsFloat(format)) {
+    std::cout << "Depth of the 16 bits auxiliary buffers from 0 to "
+              << m_Renderer.zFar() << ", scene units times "
+              << 65535.f / m_Renderer.zFar() << std::endl;
+  }
+  const auto digitCount =
+      std::max(size_t(4), std::to_string(views.size() - 1).size());
+  std::mutex printMutex; // Of the encoder threads
+  const auto batchStart = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < views.size(); ++i) {
+    const auto &view = views[i];
+    const auto viewStart = std::chrono::steady_clock::now();
+    setView(view);
+
+    auto index = std::to_string(i);
+    index.insert(0, digitCount - index.size(), '0');
+    auto viewPath = path;
+    viewPath.replace_filename(
+        path.stem().string() + "_" + index + path.extension().string());
+    thumbnailOutputView();
+    checkOutputTiling();
+    writeAuxiliaryOutput(view.camera, viewPath, format, readbackPipeline);
+    supersampleOutputView();
+    if (const auto tileSize = outputTileSize()) {
+      drawTiledOutput(
+          view.camera, tileSize, viewPath, format, readbackPipeline);
+      std::lock_guard<std::mutex> lock(printMutex);
+      std::cout << viewPath.string() << ": " << m_Renderer.width() << "x"
+                << m_Renderer.height() << " in tiles of " << tileSize
+                << ", drawn and written in "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - viewStart)
+                       .count()
+                << " ms" << std::endl;
+      continue;
+    }
+    drawOutput(view.camera, colorFormatOf(format), m_Settings.sampleCount);
+    const auto drawTime = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - viewStart)
+                              .count();
+    // Reported by the encoder threads, the only ones printing meanwhile
+    readbackOutput(format, readbackPipeline,
+        [=, &printMutex](const ReadbackImage &image) {
+          const auto writtenPath = writeOutput(viewPath, image, format);
+          std::lock_guard<std::mutex> lock(printMutex);
+          std::cout << writtenPath.string() << ": " << image.width << "x"
+                    << image.height << ", drawn in " << drawTime
+                    << " ms, written "
+                    << std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - viewStart)
+                           .count()
+                    << " ms after the start of its draw" << std::endl;
+        });
+  }
+  readbackPipeline.finish();
+  const auto batchSeconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - batchStart)
+                                .count();
+  std::cout << views.size() << " images in " << batchSeconds << " s, "
+            << views.size() / batchSeconds << " images/s with "
+            << readbackPipeline.encoderThreadCount()
+            << " encoder threads. The render thread waited "
+            << readbackPipeline.gpuWaitTime() << " ms for the readbacks, "
+            << readbackPipeline.encoderWaitTime() << " ms for the encoders"
+            << std::endl;
+}
+
+// The frames are RGB bytes, written in order by one encoder thread
+void OffscreenOutput::stream(const std::vector<CameraView> &views,
+    const fs::path &path, FrameStreamFormat format, uint32_t framesPerSecond)
+{
+  const auto outputFormat = ImageFormat::PPM;
+  ReadbackPipeline readbackPipeline{3, 1};
+  setView(views.front());
+  const auto frameSize = glm::ivec2(m_Renderer.width(), m_Renderer.height());
+  if (outputTileSize()) {
+    throw std::runtime_error(
+        "Streamed frames larger than the largest framebuffer, " +
+        std::to_string(m_MaxFramebufferSize));
+  }
+  FrameStream stream{
+      path, format, frameSize.x, frameSize.y, framesPerSecond};
+  const auto streamStart = std::chrono::steady_clock::now();
+  for (const auto &view : views) {
+    // The reader left
+    if (stream.failed()) {
+      break;
+    }
+    setView(view);
+    if (glm::ivec2(m_Renderer.width(), m_Renderer.height()) != frameSize) {
+      throw std::runtime_error(
+          "The streamed views must all have the same size");
+    }
+    supersampleOutputView();
+    drawOutput(
+        view.camera, colorFormatOf(outputFormat), m_Settings.sampleCount);
+    readbackOutput(outputFormat, readbackPipeline,
+        [&](const ReadbackImage &image) { stream.write(image); });
+  }
+  readbackPipeline.finish();
+  const auto streamSeconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - streamStart)
+                                 .count();
+  std::cout << stream.frameCount() << " frames of " << frameSize.x << "x"
+            << frameSize.y << " streamed in " << streamSeconds << " s, "
+            << stream.frameCount() / streamSeconds
+            << " frames/s. The reader kept the stream waiting "
+            << stream.blockedTime()
+            << " ms, the render thread waited for the stream "
+            << readbackPipeline.encoderWaitTime() << " ms" << std::endl;
+}
+
+void OffscreenOutput::serve(RenderQueue &queue, const Camera &defaultCamera)
+{
+  ReadbackPipeline readbackPipeline{1, 1};
+  RenderJob job;
+  while (queue.pop(job)) {
+    const auto start = std::chrono::steady_clock::now();
+    setView(job.view);
+    if (std::max(m_Renderer.width(), m_Renderer.height()) >
+        m_MaxFramebufferSize) {
+      RenderResult result;
+      result.error = "Images larger than " +
+                     std::to_string(m_MaxFramebufferSize) +
+                     " pixels are only rendered by the viewer command, in "
+                     "tiles";
+      queue.done(std::move(result));
+      continue;
+    }
+    const auto floatOutput = imageFormatIsFloat(job.format);
+    drawOutput(job.hasCamera ? job.view.camera : defaultCamera,
+        colorFormatOf(job.format), job.sampleCount);
+
+    RenderResult result;
+    result.width = uint32_t(m_Renderer.width());
+    result.height = uint32_t(m_Renderer.height());
+    readbackPipeline.readback(m_ImageFramebuffer.colorTexture(),
+        m_Renderer.width(), m_Renderer.height(),
+        imageFormatComponentCount(job.format),
+        floatOutput ? GL_FLOAT : GL_UNSIGNED_BYTE,
+        [&](const ReadbackImage &image) {
+          const auto encodeStart = std::chrono::steady_clock::now();
+          result.renderTime =
+              std::chrono::duration<double, std::milli>(encodeStart - start)
+                  .count();
+          try {
+            if (job.outputPath.empty()) {
+              result.bytes = encodeImage(image, job.format, SHADER_GAMMA);
+            } else {
+              ::writeImage(job.outputPath, image, job.format, SHADER_GAMMA);
+            }
+            result.ok = true;
+          } catch (const std::runtime_error &e) {
+            result.error = e.what();
+          }
+          result.encodeTime = std::chrono::duration<double, std::milli>(
+              std::chrono::steady_clock::now() - encodeStart)
+                                  .count();
+        });
+    readbackPipeline.finish();
+    queue.done(std::move(result));
+  }
+}
+
+// The image of the camera in floats, converted to bytes for the 8 bits
+// formats
+void OffscreenOutput::benchmarkEncoders(const Camera &camera)
+{
+  drawOutput(camera, GL_RGBA32F, 1);
+  const auto width = m_Renderer.width(), height = m_Renderer.height();
+  ReadbackImage image(width, height, 4);
+  image.floatPixels.resize(4 * size_t(width) * height);
+  glBindTexture(GL_TEXTURE_2D, m_ImageFramebuffer.colorTexture());
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, image.floatPixels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  flipImageYAxis(image.width, image.height, 4, image.floatPixels.data());
+  const auto threadCount =
+      m_Settings.encoderThreadCount
+          ? m_Settings.encoderThreadCount
+          : std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+  std::cout << benchmarkImageEncoders(image, threadCount, SHADER_GAMMA);
+}
+
+// The draw on the GPU, then the resolve of the samples for multisampling, or
+// the readback and downsample on the CPU for supersampling. Averages over
+// frames, after a first one allocating the targets.
+void OffscreenOutput::benchmarkAntialiasing(const Camera &camera)
+{
+  using clock = std::chrono::steady_clock;
+  const auto millisecondsSince = [](clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(clock::now() - start)
+        .count();
+  };
+  const auto imageSize = glm::ivec2(m_Renderer.width(), m_Renderer.height());
+  const int frameCount = 5;
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(2)
+         << "Mode      Samples  Draw (ms)  Resolve (ms)  Total (ms)  "
+            "Target (MB)\n";
+  const auto addRow = [&](const std::string &mode, int sampleCount,
+                          double drawTime, double resolveTime,
+                          double targetBytes) {
+    report << std::left << std::setw(10) << mode << std::right << std::setw(7)
+           << sampleCount << std::setw(11) << drawTime << std::setw(14)
+           << resolveTime << std::setw(12) << drawTime + resolveTime
+           << std::setw(13) << targetBytes / (1024 * 1024) << "\n";
+  };
+  // Color and depth bytes of each sample
+  const auto pixelCount = double(imageSize.x) * imageSize.y;
+  const auto sampleBytes = 8.;
+
+  const auto timeDraw = [&]() {
+    drawOutput(camera, GL_RGBA8, 1);
+    glFinish();
+    const auto start = clock::now();
+    for (int i = 0; i < frameCount; ++i) {
+      drawOutput(camera, GL_RGBA8, 1);
+    }
+    glFinish();
+    return millisecondsSince(start) / frameCount;
+  };
+
+  const auto msaaSampleCount = m_Settings.msaaSampleCount;
+  for (GLsizei sampleCount = 1; sampleCount <= m_MaxMsaaSampleCount;
+       sampleCount *= 2) {
+    m_Settings.msaaSampleCount = uint32_t(sampleCount);
+    // The draw includes the resolve, timed alone after it
+    auto drawTime = timeDraw();
+    auto resolveTime = 0.;
+    if (sampleCount > 1) {
+      const auto start = clock::now();
+      for (int i = 0; i < frameCount; ++i) {
+        m_ImageFramebuffer.resolve();
+      }
+      glFinish();
+      resolveTime = millisecondsSince(start) / frameCount;
+      drawTime -= resolveTime;
+    }
+    addRow(sampleCount > 1 ? "MSAA" : "None", sampleCount, drawTime,
+        resolveTime,
+        pixelCount * (sampleCount * sampleBytes + (sampleCount > 1) * 4));
+  }
+  m_Settings.msaaSampleCount = 1;
+
+  for (GLsizei factor = 2; factor <= 4; ++factor) {
+    if (std::max(imageSize.x, imageSize.y) * factor > m_MaxFramebufferSize) {
+      break;
+    }
+    m_Renderer.setSize(imageSize.x * factor, imageSize.y * factor);
+    const auto drawTime = timeDraw();
+    const auto width = m_Renderer.width(), height = m_Renderer.height();
+    ReadbackImage image(width, height, 3);
+    image.pixels.resize(3 * size_t(width) * height);
+    auto start = clock::now();
+    GLint previousPackAlignment = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &previousPackAlignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, m_ImageFramebuffer.colorTexture());
+    glGetTexImage(
+        GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, previousPackAlignment);
+    const auto readbackTime = millisecondsSince(start);
+    for (const auto filter :
+        {DownsampleFilter::Box, DownsampleFilter::Lanczos}) {
+      start = clock::now();
+      for (int i = 0; i < frameCount; ++i) {
+        downsampleImage(image, imageSize.x, imageSize.y, filter, SHADER_GAMMA);
+      }
+      addRow(std::string("SSAA ") + downsampleFilterName(filter),
+          factor * factor, drawTime,
+          readbackTime + millisecondsSince(start) / frameCount,
+          pixelCount * factor * factor * sampleBytes);
+    }
+  }
+  m_Renderer.setSize(imageSize.x, imageSize.y);
+  m_Settings.msaaSampleCount = msaaSampleCount;
+
+  std::cout << "Anti-aliasing of a " << imageSize.x << "x" << imageSize.y
+            << " image, average of " << frameCount << " frames, "
+            << std::thread::hardware_concurrency()
+            << " threads downsampling:\n"
+            << report.str();
+}
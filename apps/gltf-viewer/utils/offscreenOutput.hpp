@@ -0,0 +1,118 @@
+#pragma once
+
+#include "auxiliaryBuffers.hpp"
+#include "cameraViews.hpp"
+#include "downsample.hpp"
+#include "filesystem.hpp"
+#include "frameStream.hpp"
+#include "imageEncoders.hpp"
+#include "images.hpp"
+#include "readbackPipeline.hpp"
+#include "sceneRenderer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class RenderQueue;
+
+// Images of a SceneRenderer drawn offscreen and written to files, streamed,
+// or returned to the render server. The framebuffers are kept from image to
+// image, as the other GPU resources.
+//
+// The images are read back and encoded asynchronously by a ReadbackPipeline,
+// while the next ones are drawn. Each view sets the size and the projection
+// of the renderer, the ones it had at construction for its zero values.
+class OffscreenOutput
+{
+public:
+  struct Settings
+  {
+    // Samples per pixel of progressive refinement
+    uint32_t sampleCount = 1;
+    // Side of the tiles, 0 to only tile the images larger than the GPU allows
+    uint32_t tileSize = 0;
+    // Anti-aliasing: samples per pixel of multisampling, and scale of
+    // supersampling, drawn larger then downsampled
+    uint32_t msaaSampleCount = 1;
+    uint32_t ssaaFactor = 1;
+    // Of supersampling and of the thumbnails
+    DownsampleFilter ssaaFilter = DownsampleFilter::Box;
+    // Written next to each image, empty for none
+    std::vector<AuxiliaryBuffers::Buffer> auxiliaryBuffers;
+    // Largest side of the images written, from the largest to the smallest,
+    // instead of the one image if not empty
+    std::vector<uint32_t> thumbnailSizes;
+    // Threads encoding the images, 0 for one per hardware thread
+    size_t encoderThreadCount = 0;
+  };
+
+  // Throw std::runtime_error if the GPU cannot draw the tiles or the samples
+  // of multisampling requested
+  OffscreenOutput(SceneRenderer &renderer, const Settings &settings);
+
+  // Size and projection of a view, the ones of the construction for its zero
+  // values
+  void setView(const CameraView &view);
+
+  // The image of a camera, its thumbnails and its auxiliary buffers. The
+  // format is the one of the extension of path.
+  void writeImage(const Camera &camera, const fs::path &path);
+  // Batch of views from one load of the model: out.png gives out_0000.png,
+  // out_0001.png, ...
+  void writeImages(const std::vector<CameraView> &views, const fs::path &path);
+  // Frames of the views, all of the same size, written to a FrameStream
+  void stream(const std::vector<CameraView> &views, const fs::path &path,
+      FrameStreamFormat format, uint32_t framesPerSecond);
+  // Render the jobs of the render server until it closes the queue
+  void serve(RenderQueue &queue, const Camera &defaultCamera);
+
+  // Print the time of the image encoders on the image of a camera
+  void benchmarkEncoders(const Camera &camera);
+  // Print the cost of the image of a camera with each anti-aliasing
+  void benchmarkAntialiasing(const Camera &camera);
+
+private:
+  // Draw the image of a camera in m_ImageFramebuffer, at the size of the
+  // renderer, averaging sampleCount jittered samples
+  void drawOutput(
+      const Camera &camera, GLenum colorFormat, uint32_t sampleCount);
+  // Side of the tiles of the current size, 0 to draw the image at once
+  GLsizei outputTileSize() const;
+  // Draw the image in tiles and write it strip by strip
+  void drawTiledOutput(const Camera &camera, GLsizei tileSize,
+      const fs::path &path, ImageFormat format,
+      ReadbackPipeline &readbackPipeline);
+  // Draw the auxiliary buffers of the image of a camera
+  void drawAuxiliaryOutput(const Camera &camera);
+
+  /** Steps of the images written, each from the size of the previous one **/
+  // Images larger than the largest framebuffer are drawn in tiles, without
+  // thumbnails, auxiliary buffers nor supersampling: throw
+  // std::runtime_error if some are requested
+  void checkOutputTiling() const;
+  // To the size of the largest thumbnail
+  void thumbnailOutputView();
+  void writeAuxiliaryOutput(const Camera &camera, const fs::path &imagePath,
+      ImageFormat format, ReadbackPipeline &readbackPipeline);
+  // To the supersampled size
+  void supersampleOutputView();
+  // Read back the image drawn, downsampled if supersampled
+  void readbackOutput(ImageFormat format, ReadbackPipeline &readbackPipeline,
+      ReadbackPipeline::Handler handler);
+  // Return the path of the largest image written
+  fs::path writeOutput(const fs::path &path, const ReadbackImage &image,
+      ImageFormat format) const;
+
+  SceneRenderer &m_Renderer;
+  Settings m_Settings;
+  GLsizei m_MaxMsaaSampleCount;
+  // Smallest of the largest texture and of the largest viewport
+  GLsizei m_MaxFramebufferSize;
+  // Of the renderer at construction
+  GLsizei m_DefaultWidth;
+  GLsizei m_DefaultHeight;
+
+  ImageFramebuffer m_ImageFramebuffer;
+  AuxiliaryBuffers m_AuxiliaryBuffers;
+};
@@ -0,0 +1,44 @@
+#include "overdrawMeter.hpp"
+
+OverdrawMeter::OverdrawMeter() { glGenQueries(2, m_Queries); }
+
+OverdrawMeter::~OverdrawMeter() { glDeleteQueries(2, m_Queries); }
+
+void OverdrawMeter::beginGeometry()
+{
+  glBeginQuery(GL_SAMPLES_PASSED, m_Queries[0]);
+}
+
+void OverdrawMeter::endGeometry() { glEndQuery(GL_SAMPLES_PASSED); }
+
+void OverdrawMeter::beginCoverage()
+{
+  glBeginQuery(GL_SAMPLES_PASSED, m_Queries[1]);
+}
+
+void OverdrawMeter::endCoverage()
+{
+  glEndQuery(GL_SAMPLES_PASSED);
+  m_Pending = true;
+}
+
+bool OverdrawMeter::update()
+{
+  if (!m_Pending) {
+    return false;
+  }
+  for (const auto query : m_Queries) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return false;
+    }
+  }
+  glGetQueryObjectui64v(m_Queries[0], GL_QUERY_RESULT, &m_FragmentCount);
+  glGetQueryObjectui64v(m_Queries[1], GL_QUERY_RESULT, &m_CoveredPixelCount);
+  m_Overdraw = m_CoveredPixelCount
+                   ? float(m_FragmentCount) / float(m_CoveredPixelCount)
+                   : 0.f;
+  m_Pending = false;
+  return true;
+}
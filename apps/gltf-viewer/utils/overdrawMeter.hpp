@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Measure the overdraw of the geometry pass: the number of fragments passing
+// the depth test while drawing the geometry, i.e. shaded without depth
+// pre-pass, divided by the number of pixels covered by the geometry. Both are
+// counted with GL_SAMPLES_PASSED queries, read back once available so that
+// measuring never stalls the pipeline.
+class OverdrawMeter
+{
+public:
+  OverdrawMeter();
+  ~OverdrawMeter();
+
+  OverdrawMeter(const OverdrawMeter &) = delete;
+  OverdrawMeter &operator=(const OverdrawMeter &) = delete;
+
+  // Whether the queries of the last measurement are still in flight, a new
+  // one cannot begin until update() read them
+  bool pending() const { return m_Pending; }
+
+  // Count the samples passing the depth test between begin and end. The
+  // coverage is counted after the geometry, by a pass testing the depth
+  // buffer against the far plane.
+  void beginGeometry();
+  void endGeometry();
+  void beginCoverage();
+  void endCoverage();
+
+  // Read the results of the pending measurement, return true if they were
+  // available
+  bool update();
+
+  // Result of the last complete measurement, 0 if there is none
+  float overdraw() const { return m_Overdraw; }
+  GLuint64 fragmentCount() const { return m_FragmentCount; }
+  GLuint64 coveredPixelCount() const { return m_CoveredPixelCount; }
+
+private:
+  GLuint m_Queries[2] = {0, 0}; // Geometry, coverage
+  bool m_Pending = false;
+  float m_Overdraw = 0;
+  GLuint64 m_FragmentCount = 0;
+  GLuint64 m_CoveredPixelCount = 0;
+};
@@ -0,0 +1,168 @@
+#include "programBinaryCache.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Header of a cache file, followed by binaryLength bytes of program binary
+struct ProgramBinaryHeader
+{
+  char magic[4];
+  uint32_t version;
+  GLenum binaryFormat;
+  GLsizei binaryLength;
+  float compileMilliseconds; // Time it took to build the program
+};
+
+const char programBinaryMagic[4] = {'G', 'L', 'P', 'B'};
+const uint32_t programBinaryVersion = 1;
+
+std::string glString(GLenum name)
+{
+  const auto str = glGetString(name);
+  return str ? reinterpret_cast<const char *>(str) : "";
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+ProgramBinaryCache::ProgramBinaryCache(fs::path directory) :
+    m_Directory(std::move(directory))
+{
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  if (formatCount <= 0) {
+    std::clog << "Program binary cache disabled: the driver has no program "
+                 "binary format"
+              << std::endl;
+    return;
+  }
+
+  std::error_code error;
+  fs::create_directories(m_Directory, error);
+  if (error) {
+    std::cerr << "Program binary cache disabled: unable to create "
+              << m_Directory << " (" << error.message() << ")" << std::endl;
+    return;
+  }
+
+  m_DriverString = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' +
+                   glString(GL_VERSION);
+  m_Enabled = true;
+}
+
+GLProgram ProgramBinaryCache::compileProgram(
+    const std::vector<fs::path> &shaderPaths,
+    const std::vector<std::string> &defines)
+{
+  if (!m_Enabled) {
+    return ::compileProgram(shaderPaths, defines);
+  }
+
+  auto hash = fnv1a64(m_DriverString.data(), m_DriverString.size());
+  for (const auto &path : shaderPaths) {
+    const auto name = path.filename().string() + '\n';
+    const auto source =
+        preprocessShaderSource(loadShaderSource(path), defines) + '\0';
+    hash = fnv1a64(name.data(), name.size(), hash);
+    hash = fnv1a64(source.data(), source.size(), hash);
+  }
+  std::stringstream filename;
+  filename << std::hex << std::setw(16) << std::setfill('0') << hash
+           << ".bin";
+  const auto cachePath = m_Directory / filename.str();
+
+  // Try to load the binary
+  const auto loadStart = std::chrono::steady_clock::now();
+  std::ifstream in(cachePath.string(), std::ios::binary);
+  if (in) {
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    if (in.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+        std::equal(std::begin(header.magic), std::end(header.magic),
+            programBinaryMagic) &&
+        header.version == programBinaryVersion && header.binaryLength > 0) {
+      binary.resize(header.binaryLength);
+      if (!in.read(binary.data(), binary.size())) {
+        binary.clear();
+      }
+    }
+    if (!binary.empty()) {
+      GLProgram program;
+      glProgramBinary(program.glId(), header.binaryFormat, binary.data(),
+          GLsizei(binary.size()));
+      if (program.getLinkStatus()) {
+        ++m_HitCount;
+        m_SavedMilliseconds +=
+            header.compileMilliseconds - millisecondsSince(loadStart);
+        return program;
+      }
+    }
+    // Invalid file or binary rejected by the driver, it is replaced below
+    ++m_RejectedCount;
+  }
+  in.close();
+  ++m_MissCount;
+
+  // Compile, link and store the binary
+  const auto compileStart = std::chrono::steady_clock::now();
+  GLProgram program;
+  for (const auto &path : shaderPaths) {
+    auto shader = loadShader(path, defines);
+    program.attachShader(shader);
+  }
+  glProgramParameteri(
+      program.glId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  program.link();
+  if (!program.getLinkStatus()) {
+    std::cerr << "Program link error:" << program.getInfoLog() << std::endl;
+    throw std::runtime_error("Program link error:" + program.getInfoLog());
+  }
+
+  ProgramBinaryHeader header;
+  std::copy(std::begin(programBinaryMagic), std::end(programBinaryMagic),
+      header.magic);
+  header.version = programBinaryVersion;
+  glGetProgramiv(
+      program.glId(), GL_PROGRAM_BINARY_LENGTH, &header.binaryLength);
+  if (header.binaryLength <= 0) {
+    return program;
+  }
+  std::vector<char> binary(header.binaryLength);
+  glGetProgramBinary(program.glId(), header.binaryLength, &header.binaryLength,
+      &header.binaryFormat, binary.data());
+  header.compileMilliseconds = float(millisecondsSince(compileStart));
+
+  std::ofstream out(cachePath.string(), std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(binary.data(), header.binaryLength);
+  if (!out) {
+    std::cerr << "Unable to write program binary " << cachePath << std::endl;
+  }
+  return program;
+}
+
+void ProgramBinaryCache::logStats() const
+{
+  if (!m_Enabled) {
+    return;
+  }
+  const auto requestCount = m_HitCount + m_MissCount;
+  std::clog << "Program binary cache: " << m_HitCount << "/" << requestCount
+            << " hits ("
+            << (requestCount ? 100.f * m_HitCount / requestCount : 0.f)
+            << "%), " << m_RejectedCount << " rejected, "
+            << m_SavedMilliseconds << " ms of compilation saved" << std::endl;
+}
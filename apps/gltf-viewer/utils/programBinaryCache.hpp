@@ -0,0 +1,44 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "shaders.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked programs, stored with glGetProgramBinary and loaded
+// back with glProgramBinary. A program is identified by a hash of its
+// preprocessed sources and of the GL vendor, renderer and version strings, so
+// that editing a shader or updating the driver only causes a cache miss.
+// When the driver rejects a binary, the program is compiled from its sources
+// and the binary is stored again.
+class ProgramBinaryCache
+{
+public:
+  explicit ProgramBinaryCache(fs::path directory);
+
+  // Same as compileProgram(shaderPaths, defines), but from the cache when
+  // possible
+  GLProgram compileProgram(const std::vector<fs::path> &shaderPaths,
+      const std::vector<std::string> &defines = {});
+
+  bool enabled() const { return m_Enabled; }
+  uint32_t hitCount() const { return m_HitCount; }
+  uint32_t missCount() const { return m_MissCount; }
+  uint32_t rejectedCount() const { return m_RejectedCount; }
+  // Compile time of the programs loaded from the cache minus their load time
+  double savedMilliseconds() const { return m_SavedMilliseconds; }
+
+  void logStats() const;
+
+private:
+  fs::path m_Directory;
+  std::string m_DriverString; // GL_VENDOR, GL_RENDERER and GL_VERSION
+  bool m_Enabled = false;
+
+  uint32_t m_HitCount = 0;
+  uint32_t m_MissCount = 0;
+  uint32_t m_RejectedCount = 0;
+  double m_SavedMilliseconds = 0;
+};
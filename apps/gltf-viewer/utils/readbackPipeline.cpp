@@ -0,0 +1,236 @@
+#include "readbackPipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+size_t componentSize(GLenum type)
+{
+  return type == GL_FLOAT ? sizeof(float) : 1;
+}
+
+} // namespace
+
+ReadbackPipeline::ReadbackPipeline(
+    size_t bufferCount, size_t encoderThreadCount) :
+    m_Buffers(bufferCount)
+{
+  for (auto &buffer : m_Buffers) {
+    glGenBuffers(1, &buffer.buffer);
+  }
+  if (!encoderThreadCount) {
+    encoderThreadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Enough jobs queued to keep all the encoders busy
+  m_MaxJobCount = std::max(bufferCount, encoderThreadCount);
+  for (size_t i = 0; i < encoderThreadCount; ++i) {
+    m_Threads.emplace_back([this]() { encode(); });
+  }
+}
+
+ReadbackPipeline::~ReadbackPipeline()
+{
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Condition.notify_all();
+  for (auto &thread : m_Threads) {
+    thread.join();
+  }
+  for (auto &buffer : m_Buffers) {
+    glDeleteBuffers(1, &buffer.buffer);
+  }
+}
+
+void ReadbackPipeline::readback(GLuint texture, GLsizei width,
+    GLsizei height, size_t componentCount, GLenum type, Handler handler)
+{
+  collect(false);
+  if (m_PendingCount == m_Buffers.size()) {
+    collect(true);
+  }
+
+  auto &buffer = m_Buffers[(m_Oldest + m_PendingCount) % m_Buffers.size()];
+  // Read as RGBA, a plain copy from a GL_RGBA8 or GL_RGBA32F texture, the
+  // alpha is dropped while the rows are flipped for RGB
+  const auto byteSize =
+      GLsizeiptr(size_t(width) * height * 4 * componentSize(type));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+  if (buffer.byteSize != byteSize) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_STREAM_READ);
+    buffer.byteSize = byteSize;
+  }
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, type, nullptr);
+  glBindTexture(GL_TEXTURE_2D, previousTexture);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Submitted now, the next collect() may not flush
+  glFlush();
+  buffer.width = width;
+  buffer.height = height;
+  buffer.componentCount = componentCount;
+  buffer.type = type;
+  buffer.handler = std::move(handler);
+  ++m_PendingCount;
+}
+
+void ReadbackPipeline::finish()
+{
+  wait();
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::swap(error, m_Error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ReadbackPipeline::wait()
+{
+  while (m_PendingCount) {
+    collect(true);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Condition.wait(
+      lock, [this]() { return m_Jobs.empty() && !m_EncodingCount; });
+  m_EncoderWaitTime += millisecondsSince(start);
+}
+
+void ReadbackPipeline::collect(bool wait)
+{
+  while (m_PendingCount) {
+    auto &buffer = m_Buffers[m_Oldest];
+    const auto start = std::chrono::steady_clock::now();
+    // The copies complete in order, none is done if the oldest is not
+    const GLuint64 timeout = wait ? 1000000000 : 0; // Nanoseconds
+    auto status = glClientWaitSync(buffer.fence, 0, 0);
+    while (wait && status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(
+          buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    }
+    m_GpuWaitTime += millisecondsSince(start);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    if (status == GL_WAIT_FAILED) {
+      throw std::runtime_error("Readback fence wait failed.");
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    Job job;
+    job.image =
+        ReadbackImage(buffer.width, buffer.height, buffer.componentCount);
+    const auto pixelCount = size_t(buffer.width) * buffer.height;
+    unsigned char *pixels = nullptr;
+    if (buffer.type == GL_FLOAT) {
+      job.image.floatPixels.resize(pixelCount * buffer.componentCount);
+      pixels = reinterpret_cast<unsigned char *>(job.image.floatPixels.data());
+    } else {
+      job.image.pixels.resize(pixelCount * buffer.componentCount);
+      pixels = job.image.pixels.data();
+    }
+    job.handler = std::move(buffer.handler);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.buffer);
+    const auto *mapped = static_cast<const unsigned char *>(glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, buffer.byteSize, GL_MAP_READ_BIT));
+    if (mapped) {
+      // OpenGL rows go from bottom to top
+      const auto width = size_t(buffer.width);
+      const auto size = componentSize(buffer.type);
+      const auto pixelSize = buffer.componentCount * size;
+      for (GLsizei y = 0; y < buffer.height; ++y) {
+        const auto *source =
+            mapped + (buffer.height - 1 - y) * width * 4 * size;
+        auto *destination = pixels + y * width * pixelSize;
+        if (buffer.componentCount == 4) {
+          std::memcpy(destination, source, width * pixelSize);
+          continue;
+        }
+        for (size_t x = 0; x < width; ++x) {
+          std::memcpy(
+              destination + pixelSize * x, source + 4 * size * x, pixelSize);
+        }
+      }
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+      std::cerr << "Unable to map the readback buffer." << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_Oldest = (m_Oldest + 1) % m_Buffers.size();
+    --m_PendingCount;
+    enqueue(std::move(job));
+    wait = false;
+  }
+}
+
+void ReadbackPipeline::enqueue(Job job)
+{
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(
+        lock, [this]() { return m_Jobs.size() < m_MaxJobCount; });
+    m_Jobs.push_back(std::move(job));
+  }
+  m_EncoderWaitTime += millisecondsSince(start);
+  m_Condition.notify_all();
+}
+
+void ReadbackPipeline::encode()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (true) {
+    m_Condition.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+    if (m_Jobs.empty()) {
+      return;
+    }
+    auto job = std::move(m_Jobs.front());
+    m_Jobs.pop_front();
+    ++m_EncodingCount;
+    lock.unlock();
+    m_Condition.notify_all();
+    std::exception_ptr error;
+    try {
+      job.handler(job.image);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !m_Error) {
+      m_Error = error;
+    } else if (error) {
+      try {
+        std::rethrow_exception(error);
+      } catch (const std::exception &e) {
+        std::cerr << "Unable to handle an image read back: " << e.what()
+                  << std::endl;
+      } catch (...) {
+        std::cerr << "Unable to handle an image read back." << std::endl;
+      }
+    }
+    --m_EncodingCount;
+    m_Condition.notify_all();
+  }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// An image read back from the GPU, rows from top to bottom as image files
+// expect them
+struct ReadbackImage
+{
+  ReadbackImage() = default;
+  // Without pixels, filled by the caller
+  ReadbackImage(GLsizei width, GLsizei height, size_t componentCount) :
+      width(width), height(height), componentCount(componentCount)
+  {
+  }
+
+  GLsizei width = 0;
+  GLsizei height = 0;
+  size_t componentCount = 0; // 3: RGB, 4: RGBA, 1 or 2 for other data
+  std::vector<unsigned char> pixels; // Read back as GL_UNSIGNED_BYTE
+  std::vector<float> floatPixels;    // Instead, read back as GL_FLOAT
+};
+
+// Asynchronous readback of rendered images, for offscreen output: the render
+// thread does not wait for the GPU after each image, nor for its encoding.
+//
+// readback() copies a texture into one of a ring of pixel buffer objects
+// (glGetTexImage to GL_PIXEL_PACK_BUFFER returns without waiting) and puts a
+// fence after the copy. The buffers whose fence is signaled are mapped and
+// copied out, the rows flipped during the copy, on the following calls: the
+// render thread only waits when the ring is full, for the oldest copy. The
+// images are then handed to a pool of encoder threads, through a queue as long
+// as the ring: the render thread also waits when the encoders are behind.
+// Rendering image N + 1 thus overlaps the readback of image N and the encoding
+// of the previous ones.
+//
+// The images are taken from the queue in the order of the readbacks, but with
+// several encoder threads their handlers run concurrently and may finish in
+// any order. The first exception thrown by a handler is rethrown by finish(),
+// the following ones are logged.
+class ReadbackPipeline
+{
+public:
+  // Called on an encoder thread
+  using Handler = std::function<void(const ReadbackImage &image)>;
+
+  // encoderThreadCount 0 starts one thread per hardware thread
+  explicit ReadbackPipeline(
+      size_t bufferCount = 3, size_t encoderThreadCount = 1);
+  // Finish the pending images, the exceptions of their handlers are dropped
+  ~ReadbackPipeline();
+
+  ReadbackPipeline(const ReadbackPipeline &) = delete;
+  ReadbackPipeline &operator=(const ReadbackPipeline &) = delete;
+
+  // Read back level 0 of a 2D texture, then call handler with its pixels of
+  // type GL_UNSIGNED_BYTE or GL_FLOAT. The copy is fastest from a GL_RGBA8
+  // texture for bytes, from a GL_RGBA32F texture for floats.
+  void readback(GLuint texture, GLsizei width, GLsizei height,
+      size_t componentCount, GLenum type, Handler handler);
+
+  // Wait until the handlers of all the images read back have returned, then
+  // rethrow the first exception thrown by one of them since the last call
+  void finish();
+
+  size_t encoderThreadCount() const { return m_Threads.size(); }
+
+  // Time the render thread waited for the GPU copies and for the encoders, in
+  // milliseconds
+  double gpuWaitTime() const { return m_GpuWaitTime; }
+  double encoderWaitTime() const { return m_EncoderWaitTime; }
+
+private:
+  struct Buffer
+  {
+    GLuint buffer = 0;
+    GLsizeiptr byteSize = 0;
+    GLsync fence = nullptr; // Of the pending copy, null if the buffer is free
+    GLsizei width = 0;
+    GLsizei height = 0;
+    size_t componentCount = 0;
+    GLenum type = GL_UNSIGNED_BYTE;
+    Handler handler;
+  };
+
+  struct Job
+  {
+    ReadbackImage image;
+    Handler handler;
+  };
+
+  // Map the buffers whose copy is done, in order, waiting for the first one
+  // if wait is true
+  void collect(bool wait);
+  // finish() without the rethrow
+  void wait();
+  void enqueue(Job job);
+  void encode();
+
+  std::vector<Buffer> m_Buffers;
+  size_t m_Oldest = 0;       // Of the pending copies
+  size_t m_PendingCount = 0; // Copies not collected yet
+  double m_GpuWaitTime = 0;
+  double m_EncoderWaitTime = 0;
+
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<Job> m_Jobs;
+  size_t m_MaxJobCount;
+  size_t m_EncodingCount = 0; // Jobs taken from the queue, not done yet
+  std::exception_ptr m_Error; // First thrown by a handler, for finish()
+  bool m_Stop = false;
+
+  std::vector<std::thread> m_Threads;
+};
@@ -0,0 +1,136 @@
+#include "redrawScheduler.hpp"
+
+#include <algorithm>
+
+RedrawScheduler::RedrawScheduler(GLFWwindow *window) :
+    m_pWindow(window),
+    m_PrevUserPointer(glfwGetWindowUserPointer(window))
+{
+  glfwSetWindowUserPointer(window, this);
+  m_PrevCursorPosCallback = glfwSetCursorPosCallback(window, cursorPosCallback);
+  m_PrevCursorEnterCallback =
+      glfwSetCursorEnterCallback(window, cursorEnterCallback);
+  m_PrevMouseButtonCallback =
+      glfwSetMouseButtonCallback(window, mouseButtonCallback);
+  m_PrevScrollCallback = glfwSetScrollCallback(window, scrollCallback);
+  m_PrevKeyCallback = glfwSetKeyCallback(window, keyCallback);
+  m_PrevCharCallback = glfwSetCharCallback(window, charCallback);
+  m_PrevWindowRefreshCallback =
+      glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+  m_PrevWindowFocusCallback =
+      glfwSetWindowFocusCallback(window, windowFocusCallback);
+}
+
+RedrawScheduler::~RedrawScheduler()
+{
+  glfwSetCursorPosCallback(m_pWindow, m_PrevCursorPosCallback);
+  glfwSetCursorEnterCallback(m_pWindow, m_PrevCursorEnterCallback);
+  glfwSetMouseButtonCallback(m_pWindow, m_PrevMouseButtonCallback);
+  glfwSetScrollCallback(m_pWindow, m_PrevScrollCallback);
+  glfwSetKeyCallback(m_pWindow, m_PrevKeyCallback);
+  glfwSetCharCallback(m_pWindow, m_PrevCharCallback);
+  glfwSetWindowRefreshCallback(m_pWindow, m_PrevWindowRefreshCallback);
+  glfwSetWindowFocusCallback(m_pWindow, m_PrevWindowFocusCallback);
+  glfwSetWindowUserPointer(m_pWindow, m_PrevUserPointer);
+}
+
+void RedrawScheduler::requestRedraw(int frameCount)
+{
+  m_PendingFrameCount = std::max(m_PendingFrameCount, frameCount);
+}
+
+void RedrawScheduler::waitEvents(double timeout)
+{
+  if (redrawPending()) {
+    glfwPollEvents();
+  } else {
+    glfwWaitEventsTimeout(timeout);
+  }
+}
+
+void RedrawScheduler::frameDrawn()
+{
+  if (m_PendingFrameCount > 0) {
+    --m_PendingFrameCount;
+  }
+}
+
+RedrawScheduler &RedrawScheduler::fromWindow(GLFWwindow *window)
+{
+  return *static_cast<RedrawScheduler *>(glfwGetWindowUserPointer(window));
+}
+
+void RedrawScheduler::cursorPosCallback(GLFWwindow *window, double x, double y)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevCursorPosCallback) {
+    scheduler.m_PrevCursorPosCallback(window, x, y);
+  }
+}
+
+void RedrawScheduler::cursorEnterCallback(GLFWwindow *window, int entered)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevCursorEnterCallback) {
+    scheduler.m_PrevCursorEnterCallback(window, entered);
+  }
+}
+
+void RedrawScheduler::mouseButtonCallback(
+    GLFWwindow *window, int button, int action, int mods)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevMouseButtonCallback) {
+    scheduler.m_PrevMouseButtonCallback(window, button, action, mods);
+  }
+}
+
+void RedrawScheduler::scrollCallback(GLFWwindow *window, double x, double y)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevScrollCallback) {
+    scheduler.m_PrevScrollCallback(window, x, y);
+  }
+}
+
+void RedrawScheduler::keyCallback(
+    GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevKeyCallback) {
+    scheduler.m_PrevKeyCallback(window, key, scancode, action, mods);
+  }
+}
+
+void RedrawScheduler::charCallback(GLFWwindow *window, unsigned int codepoint)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevCharCallback) {
+    scheduler.m_PrevCharCallback(window, codepoint);
+  }
+}
+
+void RedrawScheduler::windowRefreshCallback(GLFWwindow *window)
+{
+  // The window content was damaged, e.g. by another window
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw();
+  if (scheduler.m_PrevWindowRefreshCallback) {
+    scheduler.m_PrevWindowRefreshCallback(window);
+  }
+}
+
+void RedrawScheduler::windowFocusCallback(GLFWwindow *window, int focused)
+{
+  auto &scheduler = fromWindow(window);
+  scheduler.requestRedraw(INPUT_FRAME_COUNT);
+  if (scheduler.m_PrevWindowFocusCallback) {
+    scheduler.m_PrevWindowFocusCallback(window, focused);
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "glfw.hpp"
+
+// Decide when the main loop draws a frame, to render on demand: a frame is
+// drawn after an input event or when the application requests it (camera
+// moving, shaders reloaded, ...). Otherwise the last frame stays on screen and
+// the loop sleeps in glfwWaitEventsTimeout.
+class RedrawScheduler
+{
+public:
+  // Install the input and window callbacks, chained to the ones installed
+  // before (ImGui's and the application's). The window user pointer is used to
+  // find the scheduler from the callbacks.
+  explicit RedrawScheduler(GLFWwindow *window);
+  ~RedrawScheduler();
+
+  RedrawScheduler(const RedrawScheduler &) = delete;
+  RedrawScheduler &operator=(const RedrawScheduler &) = delete;
+
+  // Draw at least the next frameCount frames
+  void requestRedraw(int frameCount = 1);
+
+  // Whether a frame must be drawn
+  bool redrawPending() const { return m_PendingFrameCount > 0; }
+
+  // Process the events, waiting for at most timeout seconds if no frame is
+  // pending. Another thread wakes the loop up with glfwPostEmptyEvent().
+  void waitEvents(double timeout);
+
+  // To call once a frame has been drawn
+  void frameDrawn();
+
+  // Number of frames ImGui needs after an input to update the widgets and the
+  // scene from the values they changed
+  static const int INPUT_FRAME_COUNT = 3;
+
+private:
+  static RedrawScheduler &fromWindow(GLFWwindow *window);
+
+  static void cursorPosCallback(GLFWwindow *window, double x, double y);
+  static void cursorEnterCallback(GLFWwindow *window, int entered);
+  static void mouseButtonCallback(
+      GLFWwindow *window, int button, int action, int mods);
+  static void scrollCallback(GLFWwindow *window, double x, double y);
+  static void keyCallback(
+      GLFWwindow *window, int key, int scancode, int action, int mods);
+  static void charCallback(GLFWwindow *window, unsigned int codepoint);
+  static void windowRefreshCallback(GLFWwindow *window);
+  static void windowFocusCallback(GLFWwindow *window, int focused);
+
+  GLFWwindow *m_pWindow;
+  int m_PendingFrameCount = INPUT_FRAME_COUNT; // The first frames
+
+  void *m_PrevUserPointer;
+  GLFWcursorposfun m_PrevCursorPosCallback;
+  GLFWcursorenterfun m_PrevCursorEnterCallback;
+  GLFWmousebuttonfun m_PrevMouseButtonCallback;
+  GLFWscrollfun m_PrevScrollCallback;
+  GLFWkeyfun m_PrevKeyCallback;
+  GLFWcharfun m_PrevCharCallback;
+  GLFWwindowrefreshfun m_PrevWindowRefreshCallback;
+  GLFWwindowfocusfun m_PrevWindowFocusCallback;
+};
@@ -0,0 +1,80 @@
+#include "renderQueue.hpp"
+
+RenderResult RenderQueue::render(const RenderJob &job)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Job = job;
+  m_HasJob = true;
+  m_HasResult = false;
+  m_Condition.notify_all();
+  m_Condition.wait(lock, [this]() { return m_HasResult || m_Stopped; });
+  if (!m_HasResult) {
+    m_HasJob = false;
+    RenderResult result;
+    result.error =
+        m_Error.empty() ? "The model could not be loaded" : m_Error;
+    return result;
+  }
+  m_HasResult = false;
+  return std::move(m_Result);
+}
+
+void RenderQueue::close()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Closed = true;
+  m_Condition.notify_all();
+}
+
+bool RenderQueue::isStopped() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Stopped;
+}
+
+bool RenderQueue::pop(RenderJob &job)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Condition.wait(lock, [this]() { return m_HasJob || m_Closed; });
+  if (!m_HasJob) {
+    return false;
+  }
+  job = std::move(m_Job);
+  m_HasJob = false;
+  return true;
+}
+
+void RenderQueue::done(RenderResult result)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Result = std::move(result);
+  m_HasResult = true;
+  m_Condition.notify_all();
+}
+
+void RenderQueue::stopped(const std::string &error)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Stopped = true;
+  m_Error = error;
+  m_Condition.notify_all();
+}
+
+void RenderQueue::setModelMemory(size_t hostBytes, size_t gpuBytes)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_HostBytes = hostBytes;
+  m_GpuBytes = gpuBytes;
+}
+
+size_t RenderQueue::hostBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_HostBytes;
+}
+
+size_t RenderQueue::gpuBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_GpuBytes;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cameraViews.hpp"
+#include "filesystem.hpp"
+#include "imageEncoders.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// An image requested to the render server
+struct RenderJob
+{
+  CameraView view;        // Size 0: the size of the server
+  bool hasCamera = false; // Else the default camera of the model
+  uint32_t sampleCount = 1;
+  ImageFormat format = ImageFormat::PNG;
+  fs::path outputPath; // Written there if not empty, else returned encoded
+};
+
+struct RenderResult
+{
+  bool ok = false;
+  std::string error;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<unsigned char> bytes; // Encoded image, without outputPath
+  double renderTime = 0;            // Draw and readback, in milliseconds
+  double encodeTime = 0;            // Encoding and writing, in milliseconds
+};
+
+// Jobs of the render server for the thread rendering one model: the thread
+// loads the model once, then renders the jobs one at a time until the server
+// closes the queue. The server waits for each job, so that only one thread
+// uses OpenGL at a time.
+class RenderQueue
+{
+public:
+  /** Server side **/
+  // Hand a job to the thread and wait for its result. Fail if the thread
+  // stopped, if it could not load the model for example.
+  RenderResult render(const RenderJob &job);
+  // Make pop() return false
+  void close();
+  // Whether the thread stopped, it renders no more jobs
+  bool isStopped() const;
+
+  /** Rendering thread side **/
+  // Wait for the next job, return false once the queue is closed
+  bool pop(RenderJob &job);
+  void done(RenderResult result);
+  // The thread is stopping, with the reason if it stops on an error
+  void stopped(const std::string &error = {});
+
+  // Memory used by the model, estimated by the thread once it is loaded
+  void setModelMemory(size_t hostBytes, size_t gpuBytes);
+  size_t hostBytes() const;
+  size_t gpuBytes() const;
+
+private:
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  RenderJob m_Job;
+  bool m_HasJob = false;
+  RenderResult m_Result;
+  bool m_HasResult = false;
+  bool m_Closed = false;
+  bool m_Stopped = false;
+  std::string m_Error;
+  size_t m_HostBytes = 0;
+  size_t m_GpuBytes = 0;
+};
@@ -0,0 +1,131 @@
+#include "sampleAccumulator.hpp"
+
+#include <cassert>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+
+// Radical inverse of index in base, in [0, 1)
+float halton(int index, int base)
+{
+  float result = 0.f;
+  float fraction = 1.f;
+  while (index > 0) {
+    fraction /= base;
+    result += fraction * (index % base);
+    index /= base;
+  }
+  return result;
+}
+
+GLuint createTexture(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+  // Copied texel to pixel, never filtered
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
+
+} // namespace
+
+SampleAccumulator::~SampleAccumulator()
+{
+  glDeleteFramebuffers(1, &m_FrameFramebuffer);
+  glDeleteFramebuffers(1, &m_AccumulationFramebuffer);
+  glDeleteTextures(1, &m_FrameTexture);
+  glDeleteTextures(1, &m_DepthTexture);
+  glDeleteTextures(1, &m_AccumulationTexture);
+}
+
+void SampleAccumulator::resize(GLsizei width, GLsizei height)
+{
+  if (width == m_Width && height == m_Height) {
+    return;
+  }
+  m_Width = width;
+  m_Height = height;
+  m_SampleCount = 0;
+
+  glDeleteTextures(1, &m_FrameTexture);
+  glDeleteTextures(1, &m_DepthTexture);
+  glDeleteTextures(1, &m_AccumulationTexture);
+  // Half floats keep the fraction of the 8 bits levels that the average of
+  // many samples resolves
+  m_FrameTexture = createTexture(GL_RGBA16F, width, height);
+  m_DepthTexture = createTexture(GL_DEPTH_COMPONENT32F, width, height);
+  m_AccumulationTexture = createTexture(GL_RGBA32F, width, height);
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  if (!m_FrameFramebuffer) {
+    glGenFramebuffers(1, &m_FrameFramebuffer);
+    glGenFramebuffers(1, &m_AccumulationFramebuffer);
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FrameFramebuffer);
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_FrameTexture, 0);
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTexture, 0);
+  auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_AccumulationFramebuffer);
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_AccumulationTexture, 0);
+  framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  (void)framebufferStatus;
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+}
+
+glm::vec2 SampleAccumulator::nextJitter() const
+{
+  if (m_SampleCount == 0) {
+    return glm::vec2(0);
+  }
+  // From index 2, the index 1 is the center of the pixel
+  const auto index = m_SampleCount + 1;
+  return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+}
+
+glm::mat4 SampleAccumulator::jitterProjection(const glm::mat4 &projMatrix,
+    const glm::vec2 &jitter, const glm::ivec2 &viewportSize)
+{
+  // A pixel is 2 / viewportSize in normalized device coordinates
+  const auto offset = 2.f * jitter / glm::vec2(viewportSize);
+  return glm::translate(glm::mat4(1), glm::vec3(offset, 0)) * projMatrix;
+}
+
+void SampleAccumulator::bindFrame() const
+{
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FrameFramebuffer);
+}
+
+void SampleAccumulator::beginAccumulation() const
+{
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_AccumulationFramebuffer);
+  // The first sample overwrites the target, which may hold anything (even
+  // NaNs that a zero weight would keep)
+  if (m_SampleCount == 0) {
+    return;
+  }
+  // average(n + 1) = average(n) + (sample - average(n)) / (n + 1)
+  glEnable(GL_BLEND);
+  glBlendColor(0.f, 0.f, 0.f, 1.f / (m_SampleCount + 1));
+  glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+}
+
+void SampleAccumulator::endAccumulation()
+{
+  glDisable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ZERO);
+  ++m_SampleCount;
+}
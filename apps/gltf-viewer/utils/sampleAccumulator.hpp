@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Progressive refinement: while the view stays still, each frame renders the
+// scene with the projection jittered by a sub-pixel offset into a frame
+// target, then the caller blends it into a RGBA32F accumulation target that
+// holds the running average of the samples: a supersampled image refined
+// over the frames.
+//
+// The first sample is not jittered, so that one sample gives the same image
+// as a frame rendered without accumulation. The next ones follow the Halton
+// sequence in bases 2 and 3, which covers the pixel evenly whatever the
+// number of samples.
+class SampleAccumulator
+{
+public:
+  SampleAccumulator() = default;
+  ~SampleAccumulator();
+
+  SampleAccumulator(const SampleAccumulator &) = delete;
+  SampleAccumulator &operator=(const SampleAccumulator &) = delete;
+
+  // Allocate the targets for a window of width x height pixels, does nothing
+  // if they already have that size. Resizing restarts the accumulation.
+  void resize(GLsizei width, GLsizei height);
+
+  // Restart the accumulation, the next sample replaces the average
+  void reset() { m_SampleCount = 0; }
+
+  // Number of samples in the average
+  int sampleCount() const { return m_SampleCount; }
+
+  // Sub-pixel offset of the next sample, in pixels in [-0.5, 0.5]
+  glm::vec2 nextJitter() const;
+
+  // Projection matrix moved by jitter pixels on a viewport of viewportSize
+  // pixels
+  static glm::mat4 jitterProjection(const glm::mat4 &projMatrix,
+      const glm::vec2 &jitter, const glm::ivec2 &viewportSize);
+
+  // Bind the frame target to GL_DRAW_FRAMEBUFFER, to render the next sample
+  void bindFrame() const;
+
+  // Bind the accumulation target to GL_DRAW_FRAMEBUFFER and set the blending
+  // that averages the fragments drawn with the samples already accumulated.
+  // The caller then copies the frame texture over the viewport.
+  void beginAccumulation() const;
+
+  // Restore the blending state, and count the sample accumulated
+  void endAccumulation();
+
+  GLuint frameTexture() const { return m_FrameTexture; }
+  GLuint accumulationTexture() const { return m_AccumulationTexture; }
+
+private:
+  GLuint m_FrameFramebuffer = 0;
+  GLuint m_FrameTexture = 0;
+  GLuint m_DepthTexture = 0;
+  GLuint m_AccumulationFramebuffer = 0;
+  GLuint m_AccumulationTexture = 0;
+  GLsizei m_Width = 0;
+  GLsizei m_Height = 0;
+
+  int m_SampleCount = 0;
+};
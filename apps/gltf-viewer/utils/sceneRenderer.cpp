@@ -0,0 +1,1374 @@
+#include "sceneRenderer.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+
+// Frames between two measures of the overdraw, for the auto depth pre-pass
+const uint64_t OVERDRAW_MEASURE_PERIOD = 30;
+
+// A negative determinant mirrors the primitive, and its winding
+GLenum frontFace(const glm::mat4 &modelMatrix)
+{
+  return glm::determinant(glm::mat3(modelMatrix)) < 0 ? GL_CW : GL_CCW;
+}
+
+} // namespace
+
+SceneRenderer::SceneRenderer(const tinygltf::Model &model,
+    SceneResources resources, const fs::path &shadersPath,
+    const std::string &vertexShader, const std::string &fragmentShader,
+    const fs::path &programCachePath, GLsizei width, GLsizei height) :
+    m_Model(model),
+    m_Resources(std::move(resources)),
+    m_Width(width),
+    m_Height(height),
+    m_ViewportSize(width, height),
+    m_VertexShaderPath(shadersPath / vertexShader),
+    m_FragmentShaderPath(shadersPath / fragmentShader),
+    m_GBufferShaderPath(shadersPath / "gbuffer.fs.glsl"),
+    m_FullScreenShaderPath(shadersPath / "fullscreen_triangle.vs.glsl"),
+    m_LightingShaderPath(shadersPath / "deferred_lighting.fs.glsl"),
+    m_DepthOnlyShaderPath(shadersPath / "depth_only.fs.glsl"),
+    m_UpscaleShaderPath(shadersPath / "upscale.fs.glsl"),
+    m_AuxiliaryBuffersShaderPath(shadersPath / "auxiliary_buffers.fs.glsl"),
+    m_ProgramBinaryCache(programCachePath),
+    m_ForwardPrograms([this](uint32_t featureMask) {
+      return buildProgram(featureMask);
+    }),
+    m_ClusteredLights(shadersPath / "cluster_lights.cs.glsl")
+{
+  //  compute the bounding box of the scene
+  computeSceneBounds(model, m_BboxMin, m_BboxMax);
+  const auto diagVector = m_BboxMax - m_BboxMin;
+  const float maxDistance =
+      glm::length(diagVector) > 0 ? glm::length(diagVector) : 100.f;
+  m_ZNear = 0.001f * maxDistance;
+  m_ZFar = 1.5f * maxDistance;
+  setPerspective(DEFAULT_FOVY);
+
+  computePunctualLights(model, m_SceneLights);
+  m_Settings.useClusteredLighting = !m_SceneLights.empty();
+  std::cout << m_SceneLights.size() << " punctual lights in the scene"
+            << std::endl;
+
+  float white[] = {1, 1, 1, 1};
+  glGenTextures(1, &m_WhiteTexture);
+  glBindTexture(GL_TEXTURE_2D, m_WhiteTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, white);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  for (const auto &batch : m_Resources.instanceBatches) {
+    m_InstanceCount += batch.instanceCount;
+  }
+
+  m_PrimitiveCenters.resize(model.meshes.size());
+  m_MeshCenters.resize(model.meshes.size());
+  m_MeshRadii.resize(model.meshes.size(), 0.f);
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    auto meshMin = glm::vec3(std::numeric_limits<float>::max());
+    auto meshMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const auto &primitive : model.meshes[meshIdx].primitives) {
+      glm::vec3 primitiveMin, primitiveMax;
+      computePrimitiveBounds(model, primitive, primitiveMin, primitiveMax);
+      m_PrimitiveCenters[meshIdx].push_back(
+          0.5f * (primitiveMin + primitiveMax));
+      meshMin = glm::min(meshMin, primitiveMin);
+      meshMax = glm::max(meshMax, primitiveMax);
+    }
+    if (!model.meshes[meshIdx].primitives.empty()) {
+      m_MeshCenters[meshIdx] = 0.5f * (meshMin + meshMax);
+      m_MeshRadii[meshIdx] = 0.5f * glm::length(meshMax - meshMin);
+    }
+  }
+  computeMeshInstances(model, m_MeshInstances);
+  for (const auto &batch : m_Resources.instanceBatches) {
+    const auto &instances = m_MeshInstances[batch.meshIndex];
+    m_BatchInstanceOrders.emplace_back(instances.size());
+    std::iota(begin(m_BatchInstanceOrders.back()),
+        end(m_BatchInstanceOrders.back()), 0);
+    GLenum batchFrontFace = frontFace(instances.front());
+    for (const auto &instance : instances) {
+      if (frontFace(instance) != batchFrontFace) {
+        batchFrontFace = GL_NONE;
+        break;
+      }
+    }
+    m_BatchFrontFaces.push_back(batchFrontFace);
+  }
+
+  glGenVertexArrays(1, &m_FullScreenVertexArray);
+
+  // Setup OpenGL state for rendering
+  glEnable(GL_DEPTH_TEST);
+}
+
+SceneRenderer::~SceneRenderer()
+{
+  glDeleteVertexArrays(1, &m_FullScreenVertexArray);
+  glDeleteTextures(1, &m_WhiteTexture);
+}
+
+void SceneRenderer::loadEnvironment(
+    const fs::path &path, const fs::path &cacheDirectory)
+{
+  // GLFW is not initialized with a headless context, no glfwGetTime
+  const auto start = std::chrono::steady_clock::now();
+  bool fromCache = false;
+  m_EnvironmentLighting =
+      loadEnvironmentLighting(path, cacheDirectory, &fromCache);
+  m_EnvironmentTextures = createEnvironmentTextures(m_EnvironmentLighting);
+  m_Settings.useImageBasedLighting = true;
+  std::stringstream report;
+  report << "Environment "
+         << (fromCache ? "loaded from the cache" : "precomputed") << " in "
+         << std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start)
+                .count()
+         << " ms";
+  m_EnvironmentReport = report.str();
+  std::cout << m_EnvironmentReport << std::endl;
+}
+
+void SceneRenderer::precompilePrograms()
+{
+  const auto start = std::chrono::steady_clock::now();
+  // With the deferred renderer the materials are drawn by the G-buffer pass
+  const uint32_t geometryFeatures = m_Settings.useDeferredRendering
+                                        ? uint32_t(GBUFFER_PASS)
+                                        : sceneFeatures();
+  m_ForwardPrograms.get(geometryFeatures);
+  for (int i = 0; i < int(m_Model.materials.size()); ++i) {
+    m_ForwardPrograms.get(materialFeatures(i) | geometryFeatures);
+  }
+  if (m_Settings.useDeferredRendering) {
+    m_ForwardPrograms.get(sceneFeatures() | LIGHTING_PASS);
+  }
+  std::cout << m_ForwardPrograms.size() << " program permutations compiled in "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms" << std::endl;
+  m_ProgramBinaryCache.logStats();
+}
+
+void SceneRenderer::setSize(GLsizei width, GLsizei height)
+{
+  m_Width = width;
+  m_Height = height;
+  m_ViewportSize = glm::ivec2(width, height);
+}
+
+void SceneRenderer::setPerspective(float fovy)
+{
+  m_ProjMatrix =
+      glm::perspective(fovy, float(m_Width) / m_Height, m_ZNear, m_ZFar);
+  m_FrameProjMatrix = m_ProjMatrix;
+  m_ImageProjMatrix = m_ProjMatrix;
+}
+
+void SceneRenderer::setTileProjection(const glm::mat4 &projMatrix)
+{
+  m_ProjMatrix = projMatrix;
+  m_FrameProjMatrix = projMatrix;
+}
+
+ForwardProgram SceneRenderer::buildProgram(uint32_t featureMask)
+{
+  std::vector<fs::path> shaderPaths = {
+      m_VertexShaderPath, m_FragmentShaderPath};
+  if (featureMask & GBUFFER_PASS) {
+    shaderPaths = {m_VertexShaderPath, m_GBufferShaderPath};
+  } else if (featureMask & LIGHTING_PASS) {
+    shaderPaths = {m_FullScreenShaderPath, m_LightingShaderPath};
+  } else if (featureMask & DEPTH_PREPASS) {
+    shaderPaths = {m_VertexShaderPath, m_DepthOnlyShaderPath};
+  } else if (featureMask & COVERAGE_PASS) {
+    shaderPaths = {m_FullScreenShaderPath, m_DepthOnlyShaderPath};
+  } else if (featureMask & UPSCALE_PASS) {
+    shaderPaths = {m_FullScreenShaderPath, m_UpscaleShaderPath};
+  } else if (featureMask & AUXILIARY_PASS) {
+    shaderPaths = {m_VertexShaderPath, m_AuxiliaryBuffersShaderPath};
+  }
+  return ForwardProgram{m_ProgramBinaryCache.compileProgram(
+      shaderPaths, forwardProgramDefines(featureMask))};
+}
+
+uint32_t SceneRenderer::materialFeatures(int materialIndex) const
+{
+  uint32_t features = 0;
+  if (materialIndex < 0) {
+    return features;
+  }
+  const auto &material = m_Model.materials[materialIndex];
+  const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+  const auto hasTexture = [&](int textureIndex) {
+    return textureIndex >= 0 && m_Model.textures[textureIndex].source >= 0;
+  };
+  if (hasTexture(pbrMetallicRoughness.baseColorTexture.index)) {
+    features |= HAS_BASE_COLOR_TEXTURE;
+  }
+  if (hasTexture(pbrMetallicRoughness.metallicRoughnessTexture.index)) {
+    features |= HAS_METALLIC_ROUGHNESS_TEXTURE;
+  }
+  if (m_Settings.normalMapping && hasTexture(material.normalTexture.index)) {
+    features |= HAS_NORMAL_MAP;
+  }
+  const auto &emissiveFactor = material.emissiveFactor;
+  if (emissiveFactor[0] > 0 || emissiveFactor[1] > 0 ||
+      emissiveFactor[2] > 0) {
+    features |= HAS_EMISSIVE;
+    if (hasTexture(material.emissiveTexture.index)) {
+      features |= HAS_EMISSIVE_TEXTURE;
+    }
+  }
+  if (material.doubleSided) {
+    features |= DOUBLE_SIDED;
+  }
+  return features;
+}
+
+uint32_t SceneRenderer::sceneFeatures() const
+{
+  uint32_t features = 0;
+  if (m_Settings.useImageBasedLighting) {
+    features |= IMAGE_BASED_LIGHTING;
+  }
+  if (m_Settings.useShadows) {
+    features |= HAS_SHADOWS;
+  }
+  if (m_Settings.useClusteredLighting) {
+    return features | CLUSTERED_LIGHTS;
+  }
+  const uint32_t pointLightCount =
+      (m_Settings.enablePointLight ? 1 : 0) +
+      (m_Settings.enablePointLightAdditionnal ? NB_POINTS_LIGHTS - 1 : 0);
+  features |= pointLightCount << NUM_POINT_LIGHTS_SHIFT;
+  if (m_Settings.enableSpotLight) {
+    features |= HAS_SPOT_LIGHT;
+  }
+  return features;
+}
+
+bool SceneRenderer::isBlended(int materialIndex) const
+{
+  return materialIndex >= 0 &&
+         m_Model.materials[materialIndex].alphaMode == "BLEND";
+}
+
+void SceneRenderer::bindMaterial(
+    const ForwardProgram &program, int materialIndex) const
+{
+  // Textures are indexed like model.textures, the white texture when absent
+  const auto bindTexture = [&](GLint location, GLuint unit,
+                               int textureIndex) {
+    if (location >= 0) {
+      auto textureObject = m_WhiteTexture;
+      if (textureIndex >= 0 && m_Model.textures[textureIndex].source >= 0) {
+        textureObject = m_Resources.textureObjects[textureIndex];
+      }
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D, textureObject);
+      glUniform1i(location, unit);
+    }
+  };
+
+  if (materialIndex >= 0) {
+    // only valid is materialIndex >= 0
+    const auto &material = m_Model.materials[materialIndex];
+    const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+
+    bindTexture(program.baseColorTextureLocation, 0,
+        pbrMetallicRoughness.baseColorTexture.index);
+    if (program.baseColorFactorLocation >= 0) {
+      glUniform4f(program.baseColorFactorLocation,
+          (float)pbrMetallicRoughness.baseColorFactor[0],
+          (float)pbrMetallicRoughness.baseColorFactor[1],
+          (float)pbrMetallicRoughness.baseColorFactor[2],
+          (float)pbrMetallicRoughness.baseColorFactor[3]);
+    }
+
+    if (program.metallicFactorLocation >= 0) {
+      glUniform1f(program.metallicFactorLocation,
+          (float)pbrMetallicRoughness.metallicFactor);
+    }
+    if (program.roughnessFactorLocation >= 0) {
+      glUniform1f(program.roughnessFactorLocation,
+          (float)pbrMetallicRoughness.roughnessFactor);
+    }
+    bindTexture(program.metallicRoughnessTextureLocation, 1,
+        pbrMetallicRoughness.metallicRoughnessTexture.index);
+
+    bindTexture(
+        program.emissiveTextureLocation, 2, material.emissiveTexture.index);
+    if (program.emissiveFactorLocation >= 0) {
+      auto emissiveFactor = material.emissiveFactor;
+      glUniform3f(program.emissiveFactorLocation, (float)emissiveFactor[0],
+          (float)emissiveFactor[1], (float)emissiveFactor[2]);
+    }
+
+    // NORMAL MAPPING //
+    bindTexture(
+        program.normalTextureLocation, 3, material.normalTexture.index);
+  } else {
+    // The program of a primitive without material has no texture
+    if (program.baseColorFactorLocation >= 0) {
+      glUniform4f(program.baseColorFactorLocation, 1, 1, 1, 1);
+    }
+    if (program.metallicFactorLocation >= 0) {
+      glUniform1f(program.metallicFactorLocation, 0.f);
+    }
+    if (program.roughnessFactorLocation >= 0) {
+      glUniform1f(program.roughnessFactorLocation, 0.f);
+    }
+    if (program.emissiveFactorLocation >= 0) {
+      glUniform3f(program.emissiveFactorLocation, 0, 0, 0);
+    }
+  }
+}
+
+void SceneRenderer::setFrameUniforms(const ForwardProgram &program) const
+{
+  const auto &settings = m_Settings;
+
+  /** Directionnal Light **/
+  if (program.lightDirectionLocation >= 0) {
+    if (settings.lightFromCamera)
+      glUniform3f(program.lightDirectionLocation, 0, 0, 1);
+    else
+      glUniform3fv(program.lightDirectionLocation, 1,
+          glm::value_ptr(glm::normalize(glm::vec3(
+              m_ViewMatrix * glm::vec4(settings.lightDirection, 0.)))));
+  }
+  if (program.lightIntensityLocation >= 0) {
+    glUniform3fv(program.lightIntensityLocation, 1,
+        glm::value_ptr(settings.lightIntensity));
+  }
+
+  /** Point Light **/
+  // The enabled lights are packed at the start of the array, its size being
+  // the number of enabled lights
+  int pointLightIndex = 0;
+  for (int i = 0; i < NB_POINTS_LIGHTS; ++i) {
+    if ((i == 0 && !settings.enablePointLight) ||
+        (i > 0 && !settings.enablePointLightAdditionnal)) {
+      continue;
+    }
+    const auto slot = pointLightIndex++;
+    if (program.pointLightPositionLocation[slot] >= 0) {
+      glUniform3fv(program.pointLightPositionLocation[slot], 1,
+          glm::value_ptr(glm::vec3(
+              m_ViewMatrix * glm::vec4(settings.pointLightPosition[i], 1.))));
+      glUniform3fv(program.pointLightColorLocation[slot], 1,
+          glm::value_ptr(settings.pointLightIntensity[i]));
+      glUniform1f(program.pointLightConstantLocation[slot], 1.0f);
+      glUniform1f(program.pointLightLinearLocation[slot], 0.09f);
+      glUniform1f(program.pointLightQuadraticLocation[slot], 0.032f);
+    }
+  }
+
+  /** Spot Light **/
+  if (program.spotLightPositionLocation >= 0) {
+    glUniform3fv(program.spotLightPositionLocation, 1,
+        glm::value_ptr(settings.spotLightPosition));
+    glUniform3fv(program.spotLightDirectionLocation, 1,
+        glm::value_ptr(settings.spotLightDirection));
+    glUniform3fv(program.spotLightColorLocation, 1,
+        glm::value_ptr(settings.spotLightIntensity));
+    glUniform1f(program.spotLightCutOffLocation,
+        glm::cos(glm::radians(settings.spotLightCutOff)));
+    glUniform1f(program.spotLightOuterCutOffLocation,
+        glm::cos(glm::radians(settings.spotLightOuterCutOff)));
+    glUniform1f(program.spotLightConstantLocation, 1.0f);
+    glUniform1f(program.spotLightLinearLocation, 0.09f);
+    glUniform1f(program.spotLightQuadraticLocation, 0.032f);
+  }
+
+  /** Clustered lights **/
+  if (program.clusterGridSizeLocation >= 0) {
+    const auto &gridSize = m_ClusteredLights.gridSize();
+    glUniform3ui(
+        program.clusterGridSizeLocation, gridSize.x, gridSize.y, gridSize.z);
+    glUniform2fv(program.clusterTileSizeLocation, 1,
+        glm::value_ptr(m_ClusteredLights.tileSize()));
+    glUniform2fv(program.clusterDepthScaleBiasLocation, 1,
+        glm::value_ptr(m_ClusteredLights.depthScaleBias()));
+  }
+
+  /** Image based lighting **/
+  // Units 5 and 6, after the ones of the materials and of the G-buffer
+  if (program.irradianceSHLocation >= 0) {
+    glUniform3fv(program.irradianceSHLocation, 9,
+        glm::value_ptr(m_EnvironmentLighting.irradianceSH[0]));
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_EnvironmentTextures.specularCubemap);
+    glUniform1i(program.specularEnvironmentLocation, 5);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, m_EnvironmentTextures.brdfLut);
+    glUniform1i(program.brdfLutLocation, 6);
+    glActiveTexture(GL_TEXTURE0);
+    const auto viewToWorld = glm::transpose(glm::mat3(m_ViewMatrix));
+    glUniformMatrix3fv(program.viewToWorldLocation, 1, GL_FALSE,
+        glm::value_ptr(viewToWorld));
+    glUniform1f(
+        program.environmentIntensityLocation, settings.environmentIntensity);
+  }
+
+  /** Shadows **/
+  // Unit 7, after the ones of image based lighting
+  if (program.shadowMapsLocation >= 0) {
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_ShadowMaps.texture());
+    glUniform1i(program.shadowMapsLocation, 7);
+    glActiveTexture(GL_TEXTURE0);
+    // From the view space of the shaders to the clip space of the lights
+    const auto viewToWorld = glm::inverse(m_ViewMatrix);
+    glm::mat4 shadowMatrices[ShadowMaps::LAYER_COUNT];
+    for (GLsizei i = 0; i < ShadowMaps::LAYER_COUNT; ++i) {
+      const auto &view = m_ShadowMaps.view(i);
+      shadowMatrices[i] = view.projMatrix * view.viewMatrix * viewToWorld;
+    }
+    glUniformMatrix4fv(program.shadowMatricesLocation, ShadowMaps::LAYER_COUNT,
+        GL_FALSE, glm::value_ptr(shadowMatrices[0]));
+    glUniform1fv(program.cascadeEndsLocation, ShadowMaps::CASCADE_COUNT,
+        m_CascadeEnds);
+  }
+
+  if (program.useInstancingLocation >= 0) {
+    glUniform1i(program.useInstancingLocation, settings.useInstancing);
+  }
+  glUniformMatrix4fv(
+      program.viewMatrixLocation, 1, GL_FALSE, glm::value_ptr(m_ViewMatrix));
+  glUniformMatrix4fv(program.projMatrixLocation, 1, GL_FALSE,
+      glm::value_ptr(m_FrameProjMatrix));
+  if (program.inverseProjMatrixLocation >= 0) {
+    glUniformMatrix4fv(program.inverseProjMatrixLocation, 1, GL_FALSE,
+        glm::value_ptr(glm::inverse(m_FrameProjMatrix)));
+  }
+  if (program.viewportSizeLocation >= 0) {
+    glUniform2f(program.viewportSizeLocation, float(m_ViewportSize.x),
+        float(m_ViewportSize.y));
+  }
+}
+
+void SceneRenderer::setNodeUniforms(const ForwardProgram &program) const
+{
+  //  init  modelViewMatrix, modelViewProjectionMatrix, and
+  //  normalMatrix
+  const glm::mat4 MV = m_ViewMatrix * m_NodeModelMatrix;
+  const glm::mat4 MVP = m_FrameProjMatrix * MV;
+  const glm::mat4 N = glm::transpose(glm::inverse(MV));
+  // Send all to Shaders
+  glUniformMatrix4fv(program.modelMatrixLocation, 1, GL_FALSE,
+      glm::value_ptr(m_NodeModelMatrix));
+  glUniformMatrix4fv(
+      program.modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(MV));
+  glUniformMatrix4fv(
+      program.modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(MVP));
+  glUniformMatrix4fv(
+      program.normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(N));
+}
+
+const ForwardProgram *SceneRenderer::selectProgram(uint32_t featureMask)
+{
+  if (!m_ForwardPrograms.contains(featureMask)) {
+    // A new permutation built from shaders being edited can fail
+    try {
+      m_ForwardPrograms.get(featureMask);
+    } catch (const std::exception &e) {
+      m_ShaderErrorLog = e.what();
+      return nullptr;
+    }
+  }
+  auto &program = m_ForwardPrograms.get(featureMask);
+  if (&program != m_CurrentProgram) {
+    program.program.use();
+    m_CurrentProgram = &program;
+    ++m_ProgramSwitchCount;
+    // The node matrices of this program are those of a previous node
+    m_NodeMatrixChanged = true;
+  }
+  if (program.frameIndex != m_FrameIndex) {
+    setFrameUniforms(program);
+    program.frameIndex = m_FrameIndex;
+  }
+  return &program;
+}
+
+const ForwardProgram *SceneRenderer::useProgram(int materialIndex)
+{
+  const auto materialMask = materialIndex >= 0 && !m_DepthOnlyPass
+                                ? m_MaterialFeatureMasks[materialIndex]
+                                : 0;
+  const auto program = selectProgram(materialMask | m_SceneFeatureMask);
+  if (program && !m_Settings.useInstancing && m_NodeMatrixChanged) {
+    setNodeUniforms(*program);
+    m_NodeMatrixChanged = false;
+  }
+  return program;
+}
+
+void SceneRenderer::drawPrimitive(int meshIdx, size_t primitiveIdx,
+    GLsizei instanceCount, GLuint firstInstance)
+{
+  const auto &primitive = m_Model.meshes[meshIdx].primitives[primitiveIdx];
+  const auto bindVertexArray = [&](GLuint vao) {
+    if (vao != m_BoundVertexArray) {
+      glBindVertexArray(vao);
+      m_BoundVertexArray = vao;
+      ++m_VaoBindCount;
+    }
+  };
+
+  if (m_Resources.useMeshArena) {
+    const auto &meshArena = m_Resources.meshArena;
+    const auto &arenaPrimitive =
+        meshArena.primitives[meshArena.meshToFirstPrimitive[meshIdx] +
+                             primitiveIdx];
+    if (arenaPrimitive.indexCount == 0) {
+      return;
+    }
+    const auto program = useProgram(primitive.material);
+    if (!program) {
+      return;
+    }
+    if (!m_DepthOnlyPass) {
+      bindMaterial(*program, primitive.material);
+    }
+    bindVertexArray(arenaPrimitive.vertexArray);
+    glDrawElementsInstancedBaseVertexBaseInstance(arenaPrimitive.mode,
+        arenaPrimitive.indexCount, GL_UNSIGNED_INT,
+        (const GLvoid *)arenaPrimitive.indexByteOffset, instanceCount,
+        arenaPrimitive.baseVertex, firstInstance);
+    ++m_DrawCallCount;
+    return;
+  }
+
+  const auto program = useProgram(primitive.material);
+  if (!program) {
+    return;
+  }
+  if (!m_DepthOnlyPass) {
+    bindMaterial(*program, primitive.material);
+  }
+  bindVertexArray(
+      m_Resources.vertexArrayObjects[m_Resources.meshToVertexArrays[meshIdx]
+                                         .begin +
+                                     primitiveIdx]);
+  if (primitive.indices >= 0) {
+    const auto &accessor = m_Model.accessors[primitive.indices];
+    const auto &bufferView = m_Model.bufferViews[accessor.bufferView];
+    const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+    glDrawElementsInstancedBaseInstance(primitive.mode,
+        GLsizei(accessor.count), accessor.componentType,
+        (const GLvoid *)byteOffset, instanceCount, firstInstance);
+  } else {
+    const auto accessorIdx = (*begin(primitive.attributes)).second;
+    const auto &accessor = m_Model.accessors[accessorIdx];
+    glDrawArraysInstancedBaseInstance(primitive.mode, 0,
+        GLsizei(accessor.count), instanceCount, firstInstance);
+  }
+  ++m_DrawCallCount;
+}
+
+void SceneRenderer::drawUpscale(GLuint texture, const glm::ivec2 &sourceSize)
+{
+  const auto program = selectProgram(UPSCALE_PASS);
+  if (!program) {
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glUniform1i(program->sourceTextureLocation, 0);
+  glUniform2f(
+      program->sourceSizeLocation, float(sourceSize.x), float(sourceSize.y));
+  // Set for each copy, the viewport may have changed since the frame uniforms
+  // were set
+  glUniform2f(program->viewportSizeLocation, float(m_ViewportSize.x),
+      float(m_ViewportSize.y));
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_FullScreenVertexArray);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+  glEnable(GL_DEPTH_TEST);
+  ++m_DrawCallCount;
+}
+
+void SceneRenderer::drawItems(const std::vector<DrawItem> &items)
+{
+  bool cullFaceEnabled = false;
+  GLenum currentFrontFace = GL_CCW;
+  m_NodeMatrixChanged = true;
+  for (const auto &item : items) {
+    const auto materialIndex = m_Model.meshes[item.meshIndex]
+                                   .primitives[item.primitiveIndex]
+                                   .material;
+    const bool doubleSided =
+        materialIndex >= 0 && m_Model.materials[materialIndex].doubleSided;
+    const bool cullFace = m_Settings.cullBackFaces && !doubleSided &&
+                          item.frontFace != GL_NONE;
+    if (cullFace != cullFaceEnabled) {
+      if (cullFace) {
+        glEnable(GL_CULL_FACE);
+      } else {
+        glDisable(GL_CULL_FACE);
+      }
+      cullFaceEnabled = cullFace;
+    }
+    // Also needed by the double sided materials, to flip their normals
+    const auto itemFrontFace =
+        item.frontFace != GL_NONE ? item.frontFace : GL_CCW;
+    if (itemFrontFace != currentFrontFace) {
+      glFrontFace(itemFrontFace);
+      currentFrontFace = itemFrontFace;
+    }
+    if (!m_Settings.useInstancing && item.modelMatrix != m_NodeModelMatrix) {
+      m_NodeModelMatrix = item.modelMatrix;
+      m_NodeMatrixChanged = true;
+    }
+    drawPrimitive(item.meshIndex, item.primitiveIndex, item.instanceCount,
+        item.firstInstance);
+  }
+  glDisable(GL_CULL_FACE);
+  glFrontFace(GL_CCW);
+}
+
+uint64_t SceneRenderer::shadowCasterSignature(const ShadowView &view) const
+{
+  auto signature = FNV_OFFSET_BASIS;
+  for (size_t meshIdx = 0; meshIdx < m_MeshInstances.size(); ++meshIdx) {
+    for (const auto &instance : m_MeshInstances[meshIdx]) {
+      const auto center =
+          glm::vec3(instance * glm::vec4(m_MeshCenters[meshIdx], 1));
+      const auto scale = glm::max(glm::length(glm::vec3(instance[0])),
+          glm::max(glm::length(glm::vec3(instance[1])),
+              glm::length(glm::vec3(instance[2]))));
+      if (sphereInShadowView(view, center, scale * m_MeshRadii[meshIdx])) {
+        signature = fnv1a64(&meshIdx, sizeof(meshIdx), signature);
+        signature =
+            fnv1a64(glm::value_ptr(instance), sizeof(instance), signature);
+      }
+    }
+  }
+  return signature;
+}
+
+void SceneRenderer::drawShadowMaps()
+{
+  const auto &settings = m_Settings;
+  const auto cameraViewMatrix = m_ViewMatrix;
+  const auto cameraProjMatrix = m_FrameProjMatrix;
+  const auto viewToWorld = glm::inverse(cameraViewMatrix);
+  ShadowView views[ShadowMaps::LAYER_COUNT];
+  // Without the jitter of progressive refinement, so that the cascades stay
+  // cached while the samples are accumulated
+  const auto worldLightDirection = glm::normalize(
+      settings.lightFromCamera ? glm::vec3(viewToWorld * glm::vec4(0, 0, 1, 0))
+                               : settings.lightDirection);
+  fitShadowCascades(cameraViewMatrix, m_ImageProjMatrix, m_ZNear, m_ZFar,
+      worldLightDirection, m_BboxMin, m_BboxMax, m_ShadowMaps.size(), views,
+      m_CascadeEnds);
+  // The spot light is attached to the camera. With clustered lighting it goes
+  // through the clusters, which are not shadowed.
+  const bool spotShadow =
+      settings.enableSpotLight && !settings.useClusteredLighting;
+  if (spotShadow) {
+    views[ShadowMaps::SPOT_LAYER] = spotShadowView(
+        glm::vec3(viewToWorld * glm::vec4(settings.spotLightPosition, 1)),
+        glm::vec3(viewToWorld * glm::vec4(settings.spotLightDirection, 0)),
+        settings.spotLightOuterCutOff, m_BboxMin, m_BboxMax);
+  }
+  const auto layerCount =
+      spotShadow ? ShadowMaps::LAYER_COUNT : ShadowMaps::CASCADE_COUNT;
+
+  GLint targetFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+  m_DepthOnlyPass = true;
+  m_SceneFeatureMask = DEPTH_PREPASS;
+  // Slope scaled bias, against the acne of the surfaces facing the light
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(1.5f, 4.f);
+  m_ShadowMaps.beginUpdates();
+  for (GLsizei layer = 0; layer < layerCount; ++layer) {
+    const auto &view = views[layer];
+    if (m_ShadowMaps.updateLayer(layer, view, shadowCasterSignature(view))) {
+      m_ViewMatrix = view.viewMatrix;
+      m_FrameProjMatrix = view.projMatrix;
+      ++m_FrameIndex;
+      drawItems(m_OpaqueItems);
+    }
+  }
+  m_ShadowMaps.endUpdates();
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  m_DepthOnlyPass = false;
+
+  m_ViewMatrix = cameraViewMatrix;
+  m_FrameProjMatrix = cameraProjMatrix;
+  ++m_FrameIndex;
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+  glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+}
+
+void SceneRenderer::drawBlendedItems()
+{
+  if (m_BlendedItems.empty()) {
+    return;
+  }
+  m_SceneFeatureMask = sceneFeatures();
+  m_BoundVertexArray = 0;
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDepthMask(GL_FALSE);
+  drawItems(m_BlendedItems);
+  glBindVertexArray(0);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
+}
+
+void SceneRenderer::updateClusteredLights()
+{
+  const auto &settings = m_Settings;
+  m_ViewSpaceLights.clear();
+  for (int i = 0; i < NB_POINTS_LIGHTS; ++i) {
+    if ((i == 0 && !settings.enablePointLight) ||
+        (i > 0 && !settings.enablePointLightAdditionnal)) {
+      continue;
+    }
+    PunctualLight light;
+    light.position = glm::vec3(
+        m_ViewMatrix * glm::vec4(settings.pointLightPosition[i], 1.));
+    light.color = settings.pointLightIntensity[i];
+    light.attenuation = glm::vec3(1.0f, 0.09f, 0.032f);
+    light.range = computeLightRange(light.color, light.attenuation);
+    m_ViewSpaceLights.push_back(light);
+  }
+  if (settings.enableSpotLight) {
+    // The spot light is attached to the camera
+    PunctualLight light;
+    light.position = settings.spotLightPosition;
+    light.color = settings.spotLightIntensity;
+    light.attenuation = glm::vec3(1.0f, 0.09f, 0.032f);
+    light.range = computeLightRange(light.color, light.attenuation);
+    light.isSpot = true;
+    light.direction = settings.spotLightDirection;
+    light.innerConeCos = glm::cos(glm::radians(settings.spotLightCutOff));
+    light.outerConeCos = glm::cos(glm::radians(settings.spotLightOuterCutOff));
+    m_ViewSpaceLights.push_back(light);
+  }
+  for (const auto *lights : {&m_SceneLights, &m_RandomLights}) {
+    for (auto light : *lights) {
+      light.position = glm::vec3(m_ViewMatrix * glm::vec4(light.position, 1));
+      light.direction = glm::mat3(m_ViewMatrix) * light.direction;
+      m_ViewSpaceLights.push_back(light);
+    }
+  }
+  m_ClusteredLights.update(m_ViewSpaceLights, m_FrameProjMatrix, m_ZNear,
+      m_ZFar, glm::uvec2(m_ViewportSize));
+}
+
+void SceneRenderer::collectDrawItems()
+{
+  const auto &model = m_Model;
+  m_OpaqueItems.clear();
+  m_BlendedItems.clear();
+  const auto viewDepth = [&](const glm::mat4 &modelMatrix,
+                             const glm::vec3 &center) {
+    return -(m_ViewMatrix * modelMatrix * glm::vec4(center, 1)).z;
+  };
+  if (m_Settings.useInstancing) {
+    // The instances of a batch are drawn together, in the order of the
+    // instance buffer: an opaque batch is sorted by its nearest instance, a
+    // blended one by its farthest
+    const auto &instanceBatches = m_Resources.instanceBatches;
+    for (size_t batchIdx = 0; batchIdx < instanceBatches.size(); ++batchIdx) {
+      const auto &batch = instanceBatches[batchIdx];
+      const auto &mesh = model.meshes[batch.meshIndex];
+      const auto &instances = m_MeshInstances[batch.meshIndex];
+      if (mesh.primitives.empty()) {
+        continue;
+      }
+
+      // The matrices of the batch are uploaded again when their order
+      // changes, back to front if one of its primitives is blended
+      const bool blendedBatch = std::any_of(begin(mesh.primitives),
+          end(mesh.primitives), [&](const tinygltf::Primitive &primitive) {
+            return isBlended(primitive.material);
+          });
+      m_InstanceDepths.clear();
+      for (const auto &instance : instances) {
+        m_InstanceDepths.push_back(
+            viewDepth(instance, m_PrimitiveCenters[batch.meshIndex][0]));
+      }
+      m_InstanceOrder.resize(instances.size());
+      std::iota(begin(m_InstanceOrder), end(m_InstanceOrder), 0);
+      if (blendedBatch || m_Settings.sortOpaqueItems) {
+        std::sort(begin(m_InstanceOrder), end(m_InstanceOrder),
+            [&](GLuint a, GLuint b) {
+              return blendedBatch ? m_InstanceDepths[a] > m_InstanceDepths[b]
+                                  : m_InstanceDepths[a] < m_InstanceDepths[b];
+            });
+      }
+      if (m_InstanceOrder != m_BatchInstanceOrders[batchIdx]) {
+        m_BatchInstanceOrders[batchIdx] = m_InstanceOrder;
+        m_SortedInstances.clear();
+        for (const auto instanceIdx : m_InstanceOrder) {
+          m_SortedInstances.push_back(
+              computeInstanceAttributes(instances[instanceIdx]));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_Resources.instanceBufferObject);
+        glBufferSubData(GL_ARRAY_BUFFER,
+            batch.firstInstance * sizeof(InstanceAttributes),
+            m_SortedInstances.size() * sizeof(InstanceAttributes),
+            m_SortedInstances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+      }
+
+      for (size_t primitiveIndice = 0;
+           primitiveIndice < mesh.primitives.size(); ++primitiveIndice) {
+        const auto &center =
+            m_PrimitiveCenters[batch.meshIndex][primitiveIndice];
+        const bool blended =
+            isBlended(mesh.primitives[primitiveIndice].material);
+        DrawItem item{batch.meshIndex, primitiveIndice, batch.firstInstance,
+            batch.instanceCount, glm::mat4(1), m_BatchFrontFaces[batchIdx],
+            viewDepth(instances.front(), center)};
+        for (const auto &instance : instances) {
+          const auto depth = viewDepth(instance, center);
+          item.depth = blended ? glm::max(item.depth, depth)
+                               : glm::min(item.depth, depth);
+        }
+        (blended ? m_BlendedItems : m_OpaqueItems).push_back(item);
+      }
+    }
+  } else if (model.defaultScene >= 0) {
+    // The recursive function that should collect the primitives of a node
+    // We use a std::function because a simple lambda cannot be recursive
+    const std::function<void(int, const glm::mat4 &)> collectNode =
+        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+          const tinygltf::Node &node = model.nodes[nodeIdx];
+          const glm::mat4 modelMatrix =
+              getLocalToWorldMatrix(node, parentMatrix);
+          if (node.mesh >= 0) {
+            const auto &mesh = model.meshes[node.mesh];
+            for (size_t primitiveIndice = 0;
+                 primitiveIndice < mesh.primitives.size();
+                 ++primitiveIndice) {
+              const DrawItem item{node.mesh, primitiveIndice, 0, 1,
+                  modelMatrix, frontFace(modelMatrix),
+                  viewDepth(modelMatrix,
+                      m_PrimitiveCenters[node.mesh][primitiveIndice])};
+              (isBlended(mesh.primitives[primitiveIndice].material)
+                      ? m_BlendedItems
+                      : m_OpaqueItems)
+                  .push_back(item);
+            }
+          }
+          // For Children Nodes
+          for (const auto childNode : node.children) {
+            collectNode(childNode, modelMatrix);
+          }
+        };
+    // Collect the scene referenced by gltf file
+    for (const auto nodeIndice : model.scenes[model.defaultScene].nodes) {
+      collectNode(nodeIndice, glm::mat4(1));
+    }
+  }
+  if (m_Settings.sortOpaqueItems) {
+    std::sort(begin(m_OpaqueItems), end(m_OpaqueItems),
+        [](const DrawItem &a, const DrawItem &b) { return a.depth < b.depth; });
+  }
+  std::sort(begin(m_BlendedItems), end(m_BlendedItems),
+      [](const DrawItem &a, const DrawItem &b) { return a.depth > b.depth; });
+}
+
+void SceneRenderer::addScenePasses(const Camera &camera,
+    FrameGraph::Resource colorTarget, FrameGraph::Resource depthTarget)
+{
+  const auto &settings = m_Settings;
+  m_DrawCallCount = 0;
+  m_VaoBindCount = 0;
+  m_BoundVertexArray = 0;
+  m_ProgramSwitchCount = 0;
+  m_CurrentProgram = nullptr;
+
+  // Lights and camera uniforms are set again for each program used
+  ++m_FrameIndex;
+  m_ViewMatrix = camera.getViewMatrix();
+
+  // Normal mapping and the lights can be toggled, so the features of the
+  // programs are updated every frame
+  m_MaterialFeatureMasks.resize(m_Model.materials.size());
+  for (int i = 0; i < int(m_Model.materials.size()); ++i) {
+    m_MaterialFeatureMasks[i] = materialFeatures(i);
+  }
+
+  if (settings.useClusteredLighting) {
+    updateClusteredLights();
+  }
+  collectDrawItems();
+
+  const auto shadowTexture =
+      settings.useShadows
+          ? m_FrameGraph.importTexture("Shadow maps", m_ShadowMaps.texture())
+          : FrameGraph::NO_RESOURCE;
+  if (settings.useShadows) {
+    m_FrameGraph.addPass(
+        "Shadow maps",
+        [&](FrameGraph::PassBuilder &builder) {
+          builder.write(shadowTexture);
+        },
+        [this]() { drawShadowMaps(); });
+  }
+
+  // The overdraw is measured in every mode, for the stats
+  if (m_OverdrawMeter.update() && settings.depthPrePassMode == 2) {
+    // Disabled a bit under the threshold, not to switch at each measure
+    if (m_OverdrawMeter.overdraw() > settings.overdrawThreshold) {
+      m_DepthPrePassActive = true;
+    } else if (m_OverdrawMeter.overdraw() <
+               0.9f * settings.overdrawThreshold) {
+      m_DepthPrePassActive = false;
+    }
+  }
+  const bool depthPrePass =
+      settings.depthPrePassMode == 1 ||
+      (settings.depthPrePassMode == 2 && m_DepthPrePassActive);
+  const bool measureOverdraw = !m_OverdrawMeter.pending() &&
+                               m_FrameIndex % OVERDRAW_MEASURE_PERIOD == 1;
+
+  // The deferred renderer draws the geometry in the G-buffer, at the size of
+  // the image whatever the scale of dynamic resolution, then lights it in the
+  // lit color
+  const bool deferred = settings.useDeferredRendering;
+  std::vector<FrameGraph::Resource> geometryTargets = {
+      colorTarget, depthTarget};
+  FrameGraph::Resource litColor = FrameGraph::NO_RESOURCE;
+  if (deferred) {
+    geometryTargets.clear();
+    for (int i = 0; i < GBuffer::TEXTURE_COUNT; ++i) {
+      const auto texture = GBuffer::Texture(i);
+      geometryTargets.push_back(
+          m_FrameGraph.createTexture(GBuffer::textureName(texture),
+              {GBuffer::textureFormat(texture), m_Width, m_Height}));
+    }
+    litColor = m_FrameGraph.createTexture(
+        "Lit color", {GBuffer::LIT_COLOR_FORMAT, m_Width, m_Height});
+  }
+  const auto sceneDepth =
+      deferred ? geometryTargets[GBuffer::DEPTH] : depthTarget;
+  const auto writeGeometryTargets = [=](FrameGraph::PassBuilder &builder) {
+    for (const auto target : geometryTargets) {
+      builder.write(target);
+    }
+  };
+
+  // The fragments passing the depth test of the first pass are those the
+  // shading pass would shade without pre-pass
+  if (depthPrePass) {
+    m_FrameGraph.addPass(
+        "Depth pre-pass", writeGeometryTargets, [this, measureOverdraw]() {
+          m_FrameGraph.bindFramebuffer();
+          glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+          glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+          m_DepthOnlyPass = true;
+          m_SceneFeatureMask = DEPTH_PREPASS;
+          glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+          if (measureOverdraw) {
+            m_OverdrawMeter.beginGeometry();
+          }
+          drawItems(m_OpaqueItems);
+          if (measureOverdraw) {
+            m_OverdrawMeter.endGeometry();
+          }
+          glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+          m_DepthOnlyPass = false;
+        });
+  }
+
+  m_FrameGraph.addPass(
+      deferred ? "G-buffer" : "Opaque",
+      [&](FrameGraph::PassBuilder &builder) {
+        writeGeometryTargets(builder);
+        if (settings.useShadows && !deferred) {
+          builder.read(shadowTexture);
+        }
+      },
+      [this, deferred, depthPrePass, measureOverdraw]() {
+        m_FrameGraph.bindFramebuffer();
+        glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+        if (deferred) {
+          // Linear base colors are encoded to the sRGB texture
+          glEnable(GL_FRAMEBUFFER_SRGB);
+        }
+        if (depthPrePass) {
+          // Only the fragments at the depth of the pre-pass are shaded
+          glDepthFunc(GL_LEQUAL);
+          glDepthMask(GL_FALSE);
+        } else {
+          glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+          if (measureOverdraw) {
+            m_OverdrawMeter.beginGeometry();
+          }
+        }
+
+        m_SceneFeatureMask =
+            deferred ? uint32_t(GBUFFER_PASS) : sceneFeatures();
+        drawItems(m_OpaqueItems);
+        glBindVertexArray(0);
+
+        if (depthPrePass) {
+          glDepthMask(GL_TRUE);
+          glDepthFunc(GL_LESS);
+        } else if (measureOverdraw) {
+          m_OverdrawMeter.endGeometry();
+        }
+        glDisable(GL_FRAMEBUFFER_SRGB);
+      });
+
+  /** Pixels covered by the geometry, to measure the overdraw **/
+  if (measureOverdraw) {
+    m_FrameGraph.addPass(
+        "Overdraw coverage",
+        [&](FrameGraph::PassBuilder &builder) { builder.write(sceneDepth); },
+        [this]() {
+          m_FrameGraph.bindFramebuffer();
+          glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+          const auto program = selectProgram(COVERAGE_PASS);
+          glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+          glDepthFunc(GL_GREATER);
+          glDepthMask(GL_FALSE);
+          m_OverdrawMeter.beginCoverage();
+          if (program) {
+            glBindVertexArray(m_FullScreenVertexArray);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            ++m_DrawCallCount;
+          }
+          m_OverdrawMeter.endCoverage();
+          glDepthMask(GL_TRUE);
+          glDepthFunc(GL_LESS);
+          glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        });
+  }
+
+  // Forward: over the opaque items. Deferred: over the lit color, tested
+  // against the depth of the G-buffer.
+  const auto blendedTarget = deferred ? litColor : colorTarget;
+  const auto addBlendedPass = [&]() {
+    if (m_BlendedItems.empty()) {
+      return;
+    }
+    m_FrameGraph.addPass(
+        "Blended",
+        [&](FrameGraph::PassBuilder &builder) {
+          builder.write(blendedTarget);
+          builder.write(sceneDepth);
+          if (settings.useShadows) {
+            builder.read(shadowTexture);
+          }
+        },
+        [this]() {
+          m_FrameGraph.bindFramebuffer();
+          glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+          drawBlendedItems();
+        });
+  };
+  if (!deferred) {
+    addBlendedPass();
+    return;
+  }
+
+  /** Deferred lighting pass **/
+  m_FrameGraph.addPass(
+      "Lighting",
+      [&](FrameGraph::PassBuilder &builder) {
+        for (int i = 0; i < GBuffer::TEXTURE_COUNT; ++i) {
+          builder.read(geometryTargets[i]);
+        }
+        if (settings.useShadows) {
+          builder.read(shadowTexture);
+        }
+        builder.write(litColor);
+        // Tested, not written
+        builder.write(sceneDepth);
+      },
+      [this, geometryTargets]() {
+        m_FrameGraph.bindFramebuffer();
+        glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+        glClear(GL_COLOR_BUFFER_BIT);
+        const auto program = selectProgram(sceneFeatures() | LIGHTING_PASS);
+        if (!program) {
+          return;
+        }
+        for (int i = 0; i < GBuffer::TEXTURE_COUNT; ++i) {
+          glActiveTexture(GL_TEXTURE0 + i);
+          glBindTexture(
+              GL_TEXTURE_2D, m_FrameGraph.texture(geometryTargets[i]));
+          glUniform1i(program->gBufferTextureLocations[i], i);
+        }
+        // The depth buffer is only read, the pixels without geometry are
+        // rejected before shading
+        glDepthFunc(GL_GREATER);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(m_FullScreenVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+        ++m_DrawCallCount;
+      });
+  addBlendedPass();
+
+  // Final pass, on the color target. The depth of the G-buffer is not copied.
+  m_FrameGraph.addPass(
+      "Resolve",
+      [&](FrameGraph::PassBuilder &builder) {
+        builder.read(litColor);
+        builder.write(colorTarget);
+      },
+      [this, litColor]() {
+        m_FrameGraph.bindFramebuffer();
+        glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+        // Only the depth of an imported framebuffer, the depth target of the
+        // scene is not attached
+        glClear(GL_DEPTH_BUFFER_BIT);
+        drawUpscale(m_FrameGraph.texture(litColor), m_ViewportSize);
+      });
+}
+
+void SceneRenderer::drawScene(const Camera &camera)
+{
+  GLint targetFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+  m_FrameGraph.reset();
+  const auto target =
+      m_FrameGraph.importFramebuffer("Target", targetFramebuffer);
+  addScenePasses(camera, target, target);
+  m_FrameGraph.compile();
+  m_FrameGraph.execute();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+}
+
+void SceneRenderer::drawFrame(const Camera &camera)
+{
+  if (!m_Settings.useDynamicResolution) {
+    drawScene(camera);
+    return;
+  }
+  GLint targetFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+  m_DynamicResolution.resize(m_Width, m_Height);
+  const auto renderSize = m_DynamicResolution.renderSize();
+
+  // The scene is rendered in the lower left corner of targets allocated at
+  // the size of the image, so that changing the scale does not reallocate
+  // them. Bilinear upscale, the texels out of the corner are never read.
+  m_FrameGraph.reset();
+  const auto target =
+      m_FrameGraph.importFramebuffer("Target", targetFramebuffer);
+  const auto sceneColor = m_FrameGraph.createTexture(
+      "Scene color", {GL_RGBA8, m_Width, m_Height, GL_LINEAR});
+  const auto sceneDepth = m_FrameGraph.createTexture(
+      "Scene depth", {GL_DEPTH_COMPONENT32F, m_Width, m_Height});
+  m_ViewportSize = renderSize;
+  addScenePasses(camera, sceneColor, sceneDepth);
+  m_FrameGraph.addPass(
+      "Upscale",
+      [&](FrameGraph::PassBuilder &builder) {
+        builder.read(sceneColor);
+        builder.write(target);
+      },
+      [this, sceneColor, renderSize]() {
+        m_DynamicResolution.endFrame(m_Settings.targetFrameTime);
+        m_ViewportSize = glm::ivec2(m_Width, m_Height);
+        m_FrameGraph.bindFramebuffer();
+        glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+        drawUpscale(m_FrameGraph.texture(sceneColor), renderSize);
+      });
+  m_FrameGraph.compile();
+  m_DynamicResolution.beginFrame();
+  m_FrameGraph.execute();
+}
+
+void SceneRenderer::accumulateSample(const Camera &camera)
+{
+  GLint targetFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+  const auto imageSize = glm::ivec2(m_Width, m_Height);
+  m_SampleAccumulator.resize(imageSize.x, imageSize.y);
+  m_FrameProjMatrix = SampleAccumulator::jitterProjection(
+      m_ProjMatrix, m_SampleAccumulator.nextJitter(), imageSize);
+  m_SampleAccumulator.bindFrame();
+  drawScene(camera);
+  m_FrameProjMatrix = m_ProjMatrix;
+
+  m_SampleAccumulator.beginAccumulation();
+  drawUpscale(m_SampleAccumulator.frameTexture(), imageSize);
+  m_SampleAccumulator.endAccumulation();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+}
+
+void SceneRenderer::drawAccumulation()
+{
+  glViewport(0, 0, m_ViewportSize.x, m_ViewportSize.y);
+  drawUpscale(m_SampleAccumulator.accumulationTexture(), m_ViewportSize);
+}
+
+void SceneRenderer::drawAuxiliaryBuffers(const Camera &camera)
+{
+  const auto &model = m_Model;
+  const auto instancing = m_Settings.useInstancing;
+  m_Settings.useInstancing = false;
+  m_DepthOnlyPass = true;
+  m_SceneFeatureMask = AUXILIARY_PASS;
+  m_ViewMatrix = camera.getViewMatrix();
+  m_FrameProjMatrix = m_ProjMatrix;
+  ++m_FrameIndex;
+  const auto program = selectProgram(AUXILIARY_PASS);
+  if (!program) {
+    throw std::runtime_error(m_ShaderErrorLog);
+  }
+  const std::function<void(int, const glm::mat4 &)> drawNode =
+      [&](int nodeIdx, const glm::mat4 &parentMatrix) {
+        const auto &node = model.nodes[nodeIdx];
+        const auto modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
+        if (node.mesh >= 0) {
+          m_NodeModelMatrix = modelMatrix;
+          m_NodeMatrixChanged = true;
+          // For the normals of the back faces
+          glFrontFace(frontFace(modelMatrix));
+          glUniform1i(program->nodeIdLocation, nodeIdx + 1);
+          const auto &primitives = model.meshes[node.mesh].primitives;
+          for (size_t i = 0; i < primitives.size(); ++i) {
+            glUniform1i(
+                program->materialIdLocation, primitives[i].material + 1);
+            drawPrimitive(node.mesh, i, 1, 0);
+          }
+        }
+        for (const auto childNode : node.children) {
+          drawNode(childNode, modelMatrix);
+        }
+      };
+  if (model.defaultScene >= 0) {
+    for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
+      drawNode(nodeIdx, glm::mat4(1));
+    }
+  }
+  glFrontFace(GL_CCW);
+  glBindVertexArray(0);
+  m_BoundVertexArray = 0;
+  m_Settings.useInstancing = instancing;
+  m_DepthOnlyPass = false;
+}
+
+std::string SceneRenderer::benchmarkRenderers(const Camera &camera)
+{
+  // The lights and the renderer are restored at the end
+  auto &settings = m_Settings;
+  const auto previousSettings = settings;
+  const auto previousRandomLights = m_RandomLights;
+
+  const int warmupFrameCount = 10;
+  const int frameCount = 100;
+  GLuint query = 0;
+  glGenQueries(1, &query);
+  const auto averageFrameTime = [&]() {
+    for (int i = 0; i < warmupFrameCount; ++i) {
+      drawScene(camera);
+    }
+    GLuint64 totalNanoseconds = 0;
+    for (int i = 0; i < frameCount; ++i) {
+      glBeginQuery(GL_TIME_ELAPSED, query);
+      drawScene(camera);
+      glEndQuery(GL_TIME_ELAPSED);
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      totalNanoseconds += nanoseconds;
+    }
+    return totalNanoseconds / (1e6 * frameCount);
+  };
+
+  // The random lights go through the clusters with both renderers, only the
+  // directional light is added to them
+  settings.enablePointLight = false;
+  settings.enablePointLightAdditionnal = false;
+  settings.enableSpotLight = false;
+  settings.useClusteredLighting = true;
+  std::stringstream report;
+  report << "Lights  Forward (ms)  Deferred (ms)\n"
+         << std::fixed << std::setprecision(3);
+  for (const auto lightCount : {1, 10, 100}) {
+    spawnRandomLights(lightCount);
+    settings.useDeferredRendering = false;
+    const auto forwardTime = averageFrameTime();
+    settings.useDeferredRendering = true;
+    const auto deferredTime = averageFrameTime();
+    report << std::setw(6) << lightCount << std::setw(14) << forwardTime
+           << std::setw(15) << deferredTime << '\n';
+  }
+  glDeleteQueries(1, &query);
+
+  m_RandomLights = previousRandomLights;
+  settings = previousSettings;
+
+  std::cout << "GPU frame time at " << m_Width << "x" << m_Height
+            << ", average of " << frameCount << " frames:\n"
+            << report.str();
+  return report.str();
+}
+
+void SceneRenderer::spawnRandomLights(int count)
+{
+  static std::mt19937 generator;
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  const auto diagVector = m_BboxMax - m_BboxMin;
+  // A light lits about a tenth of the scene
+  const auto range = 0.1f * glm::length(diagVector);
+  m_RandomLights.resize(count);
+  for (auto &light : m_RandomLights) {
+    const auto random = [&]() {
+      return glm::vec3(unit(generator), unit(generator), unit(generator));
+    };
+    light.position = m_BboxMin + random() * diagVector;
+    light.color = random();
+    light.color /=
+        glm::max(light.color.r, glm::max(light.color.g, light.color.b));
+    // Half intensity at a quarter of the range
+    light.attenuation = glm::vec3(1, 0, 16.f / (range * range));
+    light.range = range;
+  }
+}
+
+void SceneRenderer::reloadShaders()
+{
+  // On failure the previous programs are kept and the log is displayed. The
+  // permutations include the passes of the deferred renderer and the image
+  // based lighting ones, the light assignment compute shader is apart.
+  try {
+    m_ClusteredLights.reloadProgram();
+  } catch (const std::exception &e) {
+    m_ShaderErrorLog = e.what();
+    return;
+  }
+  if (m_ForwardPrograms.rebuild(m_ShaderErrorLog)) {
+    m_ShaderErrorLog.clear();
+  }
+  m_ShadowMaps.invalidate();
+}
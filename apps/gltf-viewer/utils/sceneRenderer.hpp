@@ -0,0 +1,408 @@
+#pragma once
+
+#include "cameras.hpp"
+#include "clusteredLights.hpp"
+#include "dynamicResolution.hpp"
+#include "environmentLighting.hpp"
+#include "filesystem.hpp"
+#include "forwardProgram.hpp"
+#include "frameGraph.hpp"
+#include "gltf.hpp"
+#include "meshArena.hpp"
+#include "overdrawMeter.hpp"
+#include "programBinaryCache.hpp"
+#include "sampleAccumulator.hpp"
+#include "shaderPermutations.hpp"
+#include "shadowMaps.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A range of indices in a vector containing Vertex Array Objects
+struct VaoRange
+{
+  GLsizei begin; // Index of first element in vertexArrayObjects
+  GLsizei count; // Number of elements in range
+};
+
+// All the instances of a mesh, drawn with one instanced draw call per
+// primitive
+struct InstanceBatch
+{
+  int meshIndex;
+  GLuint firstInstance; // Index of first matrix in the instance buffer
+  GLsizei instanceCount;
+};
+
+// GPU resources of a model, created by the viewer from its buffers
+struct SceneResources
+{
+  std::vector<GLuint> textureObjects; // Indexed like model.textures
+  // The geometry, either repacked in meshArena or in the buffers of the model
+  // with one VAO per primitive, the other one staying empty
+  bool useMeshArena = true;
+  MeshArena meshArena;
+  std::vector<GLuint> vertexArrayObjects; // One per primitive
+  std::vector<VaoRange> meshToVertexArrays;
+  // Per-instance model and normal matrices, attached to the VAOs (vertex
+  // attributes 5 to 11)
+  GLuint instanceBufferObject = 0;
+  std::vector<InstanceBatch> instanceBatches;
+};
+
+// Renderer of a glTF model: the passes of a frame (shadow maps, depth
+// pre-pass, forward or G-buffer geometry, deferred lighting, blended
+// primitives) recorded in a FrameGraph, and the frames around them: dynamic
+// resolution, progressive refinement and the auxiliary buffers pass.
+//
+// Every draw goes to the framebuffer bound to GL_DRAW_FRAMEBUFFER, of
+// width() x height() pixels, with the projection set by setPerspective(). The
+// programs are permutations of the forward program, see ForwardProgram, built
+// on first use.
+class SceneRenderer
+{
+public:
+  // glm::perspective takes radians: 70 is a vertical field of view of about
+  // 50.7 degrees (70 - 22 pi). The views of --cameras can change it.
+  static constexpr float DEFAULT_FOVY = 70.f;
+
+  // Parameters of the frames, edited by the GUI between them
+  struct Settings
+  {
+    /** Directional light **/
+    glm::vec3 lightDirection = glm::vec3(0, 1, 0); // World space
+    glm::vec3 lightIntensity = glm::vec3(3.f);
+    bool lightFromCamera = false;
+
+    /** Point lights **/
+    glm::vec3 pointLightIntensity[NB_POINTS_LIGHTS] = {
+        glm::vec3(1.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f)};
+    glm::vec3 pointLightPosition[NB_POINTS_LIGHTS] = {
+        glm::vec3(-10.f, 5.f, 0.f), glm::vec3(10.f, 5.f, 0.f),
+        glm::vec3(0.f, 5.f, 0.f)};
+    bool enablePointLight = true;
+    bool enablePointLightAdditionnal = true;
+
+    /** Spot light, attached to the camera **/
+    glm::vec3 spotLightIntensity = glm::vec3(1.f);
+    glm::vec3 spotLightPosition = glm::vec3(0.f);
+    glm::vec3 spotLightDirection = glm::vec3(0.f, 0.f, -1.f);
+    bool enableSpotLight = true;
+    float spotLightCutOff = 12.5f;
+    float spotLightOuterCutOff = 12.5f;
+
+    // The point and spot lights, and the ones of the scene, evaluated through
+    // the clusters. Enabled when the scene has lights.
+    bool useClusteredLighting = false;
+    // Enabled by loadEnvironment()
+    bool useImageBasedLighting = false;
+    float environmentIntensity = 1.f;
+    bool useShadows = true;
+    bool normalMapping = false;
+    bool useInstancing = true;
+
+    // Draw order: the opaque primitives are sorted front to back, so that the
+    // depth test rejects the hidden fragments before they are shaded, then the
+    // blended ones are drawn back to front over them. The back faces of the
+    // single sided materials are culled.
+    bool cullBackFaces = true;
+    bool sortOpaqueItems = true;
+
+    // Deferred renderer: the materials are written to the G-buffer, then the
+    // lights are evaluated once per pixel by a full screen triangle
+    bool useDeferredRendering = false;
+
+    // Depth pre-pass: the geometry is first drawn with a depth only program,
+    // so that the shading pass only shades the visible fragments. In auto
+    // mode it is enabled when the overdraw, measured periodically, exceeds
+    // the threshold.
+    int depthPrePassMode = 2; // 0: off, 1: on, 2: auto
+    float overdrawThreshold = 2.f;
+
+    // Dynamic resolution of drawFrame(): the scene is rendered at a scale of
+    // the resolution adjusted to hold the target GPU frame time, then
+    // upscaled
+    bool useDynamicResolution = false;
+    float targetFrameTime = 16.f; // Milliseconds
+  };
+
+  // The model and the resources must outlive the renderer. The shaders are
+  // read from shadersPath, the linked programs stored in programCachePath.
+  SceneRenderer(const tinygltf::Model &model, SceneResources resources,
+      const fs::path &shadersPath, const std::string &vertexShader,
+      const std::string &fragmentShader, const fs::path &programCachePath,
+      GLsizei width, GLsizei height);
+  ~SceneRenderer();
+
+  SceneRenderer(const SceneRenderer &) = delete;
+  SceneRenderer &operator=(const SceneRenderer &) = delete;
+
+  // Light the scene with an equirectangular HDR image, precomputed or read
+  // from cacheDirectory, and enable image based lighting. Throw
+  // std::runtime_error if the image cannot be read.
+  void loadEnvironment(const fs::path &path, const fs::path &cacheDirectory);
+
+  // Compile the programs of the materials for the current settings now,
+  // rather than during the first frame
+  void precompilePrograms();
+
+  Settings &settings() { return m_Settings; }
+  const Settings &settings() const { return m_Settings; }
+
+  /** Bounds of the scene, and the depth range of the projections **/
+  const glm::vec3 &bboxMin() const { return m_BboxMin; }
+  const glm::vec3 &bboxMax() const { return m_BboxMax; }
+  float zNear() const { return m_ZNear; }
+  float zFar() const { return m_ZFar; }
+
+  /** Size and projection of the images drawn **/
+  GLsizei width() const { return m_Width; }
+  GLsizei height() const { return m_Height; }
+  // Keep the projection, call setPerspective() for the new aspect ratio
+  void setSize(GLsizei width, GLsizei height);
+  // Projection of the whole image, fovy in radians
+  void setPerspective(float fovy);
+  // Projection of a tile of the image, a sub-frustum of imageProjMatrix():
+  // the shadow cascades stay fitted to the whole image, the same for all the
+  // tiles
+  void setTileProjection(const glm::mat4 &projMatrix);
+  const glm::mat4 &projMatrix() const { return m_ProjMatrix; }
+  const glm::mat4 &imageProjMatrix() const { return m_ImageProjMatrix; }
+
+  /** Draw on the framebuffer bound to GL_DRAW_FRAMEBUFFER **/
+  void drawScene(const Camera &camera);
+  // At the scale of dynamic resolution if enabled
+  void drawFrame(const Camera &camera);
+  // One more sample of the scene, jittered, averaged with the samples already
+  // accumulated. Nothing is drawn on the framebuffer.
+  void accumulateSample(const Camera &camera);
+  // Copy the average of the samples
+  void drawAccumulation();
+  void resetSamples() { m_SampleAccumulator.reset(); }
+  int sampleCount() const { return m_SampleAccumulator.sampleCount(); }
+  // The ids and the geometry of the nodes, for the framebuffer of an
+  // AuxiliaryBuffers (auxiliary_buffers.fs.glsl): one pass without
+  // instancing, to set the id of each node, the materials ignored as by the
+  // depth pre-pass. Throw std::runtime_error if its program does not compile.
+  void drawAuxiliaryBuffers(const Camera &camera);
+
+  // GPU frame time of the forward and the deferred renderers with 1, 10 and
+  // 100 random lights, measured with GL_TIME_ELAPSED queries. Print the
+  // report and return it. The settings are restored at the end.
+  std::string benchmarkRenderers(const Camera &camera);
+
+  // Replace the random lights by count new ones, lighting about a tenth of
+  // the scene each
+  void spawnRandomLights(int count);
+
+  // Hot reload: build the programs again from the shaders on disk. On
+  // failure the previous programs are kept and shaderErrorLog() tells why.
+  void reloadShaders();
+  // Last compilation error of the shaders, empty if none
+  const std::string &shaderErrorLog() const { return m_ShaderErrorLog; }
+
+  /** Stats, for the GUI **/
+  size_t sceneLightCount() const { return m_SceneLights.size(); }
+  size_t randomLightCount() const { return m_RandomLights.size(); }
+  const ClusteredLights &clusteredLights() const { return m_ClusteredLights; }
+  // Empty without environment
+  const std::string &environmentReport() const { return m_EnvironmentReport; }
+  const ShadowMaps &shadowMaps() const { return m_ShadowMaps; }
+  // View distances where the cascades end
+  const float *cascadeEnds() const { return m_CascadeEnds; }
+  const DynamicResolution &dynamicResolution() const
+  {
+    return m_DynamicResolution;
+  }
+  const FrameGraph &frameGraph() const { return m_FrameGraph; }
+  const OverdrawMeter &overdrawMeter() const { return m_OverdrawMeter; }
+  bool depthPrePassActive() const { return m_DepthPrePassActive; }
+  size_t opaqueDrawCount() const { return m_OpaqueItems.size(); }
+  size_t blendedDrawCount() const { return m_BlendedItems.size(); }
+  GLsizei drawCallCount() const { return m_DrawCallCount; }
+  GLsizei vaoBindCount() const { return m_VaoBindCount; }
+  size_t programCount() const { return m_ForwardPrograms.size(); }
+  GLsizei programSwitchCount() const { return m_ProgramSwitchCount; }
+  const ProgramBinaryCache &programBinaryCache() const
+  {
+    return m_ProgramBinaryCache;
+  }
+  bool useMeshArena() const { return m_Resources.useMeshArena; }
+  const MeshArena &meshArena() const { return m_Resources.meshArena; }
+  GLsizei instanceCount() const { return m_InstanceCount; }
+  size_t instanceBatchCount() const
+  {
+    return m_Resources.instanceBatches.size();
+  }
+
+private:
+  // A primitive drawn this frame: the instances of a batch, or a single node
+  // without instancing. The items are sorted by depth before being drawn.
+  struct DrawItem
+  {
+    int meshIndex;
+    size_t primitiveIndex;
+    GLuint firstInstance;
+    GLsizei instanceCount;
+    glm::mat4 modelMatrix; // Of the node, without instancing
+    GLenum frontFace; // GL_CW when mirrored, GL_NONE to not cull the item
+    float depth;      // Distance of the primitive along the view axis
+  };
+
+  ForwardProgram buildProgram(uint32_t featureMask);
+  // Features of the leanest program for a material
+  uint32_t materialFeatures(int materialIndex) const;
+  // Features of the programs for the enabled lights
+  uint32_t sceneFeatures() const;
+  bool isBlended(int materialIndex) const;
+
+  /** Uniforms and draws, shared by the passes **/
+  void bindMaterial(const ForwardProgram &program, int materialIndex) const;
+  // Lights and camera parameters, once per frame and program
+  void setFrameUniforms(const ForwardProgram &program) const;
+  // Model matrices of the node being drawn without instancing
+  void setNodeUniforms(const ForwardProgram &program) const;
+  // Select the program of a feature mask and bring its frame uniforms up to
+  // date, nullptr if it does not compile
+  const ForwardProgram *selectProgram(uint32_t featureMask);
+  // Select the program of a material and bring its uniforms up to date,
+  // nullptr if it does not compile
+  const ForwardProgram *useProgram(int materialIndex);
+  // Draw instanceCount instances of a primitive, their model matrices
+  // starting at firstInstance in the instance buffer
+  void drawPrimitive(int meshIdx, size_t primitiveIdx, GLsizei instanceCount,
+      GLuint firstInstance);
+  // Copy the lower left corner of a texture, of sourceSize pixels, over the
+  // viewport
+  void drawUpscale(GLuint texture, const glm::ivec2 &sourceSize);
+  // Cull the back faces of the materials unless they are double sided
+  void drawItems(const std::vector<DrawItem> &items);
+
+  /** Passes **/
+  // Hash of the world matrices of the meshes inside the view of a light
+  uint64_t shadowCasterSignature(const ShadowView &view) const;
+  // Render the opaque items of the frame in the layers of the shadow maps
+  // whose view or casters changed
+  void drawShadowMaps();
+  // The blended primitives are not in the G-buffer, they are drawn by the
+  // forward programs over the lit color of the deferred renderer
+  void drawBlendedItems();
+  // All the point and spot lights in the clusters, in view space
+  void updateClusteredLights();
+  // Draw lists of the frame, sorted along the view axis
+  void collectDrawItems();
+  // Add the passes drawing the scene to the frame graph, on colorTarget and
+  // depthTarget (the same resource for an imported framebuffer). The draw
+  // lists and the lights are prepared now, the passes draw them when the
+  // graph is executed.
+  void addScenePasses(const Camera &camera, FrameGraph::Resource colorTarget,
+      FrameGraph::Resource depthTarget);
+
+  const tinygltf::Model &m_Model;
+  const SceneResources m_Resources;
+  Settings m_Settings;
+
+  glm::vec3 m_BboxMin;
+  glm::vec3 m_BboxMax;
+  float m_ZNear;
+  float m_ZFar;
+
+  GLsizei m_Width;
+  GLsizei m_Height;
+  // Of the scene, smaller than the image with dynamic resolution
+  glm::ivec2 m_ViewportSize;
+  glm::mat4 m_ProjMatrix;
+  // Projection of the frame being drawn, jittered by a sub-pixel offset when
+  // the samples of progressive refinement are accumulated
+  glm::mat4 m_FrameProjMatrix;
+  // Projection of the whole image, m_ProjMatrix only covers a tile of it in
+  // tiled rendering
+  glm::mat4 m_ImageProjMatrix;
+
+  /** Programs: one per feature mask, built on first use with only the code
+   * its material and the lights of the scene need **/
+  const fs::path m_VertexShaderPath;
+  const fs::path m_FragmentShaderPath;
+  // Passes of the deferred renderer, and depth only passes
+  const fs::path m_GBufferShaderPath;
+  const fs::path m_FullScreenShaderPath;
+  const fs::path m_LightingShaderPath;
+  const fs::path m_DepthOnlyShaderPath;
+  const fs::path m_UpscaleShaderPath;
+  const fs::path m_AuxiliaryBuffersShaderPath;
+  // Linked programs are stored on disk to skip compilation on next launches
+  ProgramBinaryCache m_ProgramBinaryCache;
+  ProgramPermutationCache<ForwardProgram> m_ForwardPrograms;
+
+  /** Lights **/
+  // Lights of KHR_lights_punctual and lights spawned from the GUI, evaluated
+  // with the built-in point and spot lights through the clusters
+  std::vector<PunctualLight> m_SceneLights;
+  std::vector<PunctualLight> m_RandomLights;
+  std::vector<PunctualLight> m_ViewSpaceLights; // All of them, each frame
+  ClusteredLights m_ClusteredLights;
+  EnvironmentLighting m_EnvironmentLighting;
+  EnvironmentTextures m_EnvironmentTextures;
+  std::string m_EnvironmentReport;
+  // The directional light casts shadows through cascades fitted to the
+  // visible part of the scene, the spot light through its cone. Each layer is
+  // cached and rendered again only when its view or its casters move.
+  ShadowMaps m_ShadowMaps{2048};
+  float m_CascadeEnds[ShadowMaps::CASCADE_COUNT] = {};
+
+  /** Geometry **/
+  GLuint m_WhiteTexture = 0; // Of the textures absent from a material
+  GLsizei m_InstanceCount = 0;
+  GLuint m_FullScreenVertexArray = 0; // Empty, see fullscreen_triangle.vs
+
+  /** Draw order **/
+  std::vector<DrawItem> m_OpaqueItems;
+  std::vector<DrawItem> m_BlendedItems;
+  std::vector<std::vector<glm::vec3>> m_PrimitiveCenters;
+  // Bounding spheres of the meshes in model space, to find the shadow casters
+  std::vector<glm::vec3> m_MeshCenters;
+  std::vector<float> m_MeshRadii;
+  // Same matrices as the instance buffer, where the instances of each batch
+  // are sorted too. The batches mixing mirrored and not mirrored instances
+  // are not culled.
+  std::vector<std::vector<glm::mat4>> m_MeshInstances;
+  std::vector<GLenum> m_BatchFrontFaces;
+  std::vector<std::vector<GLuint>> m_BatchInstanceOrders;
+  std::vector<GLuint> m_InstanceOrder;
+  std::vector<float> m_InstanceDepths;
+  std::vector<InstanceAttributes> m_SortedInstances;
+
+  /** Frames **/
+  // Passes of the frame and their render targets, recorded then executed
+  // every frame, see addScenePasses
+  FrameGraph m_FrameGraph;
+  bool m_DepthPrePassActive = false;
+  OverdrawMeter m_OverdrawMeter;
+  DynamicResolution m_DynamicResolution;
+  // Progressive refinement: jittered samples of the scene, averaged
+  SampleAccumulator m_SampleAccumulator;
+
+  /** State of the frame being drawn, shared by the programs **/
+  glm::mat4 m_ViewMatrix = glm::mat4(1);
+  uint64_t m_FrameIndex = 0;
+  std::vector<uint32_t> m_MaterialFeatureMasks;
+  // Features added to the ones of the materials: the lights for the forward
+  // renderer, GBUFFER_PASS for the deferred one
+  uint32_t m_SceneFeatureMask = 0;
+  ForwardProgram *m_CurrentProgram = nullptr;
+  bool m_DepthOnlyPass = false; // Materials are ignored by the depth pre-pass
+  std::string m_ShaderErrorLog;
+  // Model matrix of the node being drawn without instancing
+  glm::mat4 m_NodeModelMatrix = glm::mat4(1);
+  bool m_NodeMatrixChanged = false;
+
+  GLsizei m_DrawCallCount = 0;
+  GLsizei m_VaoBindCount = 0;
+  GLsizei m_ProgramSwitchCount = 0;
+  GLuint m_BoundVertexArray = 0;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+// In-memory cache of the permutations of a program: the same shader files
+// compiled with different #defines. Each permutation is identified by a
+// feature mask, and is built with the builder function the first time it is
+// requested. ProgramType wraps a GLProgram, possibly with the locations of its
+// uniforms.
+template <typename ProgramType> class ProgramPermutationCache
+{
+public:
+  using Builder = std::function<ProgramType(uint32_t featureMask)>;
+
+  explicit ProgramPermutationCache(Builder builder) :
+      m_Builder(std::move(builder))
+  {
+  }
+
+  // Return the permutation for featureMask, building it if needed
+  ProgramType &get(uint32_t featureMask)
+  {
+    auto it = m_Programs.find(featureMask);
+    if (it == end(m_Programs)) {
+      it = m_Programs.emplace(featureMask, m_Builder(featureMask)).first;
+    }
+    return (*it).second;
+  }
+
+  bool contains(uint32_t featureMask) const
+  {
+    return m_Programs.find(featureMask) != end(m_Programs);
+  }
+
+  // Build again every cached permutation, after their sources were edited. If
+  // one of them fails, all the previous programs are kept and the error (the
+  // compilation or link log) is returned in errorMessage.
+  bool rebuild(std::string &errorMessage)
+  {
+    std::unordered_map<uint32_t, ProgramType> programs;
+    try {
+      for (const auto &program : m_Programs) {
+        programs.emplace(program.first, m_Builder(program.first));
+      }
+    } catch (const std::exception &e) {
+      errorMessage = e.what();
+      return false;
+    }
+    m_Programs.swap(programs);
+    return true;
+  }
+
+  size_t size() const { return m_Programs.size(); }
+
+  void clear() { m_Programs.clear(); }
+
+private:
+  Builder m_Builder;
+  std::unordered_map<uint32_t, ProgramType> m_Programs;
+};
@@ -0,0 +1,97 @@
+#include "shaderWatcher.hpp"
+
+#include <fstream>
+
+ShaderFileWatcher::ShaderFileWatcher(fs::path directory,
+    std::function<void()> onChange, std::chrono::milliseconds period) :
+    m_Directory(std::move(directory)),
+    m_OnChange(std::move(onChange)),
+    m_Period(period),
+    m_Thread([this]() { watch(); })
+{
+}
+
+ShaderFileWatcher::~ShaderFileWatcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_StopCondition.notify_one();
+  m_Thread.join();
+}
+
+bool ShaderFileWatcher::takeChange(Clock::time_point &detectionTime)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Changed) {
+    return false;
+  }
+  m_Changed = false;
+  detectionTime = m_DetectionTime;
+  return true;
+}
+
+void ShaderFileWatcher::watch()
+{
+  auto files = scan();
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (!m_StopCondition.wait_for(
+      lock, m_Period, [this]() { return m_Stop; })) {
+    lock.unlock();
+    auto newFiles = scan();
+    const auto changed = newFiles != files;
+    files = std::move(newFiles);
+    lock.lock();
+    if (changed && !m_Changed) {
+      m_Changed = true;
+      m_DetectionTime = Clock::now();
+    }
+    if (changed && m_OnChange) {
+      lock.unlock();
+      m_OnChange();
+      lock.lock();
+    }
+  }
+}
+
+std::map<std::string, fs::file_time_type> ShaderFileWatcher::scan() const
+{
+  std::map<std::string, fs::file_time_type> files;
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(m_Directory, error), end;
+       !error && it != end; it.increment(error)) {
+    if (fs::is_regular_file(it->status())) {
+      // A file being written may disappear, it is then seen on next scan
+      const auto writeTime = fs::last_write_time(it->path(), error);
+      if (!error) {
+        files[it->path().string()] = writeTime;
+      }
+      error.clear();
+    }
+  }
+  return files;
+}
+
+void copyShaderFiles(
+    const fs::path &sourceDirectory, const fs::path &outputDirectory)
+{
+  const auto sourcePrefixSize = sourceDirectory.string().size();
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(sourceDirectory, error), end;
+       !error && it != end; it.increment(error)) {
+    if (!fs::is_regular_file(it->status())) {
+      continue;
+    }
+    const auto outputPath =
+        fs::path(outputDirectory.string() +
+                 it->path().string().substr(sourcePrefixSize));
+    std::error_code directoryError;
+    fs::create_directories(outputPath.parent_path(), directoryError);
+    std::ifstream input(it->path(), std::ios::binary);
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (input && output) {
+      output << input.rdbuf();
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Watch the files of a directory from a background thread, by polling their
+// last write time. The render thread calls takeChange() once per frame to
+// know if something changed since its last call. onChange, if any, is called
+// from the background thread when a change is detected, e.g. to wake up a
+// render thread waiting for events.
+class ShaderFileWatcher
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  ShaderFileWatcher(fs::path directory,
+      std::function<void()> onChange = nullptr,
+      std::chrono::milliseconds period = std::chrono::milliseconds(250));
+  ~ShaderFileWatcher();
+
+  ShaderFileWatcher(const ShaderFileWatcher &) = delete;
+  ShaderFileWatcher &operator=(const ShaderFileWatcher &) = delete;
+
+  // Return true if a file was added, removed or modified since the last call.
+  // detectionTime is then the time the watcher noticed the first change.
+  bool takeChange(Clock::time_point &detectionTime);
+
+private:
+  void watch();
+  std::map<std::string, fs::file_time_type> scan() const;
+
+  const fs::path m_Directory;
+  const std::function<void()> m_OnChange;
+  const std::chrono::milliseconds m_Period;
+
+  std::mutex m_Mutex;
+  std::condition_variable m_StopCondition;
+  bool m_Stop = false;
+  bool m_Changed = false;
+  Clock::time_point m_DetectionTime;
+
+  std::thread m_Thread; // Last member: started once the others are ready
+};
+
+// Copy the files of sourceDirectory over the ones of outputDirectory, with the
+// same layout, as the build does for the shaders. The hot reload watches the
+// sources and compiles the programs from the copies.
+void copyShaderFiles(
+    const fs::path &sourceDirectory, const fs::path &outputDirectory);
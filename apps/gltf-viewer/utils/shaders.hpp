@@ -1,7 +1,9 @@
 #pragma once
 
 #include "filesystem.hpp"
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <glad/glad.h>
 #include <iostream>
 #include <memory>
@@ -9,6 +11,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 
 class GLShader
@@ -66,19 +69,89 @@ public:
   }
 };
 
+// Load a shader and expand its #include "file" lines, file being relative to
+// the directory of the including file. #line directives keep the line numbers
+// of compilation errors relative to each file, an included file being
+// identified by its source string number: 1 for the first included, 2 for the
+// second, etc. (0 is the loaded file).
 inline std::string loadShaderSource(const fs::path &filepath)
 {
-  std::ifstream input(filepath.string());
-  if (!input) {
-    std::stringstream ss;
-    ss << "Unable to open file " << filepath;
-    throw std::runtime_error(ss.str());
+  int includedFileCount = 0;
+  const std::function<std::string(const fs::path &, int, int)> load =
+      [&](const fs::path &path, int sourceNumber, int depth) {
+        if (depth > 16) {
+          throw std::runtime_error(
+              "Too many nested #include in " + path.string());
+        }
+        std::ifstream input(path.string());
+        if (!input) {
+          std::stringstream ss;
+          ss << "Unable to open file " << path;
+          throw std::runtime_error(ss.str());
+        }
+
+        std::stringstream buffer;
+        std::string line;
+        for (int lineNumber = 1; std::getline(input, line); ++lineNumber) {
+          const auto start = line.find_first_not_of(" \t");
+          if (start == std::string::npos ||
+              line.compare(start, 8, "#include") != 0) {
+            buffer << line << '\n';
+            continue;
+          }
+          const auto nameBegin = line.find('"', start);
+          const auto nameEnd = line.find('"', nameBegin + 1);
+          if (nameBegin == std::string::npos ||
+              nameEnd == std::string::npos) {
+            throw std::runtime_error("Malformed #include at " + path.string() +
+                                     ":" + std::to_string(lineNumber));
+          }
+          const auto includedPath =
+              path.parent_path() /
+              line.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+          buffer << "#line 1 " << ++includedFileCount << '\n';
+          buffer << load(includedPath, includedFileCount, depth + 1);
+          buffer << "#line " << lineNumber + 1 << ' ' << sourceNumber << '\n';
+        }
+        return buffer.str();
+      };
+
+  return load(filepath, 0, 0);
+}
+
+// Insert a "#define" line for each element of defines (e.g. "HAS_NORMAL_MAP" or
+// "NUM_POINT_LIGHTS 2") right after the #version directive of src, which must
+// stay the first statement of a GLSL shader. A #line directive keeps the line
+// numbers of compilation errors relative to the original file.
+inline std::string preprocessShaderSource(
+    const std::string &src, const std::vector<std::string> &defines)
+{
+  if (defines.empty()) {
+    return src;
   }
 
-  std::stringstream buffer;
-  buffer << input.rdbuf();
+  size_t insertPosition = 0;
+  size_t firstLineAfterVersion = 1;
+  const auto versionPosition = src.find("#version");
+  if (versionPosition != std::string::npos) {
+    const auto endOfLine = src.find('\n', versionPosition);
+    insertPosition =
+        endOfLine == std::string::npos ? src.size() : endOfLine + 1;
+    firstLineAfterVersion =
+        std::count(begin(src), begin(src) + insertPosition, '\n') + 1;
+  }
 
-  return buffer.str();
+  std::stringstream ss;
+  ss << src.substr(0, insertPosition);
+  if (insertPosition == src.size() && !src.empty() && src.back() != '\n') {
+    ss << '\n';
+  }
+  for (const auto &define : defines) {
+    ss << "#define " << define << '\n';
+  }
+  ss << "#line " << firstLineAfterVersion << '\n';
+  ss << src.substr(insertPosition);
+  return ss.str();
 }
 
 template <typename StringType>
@@ -98,7 +171,9 @@ GLShader compileShader(GLenum type, StringType &&src)
 // *.fs.glsl -> fragment shader
 // *.gs.glsl -> geometry shader
 // *.cs.glsl -> compute shader
-inline GLShader loadShader(const fs::path &shaderPath)
+// defines are inserted in the source, see preprocessShaderSource.
+inline GLShader loadShader(const fs::path &shaderPath,
+    const std::vector<std::string> &defines = {})
 {
   static auto extToShaderType =
       std::unordered_map<std::string, std::pair<GLenum, std::string>>(
@@ -118,7 +193,8 @@ inline GLShader loadShader(const fs::path &shaderPath)
             << "\n";
 
   GLShader shader{(*it).second.first};
-  shader.setSource(loadShaderSource(shaderPath));
+  shader.setSource(
+      preprocessShaderSource(loadShaderSource(shaderPath), defines));
   shader.compile();
   if (!shader.getCompileStatus()) {
     std::cerr << "Shader compilation error:" << shader.getInfoLog()
@@ -244,11 +320,12 @@ template <typename CSrc> GLProgram buildComputeProgram(CSrc &&src)
   ;
 }
 
-inline GLProgram compileProgram(std::vector<fs::path> shaderPaths)
+inline GLProgram compileProgram(std::vector<fs::path> shaderPaths,
+    const std::vector<std::string> &defines = {})
 {
   GLProgram program;
   for (const auto &path : shaderPaths) {
-    auto shader = loadShader(path);
+    auto shader = loadShader(path, defines);
     program.attachShader(shader);
   }
   program.link();
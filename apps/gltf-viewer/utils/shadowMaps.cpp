@@ -0,0 +1,272 @@
+#include "shadowMaps.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+
+bool operator==(const ShadowView &a, const ShadowView &b)
+{
+  return a.viewMatrix == b.viewMatrix && a.projMatrix == b.projMatrix;
+}
+
+void computeBoxCorners(
+    const glm::vec3 &bboxMin, const glm::vec3 &bboxMax, glm::vec3 *corners)
+{
+  for (int i = 0; i < 8; ++i) {
+    corners[i] = glm::vec3(i & 1 ? bboxMax.x : bboxMin.x,
+        i & 2 ? bboxMax.y : bboxMin.y, i & 4 ? bboxMax.z : bboxMin.z);
+  }
+}
+
+// Any direction not parallel to direction
+glm::vec3 upVector(const glm::vec3 &direction)
+{
+  return std::abs(glm::normalize(direction).y) > 0.99f ? glm::vec3(1, 0, 0)
+                                                        : glm::vec3(0, 1, 0);
+}
+
+} // namespace
+
+ShadowMaps::ShadowMaps(GLsizei size) : m_Size(size)
+{
+  glGenTextures(1, &m_Texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, size, size,
+      LAYER_COUNT);
+  // Hardware 2x2 percentage closer filtering
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+      GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGenFramebuffers(1, &m_Framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+  glDrawBuffer(GL_NONE); // Depth only
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+
+  glGenQueries(2, m_Queries);
+}
+
+ShadowMaps::~ShadowMaps()
+{
+  glDeleteQueries(2, m_Queries);
+  glDeleteFramebuffers(1, &m_Framebuffer);
+  glDeleteTextures(1, &m_Texture);
+}
+
+std::vector<std::string> ShadowMaps::shaderDefines()
+{
+  return {"SHADOW_CASCADE_COUNT " + std::to_string(CASCADE_COUNT),
+      "SPOT_SHADOW_LAYER " + std::to_string(SPOT_LAYER),
+      "SHADOW_LAYER_COUNT " + std::to_string(LAYER_COUNT)};
+}
+
+void ShadowMaps::beginUpdates()
+{
+  if (m_QueryPending) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(m_Queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 start = 0, end = 0;
+      glGetQueryObjectui64v(m_Queries[0], GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(m_Queries[1], GL_QUERY_RESULT, &end);
+      m_GpuTime = float((end - start) * 1e-6);
+      m_QueryPending = false;
+    }
+  }
+  for (auto &layer : m_Layers) {
+    layer.updated = false;
+  }
+}
+
+bool ShadowMaps::updateLayer(
+    GLsizei layerIndex, const ShadowView &view, uint64_t casterSignature)
+{
+  auto &layer = m_Layers[layerIndex];
+  if (layer.valid && layer.view == view &&
+      layer.casterSignature == casterSignature) {
+    ++m_HitCount;
+    return false;
+  }
+  ++m_MissCount;
+  layer.valid = true;
+  layer.view = view;
+  layer.casterSignature = casterSignature;
+  layer.updated = true;
+
+  // The first layer of the frame starts the measure, unless the previous one
+  // is still in flight
+  if (!m_Measuring && !m_QueryPending) {
+    glQueryCounter(m_Queries[0], GL_TIMESTAMP);
+    m_Measuring = true;
+  }
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffer);
+  glFramebufferTextureLayer(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Texture, 0, layerIndex);
+  assert(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) ==
+         GL_FRAMEBUFFER_COMPLETE);
+  glViewport(0, 0, m_Size, m_Size);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  return true;
+}
+
+void ShadowMaps::endUpdates()
+{
+  if (m_Measuring) {
+    glQueryCounter(m_Queries[1], GL_TIMESTAMP);
+    m_QueryPending = true;
+    m_Measuring = false;
+  }
+}
+
+void ShadowMaps::invalidate()
+{
+  for (auto &layer : m_Layers) {
+    layer.valid = false;
+  }
+}
+
+void fitShadowCascades(const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, float zNear, float zFar,
+    const glm::vec3 &lightDirection, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax, GLsizei mapSize, ShadowView *cascades,
+    float *cascadeEnds)
+{
+  const auto center = 0.5f * (bboxMax + bboxMin);
+  const auto radius = std::max(0.5f * glm::length(bboxMax - bboxMin), 1e-4f);
+  glm::vec3 sceneCorners[8];
+  computeBoxCorners(bboxMin, bboxMax, sceneCorners);
+
+  // Camera depth range of the scene
+  auto sceneNear = std::numeric_limits<float>::max();
+  auto sceneFar = std::numeric_limits<float>::lowest();
+  for (const auto &corner : sceneCorners) {
+    const auto depth = -(viewMatrix * glm::vec4(corner, 1)).z;
+    sceneNear = std::min(sceneNear, depth);
+    sceneFar = std::max(sceneFar, depth);
+  }
+  const auto depthNear = glm::clamp(sceneNear, zNear, zFar);
+  const auto depthFar = glm::clamp(sceneFar, depthNear, zFar);
+
+  // The light looks at the scene, its depth range covers the whole scene so
+  // that the casters out of the camera frustum are in the cascades too
+  const auto lightView = glm::lookAt(center + radius * lightDirection, center,
+      upVector(lightDirection));
+  auto sceneMin = glm::vec3(std::numeric_limits<float>::max());
+  auto sceneMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (const auto &corner : sceneCorners) {
+    const auto lightSpaceCorner = glm::vec3(lightView * glm::vec4(corner, 1));
+    sceneMin = glm::min(sceneMin, lightSpaceCorner);
+    sceneMax = glm::max(sceneMax, lightSpaceCorner);
+  }
+  const auto depthMargin = 0.01f * radius;
+
+  // Symmetric perspective projection, as created by glm::perspective
+  const auto cameraToLight = lightView * glm::inverse(viewMatrix);
+  const auto tanHalfFovX = 1.f / projMatrix[0][0];
+  const auto tanHalfFovY = 1.f / projMatrix[1][1];
+  // Coarse steps of the cascade sizes
+  const auto sizeStep = radius / 16;
+
+  auto sliceStart = depthNear;
+  for (GLsizei i = 0; i < ShadowMaps::CASCADE_COUNT; ++i) {
+    // Practical split scheme, between logarithmic and uniform splits
+    const auto t = float(i + 1) / ShadowMaps::CASCADE_COUNT;
+    const auto lambda = 0.75f;
+    const auto sliceEnd =
+        i + 1 == ShadowMaps::CASCADE_COUNT
+            ? depthFar
+            : lambda * depthNear * std::pow(depthFar / depthNear, t) +
+                  (1 - lambda) * (depthNear + (depthFar - depthNear) * t);
+
+    // Slice of the camera frustum in light space, intersected with the scene
+    auto boxMin = glm::vec2(std::numeric_limits<float>::max());
+    auto boxMax = glm::vec2(std::numeric_limits<float>::lowest());
+    for (const auto depth : {sliceStart, sliceEnd}) {
+      for (int corner = 0; corner < 4; ++corner) {
+        const auto x = (corner & 1 ? 1 : -1) * depth * tanHalfFovX;
+        const auto y = (corner & 2 ? 1 : -1) * depth * tanHalfFovY;
+        const auto lightSpaceCorner =
+            glm::vec2(cameraToLight * glm::vec4(x, y, -depth, 1));
+        boxMin = glm::min(boxMin, lightSpaceCorner);
+        boxMax = glm::max(boxMax, lightSpaceCorner);
+      }
+    }
+    boxMin = glm::max(boxMin, glm::vec2(sceneMin));
+    boxMax = glm::min(boxMax, glm::vec2(sceneMax));
+    if (boxMin.x >= boxMax.x || boxMin.y >= boxMax.y) {
+      // The slice does not see the scene
+      boxMin = glm::vec2(sceneMin);
+      boxMax = glm::vec2(sceneMax);
+    }
+
+    // A square of a coarse size, with its center on a texel corner, keeps
+    // the same texels when the camera moves a little. The two more steps
+    // leave room for the snapping.
+    const auto extent = std::max(boxMax.x - boxMin.x, boxMax.y - boxMin.y);
+    const auto side = (std::floor(extent / sizeStep) + 2) * sizeStep;
+    const auto texelSize = side / mapSize;
+    const auto boxCenter =
+        glm::floor(0.5f * (boxMin + boxMax) / texelSize + 0.5f) * texelSize;
+
+    cascades[i].viewMatrix = lightView;
+    cascades[i].projMatrix = glm::ortho(boxCenter.x - 0.5f * side,
+        boxCenter.x + 0.5f * side, boxCenter.y - 0.5f * side,
+        boxCenter.y + 0.5f * side, -sceneMax.z - depthMargin,
+        -sceneMin.z + depthMargin);
+    cascadeEnds[i] = sliceEnd;
+    sliceStart = sliceEnd;
+  }
+}
+
+ShadowView spotShadowView(const glm::vec3 &position,
+    const glm::vec3 &direction, float outerCutOff, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax)
+{
+  glm::vec3 sceneCorners[8];
+  computeBoxCorners(bboxMin, bboxMax, sceneCorners);
+  float farthest = 0;
+  for (const auto &corner : sceneCorners) {
+    farthest = std::max(farthest, glm::length(corner - position));
+  }
+  const auto zFar = std::max(1.01f * farthest, 1e-3f);
+
+  ShadowView view;
+  view.viewMatrix =
+      glm::lookAt(position, position + direction, upVector(direction));
+  // A degree of margin around the cone, for the filtering at its edge
+  view.projMatrix = glm::perspective(
+      glm::radians(2 * outerCutOff + 2), 1.f, 1e-3f * zFar, zFar);
+  return view;
+}
+
+bool sphereInShadowView(
+    const ShadowView &view, const glm::vec3 &center, float radius)
+{
+  // Planes of the frustum from the rows of the view-projection matrix
+  const auto m = glm::transpose(view.projMatrix * view.viewMatrix);
+  const glm::vec4 planes[6] = {m[3] + m[0], m[3] - m[0], m[3] + m[1],
+      m[3] - m[1], m[3] + m[2], m[3] - m[2]};
+  for (const auto &plane : planes) {
+    const auto distance =
+        (glm::dot(glm::vec3(plane), center) + plane.w) /
+        glm::length(glm::vec3(plane));
+    if (distance < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
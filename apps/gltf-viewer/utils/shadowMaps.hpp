@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// View and projection matrices of a light rendering a shadow map
+struct ShadowView
+{
+  glm::mat4 viewMatrix;
+  glm::mat4 projMatrix;
+};
+
+// Shadow maps of the viewer: the cascades of the directional light then the
+// spot light, in the layers of a depth texture array sampled with
+// sampler2DArrayShadow (see pbr_lights.glsl).
+//
+// A layer is cached: it is rendered again only when the view of its light
+// changes, or when the signature of the casters inside that view changes (a
+// hash of their world matrices). The layers rendered in a frame are timed
+// with GL_TIMESTAMP queries, which can be issued while a GL_TIME_ELAPSED query
+// measures the whole frame, and read a few frames later once available.
+class ShadowMaps
+{
+public:
+  static const GLsizei CASCADE_COUNT = 3;
+  static const GLsizei SPOT_LAYER = CASCADE_COUNT;
+  static const GLsizei LAYER_COUNT = CASCADE_COUNT + 1;
+
+  explicit ShadowMaps(GLsizei size);
+  ~ShadowMaps();
+
+  ShadowMaps(const ShadowMaps &) = delete;
+  ShadowMaps &operator=(const ShadowMaps &) = delete;
+
+  // #defines of the shaders sampling the layers
+  static std::vector<std::string> shaderDefines();
+
+  GLuint texture() const { return m_Texture; }
+  GLsizei size() const { return m_Size; }
+
+  // Start the updates of a frame, before any updateLayer
+  void beginUpdates();
+  // Whether a layer must be rendered again for a view and its casters. If so,
+  // the layer is bound to GL_DRAW_FRAMEBUFFER, the viewport is set and the
+  // layer is cleared, ready for the casters to be drawn.
+  bool updateLayer(
+      GLsizei layer, const ShadowView &view, uint64_t casterSignature);
+  // End the updates of a frame
+  void endUpdates();
+
+  // Forget the content of the layers, to render them again
+  void invalidate();
+
+  const ShadowView &view(GLsizei layer) const { return m_Layers[layer].view; }
+  // Whether a layer was kept by the last frame
+  bool layerCached(GLsizei layer) const { return !m_Layers[layer].updated; }
+  uint32_t hitCount() const { return m_HitCount; }
+  uint32_t missCount() const { return m_MissCount; }
+  // GPU time of the last frame which rendered layers, in milliseconds
+  float gpuTime() const { return m_GpuTime; }
+
+private:
+  struct Layer
+  {
+    bool valid = false;
+    ShadowView view;
+    uint64_t casterSignature = 0;
+    bool updated = false; // In the last frame
+  };
+  Layer m_Layers[LAYER_COUNT];
+
+  GLsizei m_Size;
+  GLuint m_Texture = 0;
+  GLuint m_Framebuffer = 0;
+
+  GLuint m_Queries[2] = {0, 0}; // Timestamps at the start and end of updates
+  bool m_QueryPending = false;
+  bool m_Measuring = false;
+
+  uint32_t m_HitCount = 0;
+  uint32_t m_MissCount = 0;
+  float m_GpuTime = 0;
+};
+
+// Views of the cascades of a directional light coming from lightDirection.
+// The camera depth range is clipped to the scene bounds and split between
+// the cascades, each cascade covering its slice of the camera frustum
+// intersected with the scene bounds. The cascades are snapped to coarse sizes
+// and to their texels, so that they only change when the camera moves by
+// more than a texel. cascadeEnds receives the view depth where each cascade
+// ends.
+void fitShadowCascades(const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, float zNear, float zFar,
+    const glm::vec3 &lightDirection, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax, GLsizei mapSize, ShadowView *cascades,
+    float *cascadeEnds);
+
+// View of a spot light of outerCutOff degrees, in world space, reaching the
+// whole scene
+ShadowView spotShadowView(const glm::vec3 &position,
+    const glm::vec3 &direction, float outerCutOff, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax);
+
+// Whether a world space sphere intersects the frustum of a view
+bool sphereInShadowView(
+    const ShadowView &view, const glm::vec3 &center, float radius);